@@ -0,0 +1,534 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/smart_handle.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_digest.hpp>
+
+#include "main.hpp"
+#include "output.hpp"
+#include "print.hpp"
+
+namespace
+{
+// Bump whenever a change to the dumper changes its output for a file, so that
+// output cached by older builds isn't used. Combined with the library
+// version.
+std::uint32_t const kDumpCacheRevision = 1;
+
+// 'HDCR'. Also used to find the next record after a corrupt one.
+std::uint32_t const kRecordMagic = 0x52434448;
+
+// Output larger than this isn't cached, and a record claiming to be larger is
+// treated as corrupt.
+std::uint32_t const kMaxOutputSize = 0x10000000;
+
+// Appends and compaction lock this byte (which is never written) to keep
+// other processes using the same cache out.
+DWORD const kLockOffsetHigh = 0x40000000;
+
+std::size_t const kScanChunkSize = 0x10000;
+
+std::uint32_t const kFnvOffsetBasis = 0x811C9DC5;
+
+std::uint32_t const kFnvPrime = 0x01000193;
+
+// Everything after the checksum is covered by it, along with the output which
+// immediately follows the header.
+struct RecordHeader
+{
+  std::uint32_t magic;
+  std::uint32_t checksum;
+  std::uint8_t digest[32];
+  std::uint32_t parser_version;
+  std::uint8_t format;
+  std::uint8_t reserved[3];
+  std::uint32_t warnings;
+  std::uint32_t output_size;
+};
+
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(RecordHeader) == 56);
+
+std::uint32_t HashFnv1a(std::uint32_t hash, void const* data, std::size_t size)
+{
+  auto const bytes = static_cast<std::uint8_t const*>(data);
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash = (hash ^ bytes[i]) * kFnvPrime;
+  }
+  return hash;
+}
+
+std::uint32_t GetRecordChecksum(void const* record, std::size_t size)
+{
+  std::size_t const begin = offsetof(RecordHeader, digest);
+  return HashFnv1a(kFnvOffsetBasis,
+                   static_cast<std::uint8_t const*>(record) + begin,
+                   size - begin);
+}
+
+std::uint32_t GetParserVersion()
+{
+  char const version[] = HADESMEM_VERSION_STRING;
+  std::uint32_t const hash =
+    HashFnv1a(kFnvOffsetBasis, version, sizeof(version) - 1);
+  return HashFnv1a(hash, &kDumpCacheRevision, sizeof(kDumpCacheRevision));
+}
+
+struct IndexKey
+{
+  DumpCacheKey key;
+  std::uint8_t format;
+};
+
+inline bool operator==(IndexKey const& lhs, IndexKey const& rhs)
+{
+  return lhs.format == rhs.format && lhs.key.digest == rhs.key.digest;
+}
+
+struct IndexKeyHash
+{
+  std::size_t operator()(IndexKey const& k) const
+  {
+    // Already a cryptographic hash.
+    std::size_t hash = 0;
+    std::memcpy(&hash, k.key.digest.data(), sizeof(hash));
+    return hash ^ k.format;
+  }
+};
+
+struct RecordLocation
+{
+  std::uint64_t offset;
+  // Including the header.
+  std::uint32_t size;
+};
+
+OVERLAPPED MakeOverlapped(std::uint64_t offset)
+{
+  OVERLAPPED overlapped{};
+  overlapped.Offset = static_cast<DWORD>(offset);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+  return overlapped;
+}
+
+// Locks the cache file against appends and compaction by other processes.
+class FileLock
+{
+public:
+  explicit FileLock(HANDLE file) : file_{file}
+  {
+    OVERLAPPED overlapped = MakeOverlapped(0);
+    overlapped.OffsetHigh = kLockOffsetHigh;
+    if (!::LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString("LockFileEx failed.")
+                          << hadesmem::ErrorCodeWinLast(last_error));
+    }
+  }
+
+  ~FileLock()
+  {
+    OVERLAPPED overlapped = MakeOverlapped(0);
+    overlapped.OffsetHigh = kLockOffsetHigh;
+    ::UnlockFileEx(file_, 0, 1, 0, &overlapped);
+  }
+
+  FileLock(FileLock const&) = delete;
+  FileLock& operator=(FileLock const&) = delete;
+
+private:
+  HANDLE file_;
+};
+
+class DumpCache
+{
+public:
+  explicit DumpCache(std::wstring const& path)
+    : file_{::CreateFileW(path.c_str(),
+                          GENERIC_READ | GENERIC_WRITE,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE,
+                          nullptr,
+                          OPEN_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL,
+                          nullptr)},
+      provider_{hadesmem::detail::AcquireHashProvider()},
+      parser_version_{GetParserVersion()}
+  {
+    if (!file_.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString("Failed to open cache.")
+                          << hadesmem::ErrorCodeWinLast(last_error));
+    }
+
+    Scan();
+  }
+
+  DumpCache(DumpCache const&) = delete;
+  DumpCache& operator=(DumpCache const&) = delete;
+
+  DumpCacheKey GetKey(void const* data, DWORD size) const
+  {
+    hadesmem::detail::CryptHash hash{provider_.GetHandle(), CALG_SHA_256};
+    hash.Update(data, size);
+    auto const digest = hash.Finish();
+    HADESMEM_DETAIL_ASSERT(digest.size() == sizeof(DumpCacheKey::digest));
+
+    DumpCacheKey key;
+    std::copy(std::begin(digest), std::end(digest), std::begin(key.digest));
+    return key;
+  }
+
+  bool Find(DumpCacheKey const& key, DumpCacheEntry& entry) const
+  {
+    IndexKey const index_key{key, static_cast<std::uint8_t>(GetOutputFormat())};
+    RecordLocation location;
+    {
+      hadesmem::detail::AcquireSRWLock const lock(
+        &lock_, hadesmem::detail::SRWLockType::Shared);
+      auto const iter = index_.find(index_key);
+      if (iter == std::end(index_))
+      {
+        return false;
+      }
+      location = iter->second;
+    }
+
+    // Another process may have compacted the file since it was indexed, so
+    // the record has to be checked against the key as well.
+    if (!ReadRecord(location, entry.output))
+    {
+      return false;
+    }
+
+    RecordHeader header;
+    std::memcpy(&header, entry.output.data(), sizeof(header));
+    if (!std::equal(std::begin(key.digest),
+                    std::end(key.digest),
+                    std::begin(header.digest)) ||
+        header.format != index_key.format ||
+        header.parser_version != parser_version_)
+    {
+      return false;
+    }
+
+    entry.output.erase(0, sizeof(header));
+    entry.warnings = header.warnings;
+    return true;
+  }
+
+  void Add(DumpCacheKey const& key, DumpCacheEntry const& entry)
+  {
+    if (entry.output.size() > kMaxOutputSize)
+    {
+      return;
+    }
+
+    IndexKey const index_key{key, static_cast<std::uint8_t>(GetOutputFormat())};
+
+    RecordHeader header{};
+    header.magic = kRecordMagic;
+    std::copy(
+      std::begin(key.digest), std::end(key.digest), std::begin(header.digest));
+    header.parser_version = parser_version_;
+    header.format = index_key.format;
+    header.warnings = entry.warnings;
+    header.output_size = static_cast<std::uint32_t>(entry.output.size());
+
+    std::string record(reinterpret_cast<char const*>(&header), sizeof(header));
+    record += entry.output;
+    header.checksum = GetRecordChecksum(record.data(), record.size());
+    std::memcpy(&record[offsetof(RecordHeader, checksum)],
+                &header.checksum,
+                sizeof(header.checksum));
+
+    hadesmem::detail::AcquireSRWLock const lock(
+      &lock_, hadesmem::detail::SRWLockType::Exclusive);
+    FileLock const file_lock{file_.GetHandle()};
+
+    // Always at the end of the file, which may have been appended to by other
+    // processes since.
+    std::uint64_t const offset = GetFileSize();
+    WriteAt(offset, record.data(), static_cast<DWORD>(record.size()));
+    index_[index_key] =
+      RecordLocation{offset, static_cast<std::uint32_t>(record.size())};
+    ++num_records_;
+  }
+
+  // Removes every record which can't be used by this version, or which has
+  // been superseded by a later record for the same file, by moving the live
+  // records down over them in place. Records appended by other processes are
+  // kept, and they can carry on using the cache (though they'll miss on
+  // anything they looked up before compaction until they reopen it).
+  void Compact(std::size_t& kept, std::size_t& removed)
+  {
+    hadesmem::detail::AcquireSRWLock const lock(
+      &lock_, hadesmem::detail::SRWLockType::Exclusive);
+    FileLock const file_lock{file_.GetHandle()};
+
+    Scan();
+
+    std::vector<std::pair<IndexKey, RecordLocation>> live(std::begin(index_),
+                                                          std::end(index_));
+    std::sort(std::begin(live),
+              std::end(live),
+              [](std::pair<IndexKey, RecordLocation> const& lhs,
+                 std::pair<IndexKey, RecordLocation> const& rhs)
+              {
+      return lhs.second.offset < rhs.second.offset;
+    });
+
+    // Records only ever move towards the start of the file, so nothing is
+    // overwritten before it's been read. If this is interrupted the records
+    // which haven't been moved yet are still found by Scan, other than the
+    // one being overwritten.
+    index_.clear();
+    std::uint64_t write_offset = 0;
+    std::string record;
+    for (auto const& l : live)
+    {
+      if (!ReadRecord(l.second, record))
+      {
+        continue;
+      }
+
+      if (l.second.offset != write_offset)
+      {
+        WriteAt(write_offset, record.data(), l.second.size);
+      }
+
+      index_[l.first] = RecordLocation{write_offset, l.second.size};
+      write_offset += l.second.size;
+    }
+
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(write_offset);
+    if (!::SetFilePointerEx(file_.GetHandle(), end, nullptr, FILE_BEGIN) ||
+        !::SetEndOfFile(file_.GetHandle()))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString("SetEndOfFile failed.")
+                          << hadesmem::ErrorCodeWinLast(last_error));
+    }
+
+    kept = index_.size();
+    removed = num_records_ - kept;
+    num_records_ = kept;
+  }
+
+private:
+  // Indexes every record for this version, with later records for a file
+  // superseding earlier ones. Only the headers are read, so a corrupt output
+  // isn't found until the record is used.
+  void Scan()
+  {
+    index_.clear();
+    num_records_ = 0;
+
+    std::uint64_t const file_size = GetFileSize();
+    std::uint64_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= file_size)
+    {
+      RecordHeader header;
+      if (!ReadAt(offset, &header, sizeof(header)))
+      {
+        return;
+      }
+
+      std::uint64_t const record_size = sizeof(header) + header.output_size;
+      if (header.magic != kRecordMagic || header.output_size > kMaxOutputSize ||
+          offset + record_size > file_size)
+      {
+        offset = FindNextRecord(offset + 1, file_size);
+        continue;
+      }
+
+      ++num_records_;
+      if (header.parser_version == parser_version_)
+      {
+        IndexKey index_key{DumpCacheKey{}, header.format};
+        std::copy(std::begin(header.digest),
+                  std::end(header.digest),
+                  std::begin(index_key.key.digest));
+        index_[index_key] =
+          RecordLocation{offset, static_cast<std::uint32_t>(record_size)};
+      }
+
+      offset += record_size;
+    }
+  }
+
+  // Offset of the next record magic at or after offset, or the end of the
+  // file if there isn't one.
+  std::uint64_t FindNextRecord(std::uint64_t offset,
+                               std::uint64_t file_size) const
+  {
+    std::vector<char> chunk(kScanChunkSize);
+    char magic[sizeof(kRecordMagic)];
+    std::memcpy(magic, &kRecordMagic, sizeof(magic));
+
+    while (offset + sizeof(magic) <= file_size)
+    {
+      auto const size = static_cast<DWORD>((std::min)(
+        static_cast<std::uint64_t>(chunk.size()), file_size - offset));
+      if (!ReadAt(offset, chunk.data(), size))
+      {
+        break;
+      }
+
+      auto const chunk_end = std::begin(chunk) + size;
+      auto const iter = std::search(
+        std::begin(chunk), chunk_end, std::begin(magic), std::end(magic));
+      if (iter != chunk_end)
+      {
+        return offset + (iter - std::begin(chunk));
+      }
+
+      // The magic may straddle the end of the chunk.
+      offset += size - (sizeof(magic) - 1);
+    }
+
+    return file_size;
+  }
+
+  // Reads the whole record (header included) and checks it's intact.
+  bool ReadRecord(RecordLocation const& location, std::string& record) const
+  {
+    record.resize(location.size);
+    if (location.size < sizeof(RecordHeader) ||
+        !ReadAt(location.offset, &record[0], location.size))
+    {
+      return false;
+    }
+
+    RecordHeader header;
+    std::memcpy(&header, record.data(), sizeof(header));
+    return header.magic == kRecordMagic &&
+           sizeof(header) + header.output_size == location.size &&
+           header.checksum == GetRecordChecksum(record.data(), record.size());
+  }
+
+  std::uint64_t GetFileSize() const
+  {
+    LARGE_INTEGER size{};
+    if (!::GetFileSizeEx(file_.GetHandle(), &size))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString("GetFileSizeEx failed.")
+                          << hadesmem::ErrorCodeWinLast(last_error));
+    }
+    return static_cast<std::uint64_t>(size.QuadPart);
+  }
+
+  // Positional, so it's safe to read from multiple threads at once. Returns
+  // false on a short read.
+  bool ReadAt(std::uint64_t offset, void* data, DWORD size) const
+  {
+    OVERLAPPED overlapped = MakeOverlapped(offset);
+    DWORD read = 0;
+    return ::ReadFile(file_.GetHandle(), data, size, &read, &overlapped) &&
+           read == size;
+  }
+
+  void WriteAt(std::uint64_t offset, void const* data, DWORD size)
+  {
+    OVERLAPPED overlapped = MakeOverlapped(offset);
+    DWORD written = 0;
+    if (!::WriteFile(file_.GetHandle(), data, size, &written, &overlapped) ||
+        written != size)
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString("Failed to write cache.")
+                          << hadesmem::ErrorCodeWinLast(last_error));
+    }
+  }
+
+  hadesmem::detail::SmartFileHandle file_;
+  hadesmem::detail::SmartCryptContextHandle provider_;
+  std::uint32_t parser_version_;
+  mutable SRWLOCK lock_ = SRWLOCK_INIT;
+  std::unordered_map<IndexKey, RecordLocation, IndexKeyHash> index_;
+  // Including stale records.
+  std::size_t num_records_{};
+};
+
+std::unique_ptr<DumpCache> g_dump_cache;
+}
+
+bool GetDumpCacheEnabled()
+{
+  return !!g_dump_cache;
+}
+
+void OpenDumpCache(std::wstring const& path)
+{
+  g_dump_cache = std::make_unique<DumpCache>(path);
+}
+
+void CloseDumpCache(bool compact)
+{
+  if (!g_dump_cache)
+  {
+    return;
+  }
+
+  if (compact)
+  {
+    std::size_t kept = 0;
+    std::size_t removed = 0;
+    g_dump_cache->Compact(kept, removed);
+
+    OutputWriter& out = GetOutputWriter();
+    WriteNewline(out);
+    WriteNormal(out,
+                L"Compacted cache. Kept " + std::to_wstring(kept) +
+                  L" records, removed " + std::to_wstring(removed) + L".",
+                0);
+  }
+
+  g_dump_cache.reset();
+}
+
+DumpCacheKey GetDumpCacheKey(void const* data, DWORD size)
+{
+  HADESMEM_DETAIL_ASSERT(g_dump_cache);
+  return g_dump_cache->GetKey(data, size);
+}
+
+bool FindDumpCacheEntry(DumpCacheKey const& key, DumpCacheEntry& entry)
+{
+  HADESMEM_DETAIL_ASSERT(g_dump_cache);
+  return g_dump_cache->Find(key, entry);
+}
+
+void AddDumpCacheEntry(DumpCacheKey const& key, DumpCacheEntry const& entry)
+{
+  HADESMEM_DETAIL_ASSERT(g_dump_cache);
+  g_dump_cache->Add(key, entry);
+}
@@ -0,0 +1,49 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <windows.h>
+
+// The dump cache stores the output (and warnings) for each file dumped, keyed
+// by the SHA-256 of the file's contents, the dumper version and the output
+// format. Re-running over a mostly unchanged corpus then costs little more
+// than hashing each file.
+//
+// The cache is a single append-only file of self-checking records, so
+// multiple threads (and processes) can add to it at once, and a torn or
+// corrupt record only costs a re-dump of that file. Stale records (from older
+// versions, or superseded by a later record for the same file) are only
+// removed by compaction.
+
+struct DumpCacheKey
+{
+  std::array<std::uint8_t, 32> digest;
+};
+
+struct DumpCacheEntry
+{
+  // Output in the current format, as written by an OutputWriter.
+  std::string output;
+  // Mask from GetWarningsForCurrentFile.
+  std::uint32_t warnings{};
+};
+
+bool GetDumpCacheEnabled();
+
+// Opens the cache at the given path, creating it if it doesn't exist.
+void OpenDumpCache(std::wstring const& path);
+
+// Closes the cache (if any), compacting it first if requested.
+void CloseDumpCache(bool compact);
+
+DumpCacheKey GetDumpCacheKey(void const* data, DWORD size);
+
+// Returns false if there's no usable entry for the file.
+bool FindDumpCacheEntry(DumpCacheKey const& key, DumpCacheEntry& entry);
+
+void AddDumpCacheEntry(DumpCacheKey const& key, DumpCacheEntry const& entry);
@@ -45,7 +45,7 @@ void DisassembleEp(hadesmem::Process const& process,
     return;
   }
 
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   ud_t ud_obj;
   ud_init(&ud_obj);
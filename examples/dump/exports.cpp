@@ -32,7 +32,7 @@ void DumpExports(hadesmem::Process const& process,
     return;
   }
 
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
   WriteNormal(out, L"Export Dir:", 1);
@@ -53,13 +53,13 @@ void DumpExports(hadesmem::Process const& process,
   WriteNamedHex(out, L"Name (Raw)", export_dir->GetNameRaw(), 2);
   // Name is not guaranteed to be valid.
   // Sample: dllord.dll (Corkami PE Corpus)
-  try
+  auto const name = export_dir->TryGetName();
+  if (name)
   {
-    auto name = export_dir->GetName();
     HandleLongOrUnprintableString(
-      L"Name", L"export module name", 2, WarningType::kSuspicious, name);
+      L"Name", L"export module name", 2, WarningType::kSuspicious, *name);
   }
-  catch (std::exception const& /*e*/)
+  else
   {
     WriteNormal(out, L"WARNING! Failed to read export dir name.", 2);
     WarnForCurrentFile(WarningType::kSuspicious);
@@ -3,113 +3,75 @@
 
 #include "filesystem.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <algorithm>
 #include <iterator>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <windows.h>
+
 #include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
 #include <hadesmem/error.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 
+#include "cache.hpp"
 #include "main.hpp"
+#include "output.hpp"
 #include "print.hpp"
+#include "stats.hpp"
+#include "triage.hpp"
+#include "warning.hpp"
+#include "work_stealing_pool.hpp"
 
-void DumpFile(std::wstring const& path)
+namespace
 {
-  std::wostream& out = std::wcout;
-
-  SetCurrentFilePath(path);
-
-  std::unique_ptr<std::fstream> file_ptr(hadesmem::detail::OpenFile<char>(
-    path, std::ios::in | std::ios::binary | std::ios::ate));
-  std::fstream& file = *file_ptr;
-  if (!file)
-  {
-    WriteNewline(out);
-    WriteNormal(out, L"Failed to open file.", 0);
-    return;
-  }
-
-  std::streampos const size = file.tellg();
-  if (size <= 0)
-  {
-    WriteNewline(out);
-    WriteNormal(out, L"Empty or invalid file.", 0);
-    return;
-  }
-
-  if (!file.seekg(0, std::ios::beg))
+// Returns false if the error should abort the dump.
+bool HandleDirEntryError(OutputWriter& out, hadesmem::Error const& e)
+{
+  auto const last_error_ptr =
+    boost::get_error_info<hadesmem::ErrorCodeWinLast>(e);
+  if (last_error_ptr && *last_error_ptr == ERROR_SHARING_VIOLATION)
   {
     WriteNewline(out);
-    WriteNormal(out, L"WARNING! Seeking to beginning of file failed (1).", 0);
-    return;
+    WriteNormal(out, L"Sharing violation.", 0);
+    return true;
   }
 
-  // Peek for the MZ header before reading the whole file.
-  std::vector<char> mz_buf(2);
-  if (!file.read(mz_buf.data(), 2))
+  if (last_error_ptr && *last_error_ptr == ERROR_ACCESS_DENIED)
   {
     WriteNewline(out);
-    WriteNormal(out, L"WARNING! Failed to read header signature.", 0);
-    return;
+    WriteNormal(out, L"Access denied.", 0);
+    return true;
   }
 
-  // Check for MZ signature
-  if (mz_buf[0] != 'M' || mz_buf[1] != 'Z')
+  if (last_error_ptr && *last_error_ptr == ERROR_FILE_NOT_FOUND)
   {
     WriteNewline(out);
-    WriteNormal(out, L"Not a PE file (Pass 1).", 0);
-    return;
+    WriteNormal(out, L"File not found.", 0);
+    return true;
   }
 
-  if (!file.seekg(0, std::ios::beg))
-  {
-    WriteNewline(out);
-    WriteNormal(out, L"WARNING! Seeking to beginning of file failed (2).", 0);
-    return;
-  }
-
-  std::vector<char> buf(static_cast<std::size_t>(size));
-
-  if (!file.read(buf.data(), static_cast<std::streamsize>(size)))
-  {
-    WriteNewline(out);
-    WriteNormal(out, L"WARNING! Failed to read file data.", 0);
-    return;
-  }
-
-  hadesmem::Process const process(GetCurrentProcessId());
-
-  hadesmem::PeFile const pe_file(process,
-                                 buf.data(),
-                                 hadesmem::PeFileType::Data,
-                                 static_cast<DWORD>(buf.size()));
+  return false;
+}
 
-  try
-  {
-    hadesmem::NtHeaders const nt_hdr(process, pe_file);
-  }
-  catch (std::exception const& /*e*/)
+// Calls func with the path of every entry in the directory (other than '.'
+// and '..'), in the order FindNextFile returns them.
+template <typename Func>
+void ForEachDirEntry(OutputWriter& out, std::wstring const& path, Func func)
+{
+  // Triage records have the path in them, so don't clutter them up.
+  if (!GetTriageEnabled())
   {
     WriteNewline(out);
-    WriteNormal(out, L"Not a PE file or wrong architecture (Pass 2).", 0);
-    return;
+    WriteNormal(out, L"Entering dir: \"" + path + L"\".", 0);
   }
 
-  DumpPeFile(process, pe_file, path);
-}
-
-void DumpDir(std::wstring const& path)
-{
-  std::wostream& out = std::wcout;
-
-  WriteNewline(out);
-  WriteNormal(out, L"Entering dir: \"" + path + L"\".", 0);
-
   std::wstring path_real(path);
   if (path_real.back() == L'\\')
   {
@@ -147,66 +109,420 @@ void DumpDir(std::wstring const& path)
       continue;
     }
 
-    std::wstring const cur_path =
-      hadesmem::detail::MakeExtendedPath(path_real + L"\\" + cur_file);
+    func(hadesmem::detail::MakeExtendedPath(path_real + L"\\" + cur_file));
+  } while (::FindNextFileW(handle.GetHandle(), &find_data));
 
-    WriteNewline(out);
-    WriteNormal(out, L"Current path: \"" + cur_path + L"\".", 0);
+  DWORD const last_error = ::GetLastError();
+  if (last_error == ERROR_NO_MORE_FILES)
+  {
+    return;
+  }
+  HADESMEM_DETAIL_THROW_EXCEPTION(
+    hadesmem::Error() << hadesmem::ErrorString("FindNextFile failed.")
+                      << hadesmem::ErrorCodeWinLast(last_error));
+}
+
+// Output for a directory entry when dumping in parallel, and (if it's a
+// directory) its entries. Only used to put the output back in path order.
+struct DirEntryOutput
+{
+  std::string output;
+  // Set once the output and the list of entries are final.
+  bool complete{false};
+  bool written{false};
+  std::vector<std::unique_ptr<DirEntryOutput>> entries;
+};
+
+// Enumerates directories and dumps files on a WorkStealingPool. Each entry is
+// dumped into its thread's writer, and the output is written out atomically
+// once the entry is done, either immediately or (if ordered) once everything
+// before it in path order has been written. When writing immediately the
+// writer's buffer is reused for the thread's next entry.
+class ParallelDirDumper
+{
+public:
+  ParallelDirDumper(std::size_t num_threads, bool ordered)
+    : pool_{num_threads}, ordered_{ordered}
+  {
+    for (std::size_t i = 0; i < pool_.GetNumThreads(); ++i)
+    {
+      writers_.push_back(std::make_unique<OutputWriter>(GetOutputFormat()));
+    }
+  }
+
+  ParallelDirDumper(ParallelDirDumper const&) = delete;
+
+  ParallelDirDumper& operator=(ParallelDirDumper const&) = delete;
+
+  void Run(std::wstring const& path)
+  {
+    cursor_.emplace_back(&root_, 0);
+    pool_.Push(0,
+               [this, path](std::size_t worker)
+               {
+      DumpEntry(worker, path, &root_, true);
+    });
+
+    // Anything already written on this thread goes first.
+    GetStdoutWriter().Flush();
 
     try
     {
-      if (hadesmem::detail::IsDirectory(cur_path))
+      pool_.Run();
+    }
+    catch (...)
+    {
+      // The task's context is gone by now, so report the file here instead.
+      SetCurrentFilePath(failed_path_);
+      throw;
+    }
+  }
+
+private:
+  void DumpEntry(std::size_t worker,
+                 std::wstring const& path,
+                 DirEntryOutput* entry,
+                 bool is_root)
+  {
+    OutputWriter& out = *writers_[worker];
+    DumpTask const task{out};
+    std::vector<std::wstring> entry_paths;
+    auto const add_entry = [&](std::wstring const& entry_path)
+    {
+      entry_paths.push_back(entry_path);
+    };
+
+    try
+    {
+      if (is_root)
       {
-        if (hadesmem::detail::IsSymlink(cur_path))
+        ForEachDirEntry(out, path, add_entry);
+      }
+      else
+      {
+        if (!GetTriageEnabled())
         {
           WriteNewline(out);
-          WriteNormal(out, L"Skipping symlink.", 0);
+          WriteNormal(out, L"Current path: \"" + path + L"\".", 0);
         }
-        else
+
+        try
         {
-          DumpDir(cur_path);
+          if (hadesmem::detail::IsDirectory(path))
+          {
+            if (hadesmem::detail::IsSymlink(path))
+            {
+              WriteNewline(out);
+              WriteNormal(out, L"Skipping symlink.", 0);
+            }
+            else
+            {
+              ForEachDirEntry(out, path, add_entry);
+            }
+          }
+          else
+          {
+            DumpFile(path);
+          }
+        }
+        catch (hadesmem::Error const& e)
+        {
+          if (!HandleDirEntryError(out, e))
+          {
+            throw;
+          }
+
+          // Don't keep a partial list of entries.
+          entry_paths.clear();
         }
       }
-      else
+    }
+    catch (...)
+    {
+      Fail(path, out);
+      throw;
+    }
+
+    std::vector<std::unique_ptr<DirEntryOutput>> entries;
+    std::vector<DirEntryOutput*> children(entry_paths.size());
+    if (ordered_)
+    {
+      std::sort(std::begin(entry_paths), std::end(entry_paths));
+      for (auto& child : children)
       {
-        DumpFile(cur_path);
+        entries.push_back(std::make_unique<DirEntryOutput>());
+        child = entries.back().get();
       }
     }
-    catch (hadesmem::Error const& e)
+
+    // The entry (and so the list of its children) is owned by the output
+    // tree from here on, but the children can't be freed until they're
+    // complete.
+    Complete(entry, out, std::move(entries));
+
+    // Pushed in reverse so this thread pops them in order, which keeps the
+    // amount of buffered output down when ordered.
+    for (std::size_t i = entry_paths.size(); i-- > 0;)
+    {
+      DirEntryOutput* const child = children[i];
+      std::wstring const& child_path = entry_paths[i];
+      pool_.Push(worker,
+                 [this, child_path, child](std::size_t child_worker)
+                 {
+        DumpEntry(child_worker, child_path, child, false);
+      });
+    }
+  }
+
+  void Complete(DirEntryOutput* entry,
+                OutputWriter& out,
+                std::vector<std::unique_ptr<DirEntryOutput>> entries)
+  {
+    hadesmem::detail::AcquireSRWLock const lock(
+      &output_lock_, hadesmem::detail::SRWLockType::Exclusive);
+
+    if (!ordered_)
+    {
+      WriteToStdout(out.GetBuffer());
+      out.Flush();
+      return;
+    }
+
+    out.SwapBuffer(entry->output);
+    entry->entries = std::move(entries);
+    entry->complete = true;
+    WriteCompleted();
+  }
+
+  // Writes everything that's complete and not preceded by anything that
+  // isn't, freeing entries as it goes.
+  void WriteCompleted()
+  {
+    while (!cursor_.empty())
     {
-      auto const last_error_ptr =
-        boost::get_error_info<hadesmem::ErrorCodeWinLast>(e);
-      if (last_error_ptr && *last_error_ptr == ERROR_SHARING_VIOLATION)
+      DirEntryOutput* const entry = cursor_.back().first;
+      if (!entry->complete)
       {
-        WriteNewline(out);
-        WriteNormal(out, L"Sharing violation.", 0);
-        continue;
+        return;
       }
 
-      if (last_error_ptr && *last_error_ptr == ERROR_ACCESS_DENIED)
+      if (!entry->written)
       {
-        WriteNewline(out);
-        WriteNormal(out, L"Access denied.", 0);
-        continue;
+        WriteToStdout(entry->output);
+        std::string().swap(entry->output);
+        entry->written = true;
       }
 
-      if (last_error_ptr && *last_error_ptr == ERROR_FILE_NOT_FOUND)
+      std::size_t& next = cursor_.back().second;
+      if (next < entry->entries.size())
       {
-        WriteNewline(out);
-        WriteNormal(out, L"File not found.", 0);
+        DirEntryOutput* const child = entry->entries[next++].get();
+        cursor_.emplace_back(child, 0);
         continue;
       }
 
-      throw;
+      cursor_.pop_back();
+      if (!cursor_.empty())
+      {
+        auto const& parent = cursor_.back();
+        parent.first->entries[parent.second - 1].reset();
+      }
     }
-  } while (::FindNextFileW(handle.GetHandle(), &find_data));
+  }
 
-  DWORD const last_error = ::GetLastError();
-  if (last_error == ERROR_NO_MORE_FILES)
+  void Fail(std::wstring const& path, OutputWriter& out)
+  {
+    hadesmem::detail::AcquireSRWLock const lock(
+      &output_lock_, hadesmem::detail::SRWLockType::Exclusive);
+
+    // Only the first failure is reported, the rest are just stopped early.
+    if (failed_path_.empty())
+    {
+      WriteToStdout(out.GetBuffer());
+      failed_path_ = path;
+    }
+
+    out.Flush();
+  }
+
+  WorkStealingPool pool_;
+  bool ordered_;
+  // One per thread, indexed by worker.
+  std::vector<std::unique_ptr<OutputWriter>> writers_;
+  SRWLOCK output_lock_ = SRWLOCK_INIT;
+  DirEntryOutput root_;
+  std::vector<std::pair<DirEntryOutput*, std::size_t>> cursor_;
+  std::wstring failed_path_;
+};
+
+void DumpMappedFile(std::wstring const& path, hadesmem::MappedFile const& file)
+{
+  OutputWriter& out = GetOutputWriter();
+
+  hadesmem::Process const process(GetCurrentProcessId());
+
+  if (!hadesmem::ProbePeFile(process, file.GetBase(), file.GetSize()))
   {
+    WriteNewline(out);
+    WriteNormal(out, L"Not a PE file (Pass 1).", 0);
+    AddFileStats(FileStatus::kNotPe);
     return;
   }
-  HADESMEM_DETAIL_THROW_EXCEPTION(
-    hadesmem::Error() << hadesmem::ErrorString("FindNextFile failed.")
-                      << hadesmem::ErrorCodeWinLast(last_error));
+
+  hadesmem::PeFile const pe_file(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+
+  // Malformed files are common enough in a corpus that the cost of throwing
+  // here shows up in profiles.
+  auto const nt_headers = hadesmem::TryNtHeaders(process, pe_file);
+  if (!nt_headers)
+  {
+    WriteNewline(out);
+    WriteNormal(out, L"Not a PE file or wrong architecture (Pass 2).", 0);
+    AddFileStats(FileStatus::kInvalidNtHeaders);
+    return;
+  }
+
+  DumpPeFile(process, pe_file, path);
+
+  AddPeFileStats(process, pe_file, *nt_headers, GetWarningsForCurrentFile());
+}
+
+// The output (and warnings) for a file only depend on its contents, so they
+// can be replayed from the cache rather than dumping the file again.
+void DumpMappedFileCached(std::wstring const& path,
+                          hadesmem::MappedFile const& file)
+{
+  OutputWriter& out = GetOutputWriter();
+
+  DumpCacheKey const key = GetDumpCacheKey(file.GetBase(), file.GetSize());
+  DumpCacheEntry entry;
+  if (FindDumpCacheEntry(key, entry))
+  {
+    out.Append(entry.output);
+    // Only files which got as far as DumpPeFile can have warnings.
+    if (entry.warnings)
+    {
+      RestoreWarningsForCurrentFile(entry.warnings);
+      HandleWarnings(path);
+    }
+    return;
+  }
+
+  // Dumped into a writer of its own, so the output for the file can be
+  // cached on its own.
+  OutputWriter file_out{out.GetFormat()};
+  ClearWarnForCurrentFile();
+  try
+  {
+    DumpTask const task{file_out};
+    SetCurrentFilePath(path);
+    DumpMappedFile(path, file);
+  }
+  catch (...)
+  {
+    // Keep whatever was written before the error.
+    out.Append(file_out.GetBuffer());
+    throw;
+  }
+
+  file_out.SwapBuffer(entry.output);
+  entry.warnings = GetWarningsForCurrentFile();
+  out.Append(entry.output);
+  AddDumpCacheEntry(key, entry);
+}
+}
+
+void DumpFile(std::wstring const& path)
+{
+  if (GetTriageEnabled())
+  {
+    TriageFile(path);
+    return;
+  }
+
+  OutputWriter& out = GetOutputWriter();
+
+  SetCurrentFilePath(path);
+
+  // The file is mapped rather than read in, so only the pages which are
+  // actually parsed are ever read from disk.
+  std::unique_ptr<hadesmem::MappedFile> file;
+  try
+  {
+    file = std::make_unique<hadesmem::MappedFile>(path);
+  }
+  catch (std::exception const& /*e*/)
+  {
+    WriteNewline(out);
+    WriteNormal(out, L"Failed to open file.", 0);
+    AddFileStats(FileStatus::kOpenFailed);
+    return;
+  }
+
+  if (!file->GetSize())
+  {
+    WriteNewline(out);
+    WriteNormal(out, L"Empty or invalid file.", 0);
+    AddFileStats(FileStatus::kEmpty);
+    return;
+  }
+
+  if (GetDumpCacheEnabled())
+  {
+    DumpMappedFileCached(path, *file);
+  }
+  else
+  {
+    DumpMappedFile(path, *file);
+  }
+}
+
+void DumpDir(std::wstring const& path)
+{
+  OutputWriter& out = GetOutputWriter();
+
+  ForEachDirEntry(out, path, [&](std::wstring const& cur_path)
+                  {
+    if (!GetTriageEnabled())
+    {
+      WriteNewline(out);
+      WriteNormal(out, L"Current path: \"" + cur_path + L"\".", 0);
+    }
+
+    try
+    {
+      if (hadesmem::detail::IsDirectory(cur_path))
+      {
+        if (hadesmem::detail::IsSymlink(cur_path))
+        {
+          WriteNewline(out);
+          WriteNormal(out, L"Skipping symlink.", 0);
+        }
+        else
+        {
+          DumpDir(cur_path);
+        }
+      }
+      else
+      {
+        DumpFile(cur_path);
+      }
+    }
+    catch (hadesmem::Error const& e)
+    {
+      if (!HandleDirEntryError(out, e))
+      {
+        throw;
+      }
+    }
+  });
+}
+
+void DumpDirParallel(std::wstring const& path,
+                     std::size_t num_threads,
+                     bool ordered)
+{
+  ParallelDirDumper dumper{num_threads, ordered};
+  dumper.Run(path);
 }
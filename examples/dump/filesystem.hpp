@@ -3,8 +3,17 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 void DumpFile(std::wstring const& path);
 
 void DumpDir(std::wstring const& path);
+
+// Dumps every file in the directory tree using num_threads threads. Output
+// for each file is written out in one piece, either as soon as the file is
+// done or, if ordered, in path order (buffering anything which finishes out
+// of order).
+void DumpDirParallel(std::wstring const& path,
+                     std::size_t num_threads,
+                     bool ordered);
@@ -9,6 +9,7 @@
 #include <hadesmem/pelib/bound_import_desc_list.hpp>
 #include <hadesmem/pelib/import_dir.hpp>
 #include <hadesmem/pelib/import_dir_list.hpp>
+#include <hadesmem/pelib/import_table.hpp>
 #include <hadesmem/pelib/import_thunk.hpp>
 #include <hadesmem/pelib/import_thunk_list.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
@@ -28,9 +29,11 @@ bool HasValidNonEmptyBoundImportDescList(hadesmem::Process const& process,
   return (std::begin(bound_import_dirs) != std::end(bound_import_dirs));
 }
 
-void DumpImportThunk(hadesmem::ImportThunk const& thunk, bool is_bound)
+void DumpImportThunk(hadesmem::ImportTable const& import_table,
+                     hadesmem::ImportThunk const& thunk,
+                     bool is_bound)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
 
@@ -49,20 +52,42 @@ void DumpImportThunk(hadesmem::ImportThunk const& thunk, bool is_bound)
   }
   else
   {
-    try
+    // Names of well-formed thunks have already been read in bulk. Anything
+    // else goes through the slow path so it gets the appropriate warnings.
+    hadesmem::ImportThunkRecord const* const record =
+      import_table.FindThunk(thunk.GetBase());
+    if (record && record->has_name)
     {
-      WriteNamedHex(out, L"AddressOfData", thunk.GetAddressOfData(), 3);
-      WriteNamedHex(out, L"Hint", thunk.GetHint(), 3);
-      auto const name = thunk.GetName();
-      // Sample: dllweirdexp-ld.exe
-      HandleLongOrUnprintableString(
-        L"Name", L"import thunk name data", 3, WarningType::kSuspicious, name);
+      WriteNamedHex(out, L"AddressOfData", record->lookup, 3);
+      WriteNamedHex(out, L"Hint", record->hint, 3);
+      HandleLongOrUnprintableString(L"Name",
+                                    L"import thunk name data",
+                                    3,
+                                    WarningType::kSuspicious,
+                                    record->name.to_string());
+      return;
     }
-    catch (std::exception const& /*e*/)
+
+    WriteNamedHex(out, L"AddressOfData", thunk.GetAddressOfData(), 3);
+    auto const hint = thunk.TryGetHint();
+    if (hint)
     {
-      WriteNormal(out, L"WARNING! Invalid import thunk name data.", 3);
-      WarnForCurrentFile(WarningType::kSuspicious);
+      WriteNamedHex(out, L"Hint", *hint, 3);
+      auto const name = thunk.TryGetName();
+      if (name)
+      {
+        // Sample: dllweirdexp-ld.exe
+        HandleLongOrUnprintableString(L"Name",
+                                      L"import thunk name data",
+                                      3,
+                                      WarningType::kSuspicious,
+                                      *name);
+        return;
+      }
     }
+
+    WriteNormal(out, L"WARNING! Invalid import thunk name data.", 3);
+    WarnForCurrentFile(WarningType::kSuspicious);
   }
 }
 }
@@ -71,9 +96,10 @@ void DumpImports(hadesmem::Process const& process,
                  hadesmem::PeFile const& pe_file,
                  bool& has_new_bound_imports_any)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   hadesmem::ImportDirList const import_dirs(process, pe_file);
+  hadesmem::ImportTable const import_table(process, pe_file);
 
   if (std::begin(import_dirs) != std::end(import_dirs))
   {
@@ -271,16 +297,16 @@ void DumpImports(hadesmem::Process const& process,
 
     WriteNamedHex(out, L"Name (Raw)", dir.GetNameRaw(), 2);
 
-    try
+    auto const imp_desc_name = dir.TryGetName();
+    if (imp_desc_name)
     {
-      auto imp_desc_name = dir.GetName();
       HandleLongOrUnprintableString(L"Name",
                                     L"import descriptor name",
                                     2,
                                     WarningType::kSuspicious,
-                                    imp_desc_name);
+                                    *imp_desc_name);
     }
-    catch (std::exception const& /*e*/)
+    else
     {
       WriteNormal(out, L"WARNING! Failed to read import dir name.", 2);
       WarnForCurrentFile(WarningType::kSuspicious);
@@ -343,7 +369,7 @@ void DumpImports(hadesmem::Process const& process,
       // from in the IAT (which is bound).
       bool const is_image_iat =
         (pe_file.GetType() == hadesmem::PeFileType::Image && !use_ilt);
-      DumpImportThunk(thunk, is_image_iat);
+      DumpImportThunk(import_table, thunk, is_image_iat);
     }
 
     // Windows will load PE files that have an invalid RVA for the ILT (lies
@@ -382,7 +408,8 @@ void DumpImports(hadesmem::Process const& process,
         // bound, even though it actually isn't (and XP will apparently load
         // such a module). See tinygui.exe from the Corkami PE corpus for an
         // example.
-        DumpImportThunk(thunk, (is_iat_bound && ilt_valid) || !ilt_empty);
+        DumpImportThunk(
+          import_table, thunk, (is_iat_bound && ilt_valid) || !ilt_empty);
       }
     }
   }
@@ -23,6 +23,7 @@
 #include <hadesmem/config.hpp>
 #include <hadesmem/debug_privilege.hpp>
 #include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/parallel_for.hpp>
 #include <hadesmem/detail/self_path.hpp>
 #include <hadesmem/detail/str_conv.hpp>
 #include <hadesmem/error.hpp>
@@ -30,6 +31,7 @@
 #include <hadesmem/module_list.hpp>
 #include <hadesmem/pelib/dos_header.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_entropy.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/process_entry.hpp>
@@ -41,25 +43,32 @@
 #include <hadesmem/thread_entry.hpp>
 
 #include "bound_imports.hpp"
+#include "cache.hpp"
 #include "exports.hpp"
 #include "filesystem.hpp"
 #include "headers.hpp"
 #include "imports.hpp"
 #include "memory.hpp"
+#include "output.hpp"
+#include "packer.hpp"
 #include "print.hpp"
 #include "relocations.hpp"
 #include "sections.hpp"
+#include "stats.hpp"
 #include "strings.hpp"
 #include "tls.hpp"
+#include "triage.hpp"
 #include "warning.hpp"
 
 namespace
 {
+// Only used when there's no task (i.e. when dumping serially).
 std::wstring g_current_file_path;
+HADESMEM_DETAIL_THREAD_LOCAL DumpTask* g_current_task = nullptr;
 
 void DumpRegions(hadesmem::Process const& process)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
   WriteNormal(out, L"Regions:", 0);
@@ -84,7 +93,7 @@ void DumpRegions(hadesmem::Process const& process)
 
 void DumpModules(hadesmem::Process const& process)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
   WriteNormal(out, L"Modules:", 0);
@@ -102,12 +111,8 @@ void DumpModules(hadesmem::Process const& process)
     hadesmem::PeFile const pe_file(
       process, module.GetHandle(), hadesmem::PeFileType::Image, 0);
 
-    try
-    {
-      hadesmem::DosHeader const dos_header(process, pe_file);
-      hadesmem::NtHeaders const nt_headers(process, pe_file);
-    }
-    catch (std::exception const& /*e*/)
+    // Also checks the DOS header.
+    if (!hadesmem::TryNtHeaders(process, pe_file))
     {
       WriteNewline(out);
       WriteNormal(out, L"WARNING! Not a valid PE file or architecture.", 1);
@@ -120,7 +125,7 @@ void DumpModules(hadesmem::Process const& process)
 
 void DumpThreadEntry(hadesmem::ThreadEntry const& thread_entry)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
   WriteNamedHex(out, L"Usage", thread_entry.GetUsage(), 1);
@@ -133,7 +138,7 @@ void DumpThreadEntry(hadesmem::ThreadEntry const& thread_entry)
 
 void DumpThreads(DWORD pid)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
   WriteNormal(out, L"Threads:", 0);
@@ -147,7 +152,7 @@ void DumpThreads(DWORD pid)
 
 void DumpProcessEntry(hadesmem::ProcessEntry const& process_entry)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
   WriteNamedHex(out, L"ID", process_entry.GetId(), 0);
@@ -198,7 +203,7 @@ void DumpProcessEntry(hadesmem::ProcessEntry const& process_entry)
 
 void DumpProcesses()
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   WriteNewline(out);
   WriteNormal(out, L"Processes:", 0);
@@ -215,7 +220,7 @@ void DumpPeFile(hadesmem::Process const& process,
                 hadesmem::PeFile const& pe_file,
                 std::wstring const& path)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   ClearWarnForCurrentFile();
 
@@ -231,7 +236,10 @@ void DumpPeFile(hadesmem::Process const& process,
 
   DumpHeaders(process, pe_file);
 
-  DumpSections(process, pe_file);
+  hadesmem::PeEntropy const entropy(process, pe_file);
+  DumpSections(process, pe_file, entropy);
+
+  DumpPackerHeuristics(process, pe_file, entropy);
 
   DumpTls(process, pe_file);
 
@@ -249,9 +257,53 @@ void DumpPeFile(hadesmem::Process const& process,
   HandleWarnings(path);
 }
 
+DumpTask::DumpTask(OutputWriter& out)
+  : out_{&out}, path_(), prev_{g_current_task}
+{
+  g_current_task = this;
+}
+
+DumpTask::~DumpTask()
+{
+  g_current_task = prev_;
+}
+
+OutputWriter& DumpTask::GetOutputWriter() const
+{
+  return *out_;
+}
+
+std::wstring DumpTask::GetPath() const
+{
+  return path_;
+}
+
+void DumpTask::SetPath(std::wstring const& path)
+{
+  path_ = path;
+}
+
+OutputWriter& GetOutputWriter()
+{
+  return g_current_task ? g_current_task->GetOutputWriter()
+                        : GetStdoutWriter();
+}
+
+std::wstring GetCurrentFilePath()
+{
+  return g_current_task ? g_current_task->GetPath() : g_current_file_path;
+}
+
 void SetCurrentFilePath(std::wstring const& path)
 {
-  g_current_file_path = path;
+  if (g_current_task)
+  {
+    g_current_task->SetPath(path);
+  }
+  else
+  {
+    g_current_file_path = path;
+  }
 }
 
 void HandleLongOrUnprintableString(std::wstring const& name,
@@ -260,7 +312,7 @@ void HandleLongOrUnprintableString(std::wstring const& name,
                                    WarningType warning_type,
                                    std::string value)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   auto const unprintable = FindFirstUnprintableClassicLocale(value);
   std::size_t const kMaxNameLength = 1024;
@@ -325,8 +377,6 @@ int main(int argc, char* argv[])
 {
   try
   {
-    std::cout << "HadesMem Dumper [" << HADESMEM_VERSION_STRING << "]\n";
-
     TCLAP::CmdLine cmd("PE file format dumper", ' ', HADESMEM_VERSION_STRING);
     TCLAP::ValueArg<DWORD> pid_arg(
       "", "pid", "Target process id", false, 0, "DWORD");
@@ -352,6 +402,32 @@ int main(int argc, char* argv[])
       "warned-file-dynamic",
       "Dump warnings to file on the fly rather than at the end",
       cmd);
+    TCLAP::ValueArg<DWORD> jobs_arg(
+      "",
+      "jobs",
+      "Number of threads to dump directories with (0 for one per CPU)",
+      false,
+      1,
+      "DWORD",
+      cmd);
+    TCLAP::SwitchArg ordered_arg(
+      "",
+      "ordered",
+      "Write directory output in path order, regardless of thread count",
+      cmd);
+    TCLAP::ValueArg<std::string> format_arg(
+      "",
+      "format",
+      "Output format (text, json for JSON lines, or binary records)",
+      false,
+      "text",
+      "string",
+      cmd);
+    TCLAP::SwitchArg triage_arg(
+      "",
+      "triage",
+      "Only check the headers of files, and write one fixed-size record each",
+      cmd);
     TCLAP::ValueArg<int> warned_type_arg("",
                                          "warned-type",
                                          "Filter warned file using warned type",
@@ -359,8 +435,72 @@ int main(int argc, char* argv[])
                                          -1,
                                          "int",
                                          cmd);
+    TCLAP::ValueArg<std::string> cache_arg(
+      "",
+      "cache",
+      "Path of a cache to reuse the output for previously dumped files from",
+      false,
+      "",
+      "string",
+      cmd);
+    TCLAP::SwitchArg cache_compact_arg(
+      "",
+      "cache-compact",
+      "Remove stale records from the cache once dumping is done",
+      cmd);
+    TCLAP::SwitchArg stats_arg(
+      "",
+      "stats",
+      "Write statistics over all the files as JSON rather than dumping each",
+      cmd);
     cmd.parse(argc, argv);
 
+    // Statistics are the only thing written to stdout, so the warned list
+    // has to go to a file.
+    SetStatsEnabled(stats_arg.getValue());
+    if (GetStatsEnabled() &&
+        (format_arg.isSet() || triage_arg.getValue() || cache_arg.isSet() ||
+         (warned_arg.getValue() && !warned_file_arg.isSet())))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString(
+          "Statistics can't be combined with --format, --triage, --cache or "
+          "--warned without --warned-file."));
+    }
+
+    std::string const format = format_arg.getValue();
+    if (GetStatsEnabled())
+    {
+      // Nothing is written per file, only the statistics at the end.
+      SetOutputFormat(OutputFormat::kNone);
+    }
+    else if (format == "text")
+    {
+      SetOutputFormat(OutputFormat::kText);
+    }
+    else if (format == "json")
+    {
+      SetOutputFormat(OutputFormat::kJsonLines);
+    }
+    else if (format == "binary")
+    {
+      SetOutputFormat(OutputFormat::kBinary);
+    }
+    else
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString("Unknown output format."));
+    }
+
+    OutputWriter& out = GetOutputWriter();
+
+    if (GetOutputFormat() == OutputFormat::kText)
+    {
+      WriteNormal(out, "HadesMem Dumper [" HADESMEM_VERSION_STRING "]", 0);
+    }
+
+    SetTriageEnabled(triage_arg.getValue());
+
     SetWarningsEnabled(warned_arg.getValue());
     SetDynamicWarningsEnabled(warned_file_dynamic_arg.getValue());
     if (warned_file_arg.isSet())
@@ -385,6 +525,9 @@ int main(int argc, char* argv[])
     case static_cast<int>(WarningType::kUnsupported):
       SetWarnedType(WarningType::kUnsupported);
       break;
+    case static_cast<int>(WarningType::kPacked):
+      SetWarnedType(WarningType::kPacked);
+      break;
     case static_cast<int>(WarningType::kAll):
       SetWarnedType(WarningType::kAll);
       break;
@@ -394,15 +537,45 @@ int main(int argc, char* argv[])
       break;
     }
 
+    if (cache_arg.isSet())
+    {
+      OpenDumpCache(
+        hadesmem::detail::MultiByteToWideChar(cache_arg.getValue()));
+    }
+    else if (cache_compact_arg.getValue())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        hadesmem::Error() << hadesmem::ErrorString(
+          "Please specify a cache path to compact."));
+    }
+
+    std::size_t const jobs = jobs_arg.getValue()
+                               ? jobs_arg.getValue()
+                               : hadesmem::detail::GetDefaultThreadCount();
+    bool const ordered = ordered_arg.getValue();
+    auto const dump_dir = [&](std::wstring const& path)
+    {
+      if (jobs == 1 && !ordered)
+      {
+        DumpDir(path);
+      }
+      else
+      {
+        DumpDirParallel(path, jobs, ordered);
+      }
+    };
+
     try
     {
       hadesmem::GetSeDebugPrivilege();
 
-      std::wcout << "\nAcquired SeDebugPrivilege.\n";
+      WriteNewline(out);
+      WriteNormal(out, L"Acquired SeDebugPrivilege.", 0);
     }
     catch (std::exception const& /*e*/)
     {
-      std::wcout << "\nFailed to acquire SeDebugPrivilege.\n";
+      WriteNewline(out);
+      WriteNormal(out, L"Failed to acquire SeDebugPrivilege.", 0);
     }
 
     if (pid_arg.isSet())
@@ -441,7 +614,7 @@ int main(int argc, char* argv[])
         hadesmem::detail::MultiByteToWideChar(path_arg.getValue());
       if (hadesmem::detail::IsDirectory(path))
       {
-        DumpDir(path);
+        dump_dir(path);
       }
       else
       {
@@ -454,15 +627,28 @@ int main(int argc, char* argv[])
 
       DumpProcesses();
 
-      std::wcout << "\nFiles:\n";
+      WriteNewline(out);
+      WriteNormal(out, L"Files:", 0);
 
       std::wstring const self_path = hadesmem::detail::GetSelfPath();
       std::wstring const root_path = hadesmem::detail::GetRootPath(self_path);
-      DumpDir(root_path);
+      dump_dir(root_path);
+    }
+
+    CloseDumpCache(cache_compact_arg.getValue());
+
+    if (GetStatsEnabled())
+    {
+      WriteStats();
     }
 
     if (GetWarningsEnabled())
     {
+      if (ordered)
+      {
+        SortWarned();
+      }
+
       if (!GetWarnedFilePath().empty() && !GetDynamicWarningsEnabled())
       {
         std::unique_ptr<std::wfstream> warned_file_ptr(
@@ -480,20 +666,26 @@ int main(int argc, char* argv[])
       }
       else
       {
-        DumpWarned(std::wcout);
+        DumpWarned(out);
       }
     }
 
+    out.Flush();
+
     return 0;
   }
   catch (...)
   {
+    // Keep the error after whatever was dumped before it.
+    GetStdoutWriter().Flush();
+
     std::cerr << "\nError!\n"
               << boost::current_exception_diagnostic_information() << '\n';
 
-    if (!g_current_file_path.empty())
+    std::wstring const current_file_path = GetCurrentFilePath();
+    if (!current_file_path.empty())
     {
-      std::wcerr << "\nCurrent file: " << g_current_file_path << "\n";
+      std::wcerr << "\nCurrent file: " << current_file_path << "\n";
     }
 
     return 1;
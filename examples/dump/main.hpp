@@ -8,7 +8,6 @@
 #include <ctime>
 #include <iomanip>
 #include <locale>
-#include <ostream>
 #include <string>
 #include <vector>
 
@@ -20,10 +19,42 @@ class Process;
 class PeFile;
 }
 
+class OutputWriter;
+
 void DumpPeFile(hadesmem::Process const& process,
                 hadesmem::PeFile const& pe_file,
                 std::wstring const& path);
 
+// Redirects output and the current file path on the calling thread for the
+// lifetime of the object, so that multiple files can be dumped at once.
+class DumpTask
+{
+public:
+  explicit DumpTask(OutputWriter& out);
+
+  ~DumpTask();
+
+  DumpTask(DumpTask const&) = delete;
+  DumpTask& operator=(DumpTask const&) = delete;
+
+  OutputWriter& GetOutputWriter() const;
+
+  std::wstring GetPath() const;
+
+  void SetPath(std::wstring const& path);
+
+private:
+  OutputWriter* out_;
+  std::wstring path_;
+  DumpTask* prev_;
+};
+
+// Returns the output writer of the calling thread's task, or the stdout writer
+// if it has none.
+OutputWriter& GetOutputWriter();
+
+std::wstring GetCurrentFilePath();
+
 void SetCurrentFilePath(std::wstring const& path);
 
 void HandleLongOrUnprintableString(std::wstring const& name,
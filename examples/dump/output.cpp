@@ -0,0 +1,693 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include "output.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/pe_triage.hpp>
+
+namespace
+{
+// Writers with a sink flush once they're holding this much output, and all
+// writers start out with this much room so that dumping a typical file never
+// has to grow the buffer.
+std::size_t const kOutputBufferSize = 0x10000;
+
+char const kHexDigits[] = "0123456789abcdef";
+
+OutputFormat g_output_format = OutputFormat::kText;
+
+char const* GetTriageStatusName(hadesmem::PeTriageStatus status)
+{
+  switch (status)
+  {
+  case hadesmem::PeTriageStatus::kValid:
+    return "valid";
+  case hadesmem::PeTriageStatus::kIncomplete:
+    return "incomplete";
+  case hadesmem::PeTriageStatus::kUnreadable:
+    return "unreadable";
+  case hadesmem::PeTriageStatus::kInvalidDosHeader:
+    return "invalid_dos_header";
+  case hadesmem::PeTriageStatus::kInvalidNtHeaders:
+    return "invalid_nt_headers";
+  case hadesmem::PeTriageStatus::kInvalidFileHeader:
+    return "invalid_file_header";
+  case hadesmem::PeTriageStatus::kInvalidOptionalHeader:
+    return "invalid_optional_header";
+  case hadesmem::PeTriageStatus::kOpenFailed:
+    return "open_failed";
+  }
+
+  return "unknown";
+}
+
+// Calls func with each code point in the string. Unpaired surrogates are
+// replaced with U+FFFD.
+template <typename Func> void ForEachCodePoint(OutputString s, Func func)
+{
+  if (char const* const narrow = s.GetNarrow())
+  {
+    for (std::size_t i = 0; i < s.GetSize(); ++i)
+    {
+      func(static_cast<std::uint32_t>(static_cast<unsigned char>(narrow[i])));
+    }
+
+    return;
+  }
+
+  wchar_t const* const wide = s.GetWide();
+  for (std::size_t i = 0; i < s.GetSize(); ++i)
+  {
+    auto c = static_cast<std::uint32_t>(wide[i]);
+    if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDFFF)
+    {
+      auto const next = i + 1 < s.GetSize()
+                          ? static_cast<std::uint32_t>(wide[i + 1])
+                          : 0;
+      if (c <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF)
+      {
+        c = 0x10000 + ((c - 0xD800) << 10) + (next - 0xDC00);
+        ++i;
+      }
+      else
+      {
+        c = 0xFFFD;
+      }
+    }
+
+    func(c);
+  }
+}
+
+void AppendCodePoint(std::string& buffer, std::uint32_t c)
+{
+  if (c < 0x80)
+  {
+    buffer.push_back(static_cast<char>(c));
+  }
+  else if (c < 0x800)
+  {
+    buffer.push_back(static_cast<char>(0xC0 | (c >> 6)));
+    buffer.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+  else if (c < 0x10000)
+  {
+    buffer.push_back(static_cast<char>(0xE0 | (c >> 12)));
+    buffer.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+    buffer.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+  else
+  {
+    buffer.push_back(static_cast<char>(0xF0 | (c >> 18)));
+    buffer.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+    buffer.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+    buffer.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+}
+}
+
+template <typename T> void OutputWriter::AppendRaw(T value)
+{
+  // x86 and x64 are little-endian, so this is already in the record format.
+  buffer_.append(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+OutputWriter::OutputWriter(OutputFormat format, std::FILE* sink)
+  : buffer_(), format_{format}, sink_{sink}
+{
+  buffer_.reserve(kOutputBufferSize);
+}
+
+OutputWriter::~OutputWriter()
+{
+  Flush();
+}
+
+OutputFormat OutputWriter::GetFormat() const
+{
+  return format_;
+}
+
+void OutputWriter::SetFormat(OutputFormat format)
+{
+  Flush();
+  format_ = format;
+}
+
+void OutputWriter::Newline()
+{
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    buffer_.push_back('\n');
+    break;
+  case OutputFormat::kJsonLines:
+    // Blank lines only separate things visually.
+    break;
+  case OutputFormat::kBinary:
+    BeginRecord(OutputRecordType::kNewline, nullptr, 0);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  FlushIfFull();
+}
+
+void OutputWriter::Text(OutputString text, std::size_t depth)
+{
+  BeginRecord(OutputRecordType::kText, nullptr, depth);
+
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    AppendUtf8(text);
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += ",\"text\":";
+    AppendJsonString(text);
+    break;
+  case OutputFormat::kBinary:
+    AppendSizedUtf8(text);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  EndRecord();
+}
+
+void OutputWriter::NamedText(OutputString name,
+                             OutputString value,
+                             std::size_t depth)
+{
+  BeginRecord(OutputRecordType::kNamedText, &name, depth);
+
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    AppendUtf8(value);
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += ",\"value\":";
+    AppendJsonString(value);
+    break;
+  case OutputFormat::kBinary:
+    AppendSizedUtf8(value);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  EndRecord();
+}
+
+void OutputWriter::NamedBool(OutputString name, bool value, std::size_t depth)
+{
+  BeginRecord(OutputRecordType::kBool, &name, depth);
+
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    // Matches what iostreams write without boolalpha.
+    buffer_.push_back(value ? '1' : '0');
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += value ? ",\"value\":true" : ",\"value\":false";
+    break;
+  case OutputFormat::kBinary:
+    AppendRaw(static_cast<std::uint8_t>(value));
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  EndRecord();
+}
+
+void OutputWriter::NamedHex(OutputString name,
+                            std::uint64_t value,
+                            std::size_t width,
+                            std::size_t depth)
+{
+  BeginRecord(OutputRecordType::kHex, &name, depth);
+
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    buffer_ += "0x";
+    AppendHex(buffer_, value, width);
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += ",\"value\":\"0x";
+    AppendHex(buffer_, value, width);
+    buffer_.push_back('"');
+    break;
+  case OutputFormat::kBinary:
+    AppendRaw(static_cast<std::uint8_t>(width));
+    AppendRaw(value);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  EndRecord();
+}
+
+void OutputWriter::NamedHexSuffix(OutputString name,
+                                  std::uint64_t value,
+                                  std::size_t width,
+                                  OutputString suffix,
+                                  std::size_t depth)
+{
+  BeginRecord(OutputRecordType::kHexSuffix, &name, depth);
+
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    buffer_ += "0x";
+    AppendHex(buffer_, value, width);
+    buffer_ += " (";
+    AppendUtf8(suffix);
+    buffer_.push_back(')');
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += ",\"value\":\"0x";
+    AppendHex(buffer_, value, width);
+    buffer_ += "\",\"suffix\":";
+    AppendJsonString(suffix);
+    break;
+  case OutputFormat::kBinary:
+    AppendRaw(static_cast<std::uint8_t>(width));
+    AppendRaw(value);
+    AppendSizedUtf8(suffix);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  EndRecord();
+}
+
+void OutputWriter::BeginNamedHexList(OutputString name,
+                                     std::size_t width,
+                                     std::size_t depth)
+{
+  BeginRecord(OutputRecordType::kHexList, &name, depth);
+
+  list_width_ = width;
+  list_count_ = 0;
+
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += ",\"value\":[";
+    break;
+  case OutputFormat::kBinary:
+    AppendRaw(static_cast<std::uint8_t>(width));
+    list_count_offset_ = buffer_.size();
+    AppendRaw(list_count_);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+}
+
+void OutputWriter::HexListItem(std::uint64_t value)
+{
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    buffer_ += " 0x";
+    AppendHex(buffer_, value, list_width_);
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += list_count_ ? ",\"0x" : "\"0x";
+    AppendHex(buffer_, value, list_width_);
+    buffer_.push_back('"');
+    break;
+  case OutputFormat::kBinary:
+    AppendRaw(value);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  ++list_count_;
+}
+
+void OutputWriter::EndNamedHexList()
+{
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_.push_back(']');
+    break;
+  case OutputFormat::kBinary:
+    std::copy(reinterpret_cast<char const*>(&list_count_),
+              reinterpret_cast<char const*>(&list_count_ + 1),
+              buffer_.begin() + list_count_offset_);
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  EndRecord();
+}
+
+void OutputWriter::TriageRecord(OutputString path,
+                                hadesmem::PeTriageRecord const& record)
+{
+  BeginRecord(OutputRecordType::kTriage, &path, 0);
+
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    buffer_ += "status=";
+    buffer_ += GetTriageStatusName(record.status);
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += ",\"status\":\"";
+    buffer_ += GetTriageStatusName(record.status);
+    buffer_.push_back('"');
+    break;
+  case OutputFormat::kBinary:
+    AppendRaw(static_cast<std::uint32_t>(sizeof(record)));
+    buffer_.append(reinterpret_cast<char const*>(&record), sizeof(record));
+    EndRecord();
+    return;
+  case OutputFormat::kNone:
+    return;
+  }
+
+  AppendTriageField("file_size", record.file_size, 16);
+  AppendTriageField("machine", record.machine, 4);
+  AppendTriageField("magic", record.magic, 4);
+  AppendTriageField("subsystem", record.subsystem, 4);
+  AppendTriageField("characteristics", record.characteristics, 4);
+  AppendTriageField("dll_characteristics", record.dll_characteristics, 4);
+  AppendTriageField("time_date_stamp", record.time_date_stamp, 8);
+  AppendTriageField("image_base", record.image_base, 16);
+  AppendTriageField("entry_point", record.address_of_entry_point, 8);
+  AppendTriageField("size_of_image", record.size_of_image, 8);
+  AppendTriageField("size_of_headers", record.size_of_headers, 8);
+  AppendTriageField("size_of_code", record.size_of_code, 8);
+  AppendTriageField(
+    "size_of_initialized_data", record.size_of_initialized_data, 8);
+  AppendTriageField(
+    "size_of_uninitialized_data", record.size_of_uninitialized_data, 8);
+  AppendTriageField("section_alignment", record.section_alignment, 8);
+  AppendTriageField("file_alignment", record.file_alignment, 8);
+  AppendTriageField("checksum", record.checksum, 8);
+  AppendTriageField("number_of_sections", record.number_of_sections, 4);
+  AppendTriageField("data_directories", record.data_directories, 4);
+  AppendTriageField("flags", record.flags, 2);
+  AppendTriageField("subsystem_version", record.major_subsystem_version, 4);
+  AppendTriageField("linker_version",
+                    (record.major_linker_version << 8) |
+                      record.minor_linker_version,
+                    4);
+  AppendTriageField("nt_headers_offset", record.nt_headers_offset, 8);
+  AppendTriageField("headers_end", record.headers_end, 8);
+
+  EndRecord();
+}
+
+void OutputWriter::Append(std::string const& output)
+{
+  buffer_ += output;
+  FlushIfFull();
+}
+
+std::string const& OutputWriter::GetBuffer() const
+{
+  return buffer_;
+}
+
+void OutputWriter::SwapBuffer(std::string& buffer)
+{
+  buffer_.swap(buffer);
+  buffer_.clear();
+  if (buffer_.capacity() < kOutputBufferSize)
+  {
+    buffer_.reserve(kOutputBufferSize);
+  }
+}
+
+void OutputWriter::Flush()
+{
+  if (sink_ && !buffer_.empty())
+  {
+    std::fwrite(buffer_.data(), 1, buffer_.size(), sink_);
+    std::fflush(sink_);
+  }
+
+  // Keeps the capacity.
+  buffer_.clear();
+}
+
+void OutputWriter::BeginRecord(OutputRecordType type,
+                               OutputString const* name,
+                               std::size_t depth)
+{
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    buffer_.append(depth, '\t');
+    if (name)
+    {
+      AppendUtf8(*name);
+      buffer_ += ": ";
+    }
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += "{\"depth\":";
+    AppendDecimal(depth);
+    if (name)
+    {
+      buffer_ += ",\"name\":";
+      AppendJsonString(*name);
+    }
+    break;
+  case OutputFormat::kBinary:
+  {
+    AppendRaw(static_cast<std::uint8_t>(type));
+    AppendRaw(static_cast<std::uint8_t>(
+      (std::min)(depth, std::size_t{(std::numeric_limits<BYTE>::max)()})));
+    std::size_t const size_offset = buffer_.size();
+    AppendRaw(std::uint16_t{0});
+    if (name)
+    {
+      AppendUtf8(*name);
+    }
+
+    // Names are never anywhere near this long, but don't write a broken
+    // record if one is.
+    std::size_t const name_size = buffer_.size() - size_offset - 2;
+    auto const max_name_size = (std::numeric_limits<WORD>::max)();
+    if (name_size > max_name_size)
+    {
+      buffer_.resize(size_offset + 2 + max_name_size);
+    }
+    auto const name_size_raw = static_cast<std::uint16_t>(
+      (std::min)(name_size, std::size_t{max_name_size}));
+    std::copy(reinterpret_cast<char const*>(&name_size_raw),
+              reinterpret_cast<char const*>(&name_size_raw + 1),
+              buffer_.begin() + size_offset);
+    break;
+  }
+  case OutputFormat::kNone:
+    break;
+  }
+}
+
+void OutputWriter::EndRecord()
+{
+  switch (format_)
+  {
+  case OutputFormat::kText:
+    buffer_.push_back('\n');
+    break;
+  case OutputFormat::kJsonLines:
+    buffer_ += "}\n";
+    break;
+  case OutputFormat::kBinary:
+    break;
+  case OutputFormat::kNone:
+    break;
+  }
+
+  FlushIfFull();
+}
+
+void OutputWriter::FlushIfFull()
+{
+  if (sink_ && buffer_.size() >= kOutputBufferSize)
+  {
+    Flush();
+  }
+}
+
+void OutputWriter::AppendUtf8(OutputString s)
+{
+  ForEachCodePoint(s,
+                   [this](std::uint32_t c)
+                   {
+    AppendCodePoint(buffer_, c);
+  });
+}
+
+void OutputWriter::AppendJsonString(OutputString s)
+{
+  buffer_.push_back('"');
+  ForEachCodePoint(s,
+                   [this](std::uint32_t c)
+                   {
+    switch (c)
+    {
+    case '"':
+      buffer_ += "\\\"";
+      break;
+    case '\\':
+      buffer_ += "\\\\";
+      break;
+    case '\n':
+      buffer_ += "\\n";
+      break;
+    case '\r':
+      buffer_ += "\\r";
+      break;
+    case '\t':
+      buffer_ += "\\t";
+      break;
+    default:
+      if (c < 0x20)
+      {
+        buffer_ += "\\u00";
+        AppendHex(buffer_, c, 2);
+      }
+      else
+      {
+        AppendCodePoint(buffer_, c);
+      }
+      break;
+    }
+  });
+  buffer_.push_back('"');
+}
+
+void OutputWriter::AppendDecimal(std::uint64_t value)
+{
+  char digits[20];
+  std::size_t num_digits = 0;
+  do
+  {
+    digits[num_digits++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value);
+
+  while (num_digits)
+  {
+    buffer_.push_back(digits[--num_digits]);
+  }
+}
+
+void OutputWriter::AppendSizedUtf8(OutputString s)
+{
+  std::size_t const size_offset = buffer_.size();
+  AppendRaw(std::uint32_t{0});
+  AppendUtf8(s);
+
+  auto const size = static_cast<std::uint32_t>(buffer_.size() - size_offset -
+                                               sizeof(std::uint32_t));
+  std::copy(reinterpret_cast<char const*>(&size),
+            reinterpret_cast<char const*>(&size + 1),
+            buffer_.begin() + size_offset);
+}
+
+void OutputWriter::AppendTriageField(char const* name,
+                                     std::uint64_t value,
+                                     std::size_t width)
+{
+  if (format_ == OutputFormat::kJsonLines)
+  {
+    buffer_ += ",\"";
+    buffer_ += name;
+    buffer_ += "\":\"0x";
+    AppendHex(buffer_, value, width);
+    buffer_.push_back('"');
+  }
+  else
+  {
+    buffer_.push_back(' ');
+    buffer_ += name;
+    buffer_ += "=0x";
+    AppendHex(buffer_, value, width);
+  }
+}
+
+void AppendHex(std::string& buffer, std::uint64_t value, std::size_t width)
+{
+  char digits[16];
+  std::size_t num_digits = 0;
+  do
+  {
+    digits[num_digits++] = kHexDigits[value & 0xF];
+    value >>= 4;
+  } while (value);
+
+  if (width > num_digits)
+  {
+    buffer.append(width - num_digits, '0');
+  }
+
+  while (num_digits)
+  {
+    buffer.push_back(digits[--num_digits]);
+  }
+}
+
+OutputFormat GetOutputFormat()
+{
+  return g_output_format;
+}
+
+void SetOutputFormat(OutputFormat format)
+{
+  GetStdoutWriter().SetFormat(format);
+  g_output_format = format;
+
+  if (format != OutputFormat::kText)
+  {
+    std::fflush(stdout);
+    ::_setmode(::_fileno(stdout), _O_BINARY);
+  }
+}
+
+void WriteToStdout(std::string const& output)
+{
+  std::fwrite(output.data(), 1, output.size(), stdout);
+  std::fflush(stdout);
+}
+
+OutputWriter& GetStdoutWriter()
+{
+  static OutputWriter writer{g_output_format, stdout};
+  return writer;
+}
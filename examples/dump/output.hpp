@@ -0,0 +1,218 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <string>
+
+namespace hadesmem
+{
+struct PeTriageRecord;
+}
+
+enum class OutputFormat
+{
+  // Human readable text (UTF-8), as it has always been written.
+  kText,
+  // One JSON object per line, e.g. {"depth":2,"name":"Machine",
+  // "value":"0x014c"}. Hex values are written as strings so 64-bit values
+  // survive parsers which only have doubles.
+  kJsonLines,
+  // A stream of the binary records described below.
+  kBinary,
+  // Nothing at all, for when only statistics are wanted.
+  kNone
+};
+
+// Binary records are little-endian and start with a BYTE type, a BYTE depth
+// (the number of tabs in text output) and a WORD length followed by the name
+// as UTF-8 (empty for kText and kNewline). The rest depends on the type:
+//   kText, kNamedText: DWORD length, then the text as UTF-8.
+//   kNewline: Nothing.
+//   kHex: BYTE width (in hex digits), ULONGLONG value.
+//   kHexSuffix: As kHex, then DWORD length and the suffix as UTF-8.
+//   kHexList: BYTE width, DWORD count, then count ULONGLONG values.
+//   kBool: BYTE value.
+//   kTriage: DWORD size, then a hadesmem::PeTriageRecord as it is in memory.
+//     The name is the path of the file.
+enum class OutputRecordType : std::uint8_t
+{
+  kText,
+  kNamedText,
+  kNewline,
+  kHex,
+  kHexSuffix,
+  kHexList,
+  kBool,
+  kTriage
+};
+
+// Non-owning view of a string to write, so names and values can be passed
+// without being copied. Narrow strings (names read out of PE files, etc.)
+// are treated as Latin-1, as they're just bytes.
+class OutputString
+{
+public:
+  OutputString(wchar_t const* s)
+    : wide_{s}, narrow_{nullptr}, size_{std::wcslen(s)}
+  {
+  }
+
+  OutputString(char const* s)
+    : wide_{nullptr}, narrow_{s}, size_{std::strlen(s)}
+  {
+  }
+
+  OutputString(std::wstring const& s)
+    : wide_{s.c_str()}, narrow_{nullptr}, size_{s.size()}
+  {
+  }
+
+  OutputString(std::string const& s)
+    : wide_{nullptr}, narrow_{s.c_str()}, size_{s.size()}
+  {
+  }
+
+  // Null if the string is narrow.
+  wchar_t const* GetWide() const
+  {
+    return wide_;
+  }
+
+  // Null if the string is wide.
+  char const* GetNarrow() const
+  {
+    return narrow_;
+  }
+
+  std::size_t GetSize() const
+  {
+    return size_;
+  }
+
+private:
+  wchar_t const* wide_;
+  char const* narrow_;
+  std::size_t size_;
+};
+
+// Formats dump output into a buffer which is reused for the lifetime of the
+// writer, without going through iostreams (or their locales) and without
+// allocating per field. Writers with a sink flush to it whenever the buffer
+// fills up, otherwise it's up to the owner to take the output.
+class OutputWriter
+{
+public:
+  explicit OutputWriter(OutputFormat format, std::FILE* sink = nullptr);
+
+  ~OutputWriter();
+
+  OutputWriter(OutputWriter const&) = delete;
+  OutputWriter& operator=(OutputWriter const&) = delete;
+
+  OutputFormat GetFormat() const;
+
+  // Flushes anything written in the old format first.
+  void SetFormat(OutputFormat format);
+
+  void Newline();
+
+  void Text(OutputString text, std::size_t depth);
+
+  void NamedText(OutputString name, OutputString value, std::size_t depth);
+
+  void NamedBool(OutputString name, bool value, std::size_t depth);
+
+  // Width is in hex digits (i.e. twice the size of the original type).
+  void NamedHex(OutputString name,
+                std::uint64_t value,
+                std::size_t width,
+                std::size_t depth);
+
+  void NamedHexSuffix(OutputString name,
+                      std::uint64_t value,
+                      std::size_t width,
+                      OutputString suffix,
+                      std::size_t depth);
+
+  // Lists are written with BeginNamedHexList, HexListItem for each value,
+  // then EndNamedHexList. Nothing else may be written in between.
+  void BeginNamedHexList(OutputString name,
+                         std::size_t width,
+                         std::size_t depth);
+
+  void HexListItem(std::uint64_t value);
+
+  void EndNamedHexList();
+
+  // Everything about the file on one line (or in one record).
+  void TriageRecord(OutputString path, hadesmem::PeTriageRecord const& record);
+
+  // Output already formatted by a writer with the same format.
+  void Append(std::string const& output);
+
+  // Everything written since the last flush or swap.
+  std::string const& GetBuffer() const;
+
+  // Exchanges the buffer with the given string, which should usually be
+  // empty. Used to hand buffered output off to someone else.
+  void SwapBuffer(std::string& buffer);
+
+  // Writes the buffer to the sink (if any) and clears it.
+  void Flush();
+
+private:
+  void BeginRecord(OutputRecordType type,
+                   OutputString const* name,
+                   std::size_t depth);
+
+  void EndRecord();
+
+  void FlushIfFull();
+
+  void AppendUtf8(OutputString s);
+
+  void AppendJsonString(OutputString s);
+
+  void AppendDecimal(std::uint64_t value);
+
+  template <typename T> void AppendRaw(T value);
+
+  // Appends a DWORD length for the UTF-8 data appended after it.
+  void AppendSizedUtf8(OutputString s);
+
+  // Appends a name and hex value to a text or JSON triage record.
+  void AppendTriageField(char const* name,
+                         std::uint64_t value,
+                         std::size_t width);
+
+  std::string buffer_;
+  OutputFormat format_;
+  std::FILE* sink_;
+  std::size_t list_width_{0};
+  std::size_t list_count_offset_{0};
+  std::uint32_t list_count_{0};
+};
+
+// Appends the value in lower case hex (without a prefix), padded with zeros
+// to at least width digits.
+void AppendHex(std::string& buffer, std::uint64_t value, std::size_t width);
+
+OutputFormat GetOutputFormat();
+
+// Also switches stdout to binary mode for the structured formats, so that
+// newlines are written untranslated.
+void SetOutputFormat(OutputFormat format);
+
+// Writes output from another writer's buffer straight to stdout. Callers
+// must make sure the stdout writer has been flushed first.
+void WriteToStdout(std::string const& output);
+
+// The writer for stdout, which is flushed whenever its buffer fills up (and
+// at exit). Must only be used by the main thread.
+OutputWriter& GetStdoutWriter();
@@ -0,0 +1,151 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include "packer.hpp"
+
+#include <cstddef>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_entropy.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+#include "main.hpp"
+#include "print.hpp"
+#include "warning.hpp"
+
+namespace
+{
+// Compressed or encrypted data is close to 8 bits per byte, whereas native
+// code rarely gets above 6.5 and most other data is well below 7.
+double const kHighCodeEntropy = 6.8;
+double const kHighDataEntropy = 7.2;
+
+// Too little data for the entropy to mean much.
+DWORD const kMinEntropySize = 0x400;
+
+DWORD const kPackedScore = 3;
+
+bool IsExecutable(hadesmem::Section const& section)
+{
+  return !!(section.GetCharacteristics() &
+            (IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_CNT_CODE));
+}
+}
+
+void DumpPackerHeuristics(hadesmem::Process const& process,
+                          hadesmem::PeFile const& pe_file,
+                          hadesmem::PeEntropy const& entropy)
+{
+  hadesmem::NtHeaders const nt_hdrs(process, pe_file);
+  hadesmem::SectionList const sections(process, pe_file);
+  std::vector<double> const& section_entropy = entropy.GetSectionEntropy();
+
+  bool writable_executable = false;
+  bool executable_virtual = false;
+  bool high_entropy_code = false;
+  bool high_entropy_data = false;
+  bool entry_point_in_code = false;
+  DWORD const entry_point = nt_hdrs.GetAddressOfEntryPoint();
+  std::size_t index = 0;
+  for (auto const& s : sections)
+  {
+    DWORD const characteristics = s.GetCharacteristics();
+    DWORD const raw_size = s.GetSizeOfRawData();
+    DWORD const virtual_size = s.GetVirtualSize();
+    bool const executable = IsExecutable(s);
+    double const e = section_entropy[index++];
+
+    if (executable && (characteristics & IMAGE_SCN_MEM_WRITE))
+    {
+      writable_executable = true;
+    }
+
+    // Packers often have an empty section for the unpacked code, which is
+    // only filled in at runtime.
+    if (executable && virtual_size / 4 > raw_size)
+    {
+      executable_virtual = true;
+    }
+
+    if (raw_size >= kMinEntropySize)
+    {
+      if (executable && e >= kHighCodeEntropy)
+      {
+        high_entropy_code = true;
+      }
+      else if (!executable && e >= kHighDataEntropy)
+      {
+        high_entropy_data = true;
+      }
+    }
+
+    DWORD const size = virtual_size > raw_size ? virtual_size : raw_size;
+    if (executable && entry_point >= s.GetVirtualAddress() &&
+        entry_point - s.GetVirtualAddress() < size)
+    {
+      entry_point_in_code = true;
+    }
+  }
+
+  // DLLs don't need an entry point at all.
+  bool const entry_point_outside_code = entry_point && !entry_point_in_code;
+  bool const high_entropy_overlay =
+    entropy.GetOverlaySize() >= kMinEntropySize &&
+    entropy.GetOverlayEntropy() >= kHighDataEntropy;
+
+  DWORD const score = (writable_executable ? 1 : 0) +
+                      (executable_virtual ? 1 : 0) +
+                      (entry_point_outside_code ? 1 : 0) +
+                      (high_entropy_code ? 2 : 0) +
+                      (high_entropy_data ? 1 : 0) +
+                      (high_entropy_overlay ? 1 : 0);
+  if (!score)
+  {
+    return;
+  }
+
+  OutputWriter& out = GetOutputWriter();
+
+  WriteNewline(out);
+  WriteNormal(out, L"Packer Heuristics:", 1);
+  WriteNewline(out);
+  if (writable_executable)
+  {
+    WriteNormal(out, L"Detected writable and executable section.", 2);
+  }
+  if (executable_virtual)
+  {
+    WriteNormal(
+      out, L"Detected executable section with little or no raw data.", 2);
+  }
+  if (entry_point_outside_code)
+  {
+    WriteNormal(out, L"Detected EP outside of executable sections.", 2);
+  }
+  if (high_entropy_code)
+  {
+    WriteNormal(out, L"Detected executable section with high entropy.", 2);
+  }
+  if (high_entropy_data)
+  {
+    WriteNormal(out, L"Detected data section with high entropy.", 2);
+  }
+  if (high_entropy_overlay)
+  {
+    WriteNormal(out, L"Detected overlay with high entropy.", 2);
+  }
+  WriteNamedHex(out, L"Score", score, 2);
+
+  if (score >= kPackedScore)
+  {
+    WriteNormal(out, L"WARNING! File looks packed or encrypted.", 2);
+    WarnForCurrentFile(WarningType::kPacked);
+  }
+}
@@ -0,0 +1,17 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+namespace hadesmem
+{
+class Process;
+class PeFile;
+class PeEntropy;
+}
+
+// Scores the file on a few signs of packing or encryption, and warns (with
+// WarningType::kPacked) if there are enough of them.
+void DumpPackerHeuristics(hadesmem::Process const& process,
+                          hadesmem::PeFile const& pe_file,
+                          hadesmem::PeEntropy const& entropy);
@@ -4,12 +4,16 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <iomanip>
 #include <locale>
 #include <ostream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+#include "output.hpp"
+
 template <typename CharT> class StreamFlagSaver
 {
 public:
@@ -96,3 +100,78 @@ inline void WriteNewline(std::wostream& out)
 {
   out << L'\n';
 }
+
+// Dump output goes through an OutputWriter, which formats everything itself
+// rather than using iostreams. The std::wostream versions above are only
+// for things like the warned list, which can be written straight to a file.
+
+// Hex is written with two digits per byte of the original type, and signed
+// values as their two's complement (as iostreams do).
+template <typename T> inline std::uint64_t ToOutputHex(T const& num)
+{
+  static_assert(std::is_integral<T>::value, "Only integers can be hex.");
+  return static_cast<std::uint64_t>(
+    static_cast<typename std::make_unsigned<T>::type>(num));
+}
+
+template <typename T>
+inline void WriteNamedHex(OutputWriter& out,
+                          OutputString name,
+                          T const& num,
+                          std::size_t tabs)
+{
+  out.NamedHex(name, ToOutputHex(num), sizeof(num) * 2, tabs);
+}
+
+template <typename T>
+inline void WriteNamedHexSuffix(OutputWriter& out,
+                                OutputString name,
+                                T const& num,
+                                OutputString suffix,
+                                std::size_t tabs)
+{
+  out.NamedHexSuffix(name, ToOutputHex(num), sizeof(num) * 2, suffix, tabs);
+}
+
+template <typename C>
+inline void WriteNamedHexContainer(OutputWriter& out,
+                                   OutputString name,
+                                   C const& c,
+                                   std::size_t tabs)
+{
+  out.BeginNamedHexList(name, sizeof(typename C::value_type) * 2, tabs);
+  for (auto const& e : c)
+  {
+    out.HexListItem(ToOutputHex(e));
+  }
+  out.EndNamedHexList();
+}
+
+inline void WriteNamedNormal(OutputWriter& out,
+                             OutputString name,
+                             OutputString value,
+                             std::size_t tabs)
+{
+  out.NamedText(name, value, tabs);
+}
+
+// A template so that pointers (i.e. strings) don't convert to bool.
+template <typename T>
+inline typename std::enable_if<std::is_same<T, bool>::value>::type
+  WriteNamedNormal(OutputWriter& out,
+                   OutputString name,
+                   T value,
+                   std::size_t tabs)
+{
+  out.NamedBool(name, value, tabs);
+}
+
+inline void WriteNormal(OutputWriter& out, OutputString t, std::size_t tabs)
+{
+  out.Text(t, tabs);
+}
+
+inline void WriteNewline(OutputWriter& out)
+{
+  out.Newline();
+}
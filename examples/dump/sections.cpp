@@ -3,10 +3,13 @@
 
 #include "sections.hpp"
 
+#include <cstddef>
 #include <iostream>
 #include <iterator>
+#include <string>
 
 #include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_entropy.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/pelib/section.hpp>
 #include <hadesmem/pelib/section_list.hpp>
@@ -16,12 +19,27 @@
 #include "print.hpp"
 #include "warning.hpp"
 
+namespace
+{
+// Output has no floating point fields, so entropy is written as text with a
+// fixed number of places (and without going through a locale).
+std::string FormatEntropy(double entropy)
+{
+  auto const thousandths =
+    static_cast<unsigned int>(entropy * 1000.0 + 0.5);
+  std::string const fraction = std::to_string(thousandths % 1000);
+  return std::to_string(thousandths / 1000) + "." +
+         std::string(3 - fraction.size(), '0') + fraction;
+}
+}
+
 void DumpSections(hadesmem::Process const& process,
-                  hadesmem::PeFile const& pe_file)
+                  hadesmem::PeFile const& pe_file,
+                  hadesmem::PeEntropy const& entropy)
 {
   hadesmem::SectionList sections(process, pe_file);
 
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
   if (std::begin(sections) != std::end(sections))
   {
@@ -40,6 +58,7 @@ void DumpSections(hadesmem::Process const& process,
     }
   }
 
+  std::size_t index = 0;
   for (auto const& s : sections)
   {
     WriteNewline(out);
@@ -59,5 +78,18 @@ void DumpSections(hadesmem::Process const& process,
     WriteNamedHex(out, L"NumberOfRelocations", s.GetNumberOfRelocations(), 2);
     WriteNamedHex(out, L"NumberOfLinenumbers", s.GetNumberOfLinenumbers(), 2);
     WriteNamedHex(out, L"Characteristics", s.GetCharacteristics(), 2);
+    WriteNamedNormal(
+      out, L"Entropy", FormatEntropy(entropy.GetSectionEntropy()[index++]), 2);
+  }
+
+  if (entropy.HasOverlay())
+  {
+    WriteNewline(out);
+    WriteNormal(out, L"Overlay:", 1);
+    WriteNewline(out);
+    WriteNamedHex(out, L"Offset", entropy.GetOverlayOffset(), 2);
+    WriteNamedHex(out, L"Size", entropy.GetOverlaySize(), 2);
+    WriteNamedNormal(
+      out, L"Entropy", FormatEntropy(entropy.GetOverlayEntropy()), 2);
   }
 }
@@ -7,7 +7,9 @@ namespace hadesmem
 {
 class Process;
 class PeFile;
+class PeEntropy;
 }
 
 void DumpSections(hadesmem::Process const& process,
-                  hadesmem::PeFile const& pe_file);
+                  hadesmem::PeFile const& pe_file,
+                  hadesmem::PeEntropy const& entropy);
@@ -0,0 +1,350 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section_table.hpp>
+#include <hadesmem/process.hpp>
+
+#include "output.hpp"
+#include "warning.hpp"
+
+namespace
+{
+bool g_stats_enabled = false;
+
+std::size_t const kNumFileStatuses =
+  static_cast<std::size_t>(FileStatus::kDumped) + 1;
+
+char const* const kFileStatusNames[kNumFileStatuses] = {
+  "open_failed", "empty", "not_pe", "invalid_nt_headers", "dumped"};
+
+std::size_t const kNumWarningTypes =
+  static_cast<std::size_t>(WarningType::kPacked) + 1;
+
+char const* const kWarningTypeNames[kNumWarningTypes] = {
+  "suspicious", "unsupported", "packed"};
+
+std::size_t const kNumDataDirs = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+
+char const* const kDataDirNames[kNumDataDirs] = {"Export",
+                                                 "Import",
+                                                 "Resource",
+                                                 "Exception",
+                                                 "Security",
+                                                 "BaseReloc",
+                                                 "Debug",
+                                                 "Architecture",
+                                                 "GlobalPTR",
+                                                 "TLS",
+                                                 "LoadConfig",
+                                                 "BoundImport",
+                                                 "IAT",
+                                                 "DelayImport",
+                                                 "COMDescriptor",
+                                                 "Reserved"};
+
+// Header fields which get a histogram of their values.
+enum StatsField
+{
+  kStatsMachine,
+  kStatsNumberOfSections,
+  kStatsSizeOfOptionalHeader,
+  kStatsCharacteristics,
+  kStatsMagic,
+  kStatsMajorLinkerVersion,
+  kStatsSectionAlignment,
+  kStatsFileAlignment,
+  kStatsMajorSubsystemVersion,
+  kStatsSubsystem,
+  kStatsDllCharacteristics,
+  kStatsNumberOfRvaAndSizes,
+  kNumStatsFields
+};
+
+struct StatsFieldInfo
+{
+  char const* name;
+  // In hex digits.
+  std::size_t width;
+};
+
+StatsFieldInfo const kStatsFields[kNumStatsFields] = {
+  {"Machine", 4},
+  {"NumberOfSections", 4},
+  {"SizeOfOptionalHeader", 4},
+  {"Characteristics", 4},
+  {"Magic", 4},
+  {"MajorLinkerVersion", 2},
+  {"SectionAlignment", 8},
+  {"FileAlignment", 8},
+  {"MajorSubsystemVersion", 4},
+  {"Subsystem", 4},
+  {"DllCharacteristics", 4},
+  {"NumberOfRvaAndSizes", 8}};
+
+typedef std::unordered_map<std::uint64_t, std::uint64_t> Histogram;
+
+// Everything is a sum, so statistics from any number of threads can be merged
+// in any order.
+struct Stats
+{
+  void Merge(Stats const& other)
+  {
+    for (std::size_t i = 0; i < kNumFileStatuses; ++i)
+    {
+      files[i] += other.files[i];
+    }
+
+    for (std::size_t i = 0; i < kNumWarningTypes; ++i)
+    {
+      warnings[i] += other.warnings[i];
+    }
+    warned_files += other.warned_files;
+
+    virtual_section_tables += other.virtual_section_tables;
+
+    for (std::size_t i = 0; i < kNumDataDirs; ++i)
+    {
+      data_dirs[i] += other.data_dirs[i];
+    }
+
+    for (std::size_t i = 0; i < kNumStatsFields; ++i)
+    {
+      for (auto const& value : other.fields[i])
+      {
+        fields[i][value.first] += value.second;
+      }
+    }
+  }
+
+  std::array<std::uint64_t, kNumFileStatuses> files{};
+  std::array<std::uint64_t, kNumWarningTypes> warnings{};
+  // Files with at least one warning.
+  std::uint64_t warned_files{};
+  // Files where the section table runs past the end of the file.
+  std::uint64_t virtual_section_tables{};
+  // Files with each data directory present (non-zero address and size).
+  std::array<std::uint64_t, kNumDataDirs> data_dirs{};
+  std::array<Histogram, kNumStatsFields> fields;
+};
+
+// Each thread's statistics are created the first time it counts anything,
+// and live until exit so that they can be merged after the thread is gone.
+HADESMEM_DETAIL_THREAD_LOCAL Stats* g_thread_stats = nullptr;
+std::vector<std::unique_ptr<Stats>> g_all_stats;
+SRWLOCK g_all_stats_lock = SRWLOCK_INIT;
+
+Stats& GetThreadStats()
+{
+  if (!g_thread_stats)
+  {
+    auto stats = std::make_unique<Stats>();
+
+    hadesmem::detail::AcquireSRWLock const lock(
+      &g_all_stats_lock, hadesmem::detail::SRWLockType::Exclusive);
+    g_all_stats.push_back(std::move(stats));
+    g_thread_stats = g_all_stats.back().get();
+  }
+
+  return *g_thread_stats;
+}
+
+// Names are never anything which would need escaping.
+void AppendCount(std::string& buffer,
+                 char const* name,
+                 std::uint64_t count,
+                 bool first)
+{
+  if (!first)
+  {
+    buffer.push_back(',');
+  }
+  buffer.push_back('"');
+  buffer += name;
+  buffer += "\":";
+  buffer += std::to_string(count);
+}
+
+// Values are written in ascending order, as hex strings to match the
+// structured output formats.
+void AppendHistogram(std::string& buffer,
+                     StatsFieldInfo const& field,
+                     Histogram const& histogram)
+{
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> values(
+    std::begin(histogram), std::end(histogram));
+  std::sort(std::begin(values), std::end(values));
+
+  buffer.push_back('"');
+  buffer += field.name;
+  buffer += "\":{";
+  for (auto const& value : values)
+  {
+    if (&value != &values.front())
+    {
+      buffer.push_back(',');
+    }
+    buffer += "\"0x";
+    AppendHex(buffer, value.first, field.width);
+    buffer += "\":";
+    buffer += std::to_string(value.second);
+  }
+  buffer.push_back('}');
+}
+}
+
+bool GetStatsEnabled()
+{
+  return g_stats_enabled;
+}
+
+void SetStatsEnabled(bool b)
+{
+  g_stats_enabled = b;
+}
+
+void AddFileStats(FileStatus status)
+{
+  if (!g_stats_enabled)
+  {
+    return;
+  }
+
+  ++GetThreadStats().files[static_cast<std::size_t>(status)];
+}
+
+void AddPeFileStats(hadesmem::Process const& process,
+                    hadesmem::PeFile const& pe_file,
+                    hadesmem::NtHeaders const& nt_headers,
+                    std::uint32_t warnings)
+{
+  if (!g_stats_enabled)
+  {
+    return;
+  }
+
+  Stats& stats = GetThreadStats();
+
+  ++stats.files[static_cast<std::size_t>(FileStatus::kDumped)];
+
+  for (std::size_t i = 0; i < kNumWarningTypes; ++i)
+  {
+    if (warnings & (1U << i))
+    {
+      ++stats.warnings[i];
+    }
+  }
+  if (warnings)
+  {
+    ++stats.warned_files;
+  }
+
+  hadesmem::SectionTable const sections(process, pe_file);
+  if (!sections.empty() && sections.IsVirtual(sections.size() - 1))
+  {
+    ++stats.virtual_section_tables;
+  }
+
+  DWORD const num_data_dirs = nt_headers.GetNumberOfRvaAndSizesClamped();
+  for (DWORD i = 0; i < num_data_dirs; ++i)
+  {
+    auto const data_dir = static_cast<hadesmem::PeDataDir>(i);
+    if (nt_headers.GetDataDirectoryVirtualAddress(data_dir) &&
+        nt_headers.GetDataDirectorySize(data_dir))
+    {
+      ++stats.data_dirs[i];
+    }
+  }
+
+  auto& fields = stats.fields;
+  ++fields[kStatsMachine][nt_headers.GetMachine()];
+  ++fields[kStatsNumberOfSections][nt_headers.GetNumberOfSections()];
+  ++fields[kStatsSizeOfOptionalHeader][nt_headers.GetSizeOfOptionalHeader()];
+  ++fields[kStatsCharacteristics][nt_headers.GetCharacteristics()];
+  ++fields[kStatsMagic][nt_headers.GetMagic()];
+  ++fields[kStatsMajorLinkerVersion][nt_headers.GetMajorLinkerVersion()];
+  ++fields[kStatsSectionAlignment][nt_headers.GetSectionAlignment()];
+  ++fields[kStatsFileAlignment][nt_headers.GetFileAlignment()];
+  ++fields[kStatsMajorSubsystemVersion]
+          [nt_headers.GetMajorSubsystemVersion()];
+  ++fields[kStatsSubsystem][nt_headers.GetSubsystem()];
+  ++fields[kStatsDllCharacteristics][nt_headers.GetDllCharacteristics()];
+  ++fields[kStatsNumberOfRvaAndSizes][nt_headers.GetNumberOfRvaAndSizes()];
+}
+
+void WriteStats()
+{
+  Stats stats;
+  {
+    hadesmem::detail::AcquireSRWLock const lock(
+      &g_all_stats_lock, hadesmem::detail::SRWLockType::Shared);
+    for (auto const& thread_stats : g_all_stats)
+    {
+      stats.Merge(*thread_stats);
+    }
+  }
+
+  std::uint64_t total = 0;
+  for (auto const count : stats.files)
+  {
+    total += count;
+  }
+
+  std::string buffer;
+  buffer += "{\"files\":{";
+  AppendCount(buffer, "total", total, true);
+  for (std::size_t i = 0; i < kNumFileStatuses; ++i)
+  {
+    AppendCount(buffer, kFileStatusNames[i], stats.files[i], false);
+  }
+
+  buffer += "},\"warnings\":{";
+  AppendCount(buffer, "files", stats.warned_files, true);
+  for (std::size_t i = 0; i < kNumWarningTypes; ++i)
+  {
+    AppendCount(buffer, kWarningTypeNames[i], stats.warnings[i], false);
+  }
+
+  buffer += "},";
+  AppendCount(
+    buffer, "virtual_section_tables", stats.virtual_section_tables, true);
+
+  buffer += ",\"data_directories\":{";
+  for (std::size_t i = 0; i < kNumDataDirs; ++i)
+  {
+    AppendCount(buffer, kDataDirNames[i], stats.data_dirs[i], i == 0);
+  }
+
+  buffer += "},\"fields\":{";
+  for (std::size_t i = 0; i < kNumStatsFields; ++i)
+  {
+    if (i)
+    {
+      buffer.push_back(',');
+    }
+    AppendHistogram(buffer, kStatsFields[i], stats.fields[i]);
+  }
+  buffer += "}}\n";
+
+  // Anything written before the statistics goes first.
+  GetStdoutWriter().Flush();
+  WriteToStdout(buffer);
+}
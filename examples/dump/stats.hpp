@@ -0,0 +1,46 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstdint>
+
+namespace hadesmem
+{
+class Process;
+class PeFile;
+class NtHeaders;
+}
+
+// Statistics mode answers questions about a corpus as a whole (e.g. the
+// distribution of FileAlignment values, or how many files raise each type of
+// warning) without writing any per-file output. Each thread counts into its
+// own statistics, which are only merged once dumping is done.
+
+// What became of a file, in the order DumpFile checks for them.
+enum class FileStatus
+{
+  kOpenFailed,
+  kEmpty,
+  kNotPe,
+  // Or the wrong architecture.
+  kInvalidNtHeaders,
+  kDumped
+};
+
+bool GetStatsEnabled();
+
+void SetStatsEnabled(bool b);
+
+void AddFileStats(FileStatus status);
+
+// Counts a file which has been dumped successfully, with the warnings raised
+// for it (as a mask from GetWarningsForCurrentFile).
+void AddPeFileStats(hadesmem::Process const& process,
+                    hadesmem::PeFile const& pe_file,
+                    hadesmem::NtHeaders const& nt_headers,
+                    std::uint32_t warnings);
+
+// Merges the statistics from every thread, and writes them to stdout as a
+// single line of JSON.
+void WriteStats();
@@ -3,69 +3,31 @@
 
 #include "strings.hpp"
 
-#include <cctype>
-#include <cstddef>
-#include <cstdint>
-#include <iostream>
-#include <iterator>
-#include <memory>
-#include <sstream>
-#include <string>
-#include <vector>
+#include <windows.h>
 
-#include <hadesmem/detail/str_conv.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/string_extractor.hpp>
 #include <hadesmem/process.hpp>
-#include <hadesmem/read.hpp>
 
 #include "main.hpp"
 #include "print.hpp"
-#include "warning.hpp"
 
 namespace
 {
-void DumpStringsImpl(hadesmem::Process const& /*process*/,
-                     hadesmem::PeFile const& pe_file,
-                     void* beg,
-                     void* end,
-                     bool wide)
+// The alignment is only checked for UTF-16 strings.
+void DumpStringsImpl(hadesmem::StringExtractor const& strings,
+                     hadesmem::StringEncoding encoding,
+                     DWORD alignment)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
-  if (pe_file.GetType() != hadesmem::PeFileType::Data)
+  for (auto const& s : strings.GetStrings())
   {
-    WriteNormal(out,
-                L"WARNING! Skipping string dump (Image file type is currently "
-                L"unsupported).",
-                2);
-    WarnForCurrentFile(WarningType::kUnsupported);
-    return;
-  }
-
-  std::size_t const kMinStringLen = 3;
-
-  std::string buf;
-  std::locale const& loc = std::locale::classic();
-  auto const step = wide ? 2 : 1;
-  for (std::uint8_t* current = static_cast<std::uint8_t*>(beg);
-       (current + step - 1) < end;
-       current += (wide ? 2 : 1))
-  {
-    bool const is_print = (wide ? *(current + 1) == 0 : true) &&
-                          std::isprint(static_cast<char>(*current), loc);
-    if (is_print)
+    if (s.encoding == encoding &&
+        (encoding == hadesmem::StringEncoding::kAscii ||
+         s.offset % 2 == alignment))
     {
-      buf += static_cast<char>(*current);
-    }
-
-    if (!is_print || current + (wide ? 2 : 1) == end)
-    {
-      if (buf.size() >= kMinStringLen)
-      {
-        WriteNamedNormal(out, L"String", buf.c_str(), 2);
-      }
-
-      buf.clear();
+      WriteNamedNormal(out, L"String", s.value, 2);
     }
   }
 }
@@ -74,23 +36,24 @@ void DumpStringsImpl(hadesmem::Process const& /*process*/,
 void DumpStrings(hadesmem::Process const& process,
                  hadesmem::PeFile const& pe_file)
 {
-  std::wostream& out = std::wcout;
+  OutputWriter& out = GetOutputWriter();
 
-  std::uint8_t* const file_beg = static_cast<std::uint8_t*>(pe_file.GetBase());
-  void* const file_end = file_beg + pe_file.GetSize();
+  // One pass finds all of them, and is also the only thing which touches
+  // every page of the file (or image).
+  hadesmem::StringExtractor const strings(process, pe_file);
 
   WriteNewline(out);
   WriteNormal(out, L"Narrow Strings:", 1);
   WriteNewline(out);
-  DumpStringsImpl(process, pe_file, file_beg, file_end, false);
+  DumpStringsImpl(strings, hadesmem::StringEncoding::kAscii, 0);
 
   WriteNewline(out);
   WriteNormal(out, L"Wide Strings (Pass 1):", 1);
   WriteNewline(out);
-  DumpStringsImpl(process, pe_file, file_beg, file_end, true);
+  DumpStringsImpl(strings, hadesmem::StringEncoding::kUtf16, 0);
 
   WriteNewline(out);
   WriteNormal(out, L"Wide Strings (Pass 2):", 1);
   WriteNewline(out);
-  DumpStringsImpl(process, pe_file, file_beg + 1, file_end, true);
+  DumpStringsImpl(strings, hadesmem::StringEncoding::kUtf16, 1);
 }
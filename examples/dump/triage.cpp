@@ -0,0 +1,85 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include "triage.hpp"
+
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include <windows.h>
+
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/pe_triage.hpp>
+#include <hadesmem/process.hpp>
+
+#include "main.hpp"
+#include "output.hpp"
+
+namespace
+{
+bool g_triage_enabled = false;
+}
+
+bool GetTriageEnabled()
+{
+  return g_triage_enabled;
+}
+
+void SetTriageEnabled(bool b)
+{
+  g_triage_enabled = b;
+}
+
+void TriageFile(std::wstring const& path)
+{
+  OutputWriter& out = GetOutputWriter();
+
+  SetCurrentFilePath(path);
+
+  hadesmem::PeTriageRecord record;
+  std::memset(&record, 0, sizeof(record));
+
+  // The file is opened and read the same way as when it's dumped, so that
+  // triage and dumping can't disagree about what's in it. Only the pages
+  // holding the headers are ever read in.
+  std::unique_ptr<hadesmem::MappedFile> file;
+  try
+  {
+    file = std::make_unique<hadesmem::MappedFile>(path);
+  }
+  catch (std::exception const& /*e*/)
+  {
+    // Still a record like any other, so that binary output can be read back
+    // without special cases.
+    record.status = hadesmem::PeTriageStatus::kOpenFailed;
+    out.TriageRecord(path, record);
+    return;
+  }
+
+  hadesmem::Process const process(::GetCurrentProcessId());
+  if (file->GetSize())
+  {
+    hadesmem::TriagePeFile(process, file->GetBase(), file->GetSize(), record);
+  }
+  else
+  {
+    hadesmem::TriagePeHeaders(nullptr, 0, 0, record);
+  }
+
+  // DumpFile skips anything which fails ProbePeFile, so triage has to reject
+  // the same files.
+  HADESMEM_DETAIL_ASSERT(
+    record.status == hadesmem::PeTriageStatus::kInvalidDosHeader ||
+    record.status == hadesmem::PeTriageStatus::kInvalidNtHeaders ||
+    record.status == hadesmem::PeTriageStatus::kUnreadable ||
+    hadesmem::ProbePeFile(process, file->GetBase(), file->GetSize()));
+
+  // Only the first 4GB is mapped, which is as much as pelib sees, but the
+  // record has the real size.
+  record.file_size = file->GetFileSize();
+
+  out.TriageRecord(path, record);
+}
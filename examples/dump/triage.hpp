@@ -0,0 +1,15 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <string>
+
+bool GetTriageEnabled();
+
+void SetTriageEnabled(bool b);
+
+// Writes a triage record for the file (see hadesmem::TriagePeHeaders) rather
+// than dumping it. Files which can't be opened get a record too, with a
+// status of kOpenFailed.
+void TriageFile(std::wstring const& path);
@@ -3,12 +3,18 @@
 
 #include "warning.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
 #include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
 #include <hadesmem/error.hpp>
 
 #include "print.hpp"
@@ -16,17 +22,41 @@
 namespace
 {
 // Record all modules (on disk) which cause a warning when dumped, to make it
-// easier to isolate files which require further investigation.
-bool g_warned = false;
+// easier to isolate files which require further investigation. Files may be
+// dumped concurrently, so the flag for the current file is per-thread.
+HADESMEM_DETAIL_THREAD_LOCAL bool g_warned = false;
+HADESMEM_DETAIL_THREAD_LOCAL std::uint32_t g_warnings = 0;
 bool g_warned_enabled = false;
 bool g_warned_dynamic = false;
 std::vector<std::wstring> g_all_warned;
+SRWLOCK g_all_warned_lock = SRWLOCK_INIT;
 std::wstring g_warned_file_path;
 WarningType g_warned_type = WarningType::kAll;
+
+template <typename Out> void DumpWarnedImpl(Out& out)
+{
+  hadesmem::detail::AcquireSRWLock const lock(
+    &g_all_warned_lock, hadesmem::detail::SRWLockType::Shared);
+
+  if (!g_all_warned.empty())
+  {
+    WriteNewline(out);
+    WriteNormal(out, L"Dumping warned list.", 0);
+    for (auto const& f : g_all_warned)
+    {
+      WriteNormal(out, f, 0);
+    }
+  }
+}
 }
 
 void WarnForCurrentFile(WarningType warned_type)
 {
+  if (warned_type != WarningType::kAll)
+  {
+    g_warnings |= 1U << static_cast<int>(warned_type);
+  }
+
   if (warned_type == g_warned_type || g_warned_type == WarningType::kAll)
   {
     g_warned = true;
@@ -36,12 +66,34 @@ void WarnForCurrentFile(WarningType warned_type)
 void ClearWarnForCurrentFile()
 {
   g_warned = false;
+  g_warnings = 0;
+}
+
+std::uint32_t GetWarningsForCurrentFile()
+{
+  return g_warnings;
+}
+
+void RestoreWarningsForCurrentFile(std::uint32_t warnings)
+{
+  ClearWarnForCurrentFile();
+
+  for (int i = 0; i < 32; ++i)
+  {
+    if (warnings & (1U << i))
+    {
+      WarnForCurrentFile(static_cast<WarningType>(i));
+    }
+  }
 }
 
 void HandleWarnings(std::wstring const& path)
 {
   if (g_warned_enabled && g_warned)
   {
+    hadesmem::detail::AcquireSRWLock const lock(
+      &g_all_warned_lock, hadesmem::detail::SRWLockType::Exclusive);
+
     if (g_warned_dynamic)
     {
       std::unique_ptr<std::wfstream> warned_file_ptr(
@@ -63,17 +115,22 @@ void HandleWarnings(std::wstring const& path)
   }
 }
 
+void SortWarned()
+{
+  hadesmem::detail::AcquireSRWLock const lock(
+    &g_all_warned_lock, hadesmem::detail::SRWLockType::Exclusive);
+
+  std::sort(std::begin(g_all_warned), std::end(g_all_warned));
+}
+
 void DumpWarned(std::wostream& out)
 {
-  if (!g_all_warned.empty())
-  {
-    WriteNewline(out);
-    WriteNormal(out, L"Dumping warned list.", 0);
-    for (auto const& f : g_all_warned)
-    {
-      WriteNormal(out, f, 0);
-    }
-  }
+  DumpWarnedImpl(out);
+}
+
+void DumpWarned(OutputWriter& out)
+{
+  DumpWarnedImpl(out);
 }
 
 bool GetWarningsEnabled()
@@ -3,13 +3,17 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 
+class OutputWriter;
+
 enum class WarningType : int
 {
   kSuspicious,
   kUnsupported,
+  kPacked,
   kAll = -1
 };
 
@@ -17,10 +21,25 @@ void WarnForCurrentFile(WarningType warned_type);
 
 void ClearWarnForCurrentFile();
 
+// Every type of warning raised for the current file since it was cleared
+// (whether or not it passed the warned type filter), as a mask of
+// 1 << WarningType.
+std::uint32_t GetWarningsForCurrentFile();
+
+// Raises the warnings in a mask from GetWarningsForCurrentFile, e.g. when the
+// output for the file comes from the cache rather than dumping it.
+void RestoreWarningsForCurrentFile(std::uint32_t warnings);
+
 void HandleWarnings(std::wstring const& path);
 
+// Files are added to the warned list in the order they finish, which is
+// only deterministic when dumping serially.
+void SortWarned();
+
 void DumpWarned(std::wostream& out);
 
+void DumpWarned(OutputWriter& out);
+
 bool GetWarningsEnabled();
 
 void SetWarningsEnabled(bool b);
@@ -0,0 +1,219 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
+
+// Runs tasks, which may push more tasks, on a fixed number of threads until
+// there are none left. Each thread pushes and pops its own tasks at the back
+// of its own queue (so a directory walk stays depth first and mostly local to
+// a thread), and when that's empty steals from the front of the others (where
+// the oldest, and usually biggest, subtrees are).
+class WorkStealingPool
+{
+public:
+  // Tasks are passed the index of the thread running them, for use with Push.
+  using Task = std::function<void(std::size_t worker)>;
+
+  explicit WorkStealingPool(std::size_t num_threads)
+    : queues_(num_threads ? num_threads : 1)
+  {
+  }
+
+  WorkStealingPool(WorkStealingPool const&) = delete;
+
+  WorkStealingPool& operator=(WorkStealingPool const&) = delete;
+
+  std::size_t GetNumThreads() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return queues_.size();
+  }
+
+  // Tasks pushed before Run should use worker zero.
+  void Push(std::size_t worker, Task task)
+  {
+    HADESMEM_DETAIL_ASSERT(worker < queues_.size());
+
+    ++pending_;
+
+    {
+      Queue& queue = queues_[worker];
+      hadesmem::detail::AcquireSRWLock const lock(
+        &queue.lock, hadesmem::detail::SRWLockType::Exclusive);
+      queue.tasks.push_back(std::move(task));
+    }
+
+    ++queued_;
+
+    // Idle threads check queued_ with the lock held, so taking it here means
+    // they're either already asleep or will see the new task.
+    {
+      hadesmem::detail::AcquireSRWLock const lock(
+        &idle_lock_, hadesmem::detail::SRWLockType::Exclusive);
+    }
+    ::WakeConditionVariable(&idle_cv_);
+  }
+
+  // Runs until every task (including those pushed while running) has
+  // finished, using the calling thread as worker zero. The first exception
+  // thrown by a task stops the remaining work and is rethrown here once all
+  // threads have finished.
+  void Run()
+  {
+    std::vector<std::thread> threads;
+    threads.reserve(queues_.size() - 1);
+
+    try
+    {
+      for (std::size_t i = 1; i < queues_.size(); ++i)
+      {
+        threads.emplace_back(&WorkStealingPool::Work, this, i);
+      }
+    }
+    catch (...)
+    {
+      Fail(std::exception_ptr());
+      for (auto& thread : threads)
+      {
+        thread.join();
+      }
+
+      throw;
+    }
+
+    Work(0);
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    if (error_)
+    {
+      std::rethrow_exception(error_);
+    }
+  }
+
+private:
+  struct Queue
+  {
+    SRWLOCK lock = SRWLOCK_INIT;
+    std::deque<Task> tasks;
+  };
+
+  void Work(std::size_t worker)
+  {
+    for (;;)
+    {
+      Task task;
+      if (!failed_ && (Pop(worker, task) || Steal(worker, task)))
+      {
+        try
+        {
+          task(worker);
+        }
+        catch (...)
+        {
+          Fail(std::current_exception());
+        }
+
+        if (--pending_ == 0)
+        {
+          hadesmem::detail::AcquireSRWLock const lock(
+            &idle_lock_, hadesmem::detail::SRWLockType::Exclusive);
+          ::WakeAllConditionVariable(&idle_cv_);
+        }
+
+        continue;
+      }
+
+      hadesmem::detail::AcquireSRWLock const lock(
+        &idle_lock_, hadesmem::detail::SRWLockType::Exclusive);
+      while (!failed_ && pending_ && !queued_)
+      {
+        ::SleepConditionVariableSRW(&idle_cv_, &idle_lock_, INFINITE, 0);
+      }
+
+      if (failed_ || !pending_)
+      {
+        return;
+      }
+    }
+  }
+
+  bool Pop(std::size_t worker, Task& task)
+  {
+    Queue& queue = queues_[worker];
+    hadesmem::detail::AcquireSRWLock const lock(
+      &queue.lock, hadesmem::detail::SRWLockType::Exclusive);
+    if (queue.tasks.empty())
+    {
+      return false;
+    }
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    --queued_;
+    return true;
+  }
+
+  bool Steal(std::size_t worker, Task& task)
+  {
+    for (std::size_t i = 1; i < queues_.size(); ++i)
+    {
+      Queue& queue = queues_[(worker + i) % queues_.size()];
+      hadesmem::detail::AcquireSRWLock const lock(
+        &queue.lock, hadesmem::detail::SRWLockType::Exclusive);
+      if (!queue.tasks.empty())
+      {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --queued_;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void Fail(std::exception_ptr const& error)
+  {
+    {
+      hadesmem::detail::AcquireSRWLock const lock(
+        &error_lock_, hadesmem::detail::SRWLockType::Exclusive);
+      if (!error_)
+      {
+        error_ = error;
+      }
+    }
+
+    failed_ = true;
+
+    hadesmem::detail::AcquireSRWLock const lock(
+      &idle_lock_, hadesmem::detail::SRWLockType::Exclusive);
+    ::WakeAllConditionVariable(&idle_cv_);
+  }
+
+  std::vector<Queue> queues_;
+  std::atomic<std::size_t> pending_{0};
+  std::atomic<std::size_t> queued_{0};
+  std::atomic<bool> failed_{false};
+  SRWLOCK idle_lock_ = SRWLOCK_INIT;
+  CONDITION_VARIABLE idle_cv_ = CONDITION_VARIABLE_INIT;
+  SRWLOCK error_lock_ = SRWLOCK_INIT;
+  std::exception_ptr error_;
+};
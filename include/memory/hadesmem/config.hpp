@@ -58,6 +58,11 @@
 #define HADESMEM_DETAIL_NO_CONSTEXPR
 #endif // #if defined(HADESMEM_MSVC)
 
+// MSVC only supports __declspec(thread), which is limited to POD types.
+#if defined(HADESMEM_MSVC)
+#define HADESMEM_DETAIL_NO_THREAD_LOCAL
+#endif // #if defined(HADESMEM_MSVC)
+
 #if defined(HADESMEM_GCC)
 #define HADESMEM_DETAIL_NO_DXGI1_2
 #endif // #if defined(HADESMEM_GCC)
@@ -81,6 +86,12 @@
        // defined(HADESMEM_INTEL)) || !(defined(HADESMEM_DETAIL_ARCH_X64) ||
        // (defined(HADESMEM_DETAIL_ARCH_X86) && _M_IX86_FP >= 2))
 
+#if !(defined(HADESMEM_DETAIL_ARCH_X64) || defined(__SSE2__) ||                \
+      (defined(HADESMEM_DETAIL_ARCH_X86) && _M_IX86_FP >= 2))
+#define HADESMEM_DETAIL_NO_SSE2
+#endif // #if !(defined(HADESMEM_DETAIL_ARCH_X64) || defined(__SSE2__) ||
+       // (defined(HADESMEM_DETAIL_ARCH_X86) && _M_IX86_FP >= 2))
+
 #if defined(HADESMEM_DETAIL_NO_NOEXCEPT)
 #define HADESMEM_DETAIL_NOEXCEPT throw()
 #define HADESMEM_DETAIL_NOEXCEPT_IF(Pred)
@@ -97,6 +108,12 @@
 #define HADESMEM_DETAIL_CONSTEXPR constexpr
 #endif // #if defined(HADESMEM_DETAIL_NO_CONSTEXPR)
 
+#if defined(HADESMEM_DETAIL_NO_THREAD_LOCAL)
+#define HADESMEM_DETAIL_THREAD_LOCAL __declspec(thread)
+#else // #if defined(HADESMEM_DETAIL_NO_THREAD_LOCAL)
+#define HADESMEM_DETAIL_THREAD_LOCAL thread_local
+#endif // #if defined(HADESMEM_DETAIL_NO_THREAD_LOCAL)
+
 #define HADESMEM_DETAIL_DLLEXPORT __declspec(dllexport)
 
 // Approximate equivalent of MAX_PATH for Unicode APIs.
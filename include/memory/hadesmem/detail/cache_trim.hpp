@@ -0,0 +1,51 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <hadesmem/detail/assert.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+// Trims a cache (a map whose values have a last_used tick, unique per entry)
+// which has grown past max_size, by removing the least recently used
+// entries. It's trimmed down to three quarters of max_size, so that a cache
+// which is full isn't trimmed again on every insert.
+template <typename Map>
+inline void TrimLeastRecentlyUsed(Map& entries, std::size_t max_size)
+{
+  HADESMEM_DETAIL_ASSERT(max_size);
+
+  if (entries.size() <= max_size)
+  {
+    return;
+  }
+
+  std::size_t const keep = max_size - max_size / 4;
+  std::vector<std::uint64_t> ticks;
+  ticks.reserve(entries.size());
+  for (auto const& entry : entries)
+  {
+    ticks.push_back(entry.second.last_used);
+  }
+
+  auto const nth = std::begin(ticks) + (ticks.size() - keep);
+  std::nth_element(std::begin(ticks), nth, std::end(ticks));
+  std::uint64_t const oldest_kept = *nth;
+
+  for (auto iter = std::begin(entries); iter != std::end(entries);)
+  {
+    iter = iter->second.last_used < oldest_kept ? entries.erase(iter)
+                                                : std::next(iter);
+  }
+}
+}
+}
@@ -0,0 +1,142 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+// Largest span covered by a single coalesced read.
+std::size_t const kCoalescedReadMaxSpan = 0x1000;
+
+struct CoalescedRead
+{
+  void* address;
+  std::size_t size;
+  void* data;
+  bool success;
+};
+
+// Same as ReadUnchecked, but reports failure rather than throwing. On
+// failure the last error is left as set by ReadProcessMemory.
+inline bool TryReadUnchecked(Process const& process,
+                             void* address,
+                             void* data,
+                             std::size_t len)
+{
+  HADESMEM_DETAIL_ASSERT(len ? address != nullptr : true);
+  HADESMEM_DETAIL_ASSERT(data != nullptr);
+
+  if (!len)
+  {
+    return true;
+  }
+
+  SIZE_T bytes_read = 0;
+  if (!::ReadProcessMemory(
+        process.GetHandle(), address, data, len, &bytes_read))
+  {
+    return false;
+  }
+
+  if (bytes_read != len)
+  {
+    ::SetLastError(ERROR_PARTIAL_COPY);
+    return false;
+  }
+
+  return true;
+}
+
+// Services many small reads with as few ReadProcessMemory calls as possible.
+// Requests are sorted by address and merged into spans of at most max_span
+// bytes (so requests on the same page cost one call). If a span can't be read
+// in one go (e.g. it crosses into an unreadable page) its requests fall back
+// to being read individually. Protection is never changed, so unreadable
+// memory simply fails the affected requests. Returns the number of reads
+// issued.
+inline std::size_t ReadCoalesced(Process const& process,
+                                 CoalescedRead* requests,
+                                 std::size_t count,
+                                 std::size_t max_span = kCoalescedReadMaxSpan)
+{
+  std::vector<std::size_t> order(count);
+  std::iota(std::begin(order), std::end(order), static_cast<std::size_t>(0));
+  std::sort(std::begin(order),
+            std::end(order),
+            [&](std::size_t lhs, std::size_t rhs)
+            {
+    return requests[lhs].address < requests[rhs].address;
+  });
+
+  std::size_t num_reads = 0;
+  std::vector<std::uint8_t> buf;
+  for (std::size_t i = 0; i < count;)
+  {
+    auto const span_begin =
+      reinterpret_cast<std::uintptr_t>(requests[order[i]].address);
+    std::uintptr_t span_end = span_begin + requests[order[i]].size;
+    std::size_t j = i + 1;
+    for (; j < count; ++j)
+    {
+      auto const& request = requests[order[j]];
+      auto const end =
+        reinterpret_cast<std::uintptr_t>(request.address) + request.size;
+      if ((std::max)(end, span_end) - span_begin > max_span)
+      {
+        break;
+      }
+
+      span_end = (std::max)(end, span_end);
+    }
+
+    buf.resize(span_end - span_begin);
+    bool const span_ok =
+      TryReadUnchecked(process,
+                       reinterpret_cast<void*>(span_begin),
+                       buf.data(),
+                       buf.size());
+    ++num_reads;
+    for (std::size_t k = i; k < j; ++k)
+    {
+      auto& request = requests[order[k]];
+      if (span_ok)
+      {
+        std::memcpy(request.data,
+                    buf.data() +
+                      (reinterpret_cast<std::uintptr_t>(request.address) -
+                       span_begin),
+                    request.size);
+        request.success = true;
+      }
+      else
+      {
+        request.success = TryReadUnchecked(
+          process, request.address, request.data, request.size);
+        ++num_reads;
+      }
+    }
+
+    i = j;
+  }
+
+  return num_reads;
+}
+}
+}
@@ -3,18 +3,32 @@
 
 #pragma once
 
-#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 
 #include <windows.h>
 
-#include <hadesmem/pelib/export_list.hpp>
 #include <hadesmem/detail/alias_cast.hpp>
+#include <hadesmem/detail/module_cache.hpp>
+#include <hadesmem/detail/procedure_cache.hpp>
+#include <hadesmem/detail/scope_warden.hpp>
 #include <hadesmem/detail/static_assert.hpp>
 #include <hadesmem/detail/str_conv.hpp>
+#include <hadesmem/detail/to_upper_ordinal.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/module.hpp>
+#include <hadesmem/module_list.hpp>
 #include <hadesmem/pelib/export.hpp>
+#include <hadesmem/pelib/export_index.hpp>
+#include <hadesmem/pelib/import_dir.hpp>
+#include <hadesmem/pelib/import_dir_list.hpp>
+#include <hadesmem/pelib/import_thunk.hpp>
+#include <hadesmem/pelib/import_thunk_list.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 
@@ -22,69 +36,327 @@ namespace hadesmem
 {
 namespace detail
 {
-inline FARPROC GetProcAddressFromExport(Process const& process,
-                                        Export const& e);
+// An index which couldn't be built isn't cached, so a failed read doesn't
+// hide the module's exports for the rest of the process's life.
+inline std::shared_ptr<ExportIndex const>
+  GetExportIndex(Process const& process, PeFile const& pe_file)
+{
+  auto const build = [&]()
+  {
+    return std::make_shared<ExportIndex const>(process, pe_file);
+  };
+  auto const cacheable = [](ExportIndex const& index)
+  {
+    return index.IsValid();
+  };
+  return ModuleCache<ExportIndex>::Get(process, pe_file, build, cacheable);
+}
 
-template <typename Pred>
-inline FARPROC GetProcAddressInternalFromPred(Process const& process,
-                                              HMODULE module,
-                                              Pred pred)
+// Resolves procedures, following forwarders, through the ProcedureCache.
+// Every step of a forwarder chain is cached, not just the first. Modules are
+// looked up in a single module list snapshot, taken the first time one is
+// needed, rather than a toolhelp walk per forwarder.
+//
+// Not thread-safe (the cache itself is), so use one per thread.
+class ProcedureResolver
 {
-  HADESMEM_DETAIL_STATIC_ASSERT(sizeof(FARPROC) == sizeof(void*));
+public:
+  explicit ProcedureResolver(Process const& process) : process_{&process}
+  {
+  }
 
-  PeFile const pe_file{process, module, PeFileType::Image, 0};
+  explicit ProcedureResolver(Process&& process) = delete;
 
-  ExportList const exports{process, pe_file};
-  auto const iter = std::find_if(std::begin(exports), std::end(exports), pred);
-  if (iter != std::end(exports))
+  FARPROC Resolve(HMODULE module, std::string const& name)
   {
-    return GetProcAddressFromExport(process, *iter);
+    ProcedureCacheKey const key = {
+      process_->GetId(), reinterpret_cast<PBYTE>(module), name, 0};
+    return Resolve(key).address;
   }
 
-  return nullptr;
-}
+  FARPROC Resolve(HMODULE module, WORD ordinal)
+  {
+    ProcedureCacheKey const key = {process_->GetId(),
+                                   reinterpret_cast<PBYTE>(module),
+                                   std::string(),
+                                   ordinal};
+    return Resolve(key).address;
+  }
+
+  // Resolves a forwarder string (e.g. "NTDLL.RtlAllocateHeap" or "NTDLL.#1").
+  FARPROC ResolveForwarder(std::string const& forwarder)
+  {
+    return Resolve(ParseForwarder(forwarder)).address;
+  }
+
+  // Returns nullptr if no module with the given name is loaded. A name
+  // without an extension is assumed to be a DLL, as the loader does for
+  // forwarders.
+  HMODULE FindModule(std::string const& name)
+  {
+    std::wstring name_upper = ToUpperOrdinal(MultiByteToWideChar(name));
+    if (name_upper.find(L'.') == std::wstring::npos)
+    {
+      name_upper += L".DLL";
+    }
+
+    TakeSnapshot();
+    auto const iter = modules_by_name_.find(name_upper);
+    return iter != std::end(modules_by_name_) ? iter->second : nullptr;
+  }
+
+private:
+  void TakeSnapshot()
+  {
+    if (has_snapshot_)
+    {
+      return;
+    }
+
+    ModuleList const modules{*process_};
+    for (auto const& module : modules)
+    {
+      // If a name is loaded more than once the first one wins, as with
+      // Module.
+      modules_by_name_.insert(std::make_pair(
+        ToUpperOrdinal(module.GetName()), module.GetHandle()));
+      module_sizes_.insert(std::make_pair(
+        reinterpret_cast<PBYTE>(module.GetHandle()), module.GetSize()));
+    }
+
+    has_snapshot_ = true;
+  }
+
+  // Returns zero (i.e. let PeFile work it out) for unknown modules.
+  DWORD GetModuleSize(PBYTE base)
+  {
+    TakeSnapshot();
+    auto const iter = module_sizes_.find(base);
+    return iter != std::end(module_sizes_) ? iter->second : 0;
+  }
+
+  ProcedureCacheKey ParseForwarder(std::string const& forwarder)
+  {
+    std::string::size_type const split_pos = forwarder.rfind('.');
+    if (split_pos == std::string::npos)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid forwarder string format."});
+    }
+
+    HMODULE const module = FindModule(forwarder.substr(0, split_pos));
+    if (!module)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Could not find module."});
+    }
+
+    ProcedureCacheKey key = {
+      process_->GetId(), reinterpret_cast<PBYTE>(module), std::string(), 0};
+    std::string const function{forwarder.substr(split_pos + 1)};
+    if (!function.empty() && function[0] == '#')
+    {
+      try
+      {
+        key.ordinal = StrToNum<WORD>(function.substr(1));
+      }
+      catch (std::exception const& /*e*/)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"Invalid forwarder ordinal detected."});
+      }
+    }
+    else
+    {
+      key.name = function;
+    }
+
+    return key;
+  }
+
+  ProcedureCacheEntry Resolve(ProcedureCacheKey const& key)
+  {
+    ProcedureCacheEntry entry;
+    if (ProcedureCache::Find(*process_, key, entry))
+    {
+      return entry;
+    }
+
+    if (!pending_.insert(key).second)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Forwarder cycle detected."});
+    }
+    auto const remove_pending = [&]()
+    {
+      pending_.erase(key);
+    };
+    auto scope_remove_pending = MakeScopeWarden(remove_pending);
+
+    entry = ResolveUncached(key);
+    // Failed lookups aren't cached, as the export may turn up later (e.g. if
+    // a forwarder target is loaded).
+    if (entry.address)
+    {
+      ProcedureCache::Insert(key, entry);
+    }
+
+    return entry;
+  }
+
+  ProcedureCacheEntry ResolveUncached(ProcedureCacheKey const& key)
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(sizeof(FARPROC) == sizeof(void*));
+
+    PeFile const pe_file{
+      *process_, key.module, PeFileType::Image, GetModuleSize(key.module)};
+    NtHeaders const nt_headers{*process_, pe_file};
+    ModuleStamp const stamp = {key.module,
+                               static_cast<PBYTE>(nt_headers.GetBase()),
+                               nt_headers.GetTimeDateStamp(),
+                               nt_headers.GetSizeOfImage()};
+    ProcedureCacheEntry entry;
+    entry.address = nullptr;
+    entry.modules.push_back(stamp);
+
+    auto const index = GetExportIndex(*process_, pe_file);
+    WORD const ordinal_number = key.name.empty()
+                                  ? index->FindOrdinal(key.ordinal)
+                                  : index->FindName(key.name);
+    if (ordinal_number == ExportIndex::kInvalidOrdinal ||
+        ordinal_number >= index->GetNumberOfFunctions())
+    {
+      return entry;
+    }
+
+    // ExportList skips unused slots in the function table (other than the
+    // first), so they're not found here either.
+    DWORD const func_rva = index->GetFunctionRva(ordinal_number);
+    if (!func_rva && ordinal_number)
+    {
+      return entry;
+    }
+
+    if (index->IsForwarded(ordinal_number))
+    {
+      ProcedureCacheEntry const target =
+        Resolve(ParseForwarder(index->GetForwarder(ordinal_number)));
+      entry.address = target.address;
+      entry.modules.insert(std::end(entry.modules),
+                           std::begin(target.modules),
+                           std::end(target.modules));
+      return entry;
+    }
+
+    entry.address = AliasCast<FARPROC>(RvaToVa(*process_, pe_file, func_rva));
+    return entry;
+  }
+
+  Process const* process_;
+  std::set<ProcedureCacheKey> pending_;
+  bool has_snapshot_{false};
+  std::map<std::wstring, HMODULE> modules_by_name_;
+  std::map<PBYTE, DWORD> module_sizes_;
+};
 
 inline FARPROC GetProcAddressInternal(Process const& process,
                                       HMODULE module,
                                       std::string const& name)
 {
-  auto const pred = [&](Export const& e)
-  {
-    return e.ByName() && e.GetName() == name;
-  };
-  return GetProcAddressInternalFromPred(process, module, pred);
+  return ProcedureResolver{process}.Resolve(module, name);
 }
 
 inline FARPROC
   GetProcAddressInternal(Process const& process, HMODULE module, WORD ordinal)
 {
-  auto const pred = [&](Export const& e)
-  {
-    return e.ByOrdinal() && e.GetProcedureNumber() == ordinal;
-  };
-  return GetProcAddressInternalFromPred(process, module, pred);
+  return ProcedureResolver{process}.Resolve(module, ordinal);
 }
 
 inline FARPROC GetProcAddressFromExport(Process const& process, Export const& e)
 {
   if (e.IsForwarded())
   {
-    std::string const forwarder_module_name{e.GetForwarderModule()};
-    Module const forwarder_module{process,
-                                  MultiByteToWideChar(forwarder_module_name)};
-    if (e.IsForwardedByOrdinal())
+    return ProcedureResolver{process}.ResolveForwarder(e.GetForwarder());
+  }
+
+  return AliasCast<FARPROC>(e.GetVa());
+}
+
+// Resolves every import of the module (by its import lookup table) so later
+// lookups of the same procedures are served from the cache. Imports which
+// can't be resolved (e.g. the module isn't loaded) are skipped. Returns the
+// number of imports resolved.
+inline std::size_t WarmProcedureCache(Process const& process, HMODULE module)
+{
+  PeFile const pe_file{process, module, PeFileType::Image, 0};
+  ProcedureResolver resolver{process};
+
+  std::size_t num_resolved = 0;
+  ImportDirList const import_dirs{process, pe_file};
+  for (auto const& import_dir : import_dirs)
+  {
+    // Without an ILT the names are gone once the IAT has been bound.
+    DWORD const ilt = import_dir.GetOriginalFirstThunk();
+    if (!ilt)
     {
-      return GetProcAddressInternal(
-        process, forwarder_module.GetHandle(), e.GetForwarderOrdinal());
+      continue;
     }
-    else
+
+    HMODULE import_module = nullptr;
+    try
+    {
+      import_module = resolver.FindModule(import_dir.GetName());
+    }
+    catch (std::exception const& /*e*/)
     {
-      return GetProcAddressInternal(
-        process, forwarder_module.GetHandle(), e.GetForwarderFunction());
+      continue;
+    }
+
+    if (!import_module)
+    {
+      continue;
+    }
+
+    ImportThunkList const import_thunks{process, pe_file, ilt};
+    for (auto const& import_thunk : import_thunks)
+    {
+      try
+      {
+        FARPROC const address =
+          import_thunk.ByOrdinal()
+            ? resolver.Resolve(import_module, import_thunk.GetOrdinal())
+            : resolver.Resolve(import_module, import_thunk.GetName());
+        if (address)
+        {
+          ++num_resolved;
+        }
+      }
+      catch (std::exception const& /*e*/)
+      {
+        continue;
+      }
     }
   }
 
-  return AliasCast<FARPROC>(e.GetVa());
+  return num_resolved;
+}
+
+// Drops everything cached for (or resolved through) the module. Stale
+// entries are also detected on lookup, so this is only needed to release
+// memory early or if a module is replaced by one with identical headers.
+inline void InvalidateProcedureCache(Process const& process, HMODULE module)
+{
+  ProcedureCache::RemoveModule(process.GetId(),
+                               reinterpret_cast<PBYTE>(module));
+  ModuleCache<ExportIndex>::Remove(process.GetId(), module);
+}
+
+// Drops everything cached for the process, e.g. once it has exited. The
+// caches are limited in size, so this is only needed to release memory early.
+inline void InvalidateProcedureCache(Process const& process)
+{
+  ProcedureCache::RemoveProcess(process.GetId());
+  ModuleCache<ExportIndex>::RemoveProcess(process.GetId());
 }
 }
 }
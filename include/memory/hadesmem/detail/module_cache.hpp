@@ -0,0 +1,160 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/cache_trim.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
+#include <hadesmem/detail/static_instance.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+// Data derived from a loaded module (e.g. an export index), cached per
+// (process, module base). Entries are revalidated against the module's
+// TimeDateStamp and SizeOfImage on every lookup, so a different module
+// loaded at the same base is detected (at the cost of reading the headers),
+// including in a process which has reused the pid of one that has exited.
+//
+// Limited to kMaxEntries modules, with the least recently used evicted past
+// that, as nothing knows when a process exits. RemoveProcess can be used to
+// release everything for a process early.
+template <typename T> class ModuleCache
+{
+public:
+  static std::size_t const kMaxEntries = 0x400;
+
+  template <typename BuildFunc>
+  static std::shared_ptr<T const>
+    Get(Process const& process, PeFile const& pe_file, BuildFunc build)
+  {
+    return Get(process,
+               pe_file,
+               build,
+               [](T const& /*data*/)
+               {
+      return true;
+    });
+  }
+
+  // Data which cacheable returns false for (e.g. because building it failed
+  // in a way which may not happen next time) is returned but not cached.
+  template <typename BuildFunc, typename CacheablePred>
+  static std::shared_ptr<T const> Get(Process const& process,
+                                      PeFile const& pe_file,
+                                      BuildFunc build,
+                                      CacheablePred cacheable)
+  {
+    NtHeaders const nt_headers{process, pe_file};
+    Key const key{process.GetId(), pe_file.GetBase()};
+    DWORD const time_date_stamp = nt_headers.GetTimeDateStamp();
+    DWORD const size_of_image = nt_headers.GetSizeOfImage();
+
+    {
+      // Exclusive as a hit updates the entry's last use.
+      AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+      auto& entries = GetEntries();
+      auto const iter = entries.find(key);
+      if (iter != std::end(entries) &&
+          iter->second.time_date_stamp == time_date_stamp &&
+          iter->second.size_of_image == size_of_image)
+      {
+        iter->second.last_used = ++GetTick();
+        return iter->second.data;
+      }
+    }
+
+    // Built outside the lock. If two threads race the last one in wins, which
+    // is harmless.
+    Entry entry;
+    entry.time_date_stamp = time_date_stamp;
+    entry.size_of_image = size_of_image;
+    entry.data = build();
+    if (!cacheable(*entry.data))
+    {
+      return entry.data;
+    }
+
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    entry.last_used = ++GetTick();
+    auto& entries = GetEntries();
+    entries[key] = entry;
+    TrimLeastRecentlyUsed(entries, kMaxEntries);
+    return entry.data;
+  }
+
+  static void Remove(DWORD pid, void* base)
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    GetEntries().erase(Key{pid, base});
+  }
+
+  // Drops every entry for the process, e.g. once it has exited.
+  static void RemoveProcess(DWORD pid)
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    auto& entries = GetEntries();
+    for (auto iter = std::begin(entries); iter != std::end(entries);)
+    {
+      iter = iter->first.first == pid ? entries.erase(iter) : std::next(iter);
+    }
+  }
+
+  static void Clear()
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    GetEntries().clear();
+  }
+
+  static std::size_t GetSize()
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Shared);
+    return GetEntries().size();
+  }
+
+private:
+  using Key = std::pair<DWORD, void*>;
+
+  struct Entry
+  {
+    DWORD time_date_stamp;
+    DWORD size_of_image;
+    std::shared_ptr<T const> data;
+    std::uint64_t last_used;
+  };
+
+  static std::map<Key, Entry>& GetEntries()
+  {
+    return StaticInstance<std::map<Key, Entry>, ModuleCache>::instance;
+  }
+
+  // Constant initialised (as is the lock), so unlike the entries it's safe
+  // as a function-local static. Only used with the lock held exclusively.
+  static std::uint64_t& GetTick()
+  {
+    static std::uint64_t tick = 0;
+    return tick;
+  }
+
+  static SRWLOCK& GetSrwLock()
+  {
+    static SRWLOCK srw_lock = SRWLOCK_INIT;
+    return srw_lock;
+  }
+};
+}
+}
@@ -0,0 +1,126 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+inline std::size_t GetDefaultThreadCount() HADESMEM_DETAIL_NOEXCEPT
+{
+  std::size_t const num_threads = std::thread::hardware_concurrency();
+  return num_threads ? num_threads : 1;
+}
+
+// Calls func(i) for every i in [0, count) using up to num_threads threads
+// (including the calling thread). Work items are handed out dynamically so
+// uneven item sizes (e.g. memory regions) still balance reasonably. The first
+// exception thrown by any item stops the remaining work and is rethrown on
+// the calling thread once all workers have finished.
+template <typename Func>
+void ParallelFor(std::size_t count,
+                 Func const& func,
+                 std::size_t num_threads = 0)
+{
+  if (!count)
+  {
+    return;
+  }
+
+  if (!num_threads)
+  {
+    num_threads = GetDefaultThreadCount();
+  }
+
+  num_threads = (std::min)(num_threads, count);
+
+  if (num_threads == 1)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      func(i);
+    }
+
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  SRWLOCK error_lock = SRWLOCK_INIT;
+
+  auto const worker = [&]()
+  {
+    while (!failed)
+    {
+      std::size_t const i = next++;
+      if (i >= count)
+      {
+        return;
+      }
+
+      try
+      {
+        func(i);
+      }
+      catch (...)
+      {
+        AcquireSRWLock const lock(&error_lock, SRWLockType::Exclusive);
+        if (!error)
+        {
+          error = std::current_exception();
+        }
+
+        failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+
+  try
+  {
+    for (std::size_t i = 1; i < num_threads; ++i)
+    {
+      threads.emplace_back(worker);
+    }
+  }
+  catch (...)
+  {
+    failed = true;
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    throw;
+  }
+
+  worker();
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+}
+}
+}
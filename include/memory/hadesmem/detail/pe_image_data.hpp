@@ -0,0 +1,340 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+// A run of RVAs [begin, next range's begin) which all map to base + rva +
+// delta (mod 2^32) in a data file, or which are all invalid.
+struct PeRvaRange
+{
+  DWORD begin;
+  DWORD delta;
+  bool valid;
+};
+
+// Headers and section table of a PE file, parsed once. For data files the
+// RVA to file offset mapping is flattened into a sorted list of ranges.
+struct PeImageData
+{
+  IMAGE_DOS_HEADER dos_header;
+  IMAGE_NT_HEADERS nt_headers;
+  PBYTE nt_headers_base;
+  PBYTE section_headers_base;
+  // Only the headers which actually lie within the file (for data files).
+  std::vector<IMAGE_SECTION_HEADER> section_headers;
+  std::vector<PeRvaRange> rva_ranges;
+};
+
+class PeRvaMapBuilder
+{
+public:
+  explicit PeRvaMapBuilder(PeImageData const& data,
+                           PBYTE base,
+                           DWORD size) HADESMEM_DETAIL_NOEXCEPT
+    : data_(data),
+      size_{size},
+      num_sections_{data.nt_headers.FileHeader.NumberOfSections},
+      size_of_headers_{data.nt_headers.OptionalHeader.SizeOfHeaders},
+      size_of_image_{data.nt_headers.OptionalHeader.SizeOfImage},
+      file_alignment_{data.nt_headers.OptionalHeader.FileAlignment},
+      virtual_section_table_{data.section_headers_base >= base + size},
+      min_virtual_beg_{0xFFFFFFFFUL}
+  {
+    for (auto const& section_header : data_.section_headers)
+    {
+      min_virtual_beg_ =
+        (std::min)(min_virtual_beg_, section_header.VirtualAddress);
+    }
+  }
+
+  // Mirrors the rules in RvaToVa, but sweeps over every point where the
+  // outcome can change rather than walking the section table per lookup.
+  // Sections overlap arbitrarily, and the first one (in table order) which
+  // contains an RVA wins, so the set of sections covering the current point
+  // is tracked as the sweep moves along.
+  std::vector<PeRvaRange> Build() const
+  {
+    std::uint64_t const kEnd = 0x100000000ULL;
+
+    std::vector<std::uint64_t> points = {0,
+                                         1,
+                                         size_of_headers_,
+                                         file_alignment_,
+                                         size_of_image_,
+                                         size_of_image_ + 1ULL,
+                                         size_,
+                                         size_ + 1ULL,
+                                         min_virtual_beg_};
+    // (position, section index) of where each section starts and stops
+    // covering RVAs.
+    std::vector<std::pair<std::uint64_t, std::size_t>> adds;
+    std::vector<std::pair<std::uint64_t, std::size_t>> removes;
+    for (std::size_t i = 0; i < data_.section_headers.size(); ++i)
+    {
+      auto const& section_header = data_.section_headers[i];
+      std::uint64_t const virtual_beg = section_header.VirtualAddress;
+      std::uint64_t const virtual_end = GetVirtualEnd(section_header);
+      std::uint64_t const raw_ptr = GetRawPointer(section_header);
+      points.push_back(virtual_beg);
+      points.push_back(virtual_end);
+      points.push_back(virtual_beg + section_header.SizeOfRawData + 1);
+      // Where the file offset reaches the end of the file, and where it wraps
+      // (and then reaches the end of the file again).
+      for (std::uint64_t limit : {static_cast<std::uint64_t>(size_),
+                                  kEnd,
+                                  kEnd + size_})
+      {
+        if (limit >= raw_ptr)
+        {
+          points.push_back(virtual_beg + limit - raw_ptr);
+        }
+      }
+
+      if (virtual_beg < virtual_end)
+      {
+        adds.emplace_back(virtual_beg, i);
+        removes.emplace_back(virtual_end, i);
+      }
+    }
+
+    std::sort(std::begin(points), std::end(points));
+    points.erase(std::unique(std::begin(points), std::end(points)),
+                 std::end(points));
+    points.erase(std::lower_bound(std::begin(points), std::end(points), kEnd),
+                 std::end(points));
+    std::sort(std::begin(adds), std::end(adds));
+    std::sort(std::begin(removes), std::end(removes));
+
+    std::vector<PeRvaRange> ranges;
+    std::set<std::size_t> active;
+    auto add_iter = std::begin(adds);
+    auto remove_iter = std::begin(removes);
+    for (auto const point : points)
+    {
+      for (; add_iter != std::end(adds) && add_iter->first <= point;
+           ++add_iter)
+      {
+        active.insert(add_iter->second);
+      }
+
+      for (; remove_iter != std::end(removes) && remove_iter->first <= point;
+           ++remove_iter)
+      {
+        active.erase(remove_iter->second);
+      }
+
+      PeRvaRange const range =
+        Evaluate(static_cast<DWORD>(point),
+                 active.empty() ? nullptr
+                                : &data_.section_headers[*active.begin()]);
+      if (ranges.empty() || ranges.back().valid != range.valid ||
+          (range.valid && ranges.back().delta != range.delta))
+      {
+        ranges.push_back(range);
+      }
+    }
+
+    return ranges;
+  }
+
+private:
+  static std::uint64_t GetVirtualEnd(IMAGE_SECTION_HEADER const& section_header)
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    DWORD const virtual_size = section_header.Misc.VirtualSize;
+    // If VirtualSize is zero then SizeOfRawData is used. An end which wraps
+    // can never match.
+    return static_cast<DWORD>(
+      section_header.VirtualAddress +
+      (virtual_size ? virtual_size : section_header.SizeOfRawData));
+  }
+
+  static DWORD GetRawPointer(IMAGE_SECTION_HEADER const& section_header)
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    // If PointerToRawData is less than 0x200 it is rounded down to 0.
+    return section_header.PointerToRawData & ~(0x1FFUL);
+  }
+
+  static PeRvaRange MakeRange(DWORD rva, DWORD delta) HADESMEM_DETAIL_NOEXCEPT
+  {
+    PeRvaRange const range = {rva, delta, true};
+    return range;
+  }
+
+  static PeRvaRange MakeInvalid(DWORD rva) HADESMEM_DETAIL_NOEXCEPT
+  {
+    PeRvaRange const range = {rva, 0, false};
+    return range;
+  }
+
+  PeRvaRange EvaluateHeader(DWORD rva) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return (file_alignment_ < 200 || rva < file_alignment_)
+             ? MakeRange(rva, 0)
+             : MakeInvalid(rva);
+  }
+
+  PeRvaRange Evaluate(DWORD rva,
+                      IMAGE_SECTION_HEADER const* section_header) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    if (!rva)
+    {
+      return MakeInvalid(rva);
+    }
+
+    if (!num_sections_)
+    {
+      return rva > size_ ? MakeInvalid(rva) : MakeRange(rva, 0);
+    }
+
+    if (rva < size_of_headers_)
+    {
+      return EvaluateHeader(rva);
+    }
+
+    if (rva > size_of_image_)
+    {
+      return MakeInvalid(rva);
+    }
+
+    if (virtual_section_table_)
+    {
+      return rva > size_ ? MakeInvalid(rva) : MakeRange(rva, 0);
+    }
+
+    if (section_header)
+    {
+      DWORD const offset = rva - section_header->VirtualAddress;
+      if (offset > section_header->SizeOfRawData)
+      {
+        return MakeInvalid(rva);
+      }
+
+      DWORD const raw_ptr = GetRawPointer(*section_header);
+      if (static_cast<DWORD>(offset + raw_ptr) >= size_)
+      {
+        return MakeInvalid(rva);
+      }
+
+      return MakeRange(
+        rva, static_cast<DWORD>(raw_ptr - section_header->VirtualAddress));
+    }
+
+    // Part of the section table lies outside the file.
+    if (data_.section_headers.size() != num_sections_)
+    {
+      return MakeInvalid(rva);
+    }
+
+    if (rva < min_virtual_beg_ && rva < size_)
+    {
+      return EvaluateHeader(rva);
+    }
+
+    if (rva < size_of_image_ && rva < size_)
+    {
+      return MakeRange(rva, 0);
+    }
+
+    return MakeInvalid(rva);
+  }
+
+  PeImageData const& data_;
+  DWORD size_;
+  WORD num_sections_;
+  DWORD size_of_headers_;
+  DWORD size_of_image_;
+  DWORD file_alignment_;
+  bool virtual_section_table_;
+  DWORD min_virtual_beg_;
+};
+
+inline PeImageData ParsePeImageData(Process const& process,
+                                    PBYTE base,
+                                    bool is_data,
+                                    DWORD size)
+{
+  PeImageData data;
+  data.dos_header = Read<IMAGE_DOS_HEADER>(process, base);
+  if (data.dos_header.e_magic != IMAGE_DOS_SIGNATURE)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Invalid DOS header."});
+  }
+
+  data.nt_headers_base = base + data.dos_header.e_lfanew;
+  data.nt_headers = Read<IMAGE_NT_HEADERS>(process, data.nt_headers_base);
+  if (data.nt_headers.Signature != IMAGE_NT_SIGNATURE)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Invalid NT headers."});
+  }
+
+  data.section_headers_base =
+    data.nt_headers_base + offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
+    data.nt_headers.FileHeader.SizeOfOptionalHeader;
+  std::size_t num_sections = data.nt_headers.FileHeader.NumberOfSections;
+  if (is_data)
+  {
+    std::uintptr_t const table_beg =
+      reinterpret_cast<std::uintptr_t>(data.section_headers_base);
+    std::uintptr_t const file_end =
+      reinterpret_cast<std::uintptr_t>(base) + size;
+    std::size_t const num_in_file =
+      table_beg < file_end
+        ? (file_end - table_beg) / sizeof(IMAGE_SECTION_HEADER)
+        : 0;
+    num_sections = (std::min)(num_sections, num_in_file);
+  }
+
+  if (num_sections)
+  {
+    data.section_headers = ReadVector<IMAGE_SECTION_HEADER>(
+      process, data.section_headers_base, num_sections);
+  }
+
+  if (is_data)
+  {
+    data.rva_ranges = PeRvaMapBuilder(data, base, size).Build();
+  }
+
+  return data;
+}
+
+inline PVOID PeImageDataRvaToVa(PeImageData const& data, PBYTE base, DWORD rva)
+{
+  auto const iter = std::upper_bound(std::begin(data.rva_ranges),
+                                     std::end(data.rva_ranges),
+                                     rva,
+                                     [](DWORD lhs, PeRvaRange const& rhs)
+                                     {
+                                       return lhs < rhs.begin;
+                                     });
+  HADESMEM_DETAIL_ASSERT(iter != std::begin(data.rva_ranges));
+  auto const& range = *(iter - 1);
+  return range.valid ? base + static_cast<DWORD>(rva + range.delta) : nullptr;
+}
+}
+}
@@ -0,0 +1,208 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/cache_trim.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
+#include <hadesmem/detail/static_instance.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+// Identifies a module well enough to notice it being unloaded (or replaced
+// by a different module at the same base) with a single read.
+struct ModuleStamp
+{
+  PBYTE base;
+  PBYTE nt_headers;
+  DWORD time_date_stamp;
+  DWORD size_of_image;
+};
+
+inline bool IsModuleStampValid(Process const& process,
+                               ModuleStamp const& stamp)
+{
+  try
+  {
+    auto const nt_headers = Read<IMAGE_NT_HEADERS>(process, stamp.nt_headers);
+    return nt_headers.Signature == IMAGE_NT_SIGNATURE &&
+           nt_headers.FileHeader.TimeDateStamp == stamp.time_date_stamp &&
+           nt_headers.OptionalHeader.SizeOfImage == stamp.size_of_image;
+  }
+  catch (std::exception const& /*e*/)
+  {
+    return false;
+  }
+}
+
+// A procedure lookup, by name or (if the name is empty) by procedure number.
+struct ProcedureCacheKey
+{
+  DWORD pid;
+  PBYTE module;
+  std::string name;
+  WORD ordinal;
+};
+
+inline bool operator<(ProcedureCacheKey const& lhs,
+                      ProcedureCacheKey const& rhs)
+{
+  return std::tie(lhs.pid, lhs.module, lhs.name, lhs.ordinal) <
+         std::tie(rhs.pid, rhs.module, rhs.name, rhs.ordinal);
+}
+
+// The final address of a lookup, along with every module the forwarder
+// chain passed through. The entry is only valid while all of them are still
+// loaded.
+struct ProcedureCacheEntry
+{
+  FARPROC address;
+  std::vector<ModuleStamp> modules;
+};
+
+// Memoises procedure lookups (including forwarder chains) across calls.
+// Entries are revalidated against their module stamps on every hit, and
+// dropped if any module in the chain has gone away. That also covers a pid
+// being reused, as a module only matches its stamp if it's the same module at
+// the same base (and so resolves to the same address).
+//
+// Nothing knows when a process exits, so the cache is limited to
+// kMaxEntries, with the least recently used entries evicted past that.
+// RemoveProcess can be used to release everything for a process early.
+class ProcedureCache
+{
+public:
+  static std::size_t const kMaxEntries = 0x4000;
+
+  static bool Find(Process const& process,
+                   ProcedureCacheKey const& key,
+                   ProcedureCacheEntry& entry)
+  {
+    {
+      // Exclusive as the hit updates the entry's last use.
+      AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+      auto& entries = GetEntries();
+      auto const iter = entries.find(key);
+      if (iter == std::end(entries))
+      {
+        return false;
+      }
+
+      iter->second.last_used = ++GetTick();
+      entry = iter->second.entry;
+    }
+
+    // Validated outside the lock as it reads from the target. A stale module
+    // takes every entry which depends on it along with it.
+    bool valid = true;
+    for (auto const& stamp : entry.modules)
+    {
+      if (!IsModuleStampValid(process, stamp))
+      {
+        RemoveModule(key.pid, stamp.base);
+        valid = false;
+      }
+    }
+
+    return valid;
+  }
+
+  static void Insert(ProcedureCacheKey const& key,
+                     ProcedureCacheEntry const& entry)
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    auto& entries = GetEntries();
+    entries[key] = Slot{entry, ++GetTick()};
+    TrimLeastRecentlyUsed(entries, kMaxEntries);
+  }
+
+  // Drops every entry whose forwarder chain passes through the module.
+  static void RemoveModule(DWORD pid, PBYTE base)
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    auto& entries = GetEntries();
+    for (auto iter = std::begin(entries); iter != std::end(entries);)
+    {
+      auto const& modules = iter->second.entry.modules;
+      bool const depends =
+        iter->first.pid == pid &&
+        std::any_of(std::begin(modules),
+                    std::end(modules),
+                    [&](ModuleStamp const& stamp)
+                    {
+          return stamp.base == base;
+        });
+      iter = depends ? entries.erase(iter) : std::next(iter);
+    }
+  }
+
+  // Drops every entry for the process, e.g. once it has exited.
+  static void RemoveProcess(DWORD pid)
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    auto& entries = GetEntries();
+    for (auto iter = std::begin(entries); iter != std::end(entries);)
+    {
+      iter = iter->first.pid == pid ? entries.erase(iter) : std::next(iter);
+    }
+  }
+
+  static void Clear()
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Exclusive);
+    GetEntries().clear();
+  }
+
+  static std::size_t GetSize()
+  {
+    AcquireSRWLock const lock(&GetSrwLock(), SRWLockType::Shared);
+    return GetEntries().size();
+  }
+
+private:
+  struct Slot
+  {
+    ProcedureCacheEntry entry;
+    std::uint64_t last_used;
+  };
+
+  static std::map<ProcedureCacheKey, Slot>& GetEntries()
+  {
+    return StaticInstance<std::map<ProcedureCacheKey, Slot>,
+                          ProcedureCache>::instance;
+  }
+
+  // Constant initialised (as is the lock), so unlike the entries it's safe
+  // as a function-local static. Only used with the lock held exclusively.
+  static std::uint64_t& GetTick()
+  {
+    static std::uint64_t tick = 0;
+    return tick;
+  }
+
+  static SRWLOCK& GetSrwLock()
+  {
+    static SRWLOCK srw_lock = SRWLOCK_INIT;
+    return srw_lock;
+  }
+};
+}
+}
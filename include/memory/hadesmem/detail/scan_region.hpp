@@ -0,0 +1,130 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/query_region.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/region.hpp>
+#include <hadesmem/region_list.hpp>
+
+namespace hadesmem
+{
+struct MemoryScanFlags
+{
+  enum : std::uint32_t
+  {
+    kNone = 0,
+    kWritableOnly = 1 << 0,
+    kSkipMapped = 1 << 1,
+    kSkipImage = 1 << 2
+  };
+};
+
+namespace detail
+{
+struct ScanRange
+{
+  std::uintptr_t base;
+  std::size_t size;
+};
+
+inline bool IsScannableRegion(Region const& region, std::uint32_t flags)
+{
+  MEMORY_BASIC_INFORMATION mbi{};
+  mbi.State = region.GetState();
+  mbi.Protect = region.GetProtect();
+
+  if (!CanRead(mbi) || IsBadProtect(mbi))
+  {
+    return false;
+  }
+
+  if (!!(flags & MemoryScanFlags::kWritableOnly) && !CanWrite(mbi))
+  {
+    return false;
+  }
+
+  if (!!(flags & MemoryScanFlags::kSkipMapped) &&
+      region.GetType() == MEM_MAPPED)
+  {
+    return false;
+  }
+
+  if (!!(flags & MemoryScanFlags::kSkipImage) && region.GetType() == MEM_IMAGE)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+// Snapshot of the regions a scanner should visit, sorted by address. Adjacent
+// regions are coalesced so values spanning a region boundary can be found.
+inline std::vector<ScanRange> GetScanRegions(Process const& process,
+                                             std::uint32_t flags)
+{
+  std::vector<ScanRange> regions;
+  for (auto const& region : RegionList{process})
+  {
+    if (IsScannableRegion(region, flags))
+    {
+      ScanRange const range = {
+        reinterpret_cast<std::uintptr_t>(region.GetBase()), region.GetSize()};
+      if (!regions.empty() &&
+          regions.back().base + regions.back().size == range.base)
+      {
+        regions.back().size += range.size;
+      }
+      else
+      {
+        regions.push_back(range);
+      }
+    }
+  }
+
+  return regions;
+}
+
+struct ScanChunk
+{
+  std::uintptr_t base;
+  std::size_t size;
+  // Number of bytes that can be read past the end of the chunk without
+  // leaving the owning region.
+  std::size_t available_after;
+};
+
+// Splits the ranges into chunks of at most max_chunk_size bytes so they can be
+// distributed across worker threads. Chunks keep the ordering of the ranges.
+inline std::vector<ScanChunk>
+  SplitScanRegions(std::vector<ScanRange> const& regions,
+                   std::size_t max_chunk_size)
+{
+  std::vector<ScanChunk> chunks;
+  for (auto const& region : regions)
+  {
+    std::uintptr_t const region_end = region.base + region.size;
+    for (std::uintptr_t base = region.base; base < region_end;
+         base += max_chunk_size)
+    {
+      std::size_t const size =
+        (std::min)(max_chunk_size, static_cast<std::size_t>(region_end - base));
+      ScanChunk const chunk = {
+        base, size, static_cast<std::size_t>(region_end - (base + size))};
+      chunks.push_back(chunk);
+    }
+  }
+
+  return chunks;
+}
+}
+}
@@ -212,6 +212,23 @@ struct FindPolicy
 
 using SmartFindHandle = SmartHandleImpl<FindPolicy>;
 
+struct MappedViewPolicy
+{
+  using HandleT = PVOID;
+
+  static HADESMEM_DETAIL_CONSTEXPR HandleT GetInvalid() HADESMEM_DETAIL_NOEXCEPT
+  {
+    return nullptr;
+  }
+
+  static bool Cleanup(HandleT handle)
+  {
+    return ::UnmapViewOfFile(handle) != 0;
+  }
+};
+
+using SmartMappedViewHandle = SmartHandleImpl<MappedViewPolicy>;
+
 struct ComPolicy
 {
   using HandleT = IUnknown*;
@@ -0,0 +1,24 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+namespace hadesmem
+{
+namespace detail
+{
+// A T at namespace scope, so that it's constructed at load time rather than
+// on first use. Function-local statics with constructors aren't initialised
+// thread-safely by MSVC 2013, which makes them unsafe for state which may
+// first be used from several threads at once. Tag keeps different users of
+// the same type apart (normally it's the user itself).
+//
+// Being a static member of a class template, it can be defined in a header.
+template <typename T, typename Tag> struct StaticInstance
+{
+  static T instance;
+};
+
+template <typename T, typename Tag> T StaticInstance<T, Tag>::instance;
+}
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/optional.hpp>
+#include <hadesmem/error.hpp>
+
+namespace hadesmem
+{
+// Either a value or the Error that would have been thrown in its place, for
+// callers where failure is common enough that throwing is too expensive
+// (e.g. parsing a corpus of malformed files). The Error carries the same
+// diagnostic info as the throwing API, and is only thrown if Get is called
+// without checking for a value first.
+//
+// Implicitly constructible from both T and Error so that functions can
+// simply return either.
+template <typename T> class Expected
+{
+public:
+  Expected(T const& value) : value_{value}
+  {
+  }
+
+  Expected(T&& value) : value_{std::move(value)}
+  {
+  }
+
+  Expected(Error const& error) : error_{error}
+  {
+  }
+
+  explicit operator bool() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return HasValue();
+  }
+
+  bool HasValue() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return !!value_;
+  }
+
+  T& Get()
+  {
+    EnsureValue();
+    return *value_;
+  }
+
+  T const& Get() const
+  {
+    EnsureValue();
+    return *value_;
+  }
+
+  T& operator*() HADESMEM_DETAIL_NOEXCEPT
+  {
+    HADESMEM_DETAIL_ASSERT(HasValue());
+    return *value_;
+  }
+
+  T const& operator*() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    HADESMEM_DETAIL_ASSERT(HasValue());
+    return *value_;
+  }
+
+  T* operator->() HADESMEM_DETAIL_NOEXCEPT
+  {
+    HADESMEM_DETAIL_ASSERT(HasValue());
+    return value_.GetPtr();
+  }
+
+  T const* operator->() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    HADESMEM_DETAIL_ASSERT(HasValue());
+    return value_.GetPtr();
+  }
+
+  Error const& GetError() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    HADESMEM_DETAIL_ASSERT(!HasValue());
+    return *error_;
+  }
+
+  // The ErrorString attached to the error, or an empty string if there is
+  // none (or there is no error).
+  std::string GetErrorString() const
+  {
+    if (error_)
+    {
+      if (auto const error_string = boost::get_error_info<ErrorString>(*error_))
+      {
+        return *error_string;
+      }
+    }
+
+    return {};
+  }
+
+  // Throws the stored error if there is no value.
+  void EnsureValue() const
+  {
+    if (!value_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(*error_);
+    }
+  }
+
+private:
+  detail::Optional<T> value_;
+  detail::Optional<Error> error_;
+};
+}
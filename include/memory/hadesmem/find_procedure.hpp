@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 #include <windows.h>
@@ -41,4 +42,26 @@ inline FARPROC
 
   return remote_func;
 }
+
+// Resolves all of the module's imports ahead of time, so that later
+// FindProcedure calls for them (and anything they're forwarded through) are
+// cache hits. Returns the number of imports resolved.
+inline std::size_t WarmProcedureCache(Process const& process,
+                                      Module const& module)
+{
+  return detail::WarmProcedureCache(process, module.GetHandle());
+}
+
+// Drops any cached lookups involving the module, e.g. before unloading it.
+inline void InvalidateProcedureCache(Process const& process,
+                                     Module const& module)
+{
+  detail::InvalidateProcedureCache(process, module.GetHandle());
+}
+
+// Drops every cached lookup for the process, e.g. once it has exited.
+inline void InvalidateProcedureCache(Process const& process)
+{
+  detail::InvalidateProcedureCache(process);
+}
 }
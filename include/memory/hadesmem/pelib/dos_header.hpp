@@ -16,6 +16,7 @@
 
 #include <hadesmem/config.hpp>
 #include <hadesmem/error.hpp>
+#include <hadesmem/expected.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
@@ -29,7 +30,14 @@ public:
   explicit DosHeader(Process const& process, PeFile const& pe_file)
     : process_{&process}, base_{static_cast<std::uint8_t*>(pe_file.GetBase())}
   {
-    UpdateRead();
+    if (auto const image_data = pe_file.GetImageData())
+    {
+      data_ = image_data->dos_header;
+    }
+    else
+    {
+      UpdateRead();
+    }
 
     EnsureValid();
   }
@@ -269,11 +277,53 @@ public:
   }
 
 private:
+  friend Expected<DosHeader> TryDosHeader(Process const& process,
+                                          PeFile const& pe_file);
+
+  // Doesn't read or validate.
+  explicit DosHeader(Process const& process,
+                     PBYTE base,
+                     IMAGE_DOS_HEADER const& data)
+    : process_{&process}, base_{base}, data_(data)
+  {
+  }
+
   Process const* process_;
   PBYTE base_;
   IMAGE_DOS_HEADER data_ = IMAGE_DOS_HEADER{};
 };
 
+// Same as constructing a DosHeader, but reports an invalid header (or one
+// that can't be read) through the result rather than throwing.
+inline Expected<DosHeader> TryDosHeader(Process const& process,
+                                        PeFile const& pe_file)
+{
+  auto const base = static_cast<PBYTE>(pe_file.GetBase());
+  IMAGE_DOS_HEADER data;
+  if (auto const image_data = pe_file.GetImageData())
+  {
+    data = image_data->dos_header;
+  }
+  else
+  {
+    auto const read =
+      detail::TryReadPe<IMAGE_DOS_HEADER>(process, pe_file, base);
+    if (!read)
+    {
+      return read.GetError();
+    }
+    data = *read;
+  }
+
+  DosHeader const dos_header{process, base, data};
+  if (!dos_header.IsValid())
+  {
+    return Error{} << ErrorString{"DOS header magic invalid."};
+  }
+
+  return dos_header;
+}
+
 inline bool operator==(DosHeader const& lhs,
                        DosHeader const& rhs) HADESMEM_DETAIL_NOEXCEPT
 {
@@ -19,6 +19,7 @@
 #include <hadesmem/detail/str_conv.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/pelib/export_dir.hpp>
+#include <hadesmem/pelib/export_index.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
@@ -98,18 +99,7 @@ public:
       forwarded_ = true;
       forwarder_ = detail::CheckedReadString<char>(
         process, pe_file, RvaToVa(process, pe_file, func_rva));
-
-      std::string::size_type const split_pos = forwarder_.rfind('.');
-      if (split_pos != std::string::npos)
-      {
-        forwarder_split_ = std::make_pair(forwarder_.substr(0, split_pos),
-                                          forwarder_.substr(split_pos + 1));
-      }
-      else
-      {
-        HADESMEM_DETAIL_THROW_EXCEPTION(
-          Error{} << ErrorString{"Invalid forwarder string format."});
-      }
+      SplitForwarder();
     }
     else
     {
@@ -118,6 +108,43 @@ public:
     }
   }
 
+  // Uses the tables in an ExportIndex rather than reading them again. Note
+  // that this takes an ordinal number, not a procedure number.
+  explicit Export(Process const& process,
+                  PeFile const& pe_file,
+                  ExportIndex const& index,
+                  WORD ordinal_number)
+    : process_{&process},
+      pe_file_{&pe_file},
+      procedure_number_{
+        static_cast<WORD>(ordinal_number + index.GetOrdinalBase())},
+      ordinal_number_{ordinal_number}
+  {
+    if (ordinal_number_ >= index.GetNumberOfFunctions())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Ordinal out of range."});
+    }
+
+    if (std::string const* const name = index.GetName(ordinal_number_))
+    {
+      by_name_ = true;
+      name_ = *name;
+    }
+
+    if (index.IsForwarded(ordinal_number_))
+    {
+      forwarded_ = true;
+      forwarder_ = index.GetForwarder(ordinal_number_);
+      SplitForwarder();
+    }
+    else
+    {
+      rva_ = index.GetFunctionRva(ordinal_number_);
+      va_ = RvaToVa(process, pe_file, rva_);
+    }
+  }
+
   explicit Export(Process&& process,
                   PeFile const& pe_file,
                   WORD procedure_number) = delete;
@@ -130,6 +157,21 @@ public:
                   PeFile&& pe_file,
                   WORD procedure_number) = delete;
 
+  explicit Export(Process&& process,
+                  PeFile const& pe_file,
+                  ExportIndex const& index,
+                  WORD ordinal_number) = delete;
+
+  explicit Export(Process const& process,
+                  PeFile&& pe_file,
+                  ExportIndex const& index,
+                  WORD ordinal_number) = delete;
+
+  explicit Export(Process&& process,
+                  PeFile&& pe_file,
+                  ExportIndex const& index,
+                  WORD ordinal_number) = delete;
+
 #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
 
   Export(Export const&) = default;
@@ -251,6 +293,21 @@ public:
   }
 
 private:
+  void SplitForwarder()
+  {
+    std::string::size_type const split_pos = forwarder_.rfind('.');
+    if (split_pos != std::string::npos)
+    {
+      forwarder_split_ = std::make_pair(forwarder_.substr(0, split_pos),
+                                        forwarder_.substr(split_pos + 1));
+    }
+    else
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid forwarder string format."});
+    }
+  }
+
   Process const* process_;
   PeFile const* pe_file_;
   DWORD rva_{};
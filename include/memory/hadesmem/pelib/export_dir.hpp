@@ -16,6 +16,7 @@
 
 #include <hadesmem/config.hpp>
 #include <hadesmem/error.hpp>
+#include <hadesmem/expected.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
@@ -99,21 +100,29 @@ public:
   }
 
   std::string GetName() const
+  {
+    return TryGetName().Get();
+  }
+
+  Expected<std::string> TryGetName() const
   {
     DWORD const name_rva = GetNameRaw();
     if (!name_rva)
     {
-      return {};
+      return std::string{};
     }
 
-    auto const name_va = RvaToVa(*process_, *pe_file_, name_rva);
+    auto const name_va = TryRvaToVa(*process_, *pe_file_, name_rva);
     if (!name_va)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Name VA is invalid."});
+      return name_va.GetError();
+    }
+    if (!*name_va)
+    {
+      return Error{} << ErrorString{"Name VA is invalid."};
     }
 
-    return detail::CheckedReadString<char>(*process_, *pe_file_, name_va);
+    return detail::TryCheckedReadString<char>(*process_, *pe_file_, *name_va);
   }
 
   DWORD GetOrdinalBase() const
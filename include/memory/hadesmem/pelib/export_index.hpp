@@ -0,0 +1,346 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/export_dir.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// Snapshot of a module's export table for fast lookups. The function, name
+// and name ordinal arrays are each read in one go, as is the export
+// directory region (which is where the name and forwarder strings normally
+// live), so building the index costs a handful of reads rather than several
+// per export.
+//
+// Names are looked up by binary search over the name table, which the PE
+// format requires to be sorted (a sorted copy is made if it isn't), and
+// ordinals map directly into the function array.
+//
+// The array lengths are clamped to what fits in the file (or image), as
+// malformed files commonly claim far more entries than they contain. A
+// module with no export directory produces an empty index. If the index
+// can't be built (an invalid export directory, a forwarder string which
+// can't be read, or a failed read) it's empty too, but isn't valid, so that
+// callers can tell a failure which may be transient from a module with
+// nothing to export.
+class ExportIndex
+{
+public:
+  static WORD const kInvalidOrdinal = 0xFFFF;
+
+  explicit ExportIndex(Process const& process, PeFile const& pe_file)
+  {
+    try
+    {
+      Build(process, pe_file);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      *this = ExportIndex{};
+      valid_ = false;
+    }
+  }
+
+  explicit ExportIndex(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit ExportIndex(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit ExportIndex(Process&& process, PeFile&& pe_file) = delete;
+
+  bool IsValid() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return valid_;
+  }
+
+  DWORD GetOrdinalBase() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return ordinal_base_;
+  }
+
+  std::size_t GetNumberOfFunctions() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return functions_.size();
+  }
+
+  std::size_t GetNumberOfNames() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return names_.size();
+  }
+
+  DWORD GetFunctionRva(WORD ordinal_number) const
+  {
+    HADESMEM_DETAIL_ASSERT(ordinal_number < functions_.size());
+    return functions_[ordinal_number];
+  }
+
+  bool IsForwarded(WORD ordinal_number) const
+  {
+    return !GetForwarder(ordinal_number).empty();
+  }
+
+  std::string const& GetForwarder(WORD ordinal_number) const
+  {
+    HADESMEM_DETAIL_ASSERT(ordinal_number < forwarders_.size());
+    return forwarders_[ordinal_number];
+  }
+
+  // Returns nullptr if the export has no name. If several names map to the
+  // same ordinal the first one in the name table is returned.
+  std::string const* GetName(WORD ordinal_number) const
+  {
+    HADESMEM_DETAIL_ASSERT(ordinal_number < ordinal_names_.size());
+    std::uint32_t const name_index = ordinal_names_[ordinal_number];
+    return name_index == kNoName ? nullptr : &names_[name_index];
+  }
+
+  // Returns the ordinal number (i.e. without the ordinal base applied) of
+  // the named export, or kInvalidOrdinal.
+  WORD FindName(std::string const& name) const
+  {
+    auto const iter = std::lower_bound(std::begin(sorted_names_),
+                                       std::end(sorted_names_),
+                                       name,
+                                       [&](std::uint32_t lhs,
+                                           std::string const& rhs)
+                                       {
+                                         return names_[lhs] < rhs;
+                                       });
+    if (iter == std::end(sorted_names_) || names_[*iter] != name)
+    {
+      return kInvalidOrdinal;
+    }
+
+    return name_ordinals_[*iter];
+  }
+
+  // Returns the ordinal number of the export with the given procedure
+  // number (ordinal base applied), or kInvalidOrdinal.
+  WORD FindOrdinal(WORD procedure_number) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    if (procedure_number < ordinal_base_ ||
+        procedure_number - ordinal_base_ >= functions_.size())
+    {
+      return kInvalidOrdinal;
+    }
+
+    return static_cast<WORD>(procedure_number - ordinal_base_);
+  }
+
+private:
+  static std::uint32_t const kNoName = 0xFFFFFFFFUL;
+
+  ExportIndex() HADESMEM_DETAIL_NOEXCEPT
+  {
+  }
+
+  static std::size_t ClampCount(PeFile const& pe_file,
+                                void const* ptr,
+                                std::size_t count,
+                                std::size_t element_size)
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    auto const beg = static_cast<std::uint8_t const*>(ptr);
+    auto const end =
+      static_cast<std::uint8_t const*>(pe_file.GetBase()) + pe_file.GetSize();
+    return beg < end ? (std::min)(count,
+                                  static_cast<std::size_t>(end - beg) /
+                                    element_size)
+                     : 0;
+  }
+
+  // Reads a string from the bulk copy of the export directory region if it
+  // lies (and is terminated) inside it, otherwise from the target.
+  std::string ReadString(Process const& process,
+                         PeFile const& pe_file,
+                         std::vector<char> const& region,
+                         PBYTE region_va,
+                         DWORD rva) const
+  {
+    auto const va = static_cast<PBYTE>(RvaToVa(process, pe_file, rva));
+    if (!va)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid string RVA."});
+    }
+
+    if (region_va && va >= region_va && va < region_va + region.size())
+    {
+      char const* const beg = region.data() + (va - region_va);
+      char const* const end = region.data() + region.size();
+      char const* const term = std::find(beg, end, '\0');
+      if (term != end)
+      {
+        return std::string(beg, term);
+      }
+    }
+
+    return detail::CheckedReadString<char>(process, pe_file, va);
+  }
+
+  void Build(Process const& process, PeFile const& pe_file)
+  {
+    NtHeaders const nt_headers{process, pe_file};
+    if (static_cast<DWORD>(PeDataDir::Export) >=
+          nt_headers.GetNumberOfRvaAndSizesClamped() ||
+        !nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Export))
+    {
+      return;
+    }
+
+    ExportDir const export_dir{process, pe_file};
+
+    ordinal_base_ = export_dir.GetOrdinalBase();
+
+    // Names and forwarders can only refer to functions, so a directory with
+    // none is valid but has nothing to find.
+    if (!export_dir.GetNumberOfFunctions())
+    {
+      return;
+    }
+
+    auto const ptr_functions =
+      RvaToVa(process, pe_file, export_dir.GetAddressOfFunctions());
+    // Ordinal numbers are WORDs, so anything past that is unreachable.
+    std::size_t const num_funcs = ClampCount(
+      pe_file,
+      ptr_functions,
+      (std::min)(static_cast<std::size_t>(export_dir.GetNumberOfFunctions()),
+                 static_cast<std::size_t>(kInvalidOrdinal)),
+      sizeof(DWORD));
+    if (!ptr_functions || !num_funcs)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"AddressOfFunctions invalid."});
+    }
+
+    functions_ = ReadVector<DWORD>(process, ptr_functions, num_funcs);
+
+    DWORD const export_dir_start =
+      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Export);
+    DWORD const export_dir_size =
+      nt_headers.GetDataDirectorySize(PeDataDir::Export);
+    DWORD const export_dir_end = export_dir_start + export_dir_size;
+
+    std::vector<char> region;
+    PBYTE region_va = nullptr;
+    if (export_dir_size)
+    {
+      region_va =
+        static_cast<PBYTE>(RvaToVa(process, pe_file, export_dir_start));
+      auto const region_va_last = static_cast<PBYTE>(
+        RvaToVa(process, pe_file, export_dir_end - 1));
+      // Only use the bulk copy if the region is contiguous (it may not be in
+      // a data file).
+      if (region_va && region_va_last == region_va + export_dir_size - 1)
+      {
+        try
+        {
+          region = ReadVector<char>(process, region_va, export_dir_size);
+        }
+        catch (std::exception const& /*e*/)
+        {
+          region_va = nullptr;
+        }
+      }
+      else
+      {
+        region_va = nullptr;
+      }
+    }
+
+    forwarders_.resize(functions_.size());
+    for (std::size_t i = 0; i < functions_.size(); ++i)
+    {
+      DWORD const func_rva = functions_[i];
+      // Same check as Export. If the RVA lies inside the export dir region
+      // then it's a forwarded export.
+      if (func_rva > export_dir_start && func_rva < export_dir_end)
+      {
+        forwarders_[i] =
+          ReadString(process, pe_file, region, region_va, func_rva);
+        if (forwarders_[i].empty())
+        {
+          HADESMEM_DETAIL_THROW_EXCEPTION(
+            Error{} << ErrorString{"Invalid forwarder string."});
+        }
+      }
+    }
+
+    ordinal_names_.assign(functions_.size(),
+                          static_cast<std::uint32_t>(kNoName));
+    auto const ptr_ordinals =
+      RvaToVa(process, pe_file, export_dir.GetAddressOfNameOrdinals());
+    auto const ptr_names =
+      RvaToVa(process, pe_file, export_dir.GetAddressOfNames());
+    std::size_t const num_names = (std::min)(
+      ClampCount(
+        pe_file, ptr_ordinals, export_dir.GetNumberOfNames(), sizeof(WORD)),
+      ClampCount(
+        pe_file, ptr_names, export_dir.GetNumberOfNames(), sizeof(DWORD)));
+    if (!num_names || !ptr_ordinals || !ptr_names)
+    {
+      return;
+    }
+
+    name_ordinals_ = ReadVector<WORD>(process, ptr_ordinals, num_names);
+    std::vector<DWORD> const name_rvas =
+      ReadVector<DWORD>(process, ptr_names, num_names);
+    names_.reserve(num_names);
+    for (std::size_t i = 0; i < num_names; ++i)
+    {
+      names_.emplace_back(
+        ReadString(process, pe_file, region, region_va, name_rvas[i]));
+
+      WORD const ordinal_number = name_ordinals_[i];
+      if (ordinal_number < ordinal_names_.size() &&
+          ordinal_names_[ordinal_number] == kNoName)
+      {
+        ordinal_names_[ordinal_number] = static_cast<std::uint32_t>(i);
+      }
+    }
+
+    sorted_names_.resize(names_.size());
+    std::iota(std::begin(sorted_names_),
+              std::end(sorted_names_),
+              static_cast<std::uint32_t>(0));
+    auto const name_less = [&](std::uint32_t lhs, std::uint32_t rhs)
+    {
+      return names_[lhs] < names_[rhs];
+    };
+    if (!std::is_sorted(
+          std::begin(sorted_names_), std::end(sorted_names_), name_less))
+    {
+      std::stable_sort(
+        std::begin(sorted_names_), std::end(sorted_names_), name_less);
+    }
+  }
+
+  bool valid_{true};
+  DWORD ordinal_base_{};
+  std::vector<DWORD> functions_;
+  std::vector<std::string> forwarders_;
+  std::vector<std::string> names_;
+  std::vector<WORD> name_ordinals_;
+  std::vector<std::uint32_t> sorted_names_;
+  std::vector<std::uint32_t> ordinal_names_;
+};
+}
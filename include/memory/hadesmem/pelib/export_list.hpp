@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 #include <memory>
 #include <utility>
@@ -15,6 +16,7 @@
 #include <hadesmem/error.hpp>
 #include <hadesmem/pelib/export.hpp>
 #include <hadesmem/pelib/export_dir.hpp>
+#include <hadesmem/pelib/export_index.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
@@ -23,6 +25,11 @@ namespace hadesmem
 {
 // ExportIterator satisfies the requirements of an input iterator
 // (C++ Standard, 24.2.1, Input Iterators [input.iterators]).
+//
+// The export tables are read in bulk (see ExportIndex) when the iterator is
+// created, and each Export is built from that. If the tables can't be read
+// in one go (e.g. a malformed file which claims more exports than it has) we
+// fall back to reading one export at a time.
 template <typename ExportT>
 class ExportIterator : public std::iterator<std::input_iterator_tag, ExportT>
 {
@@ -42,6 +49,15 @@ public:
   {
     try
     {
+      auto const index = std::make_shared<ExportIndex const>(process, pe_file);
+      if (index->GetNumberOfFunctions())
+      {
+        Export const exp{process, pe_file, *index, 0};
+        impl_ = std::make_shared<Impl>(process, pe_file, exp);
+        impl_->index_ = index;
+        return;
+      }
+
       ExportDir const export_dir{process, pe_file};
       Export const exp{
         process, pe_file, static_cast<WORD>(export_dir.GetOrdinalBase())};
@@ -97,6 +113,11 @@ public:
     {
       HADESMEM_DETAIL_ASSERT(impl_.get());
 
+      if (impl_->index_)
+      {
+        return IncrementFromIndex();
+      }
+
       ExportDir const export_dir{*impl_->process_, *impl_->pe_file_};
 
       DWORD* ptr_functions =
@@ -164,6 +185,32 @@ public:
   }
 
 private:
+  ExportIterator& IncrementFromIndex()
+  {
+    ExportIndex const& index = *impl_->index_;
+    std::size_t const num_funcs = index.GetNumberOfFunctions();
+
+    // Unused slots are skipped, as in the slow path.
+    std::size_t ordinal_number = impl_->export_->GetOrdinalNumber() + 1U;
+    while (ordinal_number < num_funcs &&
+           !index.GetFunctionRva(static_cast<WORD>(ordinal_number)))
+    {
+      ++ordinal_number;
+    }
+
+    if (ordinal_number >= num_funcs)
+    {
+      impl_.reset();
+      return *this;
+    }
+
+    impl_->export_ = Export{*impl_->process_,
+                            *impl_->pe_file_,
+                            index,
+                            static_cast<WORD>(ordinal_number)};
+    return *this;
+  }
+
   struct Impl
   {
     explicit Impl(Process const& process,
@@ -178,6 +225,7 @@ private:
     Process const* process_;
     PeFile const* pe_file_;
     hadesmem::detail::Optional<Export> export_;
+    std::shared_ptr<ExportIndex const> index_;
   };
 
   // Shallow copy semantics, as required by InputIterator.
@@ -0,0 +1,482 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/detail/module_cache.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// Same layout as the x64 RUNTIME_FUNCTION, which winnt.h only defines as
+// such when targeting x64.
+struct FunctionEntry
+{
+  DWORD begin_address;
+  DWORD end_address;
+  DWORD unwind_data;
+};
+
+namespace detail
+{
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(FunctionEntry) == 12);
+
+// UNW_FLAG_CHAININFO, in the upper five bits of the first byte of the
+// UNWIND_INFO header.
+BYTE const kUnwindFlagChainInfo = 0x4;
+
+// Set in the unwind data of an entry which refers to another entry in the
+// table, rather than to unwind info.
+DWORD const kRuntimeFunctionIndirect = 0x1;
+
+DWORD const kUnwindInfoHeaderSize = 4;
+
+// Header, the most unwind codes there can be, and a chained entry.
+DWORD const kMaxUnwindInfoSize =
+  kUnwindInfoHeaderSize + 256 * sizeof(WORD) + sizeof(FunctionEntry);
+
+// Unwind info is normally packed together in .rdata, so it's read in one go
+// unless it's spread over more than this.
+DWORD const kMaxUnwindRegionSize = 0x1000000;
+
+// Real chains are one or two entries long, so anything longer is broken (or
+// a loop).
+std::size_t const kMaxUnwindChainDepth = 32;
+
+// Offset of the chained entry from the start of the unwind info. The array
+// of unwind codes is always padded to an even number of slots.
+inline DWORD GetChainedEntryOffset(BYTE count_of_codes)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  return kUnwindInfoHeaderSize +
+         ((static_cast<DWORD>(count_of_codes) + 1) & ~1UL) * sizeof(WORD);
+}
+}
+
+// Snapshot of the x64 function table (i.e. the exception directory, or
+// .pdata) for "which function contains this address?" lookups. The table is
+// read in one go and looked up by binary search over the begin addresses, as
+// the loader does.
+//
+// The table is supposed to be sorted with no overlapping entries. Empty or
+// inverted entries are dropped, and if what's left is out of order a sorted
+// copy is used instead (IsSorted reports which).
+//
+// Large functions may be split into several entries, the later ones having
+// chained unwind info (or, in older images, an indirect entry) which refers
+// back to the entry with the prologue. These are resolved up front, so the
+// primary entry for any address is also a single lookup.
+//
+// Images for other architectures produce an empty table, as x86 has no
+// function table and ARM uses a different entry layout. So does a missing
+// or unreadable exception directory. RVAs are used throughout, so the same
+// table serves both a file and its image.
+class FunctionTable
+{
+public:
+  static std::size_t const kNotFound = static_cast<std::size_t>(-1);
+
+  explicit FunctionTable(Process const& process, PeFile const& pe_file)
+  {
+    try
+    {
+      Build(process, pe_file);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      *this = FunctionTable{};
+    }
+  }
+
+  explicit FunctionTable(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit FunctionTable(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit FunctionTable(Process&& process, PeFile&& pe_file) = delete;
+
+  // Sorted by begin address.
+  std::vector<FunctionEntry> const& GetEntries() const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return entries_;
+  }
+
+  std::size_t GetNumberOfEntries() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return entries_.size();
+  }
+
+  FunctionEntry const& GetEntry(std::size_t index) const
+  {
+    HADESMEM_DETAIL_ASSERT(index < entries_.size());
+    return entries_[index];
+  }
+
+  // Whether the table was in order (and had no overlapping entries) as
+  // stored in the file.
+  bool IsSorted() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return sorted_;
+  }
+
+  std::size_t GetNumberOfInvalid() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return num_invalid_;
+  }
+
+  // Index of the entry containing the RVA, or kNotFound.
+  std::size_t Find(DWORD rva) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    auto const iter = std::upper_bound(std::begin(entries_),
+                                       std::end(entries_),
+                                       rva,
+                                       [](DWORD lhs, FunctionEntry const& rhs)
+                                       {
+                                         return lhs < rhs.begin_address;
+                                       });
+    if (iter == std::begin(entries_) || rva >= std::prev(iter)->end_address)
+    {
+      return kNotFound;
+    }
+
+    return static_cast<std::size_t>(std::prev(iter) - std::begin(entries_));
+  }
+
+  // Index of the entry with the prologue for the function that the entry is
+  // part of. The entry itself if it isn't chained (or the chain is broken).
+  std::size_t GetPrimary(std::size_t index) const
+  {
+    HADESMEM_DETAIL_ASSERT(index < primary_.size());
+    return primary_[index];
+  }
+
+  bool IsChained(std::size_t index) const
+  {
+    return GetPrimary(index) != index;
+  }
+
+  // Returns nullptr if the RVA isn't in any function.
+  FunctionEntry const* Lookup(DWORD rva) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    std::size_t const index = Find(rva);
+    return index == kNotFound ? nullptr : &entries_[index];
+  }
+
+  // As Lookup, but follows chained entries back to the primary entry.
+  FunctionEntry const* LookupPrimary(DWORD rva) const
+  {
+    std::size_t const index = Find(rva);
+    return index == kNotFound ? nullptr : &entries_[GetPrimary(index)];
+  }
+
+private:
+  FunctionTable() HADESMEM_DETAIL_NOEXCEPT
+  {
+  }
+
+  static std::size_t ClampCount(PeFile const& pe_file,
+                                void const* ptr,
+                                std::size_t count,
+                                std::size_t element_size)
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    auto const beg = static_cast<std::uint8_t const*>(ptr);
+    auto const end =
+      static_cast<std::uint8_t const*>(pe_file.GetBase()) + pe_file.GetSize();
+    return beg < end ? (std::min)(count,
+                                  static_cast<std::size_t>(end - beg) /
+                                    element_size)
+                     : 0;
+  }
+
+  // Begin address of the entry that each entry's unwind info chains to, or
+  // zero for none. Indirect entries are looked up in the (unsorted) copy of
+  // the table, everything else is read from the unwind info.
+  static std::vector<DWORD> GetChainTargets(Process const& process,
+                                            PeFile const& pe_file,
+                                            std::vector<FunctionEntry> const&
+                                              entries,
+                                            std::vector<FunctionEntry> const&
+                                              table,
+                                            DWORD table_rva)
+  {
+    std::vector<DWORD> targets(entries.size());
+    std::vector<std::size_t> unwind;
+    DWORD region_begin = 0xFFFFFFFFUL;
+    DWORD region_end = 0;
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+      DWORD const unwind_data = entries[i].unwind_data;
+      if (unwind_data & detail::kRuntimeFunctionIndirect)
+      {
+        DWORD const offset =
+          (unwind_data & ~detail::kRuntimeFunctionIndirect) - table_rva;
+        if (offset % sizeof(FunctionEntry) == 0 &&
+            offset / sizeof(FunctionEntry) < table.size())
+        {
+          targets[i] = table[offset / sizeof(FunctionEntry)].begin_address;
+        }
+      }
+      else if (unwind_data)
+      {
+        unwind.push_back(i);
+        region_begin = (std::min)(region_begin, unwind_data);
+        region_end = (std::max)(region_end, unwind_data);
+      }
+    }
+
+    if (unwind.empty())
+    {
+      return targets;
+    }
+
+    // Unwind info is commonly all in one place, so try to read all of it at
+    // once (as long as it's contiguous, which it may not be in a data file).
+    std::vector<BYTE> region;
+    region_end = (std::min)(region_end,
+                            static_cast<DWORD>(0xFFFFFFFFUL -
+                                               detail::kMaxUnwindInfoSize)) +
+                 detail::kMaxUnwindInfoSize;
+    if (region_end - region_begin <= detail::kMaxUnwindRegionSize)
+    {
+      auto const region_va =
+        static_cast<PBYTE>(RvaToVa(process, pe_file, region_begin));
+      std::size_t const region_size =
+        ClampCount(pe_file, region_va, region_end - region_begin, 1);
+      auto const region_va_last =
+        region_size ? static_cast<PBYTE>(RvaToVa(
+                        process,
+                        pe_file,
+                        region_begin + static_cast<DWORD>(region_size) - 1))
+                    : nullptr;
+      if (region_va && region_va_last == region_va + region_size - 1)
+      {
+        region.resize(region_size);
+        if (!detail::TryReadUnchecked(
+              process, region_va, region.data(), region.size()))
+        {
+          region.clear();
+        }
+      }
+    }
+
+    if (!region.empty())
+    {
+      for (auto const i : unwind)
+      {
+        DWORD const offset = entries[i].unwind_data - region_begin;
+        if (offset + detail::kUnwindInfoHeaderSize > region.size() ||
+            !((region[offset] >> 3) & detail::kUnwindFlagChainInfo))
+        {
+          continue;
+        }
+
+        DWORD const chained_offset =
+          offset + detail::GetChainedEntryOffset(region[offset + 2]);
+        if (chained_offset + sizeof(FunctionEntry) <= region.size())
+        {
+          FunctionEntry chained;
+          std::memcpy(&chained, &region[chained_offset], sizeof(chained));
+          targets[i] = chained.begin_address;
+        }
+      }
+
+      return targets;
+    }
+
+    // Otherwise read the headers, then the chained entries, with as few
+    // reads as possible.
+    std::vector<BYTE> headers(unwind.size() * detail::kUnwindInfoHeaderSize);
+    std::vector<detail::CoalescedRead> requests;
+    std::vector<std::size_t> request_entries;
+    for (std::size_t j = 0; j < unwind.size(); ++j)
+    {
+      auto const va = RvaToVa(process, pe_file, entries[unwind[j]].unwind_data);
+      if (va &&
+          ClampCount(pe_file, va, detail::kUnwindInfoHeaderSize, 1) ==
+            detail::kUnwindInfoHeaderSize)
+      {
+        detail::CoalescedRead const request = {
+          va,
+          detail::kUnwindInfoHeaderSize,
+          &headers[j * detail::kUnwindInfoHeaderSize],
+          false};
+        requests.push_back(request);
+        request_entries.push_back(j);
+      }
+    }
+    detail::ReadCoalesced(process, requests.data(), requests.size());
+
+    std::vector<FunctionEntry> chained(unwind.size());
+    std::vector<detail::CoalescedRead> chained_requests;
+    std::vector<std::size_t> chained_entries;
+    for (std::size_t k = 0; k < requests.size(); ++k)
+    {
+      std::size_t const j = request_entries[k];
+      BYTE const* const header = &headers[j * detail::kUnwindInfoHeaderSize];
+      if (!requests[k].success ||
+          !((header[0] >> 3) & detail::kUnwindFlagChainInfo))
+      {
+        continue;
+      }
+
+      auto const va = RvaToVa(process,
+                              pe_file,
+                              entries[unwind[j]].unwind_data +
+                                detail::GetChainedEntryOffset(header[2]));
+      if (va &&
+          ClampCount(pe_file, va, sizeof(FunctionEntry), 1) ==
+            sizeof(FunctionEntry))
+      {
+        detail::CoalescedRead const request = {
+          va, sizeof(FunctionEntry), &chained[j], false};
+        chained_requests.push_back(request);
+        chained_entries.push_back(j);
+      }
+    }
+    detail::ReadCoalesced(
+      process, chained_requests.data(), chained_requests.size());
+
+    for (std::size_t k = 0; k < chained_requests.size(); ++k)
+    {
+      if (chained_requests[k].success)
+      {
+        std::size_t const j = chained_entries[k];
+        targets[unwind[j]] = chained[j].begin_address;
+      }
+    }
+
+    return targets;
+  }
+
+  void Build(Process const& process, PeFile const& pe_file)
+  {
+    NtHeaders const nt_headers{process, pe_file};
+    if (nt_headers.GetMachine() != IMAGE_FILE_MACHINE_AMD64 ||
+        static_cast<DWORD>(PeDataDir::Exception) >=
+          nt_headers.GetNumberOfRvaAndSizesClamped())
+    {
+      return;
+    }
+
+    DWORD const table_rva =
+      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Exception);
+    DWORD const table_size =
+      nt_headers.GetDataDirectorySize(PeDataDir::Exception);
+    if (!table_rva || !table_size)
+    {
+      return;
+    }
+
+    auto const ptr_table = RvaToVa(process, pe_file, table_rva);
+    std::size_t const count = ClampCount(pe_file,
+                                         ptr_table,
+                                         table_size / sizeof(FunctionEntry),
+                                         sizeof(FunctionEntry));
+    if (!ptr_table || !count)
+    {
+      return;
+    }
+
+    std::vector<FunctionEntry> const table =
+      ReadVector<FunctionEntry>(process, ptr_table, count);
+
+    entries_.reserve(table.size());
+    for (auto const& entry : table)
+    {
+      if (entry.begin_address >= entry.end_address)
+      {
+        ++num_invalid_;
+        continue;
+      }
+
+      if (!entries_.empty() &&
+          entry.begin_address < entries_.back().end_address)
+      {
+        sorted_ = false;
+      }
+      entries_.push_back(entry);
+    }
+
+    if (!sorted_)
+    {
+      std::stable_sort(std::begin(entries_),
+                       std::end(entries_),
+                       [](FunctionEntry const& lhs, FunctionEntry const& rhs)
+                       {
+        return lhs.begin_address < rhs.begin_address;
+      });
+    }
+
+    // Resolve each chain to the index of the entry it ends at. A chain
+    // which leads out of the table, or which is too long, leaves the entry
+    // as its own primary entry.
+    std::vector<DWORD> const targets =
+      GetChainTargets(process, pe_file, entries_, table, table_rva);
+    std::vector<std::size_t> parents(entries_.size(),
+                                     static_cast<std::size_t>(kNotFound));
+    for (std::size_t i = 0; i < entries_.size(); ++i)
+    {
+      if (targets[i])
+      {
+        std::size_t const parent = Find(targets[i]);
+        if (parent != kNotFound && parent != i &&
+            entries_[parent].begin_address == targets[i])
+        {
+          parents[i] = parent;
+        }
+      }
+    }
+
+    primary_.resize(entries_.size());
+    for (std::size_t i = 0; i < entries_.size(); ++i)
+    {
+      std::size_t primary = i;
+      std::size_t depth = 0;
+      while (parents[primary] != kNotFound &&
+             depth++ < detail::kMaxUnwindChainDepth)
+      {
+        primary = parents[primary];
+      }
+      primary_[i] = parents[primary] == kNotFound ? primary : i;
+    }
+  }
+
+  std::vector<FunctionEntry> entries_;
+  std::vector<std::size_t> primary_;
+  std::size_t num_invalid_{};
+  bool sorted_{true};
+};
+
+// Function tables for loaded modules are cached per module, and rebuilt if
+// a different module is loaded at the same base.
+inline std::shared_ptr<FunctionTable const>
+  GetFunctionTable(Process const& process, PeFile const& pe_file)
+{
+  return detail::ModuleCache<FunctionTable>::Get(process,
+                                                 pe_file,
+                                                 [&]()
+                                                 {
+    return std::make_shared<FunctionTable const>(process, pe_file);
+  });
+}
+}
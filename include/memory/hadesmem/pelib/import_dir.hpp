@@ -16,6 +16,7 @@
 
 #include <hadesmem/config.hpp>
 #include <hadesmem/error.hpp>
+#include <hadesmem/expected.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/pelib/tls_dir.hpp>
@@ -183,26 +184,32 @@ public:
   }
 
   std::string GetName() const
+  {
+    return TryGetName().Get();
+  }
+
+  Expected<std::string> TryGetName() const
   {
     DWORD const name_rva = GetNameRaw();
     if (!name_rva)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Name RVA is invalid."});
+      return Error{} << ErrorString{"Name RVA is invalid."};
     }
 
-    auto name_va =
-      static_cast<std::uint8_t*>(RvaToVa(*process_, *pe_file_, name_rva));
+    auto const name_va = TryRvaToVa(*process_, *pe_file_, name_rva);
+    if (!name_va)
+    {
+      return name_va.GetError();
+    }
     // It's possible for the RVA to be invalid on disk because it's fixed by
     // relocations.
     // Sample: imports_relocW7.exe
-    if (!name_va)
+    if (!*name_va)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Name VA is invalid."});
+      return Error{} << ErrorString{"Name VA is invalid."};
     }
 
-    return detail::CheckedReadString<char>(*process_, *pe_file_, name_va);
+    return detail::TryCheckedReadString<char>(*process_, *pe_file_, *name_va);
   }
 
   DWORD GetFirstThunk() const
@@ -264,6 +271,21 @@ public:
   }
 
 private:
+  explicit ImportDir(Process const& process,
+                     PeFile const& pe_file,
+                     PIMAGE_IMPORT_DESCRIPTOR imp_desc,
+                     IMAGE_IMPORT_DESCRIPTOR const& data,
+                     bool is_virtual_beg) HADESMEM_DETAIL_NOEXCEPT
+    : process_{&process},
+      pe_file_{&pe_file},
+      base_{reinterpret_cast<std::uint8_t*>(imp_desc)},
+      data_(data),
+      is_virtual_beg_{is_virtual_beg}
+  {
+  }
+
+  friend class ImportDirTable;
+
   Process const* process_;
   PeFile const* pe_file_;
   PBYTE base_;
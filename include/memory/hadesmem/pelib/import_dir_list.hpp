@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 #include <memory>
 #include <utility>
@@ -14,6 +15,7 @@
 #include <hadesmem/detail/optional.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/pelib/import_dir.hpp>
+#include <hadesmem/pelib/import_dir_table.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
@@ -40,17 +42,11 @@ public:
 
   explicit ImportDirIterator(Process const& process, PeFile const& pe_file)
   {
-    try
+    auto const table =
+      std::make_shared<ImportDirTable const>(process, pe_file);
+    if (!table->empty())
     {
-      ImportDir const import_dir{process, pe_file, nullptr};
-      if (!IsTerminator(import_dir))
-      {
-        impl_ = std::make_shared<Impl>(process, pe_file, import_dir);
-      }
-    }
-    catch (std::exception const& /*e*/)
-    {
-      // Nothing to do here.
+      impl_ = std::make_shared<Impl>(table);
     }
   }
 
@@ -95,26 +91,16 @@ public:
 
   ImportDirIterator& operator++()
   {
-    try
-    {
-      HADESMEM_DETAIL_ASSERT(impl_.get());
-
-      auto const cur_base = reinterpret_cast<PIMAGE_IMPORT_DESCRIPTOR>(
-        impl_->import_dir_->GetBase());
-      impl_->import_dir_ =
-        ImportDir{*impl_->process_, *impl_->pe_file_, cur_base + 1};
-
-      if (IsTerminator(*impl_->import_dir_))
-      {
-        impl_.reset();
-        return *this;
-      }
-    }
-    catch (std::exception const& /*e*/)
+    HADESMEM_DETAIL_ASSERT(impl_.get());
+
+    if (++impl_->cur_import_dir_ >= impl_->table_->size())
     {
       impl_.reset();
+      return *this;
     }
 
+    impl_->import_dir_ = impl_->table_->GetImportDir(impl_->cur_import_dir_);
+
     return *this;
   }
 
@@ -136,30 +122,17 @@ public:
   }
 
 private:
-  bool IsTerminator(ImportDir const& import_dir) const
-  {
-    // If the Name is NULL then the other fields can be non-NULL
-    // but the entire entry will still be skipped by the Windows
-    // loader.
-    bool const has_name = !!import_dir.GetNameRaw();
-    bool const has_iat = !!import_dir.GetFirstThunk();
-    return (!has_name || !has_iat);
-  }
-
   struct Impl
   {
-    explicit Impl(Process const& process,
-                  PeFile const& pe_file,
-                  ImportDir const& import_dir) HADESMEM_DETAIL_NOEXCEPT
-      : process_{&process},
-        pe_file_{&pe_file},
-        import_dir_{import_dir}
+    explicit Impl(std::shared_ptr<ImportDirTable const> const& table)
+      : table_{table}, import_dir_{table->GetImportDir(0)}
     {
     }
 
-    Process const* process_;
-    PeFile const* pe_file_;
+    // The whole table is read up front, so advancing never reads.
+    std::shared_ptr<ImportDirTable const> table_;
     hadesmem::detail::Optional<ImportDir> import_dir_;
+    std::size_t cur_import_dir_{};
   };
 
   // Shallow copy semantics, as required by InputIterator.
@@ -0,0 +1,202 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/import_dir.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+// Number of import descriptors read at a time while looking for the end of
+// the table, which has no stored size that can be relied on.
+std::size_t const kImportDirChunkSize = 16;
+
+inline bool IsImportDirTerminator(IMAGE_IMPORT_DESCRIPTOR const& desc)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  // If the Name is NULL then the other fields can be non-NULL but the entire
+  // entry will still be skipped by the Windows loader.
+  return !desc.Name || !desc.FirstThunk;
+}
+}
+
+// Every import descriptor up to (but not including) the terminator, read a
+// chunk at a time rather than one descriptor at a time, for random access
+// (and repeated iteration) without going back to the PE file. The table
+// ends in the same place as ImportDirList, including when a descriptor
+// can't be read, and an invalid import directory gives an empty table.
+//
+// The descriptors are a snapshot, so ImportDir objects returned by
+// GetImportDir are too.
+class ImportDirTable
+{
+public:
+  using value_type = IMAGE_IMPORT_DESCRIPTOR;
+  using size_type = std::size_t;
+  using const_iterator = IMAGE_IMPORT_DESCRIPTOR const*;
+  using iterator = const_iterator;
+
+  explicit ImportDirTable(Process const& process, PeFile const& pe_file)
+    : process_{&process}, pe_file_{&pe_file}
+  {
+    try
+    {
+      Build();
+    }
+    catch (std::exception const& /*e*/)
+    {
+      descriptors_.clear();
+    }
+  }
+
+  explicit ImportDirTable(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit ImportDirTable(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit ImportDirTable(Process&& process, PeFile&& pe_file) = delete;
+
+  // Address of the first descriptor in the PE file, or nullptr if the table
+  // is empty.
+  PIMAGE_IMPORT_DESCRIPTOR GetBase() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return descriptors_.empty() ? nullptr : base_;
+  }
+
+  size_type size() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return descriptors_.size();
+  }
+
+  bool empty() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return descriptors_.empty();
+  }
+
+  IMAGE_IMPORT_DESCRIPTOR const* data() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return descriptors_.data();
+  }
+
+  IMAGE_IMPORT_DESCRIPTOR const& operator[](size_type index) const
+  {
+    HADESMEM_DETAIL_ASSERT(index < descriptors_.size());
+    return descriptors_[index];
+  }
+
+  const_iterator begin() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return descriptors_.data();
+  }
+
+  const_iterator cbegin() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return begin();
+  }
+
+  const_iterator end() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return descriptors_.data() + descriptors_.size();
+  }
+
+  const_iterator cend() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return end();
+  }
+
+  // Doesn't read from the PE file.
+  ImportDir GetImportDir(size_type index) const
+  {
+    HADESMEM_DETAIL_ASSERT(index < descriptors_.size());
+    return ImportDir{*process_,
+                     *pe_file_,
+                     base_ + index,
+                     descriptors_[index],
+                     !index && is_virtual_beg_};
+  }
+
+private:
+  void Build()
+  {
+    // The first descriptor goes through ImportDir, which knows how to find
+    // (and deal with tricks played with) the start of the table.
+    ImportDir const first{*process_, *pe_file_, nullptr};
+    IMAGE_IMPORT_DESCRIPTOR first_desc = IMAGE_IMPORT_DESCRIPTOR{};
+    first_desc.OriginalFirstThunk = first.GetOriginalFirstThunk();
+    first_desc.TimeDateStamp = first.GetTimeDateStamp();
+    first_desc.ForwarderChain = first.GetForwarderChain();
+    first_desc.Name = first.GetNameRaw();
+    first_desc.FirstThunk = first.GetFirstThunk();
+    if (detail::IsImportDirTerminator(first_desc))
+    {
+      return;
+    }
+
+    base_ = static_cast<PIMAGE_IMPORT_DESCRIPTOR>(first.GetBase());
+    is_virtual_beg_ = first.IsVirtualBegin();
+    descriptors_.push_back(first_desc);
+
+    std::vector<IMAGE_IMPORT_DESCRIPTOR> chunk(detail::kImportDirChunkSize);
+    for (;;)
+    {
+      auto const next = base_ + descriptors_.size();
+      std::size_t num_read = chunk.size();
+      // Reads in images fall back to changing protection, like the read of
+      // the first descriptor (and ImportDirList) does.
+      if (detail::TryReadPeImpl(*process_,
+                                *pe_file_,
+                                next,
+                                chunk.data(),
+                                chunk.size() * sizeof(chunk[0])))
+      {
+        // The chunk runs into unreadable memory, so read up to there one
+        // descriptor at a time.
+        num_read = 0;
+        while (num_read < chunk.size() &&
+               !detail::TryReadPeImpl(*process_,
+                                      *pe_file_,
+                                      next + num_read,
+                                      &chunk[num_read],
+                                      sizeof(chunk[0])))
+        {
+          ++num_read;
+        }
+      }
+
+      for (std::size_t i = 0; i < num_read; ++i)
+      {
+        if (detail::IsImportDirTerminator(chunk[i]))
+        {
+          return;
+        }
+
+        descriptors_.push_back(chunk[i]);
+      }
+
+      if (num_read < chunk.size())
+      {
+        return;
+      }
+    }
+  }
+
+  Process const* process_;
+  PeFile const* pe_file_;
+  PIMAGE_IMPORT_DESCRIPTOR base_{};
+  std::vector<IMAGE_IMPORT_DESCRIPTOR> descriptors_;
+  bool is_virtual_beg_{};
+};
+}
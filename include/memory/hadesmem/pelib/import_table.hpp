@@ -0,0 +1,570 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/detail/find_procedure.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+struct ImportThunkRecord
+{
+  // Where the lookup entry was read from (the ILT, or the IAT if the
+  // descriptor has no usable ILT), and the IAT slot it corresponds to.
+  void* lookup_address;
+  void* iat_address;
+  DWORD_PTR lookup;
+  DWORD_PTR function;
+  // Only meaningful if has_name is set. Points into the table's string
+  // arena.
+  boost::string_ref name;
+  WORD hint;
+  WORD ordinal;
+  bool by_ordinal;
+  bool has_name;
+  // Only set by ImportTable::Resolve.
+  FARPROC target;
+};
+
+struct ImportDescriptorRecord
+{
+  void* address;
+  IMAGE_IMPORT_DESCRIPTOR data;
+  // Only meaningful if has_name is set. Points into the table's string
+  // arena.
+  boost::string_ref name;
+  bool has_name;
+  bool uses_ilt;
+  // Range of the descriptor's thunks in ImportTable::GetThunks.
+  std::size_t first_thunk;
+  std::size_t num_thunks;
+};
+
+// Parses the whole import table up front. Descriptor and thunk arrays are
+// read in chunks (normally a single read each) rather than one element at a
+// time, and the module and function names are fetched with coalesced reads
+// into a single arena which the records refer to.
+//
+// Only the layout the loader actually uses is parsed. Descriptors are read
+// until the first one with no Name or FirstThunk, names are taken from the
+// ILT (falling back to the IAT if there's no valid ILT, unless the file is a
+// mapped image, where the IAT has already been bound), and nothing past the
+// end of the file (or image) is read. ImportDirList and ImportThunkList are
+// still the tools for inspecting malformed files in detail.
+//
+// Copying is disabled because the records point into the arena. Moving is
+// fine.
+class ImportTable
+{
+public:
+  explicit ImportTable(Process const& process, PeFile const& pe_file)
+    : process_{&process}, pe_file_{&pe_file}
+  {
+    Parse();
+  }
+
+  explicit ImportTable(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit ImportTable(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit ImportTable(Process&& process, PeFile&& pe_file) = delete;
+
+  ImportTable(ImportTable const&) = delete;
+
+  ImportTable& operator=(ImportTable const&) = delete;
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  ImportTable(ImportTable&& other)
+    : process_{other.process_},
+      pe_file_{other.pe_file_},
+      descriptors_(std::move(other.descriptors_)),
+      thunks_(std::move(other.thunks_)),
+      thunks_by_address_(std::move(other.thunks_by_address_)),
+      arena_(std::move(other.arena_))
+  {
+  }
+
+  ImportTable& operator=(ImportTable&& other)
+  {
+    process_ = other.process_;
+    pe_file_ = other.pe_file_;
+    descriptors_ = std::move(other.descriptors_);
+    thunks_ = std::move(other.thunks_);
+    thunks_by_address_ = std::move(other.thunks_by_address_);
+    arena_ = std::move(other.arena_);
+
+    return *this;
+  }
+
+#else // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  ImportTable(ImportTable&&) = default;
+
+  ImportTable& operator=(ImportTable&&) = default;
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  std::vector<ImportDescriptorRecord> const& GetDescriptors() const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return descriptors_;
+  }
+
+  std::vector<ImportThunkRecord> const& GetThunks() const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return thunks_;
+  }
+
+  ImportThunkRecord const*
+    GetThunksBegin(ImportDescriptorRecord const& descriptor) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return thunks_.data() + descriptor.first_thunk;
+  }
+
+  ImportThunkRecord const*
+    GetThunksEnd(ImportDescriptorRecord const& descriptor) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return thunks_.data() + descriptor.first_thunk + descriptor.num_thunks;
+  }
+
+  // Finds the thunk whose lookup entry lives at the given address (i.e.
+  // ImportThunk::GetBase), or returns nullptr. If several descriptors share
+  // a lookup array the thunk of the first one is returned.
+  ImportThunkRecord const* FindThunk(void const* lookup_address) const
+  {
+    auto const iter =
+      std::lower_bound(std::begin(thunks_by_address_),
+                       std::end(thunks_by_address_),
+                       lookup_address,
+                       [&](std::size_t lhs, void const* rhs)
+                       {
+        return thunks_[lhs].lookup_address < rhs;
+      });
+    return (iter != std::end(thunks_by_address_) &&
+            thunks_[*iter].lookup_address == lookup_address)
+             ? &thunks_[*iter]
+             : nullptr;
+  }
+
+  // Resolves every import against the modules loaded in the process
+  // (following forwarders, and using the same caches as FindProcedure), and
+  // stores the result in ImportThunkRecord::target. Imports which can't be
+  // resolved are left null. Returns the number resolved.
+  std::size_t Resolve()
+  {
+    detail::ProcedureResolver resolver{*process_};
+    std::size_t num_resolved = 0;
+    for (auto const& descriptor : descriptors_)
+    {
+      HMODULE module = nullptr;
+      try
+      {
+        module = descriptor.has_name
+                   ? resolver.FindModule(descriptor.name.to_string())
+                   : nullptr;
+      }
+      catch (std::exception const& /*e*/)
+      {
+      }
+
+      for (std::size_t i = descriptor.first_thunk;
+           i < descriptor.first_thunk + descriptor.num_thunks;
+           ++i)
+      {
+        auto& thunk = thunks_[i];
+        thunk.target = nullptr;
+        if (!module || (!thunk.by_ordinal && !thunk.has_name))
+        {
+          continue;
+        }
+
+        try
+        {
+          thunk.target =
+            thunk.by_ordinal
+              ? resolver.Resolve(module, thunk.ordinal)
+              : resolver.Resolve(module, thunk.name.to_string());
+        }
+        catch (std::exception const& /*e*/)
+        {
+          continue;
+        }
+
+        if (thunk.target)
+        {
+          ++num_resolved;
+        }
+      }
+    }
+
+    return num_resolved;
+  }
+
+private:
+  // Enough for almost every import name (plus its hint) in a single read.
+  static std::size_t const kNameReadSize = 0x80;
+
+  // Elements per chunked array read.
+  static std::size_t const kArrayChunkSize = 0x1000;
+
+  struct StringRef
+  {
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  PBYTE GetEnd() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return static_cast<PBYTE>(pe_file_->GetBase()) + pe_file_->GetSize();
+  }
+
+  // Reads elements of type T starting at ptr until stop returns true for one
+  // (which isn't included), max_count elements have been read, or the end of
+  // the file (or image) or unreadable memory is reached.
+  template <typename T, typename StopFunc>
+  std::vector<T> ReadArray(PBYTE ptr, std::size_t max_count, StopFunc stop)
+  {
+    std::vector<T> elements;
+    PBYTE const end = GetEnd();
+    while (ptr && ptr < end && elements.size() < max_count)
+    {
+      std::size_t const num_left = (std::min)(
+        static_cast<std::size_t>(end - ptr) / sizeof(T),
+        max_count - elements.size());
+      std::size_t const chunk_size = (std::min)(
+        num_left, static_cast<std::size_t>(kArrayChunkSize) / sizeof(T));
+      if (!chunk_size)
+      {
+        break;
+      }
+
+      std::vector<T> chunk(chunk_size);
+      if (!detail::TryReadUnchecked(
+            *process_, ptr, chunk.data(), chunk.size() * sizeof(T)))
+      {
+        // Part of the chunk may still be readable, so read the rest one at a
+        // time (as the iterators do).
+        chunk.resize(1);
+        if (!detail::TryReadUnchecked(
+              *process_, ptr, chunk.data(), sizeof(T)))
+        {
+          break;
+        }
+      }
+
+      for (auto const& element : chunk)
+      {
+        if (stop(element))
+        {
+          return elements;
+        }
+
+        elements.push_back(element);
+      }
+
+      ptr += chunk.size() * sizeof(T);
+    }
+
+    return elements;
+  }
+
+  // Appends the string at the given address (optionally preceded by a
+  // WORD, for hint/name entries) to the arena. Uses the result of a
+  // coalesced read if the string was terminated within it, otherwise falls
+  // back to the same checked read as the iterators.
+  bool AddString(detail::CoalescedRead const& request,
+                 bool has_hint,
+                 WORD& hint,
+                 StringRef& str)
+  {
+    std::size_t const hint_size = has_hint ? sizeof(WORD) : 0;
+    auto const data = static_cast<char const*>(request.data);
+    bool const hit_end =
+      static_cast<PBYTE>(request.address) + request.size == GetEnd();
+    if (request.success && request.size >= hint_size)
+    {
+      char const* const beg = data + hint_size;
+      char const* const end = data + request.size;
+      char const* const term = std::find(beg, end, '\0');
+      // Strings may be terminated by the end of a data file.
+      if (term != end ||
+          (hit_end && pe_file_->GetType() == PeFileType::Data))
+      {
+        if (has_hint)
+        {
+          std::memcpy(&hint, data, sizeof(hint));
+        }
+
+        str.offset = arena_.size();
+        str.size = static_cast<std::size_t>(term - beg);
+        arena_.insert(std::end(arena_), beg, term);
+        return true;
+      }
+    }
+
+    try
+    {
+      auto const address = static_cast<PBYTE>(request.address);
+      if (has_hint)
+      {
+        hint = Read<WORD>(*process_, address);
+      }
+
+      std::string const s = detail::CheckedReadString<char>(
+        *process_, *pe_file_, address + hint_size);
+      str.offset = arena_.size();
+      str.size = s.size();
+      arena_.insert(std::end(arena_), std::begin(s), std::end(s));
+      return true;
+    }
+    catch (std::exception const& /*e*/)
+    {
+      return false;
+    }
+  }
+
+  detail::CoalescedRead MakeStringRequest(DWORD rva,
+                                          std::vector<char>& scratch,
+                                          std::size_t slot)
+  {
+    detail::CoalescedRead request = {
+      RvaToVa(*process_, *pe_file_, rva),
+      0,
+      scratch.data() + slot * kNameReadSize,
+      false};
+    PBYTE const end = GetEnd();
+    auto const address = static_cast<PBYTE>(request.address);
+    if (address && address < end)
+    {
+      request.size = (std::min)(static_cast<std::size_t>(end - address),
+                                static_cast<std::size_t>(kNameReadSize));
+    }
+    return request;
+  }
+
+  void Parse()
+  {
+    NtHeaders const nt_headers{*process_, *pe_file_};
+    DWORD const import_dir_rva =
+      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Import);
+    if (!import_dir_rva)
+    {
+      return;
+    }
+
+    auto const import_dir_va =
+      static_cast<PBYTE>(RvaToVa(*process_, *pe_file_, import_dir_rva));
+    // Same terminator as ImportDirList.
+    std::vector<IMAGE_IMPORT_DESCRIPTOR> const import_descs =
+      ReadArray<IMAGE_IMPORT_DESCRIPTOR>(
+        import_dir_va,
+        (std::numeric_limits<std::size_t>::max)(),
+        [](IMAGE_IMPORT_DESCRIPTOR const& import_desc)
+        {
+          return !import_desc.Name || !import_desc.FirstThunk;
+        });
+
+    bool const is_image = pe_file_->GetType() == PeFileType::Image;
+    auto const is_thunk_terminator = [](IMAGE_THUNK_DATA const& thunk)
+    {
+      return !thunk.u1.AddressOfData;
+    };
+    descriptors_.reserve(import_descs.size());
+    for (std::size_t i = 0; i < import_descs.size(); ++i)
+    {
+      auto const& import_desc = import_descs[i];
+      auto const iat_va = static_cast<PBYTE>(
+        RvaToVa(*process_, *pe_file_, import_desc.FirstThunk));
+      auto const ilt_va = static_cast<PBYTE>(
+        RvaToVa(*process_, *pe_file_, import_desc.OriginalFirstThunk));
+
+      ImportDescriptorRecord descriptor = {};
+      descriptor.address = import_dir_va + i * sizeof(import_desc);
+      descriptor.data = import_desc;
+      descriptor.uses_ilt = import_desc.OriginalFirstThunk &&
+                            import_desc.OriginalFirstThunk !=
+                              import_desc.FirstThunk &&
+                            ilt_va;
+      descriptor.first_thunk = thunks_.size();
+
+      PBYTE const lookup_va = descriptor.uses_ilt ? ilt_va : iat_va;
+      std::vector<IMAGE_THUNK_DATA> const lookups =
+        ReadArray<IMAGE_THUNK_DATA>(lookup_va,
+                                    (std::numeric_limits<std::size_t>::max)(),
+                                    is_thunk_terminator);
+      std::vector<IMAGE_THUNK_DATA> const iat =
+        descriptor.uses_ilt
+          ? ReadArray<IMAGE_THUNK_DATA>(
+              iat_va,
+              lookups.size(),
+              [](IMAGE_THUNK_DATA const&)
+              {
+                return false;
+              })
+          : lookups;
+
+      // Names can't be recovered from a bound IAT.
+      bool const has_names = descriptor.uses_ilt || !is_image;
+      for (std::size_t j = 0; j < lookups.size(); ++j)
+      {
+        ImportThunkRecord thunk = {};
+        thunk.lookup_address = lookup_va + j * sizeof(IMAGE_THUNK_DATA);
+        thunk.iat_address = iat_va + j * sizeof(IMAGE_THUNK_DATA);
+        thunk.lookup = lookups[j].u1.AddressOfData;
+        thunk.function = j < iat.size() ? iat[j].u1.Function : 0;
+        if (has_names)
+        {
+          thunk.by_ordinal = IMAGE_SNAP_BY_ORDINAL(lookups[j].u1.Ordinal);
+          thunk.ordinal = IMAGE_ORDINAL(lookups[j].u1.Ordinal);
+        }
+        thunks_.push_back(thunk);
+      }
+
+      descriptor.num_thunks = thunks_.size() - descriptor.first_thunk;
+      descriptors_.push_back(descriptor);
+    }
+
+    ReadStrings(!is_image);
+    BuildAddressIndex();
+  }
+
+  void ReadStrings(bool iat_has_names)
+  {
+    // One request per descriptor name and per named thunk.
+    std::vector<std::size_t> named_thunks;
+    for (auto const& descriptor : descriptors_)
+    {
+      if (!descriptor.uses_ilt && !iat_has_names)
+      {
+        continue;
+      }
+
+      for (std::size_t i = descriptor.first_thunk;
+           i < descriptor.first_thunk + descriptor.num_thunks;
+           ++i)
+      {
+        if (!thunks_[i].by_ordinal)
+        {
+          named_thunks.push_back(i);
+        }
+      }
+    }
+
+    std::size_t const num_requests = descriptors_.size() + named_thunks.size();
+    std::vector<char> scratch(num_requests * kNameReadSize);
+    std::vector<detail::CoalescedRead> requests;
+    requests.reserve(num_requests);
+    for (auto const& descriptor : descriptors_)
+    {
+      requests.push_back(
+        MakeStringRequest(descriptor.data.Name, scratch, requests.size()));
+    }
+    for (auto const i : named_thunks)
+    {
+      requests.push_back(MakeStringRequest(
+        static_cast<DWORD>(thunks_[i].lookup), scratch, requests.size()));
+    }
+
+    // Requests which couldn't be mapped are left for the fallback path (which
+    // will fail them).
+    std::vector<detail::CoalescedRead> valid_requests;
+    std::vector<std::size_t> valid_indices;
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+      if (requests[i].size)
+      {
+        valid_requests.push_back(requests[i]);
+        valid_indices.push_back(i);
+      }
+    }
+    detail::ReadCoalesced(
+      *process_, valid_requests.data(), valid_requests.size());
+    for (std::size_t i = 0; i < valid_requests.size(); ++i)
+    {
+      requests[valid_indices[i]] = valid_requests[i];
+    }
+
+    std::vector<StringRef> refs(num_requests);
+    std::vector<bool> valid(num_requests);
+    for (std::size_t i = 0; i < num_requests; ++i)
+    {
+      bool const is_thunk = i >= descriptors_.size();
+      WORD hint = 0;
+      valid[i] = requests[i].address &&
+                 AddString(requests[i], is_thunk, hint, refs[i]);
+      if (is_thunk)
+      {
+        thunks_[named_thunks[i - descriptors_.size()]].hint = hint;
+      }
+    }
+
+    // Only safe to point into the arena once it has stopped growing.
+    char const* const arena = arena_.data();
+    for (std::size_t i = 0; i < descriptors_.size(); ++i)
+    {
+      descriptors_[i].has_name = valid[i];
+      descriptors_[i].name = boost::string_ref(arena + refs[i].offset,
+                                               valid[i] ? refs[i].size : 0);
+    }
+    for (std::size_t i = 0; i < named_thunks.size(); ++i)
+    {
+      std::size_t const j = descriptors_.size() + i;
+      auto& thunk = thunks_[named_thunks[i]];
+      thunk.has_name = valid[j];
+      thunk.name =
+        boost::string_ref(arena + refs[j].offset, valid[j] ? refs[j].size : 0);
+    }
+  }
+
+  void BuildAddressIndex()
+  {
+    thunks_by_address_.resize(thunks_.size());
+    for (std::size_t i = 0; i < thunks_.size(); ++i)
+    {
+      thunks_by_address_[i] = i;
+    }
+    std::stable_sort(std::begin(thunks_by_address_),
+                     std::end(thunks_by_address_),
+                     [&](std::size_t lhs, std::size_t rhs)
+                     {
+      return thunks_[lhs].lookup_address < thunks_[rhs].lookup_address;
+    });
+  }
+
+  Process const* process_;
+  PeFile const* pe_file_;
+  std::vector<ImportDescriptorRecord> descriptors_;
+  std::vector<ImportThunkRecord> thunks_;
+  std::vector<std::size_t> thunks_by_address_;
+  std::vector<char> arena_;
+};
+}
@@ -15,6 +15,7 @@
 
 #include <hadesmem/config.hpp>
 #include <hadesmem/error.hpp>
+#include <hadesmem/expected.hpp>
 #include <hadesmem/pelib/import_dir.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
@@ -91,28 +92,38 @@ public:
 
   WORD GetHint() const
   {
-    auto const name_import = static_cast<std::uint8_t*>(
-      RvaToVa(*process_, *pe_file_, static_cast<DWORD>(GetAddressOfData())));
+    return TryGetHint().Get();
+  }
+
+  Expected<WORD> TryGetHint() const
+  {
+    auto const name_import = GetNameImport();
     if (!name_import)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(
-        Error{} << ErrorString{"Invalid import name and hint."});
+      return name_import.GetError();
     }
-    return Read<WORD>(*process_,
-                      name_import + offsetof(IMAGE_IMPORT_BY_NAME, Hint));
+    return detail::TryReadPe<WORD>(*process_,
+                                   *pe_file_,
+                                   *name_import +
+                                     offsetof(IMAGE_IMPORT_BY_NAME, Hint));
   }
 
   std::string GetName() const
   {
-    auto const name_import = static_cast<std::uint8_t*>(
-      RvaToVa(*process_, *pe_file_, static_cast<DWORD>(GetAddressOfData())));
+    return TryGetName().Get();
+  }
+
+  Expected<std::string> TryGetName() const
+  {
+    auto const name_import = GetNameImport();
     if (!name_import)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(
-        Error{} << ErrorString{"Invalid import name and hint."});
+      return name_import.GetError();
     }
-    return detail::CheckedReadString<char>(
-      *process_, *pe_file_, name_import + offsetof(IMAGE_IMPORT_BY_NAME, Name));
+    return detail::TryCheckedReadString<char>(
+      *process_,
+      *pe_file_,
+      *name_import + offsetof(IMAGE_IMPORT_BY_NAME, Name));
   }
 
   void SetAddressOfData(DWORD_PTR address_of_data)
@@ -139,6 +150,21 @@ public:
   }
 
 private:
+  Expected<std::uint8_t*> GetNameImport() const
+  {
+    auto const name_import = TryRvaToVa(
+      *process_, *pe_file_, static_cast<DWORD>(GetAddressOfData()));
+    if (!name_import)
+    {
+      return name_import.GetError();
+    }
+    if (!*name_import)
+    {
+      return Error{} << ErrorString{"Invalid import name and hint."};
+    }
+    return static_cast<std::uint8_t*>(*name_import);
+  }
+
   Process const* process_;
   PeFile const* pe_file_;
   PBYTE base_;
@@ -0,0 +1,256 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/parallel_for.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/dos_header.hpp>
+#include <hadesmem/pelib/import_table.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/relocation_table.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// Returns the address to bind an import to, or zero to leave its IAT entry
+// untouched.
+using ImportBinder = std::function<DWORD_PTR(
+  ImportDescriptorRecord const& descriptor, ImportThunkRecord const& thunk)>;
+
+namespace detail
+{
+// Copies over this many bytes of section data are split across threads.
+std::size_t const kMapPeImageParallelThreshold = 0x100000;
+
+struct MapPeImageCopy
+{
+  DWORD file_offset;
+  DWORD rva;
+  DWORD size;
+};
+
+inline DWORD AlignUp(DWORD value, DWORD alignment) HADESMEM_DETAIL_NOEXCEPT
+{
+  if (!alignment)
+  {
+    return value;
+  }
+
+  DWORD const remainder = value % alignment;
+  if (!remainder)
+  {
+    return value;
+  }
+
+  // Saturate rather than wrap, the result is only ever used as an upper
+  // bound.
+  return value > (std::numeric_limits<DWORD>::max)() - (alignment - remainder)
+           ? (std::numeric_limits<DWORD>::max)()
+           : value + (alignment - remainder);
+}
+
+// Clamps a copy to both the file and the image. Returns false if nothing is
+// left.
+inline bool ClampMapPeImageCopy(MapPeImageCopy& copy,
+                                DWORD file_size,
+                                DWORD image_size) HADESMEM_DETAIL_NOEXCEPT
+{
+  if (copy.file_offset >= file_size || copy.rva >= image_size)
+  {
+    return false;
+  }
+
+  copy.size = (std::min)(copy.size, file_size - copy.file_offset);
+  copy.size = (std::min)(copy.size, image_size - copy.rva);
+  return copy.size != 0;
+}
+}
+
+// Maps a PeFileType::Data file into an image layout buffer, the way the
+// loader lays it out in memory, so it can be inspected with PeFileType::Image
+// (or scanned, disassembled, etc.) without loading it. Only the data file is
+// read, so this also works for files which can't be loaded on this machine.
+//
+// Headers and section data are copied with the same rules RvaToVa assumes
+// for data files: PointerToRawData is rounded down to 0x200, SizeOfRawData
+// is rounded up to FileAlignment, the virtual size (or SizeOfRawData if
+// that's zero) is rounded up to SectionAlignment, and anything not backed by
+// the file is zero filled. Files with a SectionAlignment smaller than a page
+// are mapped flat, as the loader does. Sections are copied in parallel
+// unless they overlap (in which case later sections win, as with the loader).
+//
+// If base is non-zero the image is relocated to it (and the ImageBase in the
+// mapped headers updated). If binder is set it's called for every import
+// with a name or ordinal, and the IAT entries it returns an address for are
+// filled in. Like the rest of pelib, only images of the same architecture as
+// the caller are supported.
+inline std::vector<BYTE> MapPeImage(Process const& process,
+                                    PeFile const& pe_file,
+                                    std::uint64_t base = 0,
+                                    ImportBinder const& binder = ImportBinder())
+{
+  if (pe_file.GetType() != PeFileType::Data)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Only data files can be mapped."});
+  }
+
+  DosHeader const dos_header{process, pe_file};
+  NtHeaders const nt_headers{process, pe_file};
+  DWORD const section_alignment = nt_headers.GetSectionAlignment();
+  DWORD const file_alignment = nt_headers.GetFileAlignment();
+  DWORD const image_size =
+    detail::AlignUp(nt_headers.GetSizeOfImage(), section_alignment);
+  if (!image_size)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Invalid SizeOfImage."});
+  }
+
+  DWORD const file_size = pe_file.GetSize();
+  std::vector<BYTE> image(image_size);
+  std::vector<detail::MapPeImageCopy> copies;
+  bool overlapping = false;
+  if (section_alignment < 0x1000)
+  {
+    detail::MapPeImageCopy const flat = {0, 0, file_size};
+    copies.push_back(flat);
+  }
+  else
+  {
+    detail::MapPeImageCopy const headers = {
+      0, 0, nt_headers.GetSizeOfHeaders()};
+    copies.push_back(headers);
+
+    SectionList const sections{process, pe_file};
+    for (auto const& section : sections)
+    {
+      DWORD const raw_size =
+        detail::AlignUp(section.GetSizeOfRawData(), file_alignment);
+      DWORD const virtual_size = section.GetVirtualSize();
+      DWORD const mapped_size = detail::AlignUp(
+        virtual_size ? virtual_size : section.GetSizeOfRawData(),
+        section_alignment);
+      detail::MapPeImageCopy const copy = {
+        static_cast<DWORD>(section.GetPointerToRawData() & ~0x1FFUL),
+        section.GetVirtualAddress(),
+        (std::min)(raw_size, mapped_size)};
+      copies.push_back(copy);
+    }
+  }
+
+  std::vector<detail::MapPeImageCopy> clamped_copies;
+  for (auto copy : copies)
+  {
+    if (detail::ClampMapPeImageCopy(copy, file_size, image_size))
+    {
+      clamped_copies.push_back(copy);
+    }
+  }
+  copies.swap(clamped_copies);
+
+  std::uint64_t total_size = 0;
+  for (std::size_t i = 0; i < copies.size(); ++i)
+  {
+    total_size += copies[i].size;
+    for (std::size_t j = 0; j < i; ++j)
+    {
+      if (copies[i].rva < copies[j].rva + copies[j].size &&
+          copies[j].rva < copies[i].rva + copies[i].size)
+      {
+        overlapping = true;
+      }
+    }
+  }
+
+  auto const file_base = static_cast<PBYTE>(pe_file.GetBase());
+  auto const do_copy = [&](std::size_t i)
+  {
+    detail::MapPeImageCopy const& copy = copies[i];
+    detail::ReadImpl(process,
+                     file_base + copy.file_offset,
+                     image.data() + copy.rva,
+                     copy.size);
+  };
+  if (!overlapping && copies.size() > 1 &&
+      total_size >= detail::kMapPeImageParallelThreshold)
+  {
+    detail::ParallelFor(copies.size(), do_copy);
+  }
+  else
+  {
+    for (std::size_t i = 0; i < copies.size(); ++i)
+    {
+      do_copy(i);
+    }
+  }
+
+  if (base && base != nt_headers.GetImageBase())
+  {
+    RelocationTable const relocations{process, pe_file};
+    relocations.Apply(
+      image.data(), image.size(), base - nt_headers.GetImageBase());
+
+    std::size_t const image_base_offset =
+      static_cast<std::size_t>(dos_header.GetNewHeaderOffset()) +
+      offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
+      offsetof(IMAGE_OPTIONAL_HEADER, ImageBase);
+    auto const new_image_base = static_cast<ULONG_PTR>(base);
+    if (image_base_offset + sizeof(new_image_base) <= image.size())
+    {
+      std::memcpy(&image[image_base_offset],
+                  &new_image_base,
+                  sizeof(new_image_base));
+    }
+  }
+
+  if (binder)
+  {
+    ImportTable const imports{process, pe_file};
+    for (auto const& descriptor : imports.GetDescriptors())
+    {
+      for (auto thunk = imports.GetThunksBegin(descriptor);
+           thunk != imports.GetThunksEnd(descriptor);
+           ++thunk)
+      {
+        if (!thunk->by_ordinal && !thunk->has_name)
+        {
+          continue;
+        }
+
+        DWORD_PTR const address = binder(descriptor, *thunk);
+        std::uint64_t const iat_rva =
+          static_cast<std::uint64_t>(descriptor.data.FirstThunk) +
+          (thunk - imports.GetThunksBegin(descriptor)) *
+            sizeof(IMAGE_THUNK_DATA);
+        if (address && iat_rva + sizeof(address) <= image.size())
+        {
+          std::memcpy(&image[static_cast<std::size_t>(iat_rva)],
+                      &address,
+                      sizeof(address));
+        }
+      }
+    }
+  }
+
+  return image;
+}
+}
@@ -0,0 +1,182 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/detail/smart_handle.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// Read-only view of a file on disk, for parsing with PeFileType::Data (using
+// the current process) without copying the file into memory first. Pages are
+// only read in when they're touched, so rejecting a non-PE file or dumping
+// the headers of a large one costs little more than opening it. As pelib
+// reads through ReadProcessMemory, an I/O error (e.g. the file being
+// truncated while mapped) fails the read rather than raising an in-page
+// exception.
+//
+// A PE file can't be larger than 4GB, so at most the first 4GB of the file
+// are mapped (anything after that could only be overlay data).
+class MappedFile
+{
+public:
+  explicit MappedFile(std::wstring const& path)
+  {
+    file_ = ::CreateFileW(path.c_str(),
+                          GENERIC_READ,
+                          FILE_SHARE_DELETE | FILE_SHARE_READ |
+                            FILE_SHARE_WRITE,
+                          nullptr,
+                          OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL,
+                          nullptr);
+    if (!file_.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"CreateFile failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    LARGE_INTEGER file_size{};
+    if (!::GetFileSizeEx(file_.GetHandle(), &file_size))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"GetFileSizeEx failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    file_size_ = static_cast<std::uint64_t>(file_size.QuadPart);
+
+    // Empty files can't be mapped.
+    if (!file_size_)
+    {
+      return;
+    }
+
+    mapping_ = ::CreateFileMappingW(
+      file_.GetHandle(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"CreateFileMapping failed."}
+                << ErrorCodeWinLast{last_error});
+    }
+
+    size_ = static_cast<DWORD>((std::min)(
+      file_size_,
+      static_cast<std::uint64_t>((std::numeric_limits<DWORD>::max)())));
+    view_ = ::MapViewOfFile(mapping_.GetHandle(), FILE_MAP_READ, 0, 0, size_);
+    if (!view_.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"MapViewOfFile failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+  }
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  MappedFile(MappedFile&& other)
+    : file_(std::move(other.file_)),
+      mapping_(std::move(other.mapping_)),
+      view_(std::move(other.view_)),
+      file_size_{other.file_size_},
+      size_{other.size_}
+  {
+    other.file_size_ = 0;
+    other.size_ = 0;
+  }
+
+  MappedFile& operator=(MappedFile&& other)
+  {
+    view_ = std::move(other.view_);
+    mapping_ = std::move(other.mapping_);
+    file_ = std::move(other.file_);
+    file_size_ = other.file_size_;
+    other.file_size_ = 0;
+    size_ = other.size_;
+    other.size_ = 0;
+
+    return *this;
+  }
+
+#else // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  MappedFile(MappedFile&&) = default;
+
+  MappedFile& operator=(MappedFile&&) = default;
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  // Null for an empty file.
+  void* GetBase() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return view_.GetHandle();
+  }
+
+  // Size of the view, i.e. what to pass to PeFile.
+  DWORD GetSize() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return size_;
+  }
+
+  std::uint64_t GetFileSize() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return file_size_;
+  }
+
+private:
+  // Declared in this order so the view is unmapped before the handles are
+  // closed.
+  detail::SmartFileHandle file_;
+  detail::SmartHandle mapping_;
+  detail::SmartMappedViewHandle view_;
+  std::uint64_t file_size_{0};
+  DWORD size_{0};
+};
+
+// Cheap check for whether a buffer (e.g. a MappedFile) could hold a PE file
+// of any architecture: a DOS header, and a PE signature at e_lfanew. Nothing
+// else is touched (so for a MappedFile usually only the first page is read
+// in), and everything past the signature is left to NtHeaders etc.
+inline bool ProbePeFile(Process const& process, void* base, std::size_t size)
+{
+  IMAGE_DOS_HEADER dos_header;
+  if (size < sizeof(dos_header) ||
+      !detail::TryReadUnchecked(
+        process, base, &dos_header, sizeof(dos_header)) ||
+      dos_header.e_magic != IMAGE_DOS_SIGNATURE)
+  {
+    return false;
+  }
+
+  // A negative offset ends up out of range too.
+  std::size_t const nt_headers_offset =
+    static_cast<DWORD>(dos_header.e_lfanew);
+  DWORD signature = 0;
+  return nt_headers_offset <= size - sizeof(signature) &&
+         detail::TryReadUnchecked(process,
+                                  static_cast<PBYTE>(base) + nt_headers_offset,
+                                  &signature,
+                                  sizeof(signature)) &&
+         signature == IMAGE_NT_SIGNATURE;
+}
+}
@@ -18,6 +18,7 @@
 #include <hadesmem/config.hpp>
 #include <hadesmem/detail/assert.hpp>
 #include <hadesmem/error.hpp>
+#include <hadesmem/expected.hpp>
 #include <hadesmem/pelib/dos_header.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
@@ -54,7 +55,14 @@ public:
       pe_file_{&pe_file},
       base_{CalculateBase(*process_, *pe_file_)}
   {
-    UpdateRead();
+    if (auto const image_data = pe_file.GetImageData())
+    {
+      data_ = image_data->nt_headers;
+    }
+    else
+    {
+      UpdateRead();
+    }
 
     EnsureValid();
   }
@@ -546,17 +554,75 @@ public:
 private:
   PBYTE CalculateBase(Process const& process, PeFile const& pe_file) const
   {
+    if (auto const image_data = pe_file.GetImageData())
+    {
+      return image_data->nt_headers_base;
+    }
+
     DosHeader dos_header{process, pe_file};
     return static_cast<PBYTE>(dos_header.GetBase()) +
            dos_header.GetNewHeaderOffset();
   }
 
+  friend Expected<NtHeaders> TryNtHeaders(Process const& process,
+                                          PeFile const& pe_file);
+
+  // Doesn't read or validate.
+  explicit NtHeaders(Process const& process,
+                     PeFile const& pe_file,
+                     std::uint8_t* base,
+                     IMAGE_NT_HEADERS const& data)
+    : process_{&process}, pe_file_{&pe_file}, base_{base}, data_(data)
+  {
+  }
+
   Process const* process_;
   PeFile const* pe_file_;
   std::uint8_t* base_;
   IMAGE_NT_HEADERS data_ = IMAGE_NT_HEADERS{};
 };
 
+// Same as constructing an NtHeaders, but reports invalid headers (including
+// an invalid DOS header, or headers that can't be read) through the result
+// rather than throwing.
+inline Expected<NtHeaders> TryNtHeaders(Process const& process,
+                                        PeFile const& pe_file)
+{
+  std::uint8_t* base = nullptr;
+  IMAGE_NT_HEADERS data;
+  if (auto const image_data = pe_file.GetImageData())
+  {
+    base = image_data->nt_headers_base;
+    data = image_data->nt_headers;
+  }
+  else
+  {
+    auto const dos_header = TryDosHeader(process, pe_file);
+    if (!dos_header)
+    {
+      return dos_header.GetError();
+    }
+
+    base = static_cast<std::uint8_t*>(dos_header->GetBase()) +
+           dos_header->GetNewHeaderOffset();
+    auto const read =
+      detail::TryReadPe<IMAGE_NT_HEADERS>(process, pe_file, base);
+    if (!read)
+    {
+      return read.GetError();
+    }
+    data = *read;
+  }
+
+  NtHeaders const nt_headers{process, pe_file, base, data};
+  if (!nt_headers.IsValid())
+  {
+    return Error{} << ErrorString{"NT headers signature invalid."};
+  }
+
+  return nt_headers;
+}
+
 inline bool operator==(NtHeaders const& lhs,
                        NtHeaders const& rhs) HADESMEM_DETAIL_NOEXCEPT
 {
@@ -0,0 +1,839 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/smart_handle.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/import_table.hpp>
+#include <hadesmem/pelib/map_pe_image.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+// After config.hpp, which decides whether this is needed.
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+#include <emmintrin.h>
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+namespace hadesmem
+{
+struct PeDigestFlags
+{
+  enum : std::uint32_t
+  {
+    kNone = 0,
+    kCheckSum = 1 << 0,
+    kImportHash = 1 << 1,
+    kSectionHashes = 1 << 2,
+    kImageHash = 1 << 3,
+    kAll = kCheckSum | kImportHash | kSectionHashes | kImageHash,
+    kInvalidFlagMaxValue = 1 << 4
+  };
+};
+
+// Algorithm for the section and image hashes. The import hash is always MD5.
+enum class PeHashAlgorithm
+{
+  kMd5,
+  kSha1,
+  kSha256
+};
+
+// Lowercase hex, as digests are usually written.
+inline std::string FormatDigest(std::vector<BYTE> const& digest)
+{
+  char const kHexDigits[] = "0123456789abcdef";
+  std::string formatted;
+  formatted.reserve(digest.size() * 2);
+  for (auto const b : digest)
+  {
+    formatted.push_back(kHexDigits[b >> 4]);
+    formatted.push_back(kHexDigits[b & 0xF]);
+  }
+  return formatted;
+}
+
+namespace detail
+{
+// Amount of a PE file read (and fed to every digest) in one go.
+DWORD const kPeDigestChunkSize = 0x10000;
+
+// Sums the little-endian WORDs in a buffer of even size. The checksum's
+// ones'-complement sum can be done with a plain sum followed by folding the
+// carries back in (see FoldPeCheckSum), so this doesn't need to fold as it
+// goes.
+inline std::uint64_t SumPeCheckSumWords(std::uint8_t const* data,
+                                        std::size_t size)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  HADESMEM_DETAIL_ASSERT(!(size & 1));
+
+  std::uint64_t sum = 0;
+  std::size_t i = 0;
+
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+  // Each pass adds at most 2 * 0xFFFF to each 32-bit lane, so empty the
+  // lanes well before they can overflow.
+  std::size_t const kPassesPerFlush = 0x4000;
+  __m128i const zero = _mm_setzero_si128();
+  while (size - i >= 16)
+  {
+    std::size_t const passes = (std::min)((size - i) / 16, kPassesPerFlush);
+    __m128i lanes = zero;
+    for (std::size_t j = 0; j < passes; ++j, i += 16)
+    {
+      __m128i const words =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+      lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(words, zero));
+      lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(words, zero));
+    }
+
+    std::uint32_t lane_values[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane_values), lanes);
+    sum += static_cast<std::uint64_t>(lane_values[0]) + lane_values[1] +
+           lane_values[2] + lane_values[3];
+  }
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+  for (; i < size; i += 2)
+  {
+    sum += static_cast<std::uint32_t>(data[i] | (data[i + 1] << 8));
+  }
+
+  return sum;
+}
+
+// Folds a sum of WORDs down to a 16-bit ones'-complement sum.
+inline DWORD FoldPeCheckSum(std::uint64_t sum) HADESMEM_DETAIL_NOEXCEPT
+{
+  while (sum >> 16)
+  {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  return static_cast<DWORD>(sum);
+}
+
+inline ALG_ID GetPeHashAlgorithmId(PeHashAlgorithm algorithm)
+{
+  switch (algorithm)
+  {
+  case PeHashAlgorithm::kMd5:
+    return CALG_MD5;
+  case PeHashAlgorithm::kSha1:
+    return CALG_SHA1;
+  case PeHashAlgorithm::kSha256:
+    return CALG_SHA_256;
+  }
+
+  HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                  << ErrorString{"Invalid hash algorithm."});
+}
+
+// The AES provider is the one with SHA-256.
+inline SmartCryptContextHandle AcquireHashProvider()
+{
+  HCRYPTPROV provider = 0;
+  if (!::CryptAcquireContextW(
+        &provider, nullptr, nullptr, PROV_RSA_AES, CRYPT_VERIFYCONTEXT))
+  {
+    DWORD const last_error = ::GetLastError();
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"CryptAcquireContext failed."}
+              << ErrorCodeWinLast{last_error});
+  }
+
+  return SmartCryptContextHandle{provider};
+}
+
+class CryptHash
+{
+public:
+  explicit CryptHash(HCRYPTPROV provider, ALG_ID algorithm)
+  {
+    HCRYPTHASH hash = 0;
+    if (!::CryptCreateHash(provider, algorithm, 0, 0, &hash))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"CryptCreateHash failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+    hash_ = hash;
+  }
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  CryptHash(CryptHash&& other) : hash_(std::move(other.hash_))
+  {
+  }
+
+  CryptHash& operator=(CryptHash&& other)
+  {
+    hash_ = std::move(other.hash_);
+
+    return *this;
+  }
+
+#else // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  CryptHash(CryptHash&&) = default;
+
+  CryptHash& operator=(CryptHash&&) = default;
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  void Update(void const* data, DWORD size)
+  {
+    if (!size)
+    {
+      return;
+    }
+
+    if (!::CryptHashData(
+          hash_.GetHandle(), static_cast<BYTE const*>(data), size, 0))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"CryptHashData failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+  }
+
+  // The hash can't be updated after this.
+  std::vector<BYTE> Finish()
+  {
+    DWORD size = 0;
+    if (!::CryptGetHashParam(hash_.GetHandle(), HP_HASHVAL, nullptr, &size, 0))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"CryptGetHashParam failed."}
+                << ErrorCodeWinLast{last_error});
+    }
+
+    std::vector<BYTE> digest(size);
+    if (!::CryptGetHashParam(
+          hash_.GetHandle(), HP_HASHVAL, digest.data(), &size, 0))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"CryptGetHashParam failed."}
+                << ErrorCodeWinLast{last_error});
+    }
+    digest.resize(size);
+
+    return digest;
+  }
+
+private:
+  SmartCryptHashHandle hash_;
+};
+
+struct PeDigestRange
+{
+  DWORD begin;
+  DWORD end;
+};
+
+// Hashes a list of ranges, in list order. If the ranges are in ascending
+// order and don't overlap (as in any sane file) they can be hashed as the
+// data streams past, otherwise they have to be read separately.
+class PeRangeHasher
+{
+public:
+  explicit PeRangeHasher(HCRYPTPROV provider,
+                         ALG_ID algorithm,
+                         std::vector<PeDigestRange> const& ranges)
+    : hash_{provider, algorithm}
+  {
+    streamable_ = true;
+    for (auto const& range : ranges)
+    {
+      if (range.begin == range.end)
+      {
+        continue;
+      }
+
+      if (!ranges_.empty() && range.begin < ranges_.back().end)
+      {
+        streamable_ = false;
+      }
+      ranges_.push_back(range);
+    }
+  }
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  PeRangeHasher(PeRangeHasher&& other)
+    : hash_(std::move(other.hash_)),
+      ranges_(std::move(other.ranges_)),
+      next_{other.next_},
+      streamable_{other.streamable_}
+  {
+  }
+
+  PeRangeHasher& operator=(PeRangeHasher&& other)
+  {
+    hash_ = std::move(other.hash_);
+    ranges_ = std::move(other.ranges_);
+    next_ = other.next_;
+    streamable_ = other.streamable_;
+
+    return *this;
+  }
+
+#else // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  PeRangeHasher(PeRangeHasher&&) = default;
+
+  PeRangeHasher& operator=(PeRangeHasher&&) = default;
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  bool IsStreamable() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return streamable_;
+  }
+
+  // End of the last range, i.e. how far the data needs to be streamed.
+  DWORD GetEnd() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    DWORD end = 0;
+    for (auto const& range : ranges_)
+    {
+      end = (std::max)(end, range.end);
+    }
+    return end;
+  }
+
+  bool Wants(DWORD begin, DWORD end) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return next_ < ranges_.size() && ranges_[next_].begin < end &&
+           begin < ranges_[next_].end;
+  }
+
+  // Hashes the parts of the next ranges which are in a chunk of the stream
+  // starting at offset. Only for streamable hashers, with the chunks passed
+  // in order.
+  void Update(DWORD offset, std::uint8_t const* data, DWORD size)
+  {
+    HADESMEM_DETAIL_ASSERT(streamable_);
+
+    DWORD const end = offset + size;
+    while (next_ < ranges_.size() && ranges_[next_].begin < end)
+    {
+      auto const& range = ranges_[next_];
+      DWORD const begin = (std::max)(range.begin, offset);
+      DWORD const stop = (std::min)(range.end, end);
+      if (begin < stop)
+      {
+        hash_.Update(data + (begin - offset), stop - begin);
+      }
+
+      if (range.end > end)
+      {
+        break;
+      }
+      ++next_;
+    }
+  }
+
+  // Hashes every range with a read of its own, for hashers which aren't
+  // streamable.
+  void UpdateFromReads(Process const& process,
+                       std::uint8_t* base,
+                       std::vector<std::uint8_t>& buf)
+  {
+    for (auto const& range : ranges_)
+    {
+      for (DWORD offset = range.begin; offset < range.end;)
+      {
+        DWORD const size = (std::min)(
+          static_cast<DWORD>(buf.size()), range.end - offset);
+        ReadImpl(process, base + offset, buf.data(), size);
+        hash_.Update(buf.data(), size);
+        offset += size;
+      }
+    }
+    next_ = ranges_.size();
+  }
+
+  std::vector<BYTE> Finish()
+  {
+    return hash_.Finish();
+  }
+
+private:
+  CryptHash hash_;
+  std::vector<PeDigestRange> ranges_;
+  std::size_t next_{0};
+  bool streamable_;
+};
+}
+
+// Computes any combination of a PE file's digests with a single pass over the
+// file, a chunk at a time, feeding each chunk to every digest which needs it:
+//   - The optional header checksum (as CheckSumMappedFile computes it), to
+//     compare with NtHeaders::GetCheckSum.
+//   - The import hash ("imphash"), i.e. the MD5 of the comma separated list
+//     of lowercase module.function imports (with .dll, .ocx and .sys dropped
+//     from module names, and imports by ordinal named ord<N>). Unlike some
+//     other implementations, ordinals aren't translated to names for any
+//     modules.
+//   - The hash of each section's data.
+//   - The image hash used by Authenticode, which covers the headers (except
+//     for the checksum and the certificate table's data directory entry), the
+//     sections in file order, and anything after them apart from the
+//     certificate table itself.
+//
+// Works on data files (e.g. a MappedFile) and on images (modules, including
+// in other processes, and image layout buffers from MapPeImage). For images
+// the checksum isn't computed (it covers the whole file, which isn't
+// mapped), and the image hash doesn't cover anything after the sections, so
+// it only matches the file's if there's nothing there but the certificates.
+// Section hashes cover as much of the section's raw data as the loader maps,
+// so those of an image can be compared with the file's to find modified
+// sections (bearing in mind relocations and import binding).
+class PeDigest
+{
+public:
+  explicit PeDigest(Process const& process,
+                    PeFile const& pe_file,
+                    std::uint32_t flags = PeDigestFlags::kAll,
+                    PeHashAlgorithm algorithm = PeHashAlgorithm::kSha256)
+  {
+    HADESMEM_DETAIL_ASSERT(
+      !(flags & ~(PeDigestFlags::kInvalidFlagMaxValue - 1UL)));
+
+    Compute(process, pe_file, flags, algorithm);
+  }
+
+  explicit PeDigest(Process&& process,
+                    PeFile const& pe_file,
+                    std::uint32_t flags = PeDigestFlags::kAll,
+                    PeHashAlgorithm algorithm = PeHashAlgorithm::kSha256) =
+    delete;
+
+  explicit PeDigest(Process const& process,
+                    PeFile&& pe_file,
+                    std::uint32_t flags = PeDigestFlags::kAll,
+                    PeHashAlgorithm algorithm = PeHashAlgorithm::kSha256) =
+    delete;
+
+  explicit PeDigest(Process&& process,
+                    PeFile&& pe_file,
+                    std::uint32_t flags = PeDigestFlags::kAll,
+                    PeHashAlgorithm algorithm = PeHashAlgorithm::kSha256) =
+    delete;
+
+  // Only set if the checksum was computed.
+  bool HasCheckSum() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return has_checksum_;
+  }
+
+  DWORD GetCheckSum() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return checksum_;
+  }
+
+  // Empty if it wasn't computed, or if there are no imports.
+  std::vector<BYTE> const& GetImportHash() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return import_hash_;
+  }
+
+  // In section table order, or empty if they weren't computed.
+  std::vector<std::vector<BYTE>> const& GetSectionHashes() const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return section_hashes_;
+  }
+
+  // Empty if it wasn't computed.
+  std::vector<BYTE> const& GetImageHash() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return image_hash_;
+  }
+
+private:
+  struct SectionData
+  {
+    // File offset for PeFileType::Data, RVA for PeFileType::Image.
+    DWORD begin;
+    DWORD pointer_to_raw_data;
+    DWORD size_of_raw_data;
+    // Amount of the raw data which is mapped.
+    DWORD mapped_size;
+  };
+
+  static DWORD ClampedEnd(DWORD begin, DWORD size, DWORD limit)
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    if (begin >= limit)
+    {
+      return limit;
+    }
+
+    return size > limit - begin ? limit : begin + size;
+  }
+
+  void Compute(Process const& process,
+               PeFile const& pe_file,
+               std::uint32_t flags,
+               PeHashAlgorithm algorithm)
+  {
+    if (flags & PeDigestFlags::kImportHash)
+    {
+      ComputeImportHash(process, pe_file);
+    }
+
+    bool const is_data = pe_file.GetType() == PeFileType::Data;
+    bool const do_checksum = is_data && !!(flags & PeDigestFlags::kCheckSum);
+    bool const do_sections = !!(flags & PeDigestFlags::kSectionHashes);
+    bool const do_image = !!(flags & PeDigestFlags::kImageHash);
+    if (!do_checksum && !do_sections && !do_image)
+    {
+      return;
+    }
+
+    NtHeaders const nt_headers{process, pe_file};
+    auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+    DWORD const size =
+      is_data ? pe_file.GetSize() : nt_headers.GetSizeOfImage();
+    auto const nt_headers_offset = static_cast<DWORD>(
+      static_cast<std::uint8_t*>(nt_headers.GetBase()) - base);
+
+    std::vector<SectionData> sections;
+    SectionList const section_list{process, pe_file};
+    for (auto const& section : section_list)
+    {
+      DWORD const raw_size = section.GetSizeOfRawData();
+      DWORD const virtual_size =
+        section.GetVirtualSize() ? section.GetVirtualSize() : raw_size;
+      SectionData const data = {
+        is_data ? section.GetPointerToRawData() : section.GetVirtualAddress(),
+        section.GetPointerToRawData(),
+        raw_size,
+        (std::min)(raw_size,
+                   detail::AlignUp(virtual_size,
+                                   nt_headers.GetSectionAlignment()))};
+      sections.push_back(data);
+    }
+
+    detail::SmartCryptContextHandle provider;
+    std::vector<detail::PeRangeHasher> hashers;
+    ALG_ID const algorithm_id = detail::GetPeHashAlgorithmId(algorithm);
+    if (do_sections || do_image)
+    {
+      provider = detail::AcquireHashProvider();
+    }
+
+    if (do_sections)
+    {
+      for (auto const& section : sections)
+      {
+        std::vector<detail::PeDigestRange> ranges;
+        detail::PeDigestRange const range = {
+          (std::min)(section.begin, size),
+          ClampedEnd(section.begin, section.mapped_size, size)};
+        ranges.push_back(range);
+        hashers.emplace_back(provider.GetHandle(), algorithm_id, ranges);
+      }
+    }
+
+    if (do_image)
+    {
+      hashers.emplace_back(
+        provider.GetHandle(),
+        algorithm_id,
+        GetImageHashRanges(
+          nt_headers, nt_headers_offset, sections, size, is_data));
+    }
+
+    std::uint64_t checksum_sum = 0;
+    DWORD const checksum_field_begin =
+      nt_headers_offset + offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
+      offsetof(IMAGE_OPTIONAL_HEADER, CheckSum);
+    DWORD const checksum_field_end = checksum_field_begin + sizeof(DWORD);
+
+    DWORD stream_end = do_checksum ? size : 0;
+    for (auto const& hasher : hashers)
+    {
+      if (hasher.IsStreamable())
+      {
+        stream_end = (std::max)(stream_end, hasher.GetEnd());
+      }
+    }
+
+    std::vector<std::uint8_t> buf(detail::kPeDigestChunkSize);
+    for (DWORD offset = 0; offset < stream_end;)
+    {
+      DWORD const chunk_size =
+        (std::min)(detail::kPeDigestChunkSize, stream_end - offset);
+      DWORD const chunk_end = offset + chunk_size;
+      bool const wanted =
+        do_checksum ||
+        std::any_of(std::begin(hashers),
+                    std::end(hashers),
+                    [&](detail::PeRangeHasher const& hasher)
+                    {
+          return hasher.IsStreamable() && hasher.Wants(offset, chunk_end);
+        });
+      if (!wanted)
+      {
+        offset = chunk_end;
+        continue;
+      }
+
+      detail::ReadImpl(process, base + offset, buf.data(), chunk_size);
+
+      for (auto& hasher : hashers)
+      {
+        if (hasher.IsStreamable())
+        {
+          hasher.Update(offset, buf.data(), chunk_size);
+        }
+      }
+
+      if (do_checksum)
+      {
+        // The checksum is computed as if its own field was zero. This is
+        // done last as it changes the chunk.
+        for (DWORD i = (std::max)(checksum_field_begin, offset);
+             i < (std::min)(checksum_field_end, chunk_end);
+             ++i)
+        {
+          buf[i - offset] = 0;
+        }
+
+        // Only the last chunk can be an odd size, in which case the last
+        // byte is summed as if it was followed by a zero.
+        DWORD const even_size = chunk_size & ~1UL;
+        checksum_sum += detail::SumPeCheckSumWords(buf.data(), even_size);
+        if (even_size != chunk_size)
+        {
+          checksum_sum += buf[even_size];
+        }
+      }
+
+      offset = chunk_end;
+    }
+
+    for (auto& hasher : hashers)
+    {
+      if (!hasher.IsStreamable())
+      {
+        hasher.UpdateFromReads(process, base, buf);
+      }
+    }
+
+    if (do_checksum)
+    {
+      checksum_ = detail::FoldPeCheckSum(checksum_sum) + size;
+      has_checksum_ = true;
+    }
+
+    auto hasher = std::begin(hashers);
+    if (do_sections)
+    {
+      for (std::size_t i = 0; i < sections.size(); ++i, ++hasher)
+      {
+        section_hashes_.emplace_back(hasher->Finish());
+      }
+    }
+
+    if (do_image)
+    {
+      image_hash_ = hasher->Finish();
+    }
+  }
+
+  std::vector<detail::PeDigestRange>
+    GetImageHashRanges(NtHeaders const& nt_headers,
+                       DWORD nt_headers_offset,
+                       std::vector<SectionData> const& sections,
+                       DWORD size,
+                       bool is_data) const
+  {
+    DWORD const checksum_begin =
+      nt_headers_offset + offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
+      offsetof(IMAGE_OPTIONAL_HEADER, CheckSum);
+    DWORD const headers_end =
+      (std::min)(nt_headers.GetSizeOfHeaders(), size);
+
+    std::vector<detail::PeDigestRange> ranges;
+    auto const add_range = [&](DWORD begin, DWORD end)
+    {
+      begin = (std::min)(begin, headers_end);
+      end = (std::max)(begin, (std::min)(end, headers_end));
+      detail::PeDigestRange const range = {begin, end};
+      ranges.push_back(range);
+    };
+
+    // The certificate table's directory entry is only skipped if it exists.
+    bool const has_security_entry =
+      nt_headers.GetNumberOfRvaAndSizes() > IMAGE_DIRECTORY_ENTRY_SECURITY;
+    DWORD const security_entry_begin =
+      nt_headers_offset + offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
+      offsetof(IMAGE_OPTIONAL_HEADER, DataDirectory) +
+      IMAGE_DIRECTORY_ENTRY_SECURITY * sizeof(IMAGE_DATA_DIRECTORY);
+    add_range(0, checksum_begin);
+    if (has_security_entry)
+    {
+      add_range(checksum_begin + sizeof(DWORD), security_entry_begin);
+      add_range(security_entry_begin + sizeof(IMAGE_DATA_DIRECTORY),
+                headers_end);
+    }
+    else
+    {
+      add_range(checksum_begin + sizeof(DWORD), headers_end);
+    }
+
+    std::vector<SectionData> sorted_sections;
+    std::copy_if(std::begin(sections),
+                 std::end(sections),
+                 std::back_inserter(sorted_sections),
+                 [](SectionData const& section)
+                 {
+      return section.size_of_raw_data != 0;
+    });
+    std::stable_sort(std::begin(sorted_sections),
+                     std::end(sorted_sections),
+                     [](SectionData const& lhs, SectionData const& rhs)
+                     {
+      return lhs.pointer_to_raw_data < rhs.pointer_to_raw_data;
+    });
+
+    // The whole of the raw data is hashed for files, but only what's mapped
+    // is available in images.
+    DWORD sum_of_bytes_hashed = nt_headers.GetSizeOfHeaders();
+    for (auto const& section : sorted_sections)
+    {
+      DWORD const section_size =
+        is_data ? section.size_of_raw_data : section.mapped_size;
+      detail::PeDigestRange const range = {
+        (std::min)(section.begin, size),
+        ClampedEnd(section.begin, section_size, size)};
+      ranges.push_back(range);
+      sum_of_bytes_hashed += range.end - range.begin;
+    }
+
+    if (is_data)
+    {
+      DWORD const certificates_size =
+        has_security_entry
+          ? nt_headers.GetDataDirectorySize(PeDataDir::Security)
+          : 0;
+      if (certificates_size < size &&
+          sum_of_bytes_hashed < size - certificates_size)
+      {
+        detail::PeDigestRange const range = {sum_of_bytes_hashed,
+                                             size - certificates_size};
+        ranges.push_back(range);
+      }
+    }
+
+    return ranges;
+  }
+
+  void ComputeImportHash(Process const& process, PeFile const& pe_file)
+  {
+    ImportTable const import_table{process, pe_file};
+    std::string imports;
+    for (auto const& descriptor : import_table.GetDescriptors())
+    {
+      std::string module_name;
+      if (descriptor.has_name)
+      {
+        module_name.assign(descriptor.name.begin(), descriptor.name.end());
+      }
+      std::transform(std::begin(module_name),
+                     std::end(module_name),
+                     std::begin(module_name),
+                     [](char c)
+                     {
+        return static_cast<char>(
+          std::tolower(static_cast<unsigned char>(c)));
+      });
+
+      auto const dot = module_name.rfind('.');
+      if (dot != std::string::npos)
+      {
+        std::string const extension = module_name.substr(dot + 1);
+        if (extension == "dll" || extension == "ocx" || extension == "sys")
+        {
+          module_name.erase(dot);
+        }
+      }
+
+      for (auto thunk = import_table.GetThunksBegin(descriptor);
+           thunk != import_table.GetThunksEnd(descriptor);
+           ++thunk)
+      {
+        std::string function_name;
+        if (thunk->by_ordinal)
+        {
+          function_name = "ord" + std::to_string(thunk->ordinal);
+        }
+        else if (thunk->has_name)
+        {
+          function_name.assign(thunk->name.begin(), thunk->name.end());
+        }
+        else
+        {
+          continue;
+        }
+
+        if (!imports.empty())
+        {
+          imports.push_back(',');
+        }
+        imports += module_name;
+        imports.push_back('.');
+        for (auto const c : function_name)
+        {
+          imports.push_back(
+            static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        }
+      }
+    }
+
+    if (imports.empty())
+    {
+      return;
+    }
+
+    auto const provider = detail::AcquireHashProvider();
+    detail::CryptHash hash{provider.GetHandle(), CALG_MD5};
+    hash.Update(imports.data(), static_cast<DWORD>(imports.size()));
+    import_hash_ = hash.Finish();
+  }
+
+  bool has_checksum_{false};
+  DWORD checksum_{0};
+  std::vector<BYTE> import_hash_;
+  std::vector<std::vector<BYTE>> section_hashes_;
+  std::vector<BYTE> image_hash_;
+};
+}
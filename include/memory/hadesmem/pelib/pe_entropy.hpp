@@ -0,0 +1,346 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/map_pe_image.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+// After config.hpp, which decides whether this is needed.
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+#include <emmintrin.h>
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+namespace hadesmem
+{
+namespace detail
+{
+// Amount of a PE file read (and counted) in one go, when it can't be
+// counted in place.
+DWORD const kPeEntropyChunkSize = 0x10000;
+
+DWORD const kPeEntropyPageSize = 0x1000;
+
+// Byte frequencies for Shannon entropy. Bytes are counted 16 at a time into
+// four tables in turn, so a run of the same byte doesn't serialize on the
+// one counter. Blocks of a single repeated byte (padding, zero fill) are
+// common enough in PE files to be checked for with SSE2 and counted at once.
+class ByteHistogram
+{
+public:
+  ByteHistogram() HADESMEM_DETAIL_NOEXCEPT : total_{0}
+  {
+    std::memset(counts_, 0, sizeof(counts_));
+  }
+
+  void Update(std::uint8_t const* data, std::size_t size)
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    // Each count is 32 bits, which is plenty for anything in a PE file.
+    HADESMEM_DETAIL_ASSERT(size <= 0xFFFFFFFFULL - total_);
+    total_ += size;
+
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+      __m128i const block =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+      __m128i const first = _mm_set1_epi8(static_cast<char>(data[i]));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, first)) == 0xFFFF)
+      {
+        counts_[0][data[i]] += 16;
+        continue;
+      }
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+      std::uint64_t lo = 0;
+      std::uint64_t hi = 0;
+      std::memcpy(&lo, data + i, sizeof(lo));
+      std::memcpy(&hi, data + i + sizeof(lo), sizeof(hi));
+      CountBytes(lo);
+      CountBytes(hi);
+    }
+
+    for (; i < size; ++i)
+    {
+      ++counts_[i & 3][data[i]];
+    }
+  }
+
+  std::uint64_t GetCount(std::uint8_t value) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return static_cast<std::uint64_t>(counts_[0][value]) + counts_[1][value] +
+           counts_[2][value] + counts_[3][value];
+  }
+
+  std::uint64_t GetTotal() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return total_;
+  }
+
+  // In bits per byte, from 0 (one value repeated) to 8 (uniformly random).
+  double GetEntropy() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    if (!total_)
+    {
+      return 0.0;
+    }
+
+    // -sum(p * log2(p)) with p = count / total, rearranged so there's only
+    // one division.
+    double sum = 0.0;
+    for (std::size_t i = 0; i < 256; ++i)
+    {
+      auto const count =
+        static_cast<double>(GetCount(static_cast<std::uint8_t>(i)));
+      if (count != 0.0)
+      {
+        sum += count * std::log2(count);
+      }
+    }
+
+    auto const total = static_cast<double>(total_);
+    double const entropy = std::log2(total) - sum / total;
+    return (std::min)((std::max)(entropy, 0.0), 8.0);
+  }
+
+private:
+  void CountBytes(std::uint64_t value) HADESMEM_DETAIL_NOEXCEPT
+  {
+    ++counts_[0][value & 0xFF];
+    ++counts_[1][(value >> 8) & 0xFF];
+    ++counts_[2][(value >> 16) & 0xFF];
+    ++counts_[3][(value >> 24) & 0xFF];
+    ++counts_[0][(value >> 32) & 0xFF];
+    ++counts_[1][(value >> 40) & 0xFF];
+    ++counts_[2][(value >> 48) & 0xFF];
+    ++counts_[3][value >> 56];
+  }
+
+  std::uint32_t counts_[4][256];
+  std::uint64_t total_;
+};
+}
+
+// Shannon entropy (in bits per byte) of the raw data of each section, and of
+// the overlay (data appended after the last section) for data files. Works
+// on data files and on images (including modules in other processes), in
+// which case the raw data is taken as it's mapped and memory which can't be
+// read is left out.
+//
+// Data files in this process (e.g. a MappedFile) are counted in place.
+// Otherwise the file is read a chunk at a time, so this never needs a copy
+// of the whole file (or image).
+class PeEntropy
+{
+public:
+  explicit PeEntropy(Process const& process, PeFile const& pe_file)
+    : section_entropy_(),
+      overlay_offset_(0),
+      overlay_size_(0),
+      overlay_entropy_(0.0)
+  {
+    Compute(process, pe_file);
+  }
+
+  explicit PeEntropy(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit PeEntropy(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit PeEntropy(Process&& process, PeFile&& pe_file) = delete;
+
+  // One for each section, in section table order. Sections with no raw data
+  // have an entropy of zero.
+  std::vector<double> const& GetSectionEntropy() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return section_entropy_;
+  }
+
+  // Only data files have an overlay. An Authenticode signature at the end of
+  // the file isn't counted as part of it.
+  bool HasOverlay() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return overlay_size_ != 0;
+  }
+
+  DWORD GetOverlayOffset() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return overlay_offset_;
+  }
+
+  DWORD GetOverlaySize() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return overlay_size_;
+  }
+
+  double GetOverlayEntropy() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return overlay_entropy_;
+  }
+
+private:
+  class RangeCounter
+  {
+  public:
+    RangeCounter(Process const& process, PeFile const& pe_file)
+      : process_(&process),
+        base_(static_cast<std::uint8_t*>(pe_file.GetBase())),
+        in_place_(pe_file.GetType() == PeFileType::Data &&
+                  process.GetId() == ::GetCurrentProcessId()),
+        buf_()
+    {
+    }
+
+    double GetEntropy(DWORD begin, DWORD end)
+    {
+      detail::ByteHistogram histogram;
+      if (in_place_)
+      {
+        histogram.Update(base_ + begin, end - begin);
+        return histogram.GetEntropy();
+      }
+
+      buf_.resize(detail::kPeEntropyChunkSize);
+      for (DWORD offset = begin; offset < end;)
+      {
+        DWORD const chunk_size =
+          (std::min)(detail::kPeEntropyChunkSize, end - offset);
+        if (!Count(histogram, offset, chunk_size))
+        {
+          // Some of it might be readable, so fall back to single pages.
+          for (DWORD page = offset; page < offset + chunk_size;)
+          {
+            DWORD const page_size = (std::min)(detail::kPeEntropyPageSize,
+                                               offset + chunk_size - page);
+            Count(histogram, page, page_size);
+            page += page_size;
+          }
+        }
+        offset += chunk_size;
+      }
+
+      return histogram.GetEntropy();
+    }
+
+  private:
+    bool Count(detail::ByteHistogram& histogram, DWORD offset, DWORD size)
+    {
+      if (!detail::TryReadUnchecked(
+            *process_, base_ + offset, buf_.data(), size))
+      {
+        return false;
+      }
+
+      histogram.Update(buf_.data(), size);
+      return true;
+    }
+
+    Process const* process_;
+    std::uint8_t* base_;
+    bool in_place_;
+    std::vector<std::uint8_t> buf_;
+  };
+
+  static DWORD ClampedEnd(DWORD begin, DWORD size, DWORD limit)
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    if (begin >= limit)
+    {
+      return limit;
+    }
+
+    return size > limit - begin ? limit : begin + size;
+  }
+
+  void Compute(Process const& process, PeFile const& pe_file)
+  {
+    bool const is_data = pe_file.GetType() == PeFileType::Data;
+    NtHeaders const nt_headers{process, pe_file};
+    DWORD const size =
+      is_data ? pe_file.GetSize() : nt_headers.GetSizeOfImage();
+    RangeCounter counter{process, pe_file};
+
+    // Anything in the headers isn't overlay, even if there are no sections.
+    DWORD raw_end = (std::min)(nt_headers.GetSizeOfHeaders(), size);
+    SectionList const sections{process, pe_file};
+    for (auto const& section : sections)
+    {
+      // The same amount of raw data for both layouts, so that a file and
+      // its image give the same results.
+      DWORD const raw_size = section.GetSizeOfRawData();
+      DWORD const virtual_size =
+        section.GetVirtualSize() ? section.GetVirtualSize() : raw_size;
+      DWORD const mapped_size = (std::min)(
+        raw_size,
+        detail::AlignUp(virtual_size, nt_headers.GetSectionAlignment()));
+      // PointerToRawData is rounded down to 0x200, as RvaToVa and
+      // MapPeImage do.
+      DWORD const pointer_to_raw_data =
+        static_cast<DWORD>(section.GetPointerToRawData() & ~0x1FFUL);
+      DWORD const begin = (std::min)(
+        is_data ? pointer_to_raw_data : section.GetVirtualAddress(), size);
+      DWORD const end = ClampedEnd(begin, mapped_size, size);
+      section_entropy_.push_back(counter.GetEntropy(begin, end));
+
+      if (is_data)
+      {
+        raw_end = (std::max)(
+          raw_end, ClampedEnd(pointer_to_raw_data, raw_size, size));
+      }
+    }
+
+    if (!is_data)
+    {
+      return;
+    }
+
+    // For data files the security directory holds a file offset rather than
+    // an RVA.
+    DWORD overlay_end = size;
+    if (static_cast<DWORD>(PeDataDir::Security) <
+        nt_headers.GetNumberOfRvaAndSizesClamped())
+    {
+      DWORD const cert_offset =
+        nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Security);
+      DWORD const cert_size =
+        nt_headers.GetDataDirectorySize(PeDataDir::Security);
+      if (cert_offset >= raw_end && cert_size &&
+          ClampedEnd(cert_offset, cert_size, size) == size)
+      {
+        overlay_end = cert_offset;
+      }
+    }
+
+    if (raw_end < overlay_end)
+    {
+      overlay_offset_ = raw_end;
+      overlay_size_ = overlay_end - raw_end;
+      overlay_entropy_ = counter.GetEntropy(raw_end, overlay_end);
+    }
+  }
+
+  std::vector<double> section_entropy_;
+  DWORD overlay_offset_;
+  DWORD overlay_size_;
+  double overlay_entropy_;
+};
+}
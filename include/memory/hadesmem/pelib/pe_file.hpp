@@ -3,20 +3,30 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <iosfwd>
 #include <memory>
 #include <ostream>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <windows.h>
 #include <winnt.h>
 
 #include <hadesmem/config.hpp>
 #include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/detail/optional.hpp>
+#include <hadesmem/detail/pe_image_data.hpp>
+#include <hadesmem/detail/read_impl.hpp>
 #include <hadesmem/detail/region_alloc_size.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/detail/type_traits.hpp>
 #include <hadesmem/error.hpp>
+#include <hadesmem/expected.hpp>
 #include <hadesmem/module.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/region.hpp>
@@ -88,11 +98,24 @@ public:
     return size_;
   }
 
+  // Headers parsed up front by PeImage, or nullptr for a plain PeFile.
+  detail::PeImageData const* GetImageData() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return image_data_.get();
+  }
+
+protected:
+  void SetImageData(std::shared_ptr<detail::PeImageData const> const& data)
+  {
+    image_data_ = data;
+  }
+
 private:
   Process const* process_;
   PBYTE base_;
   PeFileType type_;
   DWORD size_;
+  std::shared_ptr<detail::PeImageData const> image_data_;
 };
 
 inline bool operator==(PeFile const& lhs,
@@ -147,32 +170,106 @@ inline std::wostream& operator<<(std::wostream& lhs, PeFile const& rhs)
   return lhs;
 }
 
-inline PVOID RvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
+namespace detail
+{
+inline Error MakeReadError()
+{
+  DWORD const last_error = ::GetLastError();
+  return Error{} << ErrorString{"ReadProcessMemory failed."}
+                 << ErrorCodeWinLast{last_error};
+}
+
+// Reads from a PE file without throwing where possible. Nothing in a data
+// file is protected, so a failed read there is simply out of bounds and is
+// reported as such. Images fall back to a normal read (which changes
+// protection if needed) once the fast read has failed. Returns the error, if
+// any.
+inline Optional<Error> TryReadPeImpl(Process const& process,
+                                     PeFile const& pe_file,
+                                     void* address,
+                                     void* data,
+                                     std::size_t len)
+{
+  if (TryReadUnchecked(process, address, data, len))
+  {
+    return {};
+  }
+
+  if (pe_file.GetType() == PeFileType::Data)
+  {
+    return Optional<Error>{MakeReadError()};
+  }
+
+  try
+  {
+    ReadImpl(process, address, data, len);
+    return {};
+  }
+  catch (Error const& e)
+  {
+    return Optional<Error>{e};
+  }
+}
+
+template <typename T>
+Expected<T>
+  TryReadPe(Process const& process, PeFile const& pe_file, void* address)
+{
+  HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<T>::value);
+
+  T data = T{};
+  if (auto const error =
+        TryReadPeImpl(process, pe_file, address, &data, sizeof(data)))
+  {
+    return *error;
+  }
+
+  return data;
+}
+}
+
+// Same as RvaToVa, but reports an invalid file (or one that can't be read)
+// through the result rather than throwing.
+inline Expected<PVOID>
+  TryRvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
 {
   PeFileType const type = pe_file.GetType();
   PBYTE base = static_cast<PBYTE>(pe_file.GetBase());
 
   if (type == PeFileType::Data)
   {
+    if (auto const image_data = pe_file.GetImageData())
+    {
+      return detail::PeImageDataRvaToVa(*image_data, base, rva);
+    }
+
     if (!rva)
     {
       return nullptr;
     }
 
-    IMAGE_DOS_HEADER dos_header = Read<IMAGE_DOS_HEADER>(process, base);
-    if (dos_header.e_magic != IMAGE_DOS_SIGNATURE)
+    auto const dos_header =
+      detail::TryReadPe<IMAGE_DOS_HEADER>(process, pe_file, base);
+    if (!dos_header)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Invalid DOS header."});
+      return dos_header.GetError();
+    }
+    if (dos_header->e_magic != IMAGE_DOS_SIGNATURE)
+    {
+      return Error{} << ErrorString{"Invalid DOS header."};
     }
 
-    BYTE* ptr_nt_headers = base + dos_header.e_lfanew;
-    IMAGE_NT_HEADERS nt_headers =
-      Read<IMAGE_NT_HEADERS>(process, ptr_nt_headers);
+    BYTE* ptr_nt_headers = base + dos_header->e_lfanew;
+    auto const nt_headers_read =
+      detail::TryReadPe<IMAGE_NT_HEADERS>(process, pe_file, ptr_nt_headers);
+    if (!nt_headers_read)
+    {
+      return nt_headers_read.GetError();
+    }
+    IMAGE_NT_HEADERS const& nt_headers = *nt_headers_read;
     if (nt_headers.Signature != IMAGE_NT_SIGNATURE)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Invalid NT headers."});
+      return Error{} << ErrorString{"Invalid NT headers."};
     }
 
     // Windows will load specially crafted images with no sections.
@@ -219,7 +316,7 @@ inline PVOID RvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
       return nullptr;
     }
 
-    auto ptr_section_header = reinterpret_cast<PIMAGE_SECTION_HEADER>(
+    auto const ptr_section_header = reinterpret_cast<PIMAGE_SECTION_HEADER>(
       ptr_nt_headers + offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
       nt_headers.FileHeader.SizeOfOptionalHeader);
     void const* const file_end =
@@ -237,19 +334,36 @@ inline PVOID RvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
       }
     }
 
+    // Everything up to the first virtual section header is read in one go.
+    std::size_t const num_real_sections = (std::min)(
+      static_cast<std::size_t>(num_sections),
+      static_cast<std::size_t>(
+        static_cast<std::uint8_t const*>(file_end) -
+        reinterpret_cast<std::uint8_t const*>(ptr_section_header)) /
+        sizeof(IMAGE_SECTION_HEADER));
+    std::vector<IMAGE_SECTION_HEADER> section_headers(num_real_sections);
+    if (auto const error = detail::TryReadPeImpl(
+          process,
+          pe_file,
+          ptr_section_header,
+          section_headers.data(),
+          section_headers.size() * sizeof(IMAGE_SECTION_HEADER)))
+    {
+      return *error;
+    }
+
     bool in_header = true;
     for (WORD i = 0; i < num_sections; ++i)
     {
       // For a virtual section header, simply return nullptr. (Similar to above,
       // except this time only the Nth entry onwards is virtual, rather than all
       // the headers.)
-      if (ptr_section_header + 1 > file_end)
+      if (i >= num_real_sections)
       {
         return nullptr;
       }
 
-      auto const section_header =
-        Read<IMAGE_SECTION_HEADER>(process, ptr_section_header);
+      auto const& section_header = section_headers[i];
 
       DWORD const virtual_beg = section_header.VirtualAddress;
       DWORD const virtual_size = section_header.Misc.VirtualSize;
@@ -266,8 +380,8 @@ inline PVOID RvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
         // invalid. Technically files like this will work when loaded by the
         // PE loader due to the sections being mapped differention in memory
         // to on disk, but if you want to inspect the file in that manner you
-        // should just use LoadLibrary with the appropriate flags for your
-        // scenario and then use PeFileType::Image.
+        // should map it with MapPeImage (or LoadLibrary it) and then use
+        // PeFileType::Image.
         if (rva > raw_size)
         {
           return nullptr;
@@ -296,8 +410,6 @@ inline PVOID RvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
       {
         in_header = false;
       }
-
-      ++ptr_section_header;
     }
 
     // Doing the same thing as in the SizeOfHeaders check above because we're
@@ -334,40 +446,105 @@ inline PVOID RvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
   }
   else
   {
-    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                    << ErrorString{"Unhandled file type."});
+    return Error{} << ErrorString{"Unhandled file type."};
   }
 }
 
+inline PVOID RvaToVa(Process const& process, PeFile const& pe_file, DWORD rva)
+{
+  return TryRvaToVa(process, pe_file, rva).Get();
+}
+
 namespace detail
 {
+// Strings are read a page at a time so that one which ends just before
+// unreadable memory is still found without going through the (throwing)
+// region walk in ReadString.
+std::size_t const kCheckedReadStringPageSize = 0x1000;
+
+// Same as CheckedReadString, but reports an invalid VA (or one that can't be
+// read) through the result rather than throwing.
 template <typename CharT>
-std::basic_string<CharT> CheckedReadString(Process const& process,
-                                           PeFile const& pe_file,
-                                           void* address)
+Expected<std::basic_string<CharT>> TryCheckedReadString(
+  Process const& process, PeFile const& pe_file, void* address)
 {
-  if (pe_file.GetType() == PeFileType::Image)
-  {
-    return ReadString<CharT>(process, address);
-  }
-  else if (pe_file.GetType() == PeFileType::Data)
+  std::uint8_t* upper_bound = nullptr;
+  if (pe_file.GetType() == PeFileType::Data)
   {
-    void* const file_end =
+    upper_bound =
       static_cast<std::uint8_t*>(pe_file.GetBase()) + pe_file.GetSize();
-    if (address >= file_end)
+    if (address >= upper_bound)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{} << ErrorString{"Invalid VA."});
+      return Error{} << ErrorString{"Invalid VA."};
     }
-    // Handle EOF termination.
-    // Sample: maxsecXP.exe (Corkami PE Corpus)
-    return ReadStringBounded<CharT>(process, address, file_end);
   }
-  else
+  else if (pe_file.GetType() != PeFileType::Image)
   {
     HADESMEM_DETAIL_ASSERT(false);
-    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                    << ErrorString{"Unknown PE file type."});
+    return Error{} << ErrorString{"Unknown PE file type."};
   }
+
+  std::basic_string<CharT> str;
+  std::vector<CharT> buf(kCheckedReadStringPageSize / sizeof(CharT));
+  auto cur = static_cast<std::uint8_t*>(address);
+  for (;;)
+  {
+    // Handle EOF termination.
+    // Sample: maxsecXP.exe (Corkami PE Corpus)
+    if (upper_bound &&
+        static_cast<std::size_t>(upper_bound - cur) < sizeof(CharT))
+    {
+      return str;
+    }
+
+    auto page_end = reinterpret_cast<std::uint8_t*>(
+      (reinterpret_cast<std::uintptr_t>(cur) + kCheckedReadStringPageSize) &
+      ~(kCheckedReadStringPageSize - 1));
+    if (upper_bound)
+    {
+      page_end = (std::min)(page_end, upper_bound);
+    }
+    // A character which straddles the end of the page is read on its own.
+    std::size_t const len = (std::max)(
+      static_cast<std::size_t>(page_end - cur) / sizeof(CharT),
+      static_cast<std::size_t>(1));
+
+    if (!TryReadUnchecked(process, cur, buf.data(), len * sizeof(CharT)))
+    {
+      if (pe_file.GetType() == PeFileType::Data)
+      {
+        return MakeReadError();
+      }
+
+      try
+      {
+        str += ReadString<CharT>(process, cur);
+        return str;
+      }
+      catch (Error const& e)
+      {
+        return e;
+      }
+    }
+
+    auto const buf_end = std::begin(buf) + len;
+    auto const iter = std::find(std::begin(buf), buf_end, CharT());
+    str.append(std::begin(buf), iter);
+    if (iter != buf_end)
+    {
+      return str;
+    }
+
+    cur += len * sizeof(CharT);
+  }
+}
+
+template <typename CharT>
+std::basic_string<CharT> CheckedReadString(Process const& process,
+                                           PeFile const& pe_file,
+                                           void* address)
+{
+  return TryCheckedReadString<CharT>(process, pe_file, address).Get();
 }
 }
 }
@@ -0,0 +1,65 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/pe_image_data.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// A PeFile whose DOS header, NT headers and section table are read and
+// validated once, at construction. RvaToVa on a PeImage of type
+// PeFileType::Data is a binary search over a precomputed RVA to file offset
+// map (no memory is read), and DosHeader, NtHeaders and Section are
+// initialized from the cached copies rather than re-reading the target.
+//
+// Can be passed anywhere a PeFile is expected. The cache is not updated by
+// UpdateWrite etc., so construct a new PeImage after modifying the headers.
+class PeImage : public PeFile
+{
+public:
+  explicit PeImage(Process const& process,
+                   void* address,
+                   PeFileType type,
+                   DWORD size)
+    : PeFile(process, address, type, size)
+  {
+    SetImageData(std::make_shared<detail::PeImageData const>(
+      detail::ParsePeImageData(process,
+                               static_cast<PBYTE>(GetBase()),
+                               type == PeFileType::Data,
+                               GetSize())));
+  }
+
+  explicit PeImage(Process&& process,
+                   void* address,
+                   PeFileType type,
+                   DWORD size) = delete;
+
+  IMAGE_DOS_HEADER const& GetDosHeaderData() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return GetImageData()->dos_header;
+  }
+
+  IMAGE_NT_HEADERS const& GetNtHeadersData() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return GetImageData()->nt_headers;
+  }
+
+  // For data files this only includes the headers which lie within the file.
+  std::vector<IMAGE_SECTION_HEADER> const& GetSectionHeaders() const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return GetImageData()->section_headers;
+  }
+};
+}
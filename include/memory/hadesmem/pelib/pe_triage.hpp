@@ -0,0 +1,437 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// Why triage stopped, i.e. the first check which failed. Fields of the record
+// are filled in as far as they were validated.
+enum class PeTriageStatus : DWORD
+{
+  kValid,
+  // Not enough of the file was given to get to the end of the section table.
+  // PeTriageRecord::headers_end is how much is needed to get further.
+  kIncomplete,
+  // The headers couldn't be read at all (only from TriagePeFile).
+  kUnreadable,
+  kInvalidDosHeader,
+  // e_lfanew is out of range, or there's no PE signature.
+  kInvalidNtHeaders,
+  kInvalidFileHeader,
+  kInvalidOptionalHeader,
+  // The file couldn't be opened (only from callers which open files
+  // themselves). Nothing but file_size, which is zero, is filled in.
+  kOpenFailed
+};
+
+// Oddities which neither pelib nor the loader reject, but which are worth
+// knowing about (they're common in packed and malicious files). Set in
+// PeTriageRecord::flags.
+struct PeTriageFlags
+{
+  enum : DWORD
+  {
+    kNone = 0,
+    // Some or all of the section table is past the end of the file, and is
+    // taken to be zero (see SectionTable::IsVirtual). Only the sections in
+    // the file are checked.
+    kVirtualSectionTable = 1 << 0,
+    kSectionsOutOfOrder = 1 << 1,
+    kSectionsOverlap = 1 << 2,
+    // A section ends past SizeOfImage.
+    kSectionPastImage = 1 << 3,
+    // A section's raw data is (partly) past the end of the file.
+    kRawDataPastEof = 1 << 4
+  };
+};
+
+// Everything triage extracts from a file. The layout is fixed (and has no
+// padding) so that records can be written out and read back as-is. Both
+// PE32 and PE32+ files are handled, whatever the architecture of the caller.
+struct PeTriageRecord
+{
+  std::uint64_t file_size;
+  std::uint64_t image_base;
+  PeTriageStatus status;
+  DWORD nt_headers_offset;
+  // End of the section table (as far as is known).
+  DWORD headers_end;
+  DWORD time_date_stamp;
+  DWORD address_of_entry_point;
+  DWORD size_of_image;
+  DWORD size_of_headers;
+  DWORD size_of_code;
+  DWORD size_of_initialized_data;
+  DWORD size_of_uninitialized_data;
+  DWORD section_alignment;
+  DWORD file_alignment;
+  DWORD checksum;
+  // Bit n is set if data directory n exists and has a non-zero address and
+  // size.
+  DWORD data_directories;
+  // PeTriageFlags.
+  DWORD flags;
+  // Always zero. Keeps the layout free of padding.
+  DWORD reserved;
+  WORD machine;
+  WORD characteristics;
+  WORD magic;
+  WORD subsystem;
+  WORD dll_characteristics;
+  WORD number_of_sections;
+  WORD major_subsystem_version;
+  BYTE major_linker_version;
+  BYTE minor_linker_version;
+};
+
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(PeTriageRecord) == 96);
+
+namespace detail
+{
+std::size_t const kPeTriagePageSize = 0x1000;
+
+// TriagePeFile won't read more than this, so malformed files can't make it
+// read much of the file. Real headers are nowhere near this big.
+std::size_t const kPeTriageMaxHeadersSize = 0x10000;
+
+// Copies a T out of the buffer, unless it's (partly) past the end.
+template <typename T>
+bool TriageRead(std::uint8_t const* data,
+                std::size_t size,
+                std::uint64_t offset,
+                T& value,
+                std::size_t len = sizeof(T)) HADESMEM_DETAIL_NOEXCEPT
+{
+  if (offset > size || len > size - offset)
+  {
+    return false;
+  }
+
+  std::memcpy(&value, data + offset, len);
+  return true;
+}
+
+inline bool IsPowerOfTwo(DWORD value) HADESMEM_DETAIL_NOEXCEPT
+{
+  return value && !(value & (value - 1));
+}
+
+template <typename OptionalHeaderT>
+void TriageOptionalHeader(OptionalHeaderT const& optional_header,
+                          DWORD num_data_dirs,
+                          PeTriageRecord& record) HADESMEM_DETAIL_NOEXCEPT
+{
+  record.image_base = optional_header.ImageBase;
+  record.address_of_entry_point = optional_header.AddressOfEntryPoint;
+  record.size_of_image = optional_header.SizeOfImage;
+  record.size_of_headers = optional_header.SizeOfHeaders;
+  record.size_of_code = optional_header.SizeOfCode;
+  record.size_of_initialized_data = optional_header.SizeOfInitializedData;
+  record.size_of_uninitialized_data = optional_header.SizeOfUninitializedData;
+  record.section_alignment = optional_header.SectionAlignment;
+  record.file_alignment = optional_header.FileAlignment;
+  record.checksum = optional_header.CheckSum;
+  record.subsystem = optional_header.Subsystem;
+  record.dll_characteristics = optional_header.DllCharacteristics;
+  record.major_subsystem_version = optional_header.MajorSubsystemVersion;
+  record.major_linker_version = optional_header.MajorLinkerVersion;
+  record.minor_linker_version = optional_header.MinorLinkerVersion;
+
+  num_data_dirs = (std::min)(
+    (std::min)(num_data_dirs, optional_header.NumberOfRvaAndSizes),
+    static_cast<DWORD>(IMAGE_NUMBEROF_DIRECTORY_ENTRIES));
+  for (DWORD i = 0; i < num_data_dirs; ++i)
+  {
+    auto const& data_dir = optional_header.DataDirectory[i];
+    if (data_dir.VirtualAddress && data_dir.Size)
+    {
+      record.data_directories |= 1UL << i;
+    }
+  }
+}
+
+inline PeTriageStatus TriageStatus(PeTriageRecord& record,
+                                   PeTriageStatus status)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  record.status = status;
+  return status;
+}
+
+// Fails with kIncomplete if the range is in the file but not the buffer.
+inline PeTriageStatus TriageMissing(PeTriageRecord& record,
+                                    std::uint64_t end,
+                                    PeTriageStatus status)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  if (end <= record.file_size)
+  {
+    record.headers_end =
+      static_cast<DWORD>((std::max)(std::uint64_t{record.headers_end}, end));
+    return TriageStatus(record, PeTriageStatus::kIncomplete);
+  }
+
+  return TriageStatus(record, status);
+}
+}
+
+// Validates the headers of a PE file of either architecture, and fills in a
+// record with the fields needed to decide what to do with the file. Only the
+// DOS header, NT headers and the section table are looked at, so this only
+// needs the start of the file (normally less than a page). The data is
+// given as a buffer holding the first size bytes of a file of file_size
+// bytes. If the headers go past the end of the buffer the result is
+// kIncomplete and record.headers_end says how much of the file is needed.
+//
+// Only things which pelib rejects (or can't make sense of) fail. Anything else
+// odd about the section table is reported in record.flags. Data directories
+// are only checked for presence. Nothing here throws or allocates, so it's
+// safe to use on anything.
+inline PeTriageStatus TriagePeHeaders(void const* data,
+                                      std::size_t size,
+                                      std::uint64_t file_size,
+                                      PeTriageRecord& record)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  std::memset(&record, 0, sizeof(record));
+  record.file_size = file_size;
+  size = static_cast<std::size_t>(
+    (std::min)(static_cast<std::uint64_t>(size), file_size));
+  auto const bytes = static_cast<std::uint8_t const*>(data);
+
+  IMAGE_DOS_HEADER dos_header;
+  if (!detail::TriageRead(bytes, size, 0, dos_header))
+  {
+    return detail::TriageMissing(
+      record, sizeof(dos_header), PeTriageStatus::kInvalidDosHeader);
+  }
+  if (dos_header.e_magic != IMAGE_DOS_SIGNATURE)
+  {
+    return detail::TriageStatus(record, PeTriageStatus::kInvalidDosHeader);
+  }
+
+  // A negative offset ends up out of range too.
+  std::uint64_t const nt_headers_offset =
+    static_cast<DWORD>(dos_header.e_lfanew);
+  record.nt_headers_offset = static_cast<DWORD>(nt_headers_offset);
+  DWORD signature = 0;
+  IMAGE_FILE_HEADER file_header;
+  std::uint64_t const file_header_offset =
+    nt_headers_offset + sizeof(signature);
+  if (!detail::TriageRead(bytes, size, nt_headers_offset, signature))
+  {
+    return detail::TriageMissing(record,
+                                 nt_headers_offset + sizeof(signature),
+                                 PeTriageStatus::kInvalidNtHeaders);
+  }
+  if (signature != IMAGE_NT_SIGNATURE)
+  {
+    return detail::TriageStatus(record, PeTriageStatus::kInvalidNtHeaders);
+  }
+  if (!detail::TriageRead(bytes, size, file_header_offset, file_header))
+  {
+    return detail::TriageMissing(record,
+                                 file_header_offset + sizeof(file_header),
+                                 PeTriageStatus::kInvalidFileHeader);
+  }
+
+  record.machine = file_header.Machine;
+  record.characteristics = file_header.Characteristics;
+  record.time_date_stamp = file_header.TimeDateStamp;
+  record.number_of_sections = file_header.NumberOfSections;
+
+  std::uint64_t const optional_header_offset =
+    file_header_offset + sizeof(file_header);
+  std::uint64_t const section_table_offset =
+    optional_header_offset + file_header.SizeOfOptionalHeader;
+  // Sections past the end of the file are virtual, as in SectionTable.
+  std::uint64_t num_real_sections = file_header.NumberOfSections;
+  if (section_table_offset + num_real_sections * sizeof(IMAGE_SECTION_HEADER) >
+      file_size)
+  {
+    record.flags |= PeTriageFlags::kVirtualSectionTable;
+    num_real_sections =
+      section_table_offset < file_size
+        ? (file_size - section_table_offset) / sizeof(IMAGE_SECTION_HEADER)
+        : 0;
+  }
+  std::uint64_t const section_table_end =
+    section_table_offset + num_real_sections * sizeof(IMAGE_SECTION_HEADER);
+  record.headers_end = static_cast<DWORD>(
+    (std::min)(section_table_end, std::uint64_t{0xFFFFFFFFUL}));
+
+  WORD magic = 0;
+  if (!detail::TriageRead(bytes, size, optional_header_offset, magic))
+  {
+    return detail::TriageMissing(record,
+                                 optional_header_offset + sizeof(magic),
+                                 PeTriageStatus::kInvalidOptionalHeader);
+  }
+  record.magic = magic;
+
+  // Anything past SizeOfOptionalHeader (e.g. missing data directories) is
+  // left zeroed.
+  std::size_t const optional_header_size = file_header.SizeOfOptionalHeader;
+  DWORD section_alignment = 0;
+  if (magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC ||
+      magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+  {
+    bool const is_64 = magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+    std::size_t const data_dirs_offset =
+      is_64 ? offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory)
+            : offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory);
+    std::size_t const full_size = is_64 ? sizeof(IMAGE_OPTIONAL_HEADER64)
+                                        : sizeof(IMAGE_OPTIONAL_HEADER32);
+    if (optional_header_size < data_dirs_offset)
+    {
+      return detail::TriageStatus(record,
+                                  PeTriageStatus::kInvalidOptionalHeader);
+    }
+
+    auto const num_data_dirs = static_cast<DWORD>(
+      (optional_header_size - data_dirs_offset) / sizeof(IMAGE_DATA_DIRECTORY));
+    std::size_t const read_size = (std::min)(optional_header_size, full_size);
+    if (optional_header_offset + read_size > size)
+    {
+      return detail::TriageMissing(record,
+                                   optional_header_offset + read_size,
+                                   PeTriageStatus::kInvalidOptionalHeader);
+    }
+
+    if (is_64)
+    {
+      IMAGE_OPTIONAL_HEADER64 optional_header{};
+      detail::TriageRead(
+        bytes, size, optional_header_offset, optional_header, read_size);
+      detail::TriageOptionalHeader(optional_header, num_data_dirs, record);
+      section_alignment = optional_header.SectionAlignment;
+    }
+    else
+    {
+      IMAGE_OPTIONAL_HEADER32 optional_header{};
+      detail::TriageRead(
+        bytes, size, optional_header_offset, optional_header, read_size);
+      detail::TriageOptionalHeader(optional_header, num_data_dirs, record);
+      section_alignment = optional_header.SectionAlignment;
+    }
+  }
+  else
+  {
+    return detail::TriageStatus(record,
+                                PeTriageStatus::kInvalidOptionalHeader);
+  }
+
+  if (!detail::IsPowerOfTwo(record.file_alignment) ||
+      !detail::IsPowerOfTwo(section_alignment) ||
+      section_alignment < record.file_alignment || !record.size_of_image ||
+      record.size_of_headers > record.size_of_image)
+  {
+    return detail::TriageStatus(record,
+                                PeTriageStatus::kInvalidOptionalHeader);
+  }
+
+  std::uint64_t prev_section = 0;
+  std::uint64_t next_section = 0;
+  for (WORD i = 0; i < num_real_sections; ++i)
+  {
+    IMAGE_SECTION_HEADER section;
+    std::uint64_t const section_offset =
+      section_table_offset + std::uint64_t{i} * sizeof(section);
+    // Only the sections in the file are read, so this is always kIncomplete.
+    if (!detail::TriageRead(bytes, size, section_offset, section))
+    {
+      return detail::TriageMissing(
+        record, section_table_end, PeTriageStatus::kIncomplete);
+    }
+
+    std::uint64_t const virtual_size = section.Misc.VirtualSize
+                                         ? section.Misc.VirtualSize
+                                         : section.SizeOfRawData;
+    std::uint64_t const virtual_end =
+      section.VirtualAddress +
+      (virtual_size + section_alignment - 1) / section_alignment *
+        section_alignment;
+    std::uint64_t const raw_end =
+      std::uint64_t{section.PointerToRawData} + section.SizeOfRawData;
+    if (section.VirtualAddress < prev_section)
+    {
+      record.flags |= PeTriageFlags::kSectionsOutOfOrder;
+    }
+    else if (section.VirtualAddress < next_section)
+    {
+      record.flags |= PeTriageFlags::kSectionsOverlap;
+    }
+    if (virtual_end > record.size_of_image)
+    {
+      record.flags |= PeTriageFlags::kSectionPastImage;
+    }
+    if (section.SizeOfRawData && raw_end > file_size)
+    {
+      record.flags |= PeTriageFlags::kRawDataPastEof;
+    }
+
+    prev_section = section.VirtualAddress;
+    next_section = (std::max)(next_section, virtual_end);
+  }
+
+  return detail::TriageStatus(record, PeTriageStatus::kValid);
+}
+
+// Triages a file (or anything else laid out like one) of the given size at
+// base, by reading its headers through the process: normally a single page,
+// and never more than detail::kPeTriageMaxHeadersSize bytes (files with
+// headers bigger than that are left kIncomplete). Nothing is thrown.
+inline PeTriageStatus TriagePeFile(Process const& process,
+                                   void* base,
+                                   std::size_t size,
+                                   PeTriageRecord& record)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  try
+  {
+    std::vector<std::uint8_t> buf(
+      (std::min)(size, detail::kPeTriagePageSize));
+    for (;;)
+    {
+      if (!detail::TryReadUnchecked(process, base, buf.data(), buf.size()))
+      {
+        std::memset(&record, 0, sizeof(record));
+        record.file_size = size;
+        return detail::TriageStatus(record, PeTriageStatus::kUnreadable);
+      }
+
+      PeTriageStatus const status =
+        TriagePeHeaders(buf.data(), buf.size(), size, record);
+      if (status != PeTriageStatus::kIncomplete ||
+          record.headers_end <= buf.size() ||
+          record.headers_end > detail::kPeTriageMaxHeadersSize)
+      {
+        return status;
+      }
+
+      buf.resize(record.headers_end);
+    }
+  }
+  catch (...)
+  {
+    std::memset(&record, 0, sizeof(record));
+    record.file_size = size;
+    return detail::TriageStatus(record, PeTriageStatus::kUnreadable);
+  }
+}
+}
@@ -0,0 +1,498 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/parallel_for.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/relocation.hpp>
+#include <hadesmem/pelib/relocation_block.hpp>
+#include <hadesmem/pelib/relocation_block_list.hpp>
+#include <hadesmem/pelib/relocation_list.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// Decodes every base relocation block once, into sorted arrays of target
+// RVAs grouped by type, so relocations can be applied to (or reverted from)
+// a local copy of an image without going back to the PE file.
+//
+// Blocks are walked with the same rules as RelocationBlockList. HIGHLOW,
+// DIR64, HIGH and LOW relocations are supported. ABSOLUTE relocations are
+// padding, and anything else (HIGHADJ, and the machine specific types) is
+// counted but not applied.
+class RelocationTable
+{
+public:
+  explicit RelocationTable(Process const& process, PeFile const& pe_file)
+  {
+    Decode(process, pe_file);
+  }
+
+  explicit RelocationTable(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit RelocationTable(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit RelocationTable(Process&& process, PeFile&& pe_file) = delete;
+
+  std::vector<DWORD> const& GetHighLow() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return highlow_;
+  }
+
+  std::vector<DWORD> const& GetDir64() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return dir64_;
+  }
+
+  std::vector<DWORD> const& GetHigh() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return high_;
+  }
+
+  std::vector<DWORD> const& GetLow() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return low_;
+  }
+
+  // Number of relocations which will be applied.
+  std::size_t GetNumberOfRelocations() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return highlow_.size() + dir64_.size() + high_.size() + low_.size();
+  }
+
+  std::size_t GetNumberOfUnsupported() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return num_unsupported_;
+  }
+
+  // Minimum size of an image buffer which the relocations can be applied to.
+  std::uint64_t GetRequiredSize() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return required_size_;
+  }
+
+  // Whether any relocations touch the same bytes. The loader applies them in
+  // block order, so in that case they're applied in order on one thread.
+  bool IsOverlapping() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return !ordered_.empty();
+  }
+
+  // Adds delta (i.e. new base - old base) to every relocated value in an
+  // image (not file) layout buffer. Large tables are applied in parallel,
+  // split on page boundaries.
+  void Apply(void* image,
+             std::size_t size,
+             std::uint64_t delta,
+             std::size_t num_threads = 0) const
+  {
+    if (!GetNumberOfRelocations() || !delta)
+    {
+      return;
+    }
+
+    if (!image || size < required_size_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Image buffer too small for relocations."});
+    }
+
+    auto const base = static_cast<PBYTE>(image);
+    if (IsOverlapping())
+    {
+      for (auto const& entry : ordered_)
+      {
+        ApplyOne(base, entry.rva, entry.type, delta);
+      }
+
+      return;
+    }
+
+    if (chunks_.size() > 1 && num_threads != 1)
+    {
+      detail::ParallelFor(chunks_.size(),
+                          [&](std::size_t i)
+                          {
+                            ApplyChunk(base, chunks_[i], delta);
+                          },
+                          num_threads);
+    }
+    else
+    {
+      for (auto const& chunk : chunks_)
+      {
+        ApplyChunk(base, chunk, delta);
+      }
+    }
+
+    ApplyRange<std::uint16_t>(
+      base,
+      high_.data(),
+      high_.data() + high_.size(),
+      static_cast<std::uint16_t>(static_cast<std::uint32_t>(delta) >> 16));
+    ApplyRange<std::uint16_t>(base,
+                              low_.data(),
+                              low_.data() + low_.size(),
+                              static_cast<std::uint16_t>(delta));
+  }
+
+  // Undoes Apply with the same delta (e.g. to restore a dumped module to its
+  // preferred base). HIGH relocations only round trip if the delta is a
+  // multiple of 64K, which it always is for real module bases.
+  void Revert(void* image,
+              std::size_t size,
+              std::uint64_t delta,
+              std::size_t num_threads = 0) const
+  {
+    Apply(image, size, 0 - delta, num_threads);
+  }
+
+private:
+  // Roughly how many relocations each parallel work item covers.
+  static std::size_t const kChunkSize = 0x2000;
+
+  // Relocations only use the low 12 bits of the RVA within a block.
+  static DWORD const kPageShift = 12;
+
+  struct Chunk
+  {
+    std::size_t highlow_begin;
+    std::size_t highlow_end;
+    std::size_t dir64_begin;
+    std::size_t dir64_end;
+  };
+
+  struct OrderedEntry
+  {
+    DWORD rva;
+    WORD type;
+  };
+
+  template <typename T>
+  static void ApplyRange(PBYTE base,
+                         DWORD const* beg,
+                         DWORD const* end,
+                         T delta) HADESMEM_DETAIL_NOEXCEPT
+  {
+    for (; beg != end; ++beg)
+    {
+      T value;
+      std::memcpy(&value, base + *beg, sizeof(value));
+      value = static_cast<T>(value + delta);
+      std::memcpy(base + *beg, &value, sizeof(value));
+    }
+  }
+
+  void ApplyChunk(PBYTE base, Chunk const& chunk, std::uint64_t delta) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    ApplyRange<std::uint32_t>(base,
+                              highlow_.data() + chunk.highlow_begin,
+                              highlow_.data() + chunk.highlow_end,
+                              static_cast<std::uint32_t>(delta));
+    ApplyRange<std::uint64_t>(base,
+                              dir64_.data() + chunk.dir64_begin,
+                              dir64_.data() + chunk.dir64_end,
+                              delta);
+  }
+
+  static void ApplyOne(PBYTE base,
+                       DWORD rva,
+                       WORD type,
+                       std::uint64_t delta) HADESMEM_DETAIL_NOEXCEPT
+  {
+    switch (type)
+    {
+    case IMAGE_REL_BASED_HIGHLOW:
+      ApplyRange<std::uint32_t>(
+        base, &rva, &rva + 1, static_cast<std::uint32_t>(delta));
+      break;
+    case IMAGE_REL_BASED_DIR64:
+      ApplyRange<std::uint64_t>(base, &rva, &rva + 1, delta);
+      break;
+    case IMAGE_REL_BASED_HIGH:
+      ApplyRange<std::uint16_t>(
+        base,
+        &rva,
+        &rva + 1,
+        static_cast<std::uint16_t>(static_cast<std::uint32_t>(delta) >> 16));
+      break;
+    case IMAGE_REL_BASED_LOW:
+      ApplyRange<std::uint16_t>(
+        base, &rva, &rva + 1, static_cast<std::uint16_t>(delta));
+      break;
+    default:
+      HADESMEM_DETAIL_ASSERT(false);
+    }
+  }
+
+  static std::size_t GetWidth(WORD type) HADESMEM_DETAIL_NOEXCEPT
+  {
+    switch (type)
+    {
+    case IMAGE_REL_BASED_HIGHLOW:
+      return sizeof(std::uint32_t);
+    case IMAGE_REL_BASED_DIR64:
+      return sizeof(std::uint64_t);
+    case IMAGE_REL_BASED_HIGH:
+    case IMAGE_REL_BASED_LOW:
+      return sizeof(std::uint16_t);
+    default:
+      return 0;
+    }
+  }
+
+  void DecodeBlock(DWORD virtual_address, WORD const* data, std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      WORD const type = static_cast<WORD>(data[i] >> 12);
+      WORD const offset = static_cast<WORD>(data[i] & 0x0FFF);
+      if (type == IMAGE_REL_BASED_ABSOLUTE)
+      {
+        continue;
+      }
+
+      std::size_t const width = GetWidth(type);
+      if (!width)
+      {
+        ++num_unsupported_;
+        // HIGHADJ takes up an extra slot for the low half of the value.
+        if (type == IMAGE_REL_BASED_HIGHADJ)
+        {
+          ++i;
+        }
+        continue;
+      }
+
+      std::uint64_t const rva =
+        static_cast<std::uint64_t>(virtual_address) + offset;
+      // Can't possibly be inside an image, so no buffer will be big enough.
+      if (rva > (std::numeric_limits<DWORD>::max)())
+      {
+        required_size_ = (std::numeric_limits<std::uint64_t>::max)();
+        ++num_unsupported_;
+        continue;
+      }
+
+      required_size_ = (std::max)(required_size_, rva + width);
+      OrderedEntry const entry = {static_cast<DWORD>(rva), type};
+      ordered_.push_back(entry);
+    }
+  }
+
+  bool DecodeBulk(Process const& process, PBYTE base, DWORD size)
+  {
+    std::vector<BYTE> dir;
+    try
+    {
+      dir = ReadVector<BYTE>(process, base, size);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      return false;
+    }
+
+    // Same walk as RelocationBlockList, but over the local copy.
+    std::size_t pos = 0;
+    while (pos + sizeof(IMAGE_BASE_RELOCATION) <= dir.size())
+    {
+      IMAGE_BASE_RELOCATION block;
+      std::memcpy(&block, dir.data() + pos, sizeof(block));
+      std::size_t const count =
+        block.SizeOfBlock
+          ? static_cast<DWORD>(
+              (block.SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) /
+              sizeof(WORD))
+          : 0;
+      std::size_t const data_pos = pos + sizeof(IMAGE_BASE_RELOCATION);
+      if (count > (dir.size() - data_pos) / sizeof(WORD))
+      {
+        break;
+      }
+
+      std::vector<WORD> data(count);
+      if (count)
+      {
+        std::memcpy(data.data(), dir.data() + data_pos, count * sizeof(WORD));
+      }
+      DecodeBlock(block.VirtualAddress, data.data(), count);
+
+      pos = data_pos + count * sizeof(WORD);
+    }
+
+    return true;
+  }
+
+  // Used if the directory can't be read in one go (e.g. it runs into an
+  // unreadable page in a mapped image).
+  void DecodeIterative(Process const& process, PeFile const& pe_file)
+  {
+    RelocationBlockList const blocks{process, pe_file};
+    for (auto const& block : blocks)
+    {
+      std::vector<WORD> data;
+      RelocationList const relocs{process,
+                                  pe_file,
+                                  block.GetRelocationDataStart(),
+                                  block.GetNumberOfRelocations()};
+      for (auto const& reloc : relocs)
+      {
+        data.push_back(static_cast<WORD>(
+          reloc.GetOffset() | (static_cast<WORD>(reloc.GetType()) << 12)));
+      }
+      DecodeBlock(block.GetVirtualAddress(), data.data(), data.size());
+    }
+  }
+
+  void Decode(Process const& process, PeFile const& pe_file)
+  {
+    NtHeaders const nt_headers{process, pe_file};
+    DWORD const data_dir_va =
+      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::BaseReloc);
+    DWORD const size = nt_headers.GetDataDirectorySize(PeDataDir::BaseReloc);
+    if (!data_dir_va || !size)
+    {
+      return;
+    }
+
+    auto const base =
+      static_cast<PBYTE>(RvaToVa(process, pe_file, data_dir_va));
+    if (!base)
+    {
+      return;
+    }
+
+    // Cast to integer and back to avoid pointer overflow UB.
+    auto const reloc_dir_end = reinterpret_cast<void const*>(
+      reinterpret_cast<std::uintptr_t>(base) + size);
+    auto const file_end =
+      static_cast<PBYTE>(pe_file.GetBase()) + pe_file.GetSize();
+    // Sample: virtrelocXP.exe
+    if (pe_file.GetType() == PeFileType::Data &&
+        (reloc_dir_end < base || reloc_dir_end > file_end))
+    {
+      return;
+    }
+
+    if (!DecodeBulk(process, base, size))
+    {
+      DecodeIterative(process, pe_file);
+    }
+
+    Group();
+  }
+
+  void Group()
+  {
+    std::vector<OrderedEntry> sorted = ordered_;
+    std::stable_sort(std::begin(sorted),
+                     std::end(sorted),
+                     [](OrderedEntry const& lhs, OrderedEntry const& rhs)
+                     {
+      return lhs.rva < rhs.rva;
+    });
+
+    bool overlapping = false;
+    for (std::size_t i = 1; i < sorted.size(); ++i)
+    {
+      if (static_cast<std::uint64_t>(sorted[i - 1].rva) +
+            GetWidth(sorted[i - 1].type) >
+          sorted[i].rva)
+      {
+        overlapping = true;
+        break;
+      }
+    }
+
+    for (auto const& entry : sorted)
+    {
+      switch (entry.type)
+      {
+      case IMAGE_REL_BASED_HIGHLOW:
+        highlow_.push_back(entry.rva);
+        break;
+      case IMAGE_REL_BASED_DIR64:
+        dir64_.push_back(entry.rva);
+        break;
+      case IMAGE_REL_BASED_HIGH:
+        high_.push_back(entry.rva);
+        break;
+      case IMAGE_REL_BASED_LOW:
+        low_.push_back(entry.rva);
+        break;
+      default:
+        HADESMEM_DETAIL_ASSERT(false);
+      }
+    }
+
+    // The block order is only needed to apply overlapping relocations.
+    if (!overlapping)
+    {
+      std::vector<OrderedEntry>().swap(ordered_);
+    }
+
+    // Split the HIGHLOW and DIR64 relocations into chunks of whole pages.
+    // Chunks never share a page, and nothing overlaps, so they can be
+    // applied concurrently.
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < highlow_.size() || j < dir64_.size())
+    {
+      Chunk chunk = {i, i, j, j};
+      while ((i < highlow_.size() || j < dir64_.size()) &&
+             (i - chunk.highlow_begin) + (j - chunk.dir64_begin) < kChunkSize)
+      {
+        DWORD page = (std::numeric_limits<DWORD>::max)();
+        if (i < highlow_.size())
+        {
+          page = highlow_[i] >> kPageShift;
+        }
+        if (j < dir64_.size())
+        {
+          page = (std::min)(page, dir64_[j] >> kPageShift);
+        }
+        while (i < highlow_.size() && highlow_[i] >> kPageShift == page)
+        {
+          ++i;
+        }
+        while (j < dir64_.size() && dir64_[j] >> kPageShift == page)
+        {
+          ++j;
+        }
+      }
+
+      chunk.highlow_end = i;
+      chunk.dir64_end = j;
+      chunks_.push_back(chunk);
+    }
+  }
+
+  std::vector<DWORD> highlow_;
+  std::vector<DWORD> dir64_;
+  std::vector<DWORD> high_;
+  std::vector<DWORD> low_;
+  std::vector<Chunk> chunks_;
+  std::vector<OrderedEntry> ordered_;
+  std::size_t num_unsupported_{};
+  std::uint64_t required_size_{};
+};
+}
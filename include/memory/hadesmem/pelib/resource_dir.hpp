@@ -0,0 +1,593 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+namespace detail
+{
+// Windows only uses three levels (type, name and language). Deeper trees are
+// malformed, but are walked up to this point.
+std::size_t const kResourceMaxDepth = 8;
+
+DWORD const kResourceOffsetMask = 0x7FFFFFFFUL;
+
+// The resource directory as a contiguous run of bytes, starting at its RVA.
+struct ResourceRegion
+{
+  std::uint8_t const* data;
+  DWORD size;
+  DWORD rva;
+};
+
+// Offsets of the directories between the root and a node, so that walking
+// back into one of them (i.e. a loop) can be caught.
+struct ResourcePath
+{
+  DWORD offsets[kResourceMaxDepth];
+  std::size_t depth;
+};
+
+template <typename T>
+bool ReadResourceRegion(ResourceRegion const& region, DWORD offset, T& value)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  if (offset > region.size || region.size - offset < sizeof(T))
+  {
+    return false;
+  }
+
+  std::memcpy(&value, region.data + offset, sizeof(T));
+  return true;
+}
+}
+
+// Name of a resource entry, viewed in place. It's only valid for as long as
+// the ResourceDir it came from, and isn't null terminated.
+class ResourceName
+{
+public:
+  ResourceName() HADESMEM_DETAIL_NOEXCEPT : data_{nullptr}, size_{0}
+  {
+  }
+
+  ResourceName(wchar_t const* data, std::size_t size) HADESMEM_DETAIL_NOEXCEPT
+    : data_{data},
+      size_{size}
+  {
+  }
+
+  wchar_t const* GetData() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return data_;
+  }
+
+  std::size_t GetSize() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return size_;
+  }
+
+  std::wstring ToString() const
+  {
+    return std::wstring(data_, data_ + size_);
+  }
+
+  // Compares code unit by code unit. Resource compilers upper case names,
+  // and this is the order they're sorted in.
+  int Compare(wchar_t const* name, std::size_t size) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    for (std::size_t i = 0; i < size_ && i < size; ++i)
+    {
+      if (data_[i] != name[i])
+      {
+        return data_[i] < name[i] ? -1 : 1;
+      }
+    }
+
+    return size_ < size ? -1 : (size_ > size ? 1 : 0);
+  }
+
+private:
+  wchar_t const* data_;
+  std::size_t size_;
+};
+
+// A leaf of the resource tree. The data is viewed in place if it's inside
+// the resource directory (as it normally is), otherwise it's null and the
+// RVA has to be read from.
+struct ResourceData
+{
+  DWORD rva;
+  DWORD size;
+  DWORD code_page;
+  std::uint8_t const* data;
+};
+
+class ResourceEntry;
+
+// One level of the resource tree (an IMAGE_RESOURCE_DIRECTORY). Nothing is
+// read until it's asked for, so walking straight to a single resource only
+// touches the directories and entries on the way.
+//
+// Entry counts are clamped to what fits in the resource directory, as
+// malformed files commonly claim far more entries than they contain.
+class ResourceNode
+{
+public:
+  static std::size_t const kNotFound = static_cast<std::size_t>(-1);
+
+  ResourceNode(detail::ResourceRegion const& region,
+               DWORD offset,
+               detail::ResourcePath const& path)
+    : region_(&region), offset_{offset}, path_(path), data_()
+  {
+    if (!detail::ReadResourceRegion(region, offset, data_))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory is invalid."});
+    }
+
+    DWORD const entries_offset = offset + sizeof(IMAGE_RESOURCE_DIRECTORY);
+    std::size_t const max_entries = (region.size - entries_offset) /
+                                    sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY);
+    num_named_ = (std::min)(static_cast<std::size_t>(
+                              data_.NumberOfNamedEntries),
+                            max_entries);
+    num_ids_ = (std::min)(static_cast<std::size_t>(data_.NumberOfIdEntries),
+                          max_entries - num_named_);
+  }
+
+  DWORD GetOffset() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return offset_;
+  }
+
+  // Zero for the root (types), one for names, two for languages.
+  std::size_t GetDepth() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return path_.depth;
+  }
+
+  DWORD GetCharacteristics() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return data_.Characteristics;
+  }
+
+  DWORD GetTimeDateStamp() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return data_.TimeDateStamp;
+  }
+
+  WORD GetMajorVersion() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return data_.MajorVersion;
+  }
+
+  WORD GetMinorVersion() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return data_.MinorVersion;
+  }
+
+  // Named entries come first, then ID entries.
+  std::size_t GetNumberOfNamedEntries() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return num_named_;
+  }
+
+  std::size_t GetNumberOfIdEntries() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return num_ids_;
+  }
+
+  std::size_t GetNumberOfEntries() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return num_named_ + num_ids_;
+  }
+
+  ResourceEntry GetEntry(std::size_t index) const;
+
+  // Binary searches for an entry, returning its index or kNotFound. Like the
+  // loader, this relies on the entries being sorted (names, then IDs, in
+  // ascending order), so it won't necessarily find entries in malformed
+  // directories which aren't. Enumerating them still will.
+  std::size_t FindId(WORD id) const;
+
+  std::size_t FindName(std::wstring const& name) const;
+
+private:
+  IMAGE_RESOURCE_DIRECTORY_ENTRY ReadEntry(std::size_t index) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    HADESMEM_DETAIL_ASSERT(index < GetNumberOfEntries());
+    IMAGE_RESOURCE_DIRECTORY_ENTRY entry;
+    std::memcpy(&entry,
+                region_->data + offset_ + sizeof(IMAGE_RESOURCE_DIRECTORY) +
+                  index * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY),
+                sizeof(entry));
+    return entry;
+  }
+
+  detail::ResourceRegion const* region_;
+  DWORD offset_;
+  detail::ResourcePath path_;
+  IMAGE_RESOURCE_DIRECTORY data_;
+  std::size_t num_named_;
+  std::size_t num_ids_;
+};
+
+class ResourceEntry
+{
+public:
+  ResourceEntry(detail::ResourceRegion const& region,
+                IMAGE_RESOURCE_DIRECTORY_ENTRY const& data,
+                detail::ResourcePath const& path) HADESMEM_DETAIL_NOEXCEPT
+    : region_(&region),
+      data_(data),
+      path_(path)
+  {
+  }
+
+  bool IsNamed() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return !!(data_.Name & IMAGE_RESOURCE_NAME_IS_STRING);
+  }
+
+  // Zero for named entries.
+  WORD GetId() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return IsNamed() ? 0 : static_cast<WORD>(data_.Name);
+  }
+
+  // Empty for ID entries, and for names which lie outside the resource
+  // directory.
+  ResourceName GetName() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    if (!IsNamed())
+    {
+      return ResourceName();
+    }
+
+    DWORD const offset = data_.Name & detail::kResourceOffsetMask;
+    WORD size = 0;
+    if (!detail::ReadResourceRegion(*region_, offset, size) ||
+        (region_->size - offset - sizeof(WORD)) / sizeof(wchar_t) < size)
+    {
+      return ResourceName();
+    }
+
+    return ResourceName(reinterpret_cast<wchar_t const*>(
+                          region_->data + offset + sizeof(WORD)),
+                        size);
+  }
+
+  bool IsDirectory() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return !!(data_.OffsetToData & IMAGE_RESOURCE_DATA_IS_DIRECTORY);
+  }
+
+  // Throws if the subdirectory is invalid, too deep, or is one of its own
+  // parents.
+  ResourceNode GetDirectory() const
+  {
+    if (!IsDirectory())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource entry is not a directory."});
+    }
+
+    if (path_.depth + 1 >= detail::kResourceMaxDepth)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory is too deep."});
+    }
+
+    DWORD const offset = data_.OffsetToData & detail::kResourceOffsetMask;
+    if (std::find(path_.offsets, path_.offsets + path_.depth + 1, offset) !=
+        path_.offsets + path_.depth + 1)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory contains a loop."});
+    }
+
+    detail::ResourcePath path = path_;
+    path.offsets[++path.depth] = offset;
+    return ResourceNode(*region_, offset, path);
+  }
+
+  ResourceData GetData() const
+  {
+    IMAGE_RESOURCE_DATA_ENTRY entry;
+    if (IsDirectory() ||
+        !detail::ReadResourceRegion(*region_, data_.OffsetToData, entry))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource data entry is invalid."});
+    }
+
+    ResourceData data = {
+      entry.OffsetToData, entry.Size, entry.CodePage, nullptr};
+    DWORD const offset = entry.OffsetToData - region_->rva;
+    if (entry.OffsetToData >= region_->rva && offset <= region_->size &&
+        region_->size - offset >= entry.Size)
+    {
+      data.data = region_->data + offset;
+    }
+    return data;
+  }
+
+private:
+  detail::ResourceRegion const* region_;
+  IMAGE_RESOURCE_DIRECTORY_ENTRY data_;
+  // Path of the directory the entry is in.
+  detail::ResourcePath path_;
+};
+
+inline ResourceEntry ResourceNode::GetEntry(std::size_t index) const
+{
+  return ResourceEntry(*region_, ReadEntry(index), path_);
+}
+
+inline std::size_t ResourceNode::FindId(WORD id) const
+{
+  std::size_t lo = num_named_;
+  std::size_t hi = GetNumberOfEntries();
+  while (lo < hi)
+  {
+    std::size_t const mid = lo + (hi - lo) / 2;
+    auto const entry_id = static_cast<WORD>(ReadEntry(mid).Name);
+    if (entry_id == id)
+    {
+      return mid;
+    }
+
+    if (entry_id < id)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  return kNotFound;
+}
+
+inline std::size_t ResourceNode::FindName(std::wstring const& name) const
+{
+  std::size_t lo = 0;
+  std::size_t hi = num_named_;
+  while (lo < hi)
+  {
+    std::size_t const mid = lo + (hi - lo) / 2;
+    int const cmp = GetEntry(mid).GetName().Compare(name.c_str(), name.size());
+    if (cmp == 0)
+    {
+      return mid;
+    }
+
+    if (cmp < 0)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  return kNotFound;
+}
+
+// The resource directory of a module. For a PE file in this process the
+// tree is used in place, so nothing is copied. Otherwise the directory is
+// read in one go, rather than a read per node.
+class ResourceDir
+{
+public:
+  explicit ResourceDir(Process const& process, PeFile const& pe_file)
+    : buf_(), region_()
+  {
+    NtHeaders const nt_headers{process, pe_file};
+    DWORD const rva =
+      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Resource);
+    DWORD size = nt_headers.GetDataDirectorySize(PeDataDir::Resource);
+    auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+    auto const ptr =
+      rva ? static_cast<std::uint8_t*>(RvaToVa(process, pe_file, rva))
+          : nullptr;
+    DWORD const file_size = pe_file.GetType() == PeFileType::Data
+                              ? pe_file.GetSize()
+                              : nt_headers.GetSizeOfImage();
+    if (!ptr || ptr < base || ptr >= base + file_size)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory is invalid."});
+    }
+
+    // The loader doesn't check the size, so neither is it trusted here.
+    auto const available = static_cast<DWORD>(base + file_size - ptr);
+    size = size ? (std::min)(size, available) : available;
+
+    if (process.GetId() == ::GetCurrentProcessId())
+    {
+      region_.data = ptr;
+    }
+    else
+    {
+      buf_.resize(size);
+      detail::ReadUnchecked(process, ptr, buf_.data(), size);
+      region_.data = buf_.data();
+    }
+    region_.size = size;
+    region_.rva = rva;
+  }
+
+  explicit ResourceDir(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit ResourceDir(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit ResourceDir(Process&& process, PeFile&& pe_file) = delete;
+
+  ResourceDir(ResourceDir const&) = delete;
+
+  ResourceDir& operator=(ResourceDir const&) = delete;
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  ResourceDir(ResourceDir&& other)
+    : buf_(std::move(other.buf_)), region_(other.region_)
+  {
+  }
+
+  ResourceDir& operator=(ResourceDir&& other)
+  {
+    buf_ = std::move(other.buf_);
+    region_ = other.region_;
+
+    return *this;
+  }
+
+#else // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  ResourceDir(ResourceDir&&) = default;
+
+  ResourceDir& operator=(ResourceDir&&) = default;
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  DWORD GetRva() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return region_.rva;
+  }
+
+  DWORD GetSize() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return region_.size;
+  }
+
+  // Nodes and entries refer to the ResourceDir, so must not outlive it.
+  ResourceNode GetRoot() const
+  {
+    detail::ResourcePath const path = {{0}, 0};
+    return ResourceNode(region_, 0, path);
+  }
+
+private:
+  std::vector<std::uint8_t> buf_;
+  detail::ResourceRegion region_;
+};
+
+namespace detail
+{
+// Follows the first entry of each level below a type, i.e. the first name
+// and the first language. Returns false if there isn't one.
+inline bool GetFirstResource(ResourceNode const& root,
+                             WORD type,
+                             ResourceData& data)
+{
+  std::size_t const index = root.FindId(type);
+  if (index == ResourceNode::kNotFound)
+  {
+    return false;
+  }
+
+  ResourceEntry entry = root.GetEntry(index);
+  while (entry.IsDirectory())
+  {
+    ResourceNode const node = entry.GetDirectory();
+    if (!node.GetNumberOfEntries())
+    {
+      return false;
+    }
+    entry = node.GetEntry(0);
+  }
+
+  data = entry.GetData();
+  return true;
+}
+}
+
+// Gets the VS_FIXEDFILEINFO from the first RT_VERSION resource, looking
+// only at the directories on the way to it (i.e. without parsing the rest
+// of the tree or the rest of the version resource). Returns false if the
+// module doesn't have one, or it's malformed.
+inline bool GetFixedFileInfo(Process const& process,
+                             PeFile const& pe_file,
+                             VS_FIXEDFILEINFO& info)
+{
+  // VS_VERSIONINFO is three WORDs (wLength, wValueLength and wType), then
+  // L"VS_VERSION_INFO" with its terminator, then padding to a DWORD boundary,
+  // then the VS_FIXEDFILEINFO.
+  wchar_t const kKey[] = L"VS_VERSION_INFO";
+  std::size_t const kKeyOffset = sizeof(WORD) * 3;
+  std::size_t const kValueOffset = (kKeyOffset + sizeof(kKey) + 3) & ~3U;
+  std::size_t const kSize = kValueOffset + sizeof(VS_FIXEDFILEINFO);
+
+  std::uint8_t header[kSize];
+  try
+  {
+    ResourceDir const resource_dir{process, pe_file};
+    auto const type =
+      static_cast<WORD>(reinterpret_cast<ULONG_PTR>(RT_VERSION));
+    ResourceData data;
+    if (!detail::GetFirstResource(resource_dir.GetRoot(), type, data) ||
+        data.size < kSize)
+    {
+      return false;
+    }
+
+    if (data.data)
+    {
+      std::memcpy(header, data.data, kSize);
+    }
+    else
+    {
+      void* const va = RvaToVa(process, pe_file, data.rva);
+      if (!va)
+      {
+        return false;
+      }
+      detail::ReadUnchecked(process, va, header, kSize);
+    }
+  }
+  catch (std::exception const& /*e*/)
+  {
+    return false;
+  }
+
+  WORD length = 0;
+  WORD value_length = 0;
+  std::memcpy(&length, header, sizeof(length));
+  std::memcpy(&value_length, header + sizeof(WORD), sizeof(value_length));
+  if (length < kSize || value_length < sizeof(VS_FIXEDFILEINFO) ||
+      std::memcmp(header + kKeyOffset, kKey, sizeof(kKey)) != 0)
+  {
+    return false;
+  }
+
+  std::memcpy(&info, header + kValueOffset, sizeof(info));
+  return info.dwSignature == VS_FFI_SIGNATURE;
+}
+}
@@ -56,7 +56,7 @@ public:
       is_virtual_ = true;
       ::ZeroMemory(&data_, sizeof(data_));
     }
-    else
+    else if (!ReadCached(pe_file))
     {
       UpdateRead();
     }
@@ -207,7 +207,42 @@ public:
   }
 
 private:
+  explicit Section(Process const& process,
+                   PeFile const& pe_file,
+                   void* base,
+                   IMAGE_SECTION_HEADER const& data,
+                   bool is_virtual) HADESMEM_DETAIL_NOEXCEPT
+    : process_{&process},
+      pe_file_{&pe_file},
+      base_{static_cast<std::uint8_t*>(base)},
+      data_(data),
+      is_virtual_{is_virtual}
+  {
+  }
+
+  bool ReadCached(PeFile const& pe_file)
+  {
+    auto const image_data = pe_file.GetImageData();
+    if (!image_data || base_ < image_data->section_headers_base)
+    {
+      return false;
+    }
+
+    std::size_t const offset =
+      static_cast<std::size_t>(base_ - image_data->section_headers_base);
+    std::size_t const index = offset / sizeof(IMAGE_SECTION_HEADER);
+    if (offset % sizeof(IMAGE_SECTION_HEADER) ||
+        index >= image_data->section_headers.size())
+    {
+      return false;
+    }
+
+    data_ = image_data->section_headers[index];
+    return true;
+  }
+
   template <typename SectionT> friend class SectionIterator;
+  friend class SectionTable;
 
   Process const* process_;
   PeFile const* pe_file_;
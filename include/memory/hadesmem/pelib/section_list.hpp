@@ -17,6 +17,7 @@
 #include <hadesmem/error.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_table.hpp>
 #include <hadesmem/process.hpp>
 
 namespace hadesmem
@@ -40,11 +41,10 @@ public:
 
   explicit SectionIterator(Process const& process, PeFile const& pe_file)
   {
-    NtHeaders const nt_headers(process, pe_file);
-    if (auto const num_sections = nt_headers.GetNumberOfSections())
+    auto const table = std::make_shared<SectionTable const>(process, pe_file);
+    if (!table->empty())
     {
-      Section const section(process, pe_file, nullptr);
-      impl_ = std::make_shared<Impl>(process, pe_file, section, num_sections);
+      impl_ = std::make_shared<Impl>(table);
     }
   }
 
@@ -90,15 +90,13 @@ public:
   {
     HADESMEM_DETAIL_ASSERT(impl_.get());
 
-    if (++impl_->cur_section_ >= impl_->num_sections_)
+    if (++impl_->cur_section_ >= impl_->table_->size())
     {
       impl_.reset();
       return *this;
     }
 
-    auto const new_base =
-      static_cast<PIMAGE_SECTION_HEADER>(impl_->section_->GetBase()) + 1U;
-    impl_->section_ = Section{*impl_->process_, *impl_->pe_file_, new_base};
+    impl_->section_ = impl_->table_->GetSection(impl_->cur_section_);
 
     return *this;
   }
@@ -123,22 +121,15 @@ public:
 private:
   struct Impl
   {
-    explicit Impl(Process const& process,
-                  PeFile const& pe_file,
-                  Section const& section,
-                  WORD num_sections) HADESMEM_DETAIL_NOEXCEPT
-      : process_{&process},
-        pe_file_{&pe_file},
-        section_{section},
-        num_sections_{num_sections}
+    explicit Impl(std::shared_ptr<SectionTable const> const& table)
+      : table_{table}, section_{table->GetSection(0)}
     {
     }
 
-    Process const* process_;
-    PeFile const* pe_file_;
+    // The whole table is read up front, so advancing never reads.
+    std::shared_ptr<SectionTable const> table_;
     hadesmem::detail::Optional<Section> section_;
-    WORD num_sections_;
-    WORD cur_section_{};
+    std::size_t cur_section_{};
   };
 
   // Shallow copy semantics, as required by InputIterator.
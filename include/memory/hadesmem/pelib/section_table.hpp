@@ -0,0 +1,164 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// The whole section table, read in one go, for random access (and repeated
+// iteration) without going back to the PE file. Headers past the end of a
+// data file (a 'virtual' section table) read as zero, the same as Section.
+//
+// The headers are a snapshot, so Section objects returned by GetSection
+// are too. Changes written through them aren't reflected here.
+class SectionTable
+{
+public:
+  using value_type = IMAGE_SECTION_HEADER;
+  using size_type = std::size_t;
+  using const_iterator = IMAGE_SECTION_HEADER const*;
+  using iterator = const_iterator;
+
+  explicit SectionTable(Process const& process, PeFile const& pe_file)
+    : process_{&process}, pe_file_{&pe_file}
+  {
+    NtHeaders const nt_headers{process, pe_file};
+    std::size_t const num_sections = nt_headers.GetNumberOfSections();
+    if (!num_sections)
+    {
+      return;
+    }
+
+    base_ = reinterpret_cast<PIMAGE_SECTION_HEADER>(
+      static_cast<PBYTE>(nt_headers.GetBase()) +
+      offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
+      nt_headers.GetSizeOfOptionalHeader());
+    headers_.resize(num_sections);
+
+    num_real_ = num_sections;
+    if (pe_file.GetType() == PeFileType::Data)
+    {
+      auto const file_end =
+        static_cast<PBYTE>(pe_file.GetBase()) + pe_file.GetSize();
+      auto const table_beg = reinterpret_cast<PBYTE>(base_);
+      num_real_ =
+        table_beg < file_end
+          ? (std::min)(num_sections,
+                       static_cast<std::size_t>(file_end - table_beg) /
+                         sizeof(IMAGE_SECTION_HEADER))
+          : 0;
+    }
+
+    if (!num_real_)
+    {
+      return;
+    }
+
+    // PeImage has already read the table.
+    auto const image_data = pe_file.GetImageData();
+    if (image_data &&
+        reinterpret_cast<PBYTE>(base_) == image_data->section_headers_base &&
+        image_data->section_headers.size() >= num_real_)
+    {
+      std::copy(std::begin(image_data->section_headers),
+                std::begin(image_data->section_headers) + num_real_,
+                std::begin(headers_));
+      return;
+    }
+
+    Read<IMAGE_SECTION_HEADER>(
+      process, base_, num_real_, std::begin(headers_));
+  }
+
+  explicit SectionTable(Process&& process, PeFile const& pe_file) = delete;
+
+  explicit SectionTable(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit SectionTable(Process&& process, PeFile&& pe_file) = delete;
+
+  // Address of the section table in the PE file, or nullptr if there are no
+  // sections.
+  PIMAGE_SECTION_HEADER GetBase() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return base_;
+  }
+
+  size_type size() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return headers_.size();
+  }
+
+  bool empty() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return headers_.empty();
+  }
+
+  IMAGE_SECTION_HEADER const* data() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return headers_.data();
+  }
+
+  IMAGE_SECTION_HEADER const& operator[](size_type index) const
+  {
+    HADESMEM_DETAIL_ASSERT(index < headers_.size());
+    return headers_[index];
+  }
+
+  const_iterator begin() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return headers_.data();
+  }
+
+  const_iterator cbegin() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return begin();
+  }
+
+  const_iterator end() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return headers_.data() + headers_.size();
+  }
+
+  const_iterator cend() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return end();
+  }
+
+  bool IsVirtual(size_type index) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return index >= num_real_;
+  }
+
+  // Doesn't read from the PE file.
+  Section GetSection(size_type index) const
+  {
+    HADESMEM_DETAIL_ASSERT(index < headers_.size());
+    return Section{
+      *process_, *pe_file_, base_ + index, headers_[index], IsVirtual(index)};
+  }
+
+private:
+  Process const* process_;
+  PeFile const* pe_file_;
+  PIMAGE_SECTION_HEADER base_{};
+  std::vector<IMAGE_SECTION_HEADER> headers_;
+  std::size_t num_real_{};
+};
+}
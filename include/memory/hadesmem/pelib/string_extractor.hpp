@@ -0,0 +1,520 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+#include <winnt.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+// After config.hpp, which decides whether these are needed.
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+#include <emmintrin.h>
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+#if !defined(HADESMEM_GCC) && !defined(HADESMEM_CLANG)
+#include <intrin.h>
+#endif // #if !defined(HADESMEM_GCC) && !defined(HADESMEM_CLANG)
+
+namespace hadesmem
+{
+enum class StringEncoding
+{
+  kAscii,
+  kUtf16
+};
+
+struct ExtractedString
+{
+  // File offset for PeFileType::Data, RVA for PeFileType::Image.
+  DWORD offset;
+  StringEncoding encoding;
+  // Index of the section containing the start of the string, or
+  // StringExtractor::kNoSection (e.g. for strings in the headers or the
+  // overlay).
+  WORD section;
+  // Always printable ASCII, UTF-16 strings are narrowed.
+  std::string value;
+};
+
+namespace detail
+{
+// Amount of a PE file read (and scanned) in one go.
+std::size_t const kStringScanChunkSize = 0x10000;
+
+std::size_t const kStringScanPageSize = 0x1000;
+
+// Number of bytes classified at a time, one bit per byte.
+std::size_t const kStringScanBlockSize = 64;
+
+inline std::size_t CountTrailingZeros(std::uint64_t value)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  HADESMEM_DETAIL_ASSERT(value != 0);
+
+#if defined(HADESMEM_GCC) || defined(HADESMEM_CLANG)
+  return static_cast<std::size_t>(__builtin_ctzll(value));
+#else  // #if defined(HADESMEM_GCC) || defined(HADESMEM_CLANG)
+  // _BitScanForward64 is only available on x64.
+  unsigned long index = 0;
+  if (::_BitScanForward(&index, static_cast<unsigned long>(value)))
+  {
+    return index;
+  }
+
+  ::_BitScanForward(&index, static_cast<unsigned long>(value >> 32));
+  return index + 32;
+#endif // #if defined(HADESMEM_GCC) || defined(HADESMEM_CLANG)
+}
+
+// Packs the even bits of a mask into the low 32 bits.
+inline std::uint64_t CompressEvenBits(std::uint64_t value)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  value &= 0x5555555555555555ULL;
+  value = (value | (value >> 1)) & 0x3333333333333333ULL;
+  value = (value | (value >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+  value = (value | (value >> 4)) & 0x00FF00FF00FF00FFULL;
+  value = (value | (value >> 8)) & 0x0000FFFF0000FFFFULL;
+  value = (value | (value >> 16)) & 0x00000000FFFFFFFFULL;
+  return value;
+}
+
+// Classifies a full block, setting a bit in printable for each printable
+// ASCII character (0x20 - 0x7E, the same as isprint in the classic locale)
+// and a bit in zero for each null.
+inline void ClassifyStringScanBlock(std::uint8_t const* data,
+                                    std::uint64_t& printable,
+                                    std::uint64_t& zero)
+  HADESMEM_DETAIL_NOEXCEPT
+{
+  printable = 0;
+  zero = 0;
+
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+  // SSE2 only has signed byte compares, so the range check is done as an
+  // unsigned 'c - 0x20 <= 0x5E' via min.
+  __m128i const bias = _mm_set1_epi8(0x20);
+  __m128i const range = _mm_set1_epi8(0x5E);
+  __m128i const zeros = _mm_setzero_si128();
+  for (std::size_t i = 0; i < kStringScanBlockSize; i += 16)
+  {
+    __m128i const block =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    __m128i const biased = _mm_sub_epi8(block, bias);
+    __m128i const in_range =
+      _mm_cmpeq_epi8(_mm_min_epu8(biased, range), biased);
+    printable |=
+      static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+        _mm_movemask_epi8(in_range)))
+      << i;
+    zero |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+              _mm_movemask_epi8(_mm_cmpeq_epi8(block, zeros))))
+            << i;
+  }
+#else  // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+  for (std::size_t i = 0; i < kStringScanBlockSize; ++i)
+  {
+    printable |= static_cast<std::uint64_t>(
+                   static_cast<std::uint8_t>(data[i] - 0x20) <= 0x5E)
+                 << i;
+    zero |= static_cast<std::uint64_t>(data[i] == 0) << i;
+  }
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+}
+
+// Finds runs of printable ASCII, both as single bytes and as UTF-16LE code
+// units (i.e. followed by a null) at even and odd offsets, in a single pass
+// over a stream of bytes. Each block of 64 bytes is classified once into
+// bitmasks, from which the runs for all three are found by bit scanning, so
+// blocks with nothing printable cost a handful of instructions.
+//
+// Data is fed in chunks (which must all be an even number of bytes long,
+// other than the last) and strings which span chunks are stitched together.
+// Strings are reported when they end, in order of their start offset for
+// each encoding and alignment.
+class StringScanner
+{
+public:
+  using Callback = std::function<void(
+    std::size_t offset, StringEncoding encoding, std::string const& value)>;
+
+  // Strings shorter than min_length characters (or one, if it's zero) are
+  // ignored.
+  explicit StringScanner(std::size_t min_length, Callback callback)
+    : min_length_{min_length ? min_length : 1}, callback_(std::move(callback))
+  {
+  }
+
+  // Scans the next size bytes. next is the byte after them, or -1 if it's
+  // unknown (e.g. at the end of the data), and is used to detect a UTF-16
+  // character which straddles the end of the chunk.
+  void Scan(std::uint8_t const* data, std::size_t size, int next)
+  {
+    HADESMEM_DETAIL_ASSERT(offset_ % 2 == 0);
+
+    data_ = data;
+    data_offset_ = offset_;
+
+    for (std::size_t i = 0; i < size; i += kStringScanBlockSize)
+    {
+      std::size_t const bits = (std::min)(kStringScanBlockSize, size - i);
+      std::uint64_t printable = 0;
+      std::uint64_t zero = 0;
+      if (bits == kStringScanBlockSize)
+      {
+        ClassifyStringScanBlock(data + i, printable, zero);
+      }
+      else
+      {
+        std::uint8_t tail[kStringScanBlockSize] = {};
+        std::memcpy(tail, data + i, bits);
+        ClassifyStringScanBlock(tail, printable, zero);
+      }
+
+      std::uint64_t const valid =
+        bits == kStringScanBlockSize ? ~0ULL : (1ULL << bits) - 1;
+      printable &= valid;
+
+      // Whether the byte after each byte is zero, including the last one.
+      bool const next_zero =
+        i + bits < size ? data[i + bits] == 0 : next == 0;
+      std::uint64_t next_is_zero = (zero >> 1) & (valid >> 1);
+      next_is_zero |= static_cast<std::uint64_t>(next_zero) << (bits - 1);
+      std::uint64_t const wide = printable & next_is_zero;
+
+      std::size_t const block_offset = offset_ + i;
+      Track(ascii_run_,
+            StringEncoding::kAscii,
+            printable,
+            bits,
+            block_offset,
+            1);
+      Track(even_run_,
+            StringEncoding::kUtf16,
+            CompressEvenBits(wide),
+            (bits + 1) / 2,
+            block_offset,
+            2);
+      Track(odd_run_,
+            StringEncoding::kUtf16,
+            CompressEvenBits(wide >> 1),
+            bits / 2,
+            block_offset + 1,
+            2);
+    }
+
+    offset_ += size;
+
+    // The data is gone once this returns, so save anything from it which is
+    // part of a string that's still going.
+    Save(ascii_run_, 1);
+    Save(even_run_, 2);
+    Save(odd_run_, 2);
+  }
+
+  // Skips size bytes (e.g. unreadable memory), ending any strings in
+  // progress.
+  void Skip(std::size_t size)
+  {
+    Finish();
+    offset_ += size;
+  }
+
+  // Reports any strings in progress. Must be called after the last chunk.
+  void Finish()
+  {
+    End(ascii_run_, StringEncoding::kAscii, offset_, 1);
+    End(even_run_, StringEncoding::kUtf16, offset_, 2);
+    End(odd_run_, StringEncoding::kUtf16, offset_, 2);
+  }
+
+private:
+  struct Run
+  {
+    bool active{false};
+    std::size_t start{0};
+    std::size_t length{0};
+    // Offset of the first character not yet copied into value.
+    std::size_t next{0};
+    std::string value;
+  };
+
+  // Bit n of mask is set if there's a character at offset + n * stride.
+  void Track(Run& run,
+             StringEncoding encoding,
+             std::uint64_t mask,
+             std::size_t bits,
+             std::size_t offset,
+             std::size_t stride)
+  {
+    std::size_t pos = 0;
+    while (pos < bits)
+    {
+      if (!run.active)
+      {
+        std::uint64_t const rest = mask >> pos;
+        if (!rest)
+        {
+          return;
+        }
+
+        pos += CountTrailingZeros(rest);
+        run.active = true;
+        run.start = offset + pos * stride;
+        run.next = run.start;
+        run.length = 0;
+      }
+
+      // Bits shifted in at the top are zeros, so this is only all ones if
+      // the whole mask is.
+      std::uint64_t const gaps = ~(mask >> pos);
+      std::size_t const ones =
+        (std::min)(gaps ? CountTrailingZeros(gaps) : bits, bits - pos);
+      run.length += ones;
+      pos += ones;
+
+      if (pos < bits)
+      {
+        End(run, encoding, offset + pos * stride, stride);
+      }
+    }
+  }
+
+  // Copies the characters in [run.next, end) out of the current chunk.
+  void Append(Run& run, std::size_t end, std::size_t stride)
+  {
+    for (; run.next < end; run.next += stride)
+    {
+      HADESMEM_DETAIL_ASSERT(run.next >= data_offset_);
+      run.value.push_back(static_cast<char>(data_[run.next - data_offset_]));
+    }
+  }
+
+  void Save(Run& run, std::size_t stride)
+  {
+    if (run.active)
+    {
+      Append(run, offset_, stride);
+    }
+  }
+
+  void End(Run& run,
+           StringEncoding encoding,
+           std::size_t end,
+           std::size_t stride)
+  {
+    if (!run.active)
+    {
+      return;
+    }
+
+    if (run.length >= min_length_)
+    {
+      Append(run, end, stride);
+      callback_(run.start, encoding, run.value);
+    }
+
+    run.value.clear();
+    run.active = false;
+  }
+
+  std::size_t min_length_;
+  Callback callback_;
+  std::size_t offset_{0};
+  std::uint8_t const* data_{nullptr};
+  std::size_t data_offset_{0};
+  Run ascii_run_;
+  Run even_run_;
+  Run odd_run_;
+};
+}
+
+// Extracts printable ASCII and UTF-16LE strings (at both alignments) from a
+// PE file in one pass, and attributes them to sections. Works on data files,
+// and on images (including modules in other processes and image layout
+// buffers from MapPeImage), in which case offsets are RVAs and memory which
+// can't be read (e.g. reserved pages) simply ends any string in progress.
+//
+// The file is read a chunk at a time, so this never needs a copy of the
+// whole file (or image).
+class StringExtractor
+{
+public:
+  static WORD const kNoSection = 0xFFFF;
+
+  explicit StringExtractor(Process const& process,
+                           PeFile const& pe_file,
+                           std::size_t min_length = 3)
+  {
+    Extract(process, pe_file, min_length);
+  }
+
+  explicit StringExtractor(Process&& process,
+                           PeFile const& pe_file,
+                           std::size_t min_length = 3) = delete;
+
+  explicit StringExtractor(Process const& process,
+                           PeFile&& pe_file,
+                           std::size_t min_length = 3) = delete;
+
+  explicit StringExtractor(Process&& process,
+                           PeFile&& pe_file,
+                           std::size_t min_length = 3) = delete;
+
+  // Sorted by offset (then encoding).
+  std::vector<ExtractedString> const& GetStrings() const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return strings_;
+  }
+
+private:
+  struct SectionRange
+  {
+    DWORD begin;
+    DWORD end;
+    WORD index;
+  };
+
+  void Extract(Process const& process,
+               PeFile const& pe_file,
+               std::size_t min_length)
+  {
+    bool const is_data = pe_file.GetType() == PeFileType::Data;
+    NtHeaders const nt_headers{process, pe_file};
+    DWORD const size =
+      is_data ? pe_file.GetSize() : nt_headers.GetSizeOfImage();
+
+    detail::StringScanner scanner{
+      min_length,
+      [&](std::size_t offset,
+          StringEncoding encoding,
+          std::string const& value)
+      {
+        ExtractedString const string = {
+          static_cast<DWORD>(offset), encoding, kNoSection, value};
+        strings_.push_back(string);
+      }};
+
+    auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+    std::vector<std::uint8_t> buf(detail::kStringScanChunkSize + 1);
+    // Reads and scans a range along with the byte after it (if possible).
+    auto const scan = [&](DWORD offset, DWORD len) -> bool
+    {
+      if (offset + len < size &&
+          detail::TryReadUnchecked(process, base + offset, buf.data(), len + 1))
+      {
+        scanner.Scan(buf.data(), len, buf[len]);
+        return true;
+      }
+
+      if (detail::TryReadUnchecked(process, base + offset, buf.data(), len))
+      {
+        scanner.Scan(buf.data(), len, -1);
+        return true;
+      }
+
+      return false;
+    };
+
+    for (DWORD offset = 0; offset < size;)
+    {
+      auto const chunk_size = static_cast<DWORD>(
+        (std::min)(detail::kStringScanChunkSize,
+                   static_cast<std::size_t>(size - offset)));
+      if (!scan(offset, chunk_size))
+      {
+        // Some of it might be readable, so fall back to single pages.
+        for (DWORD page = offset; page < offset + chunk_size;)
+        {
+          auto const page_size = static_cast<DWORD>(
+            (std::min)(detail::kStringScanPageSize,
+                       static_cast<std::size_t>(offset + chunk_size - page)));
+          if (!scan(page, page_size))
+          {
+            scanner.Skip(page_size);
+          }
+          page += page_size;
+        }
+      }
+      offset += chunk_size;
+    }
+
+    scanner.Finish();
+
+    std::sort(std::begin(strings_),
+              std::end(strings_),
+              [](ExtractedString const& lhs, ExtractedString const& rhs)
+              {
+      return lhs.offset < rhs.offset ||
+             (lhs.offset == rhs.offset && lhs.encoding < rhs.encoding);
+    });
+
+    AssignSections(process, pe_file, is_data);
+  }
+
+  void AssignSections(Process const& process,
+                      PeFile const& pe_file,
+                      bool is_data)
+  {
+    std::vector<SectionRange> ranges;
+    WORD index = 0;
+    SectionList const sections{process, pe_file};
+    for (auto const& section : sections)
+    {
+      DWORD const begin =
+        is_data ? section.GetPointerToRawData() : section.GetVirtualAddress();
+      DWORD const section_size =
+        is_data || !section.GetVirtualSize() ? section.GetSizeOfRawData()
+                                              : section.GetVirtualSize();
+      // Saturate rather than wrap, for malformed sections.
+      DWORD const end = begin + section_size < begin
+                          ? (std::numeric_limits<DWORD>::max)()
+                          : begin + section_size;
+      if (begin != end)
+      {
+        SectionRange const range = {begin, end, index};
+        ranges.push_back(range);
+      }
+      ++index;
+    }
+
+    // Sections can overlap in malformed files, in which case the first one
+    // (in the section table) wins.
+    for (auto& string : strings_)
+    {
+      for (auto const& range : ranges)
+      {
+        if (string.offset >= range.begin && string.offset < range.end)
+        {
+          string.section = range.index;
+          break;
+        }
+      }
+    }
+  }
+
+  std::vector<ExtractedString> strings_;
+};
+}
@@ -0,0 +1,375 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pointer_scanner.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+class PointerChain;
+
+inline std::vector<PVOID>
+  ResolvePointerChains(Process const& process,
+                       std::vector<PointerChain*> const& chains);
+
+// A multi-level pointer such as [[[game.exe+0x1A2B3C]+0x10]+0x48]+0x20,
+// compiled once and resolved many times.
+//
+// The pointer read at each level is cached. A cached walk is trusted without
+// touching the target until it expires (either after the TTL, or when the
+// caller moves to a new generation, e.g. once per frame). Expired walks are
+// revalidated by re-reading every level in one coalesced batch (the level
+// addresses are all known from the cache), and only the levels below the
+// first changed pointer are walked again.
+//
+// The module base is looked up once, at construction.
+class PointerChain
+{
+public:
+  explicit PointerChain(Process const& process,
+                        PVOID base,
+                        std::vector<std::uint32_t> const& offsets)
+    : process_{&process},
+      base_{reinterpret_cast<std::uintptr_t>(base)},
+      offsets_(offsets),
+      values_(offsets.size())
+  {
+    Verify();
+  }
+
+  explicit PointerChain(Process const& process,
+                        std::wstring const& module_name,
+                        std::uintptr_t module_offset,
+                        std::vector<std::uint32_t> const& offsets)
+    : process_{&process},
+      base_{GetModuleBase(process, module_name) + module_offset},
+      offsets_(offsets),
+      values_(offsets.size())
+  {
+    Verify();
+  }
+
+  explicit PointerChain(Process const& process, PointerPath const& path)
+    : process_{&process},
+      base_{GetModuleBase(process, path.module_name) + path.module_offset},
+      offsets_(path.offsets),
+      values_(path.offsets.size())
+  {
+    Verify();
+  }
+
+  explicit PointerChain(Process&& process,
+                        PVOID base,
+                        std::vector<std::uint32_t> const& offsets) = delete;
+
+  explicit PointerChain(Process&& process,
+                        std::wstring const& module_name,
+                        std::uintptr_t module_offset,
+                        std::vector<std::uint32_t> const& offsets) = delete;
+
+  explicit PointerChain(Process&& process, PointerPath const& path) = delete;
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  PointerChain(PointerChain const&) = default;
+
+  PointerChain& operator=(PointerChain const&) = default;
+
+  PointerChain(PointerChain&& other) HADESMEM_DETAIL_NOEXCEPT
+    : process_{other.process_},
+      base_{other.base_},
+      offsets_(std::move(other.offsets_)),
+      values_(std::move(other.values_)),
+      num_valid_{other.num_valid_},
+      ttl_{other.ttl_},
+      validated_at_{other.validated_at_},
+      generation_{other.generation_},
+      has_generation_{other.has_generation_}
+  {
+  }
+
+  PointerChain& operator=(PointerChain&& other) HADESMEM_DETAIL_NOEXCEPT
+  {
+    process_ = other.process_;
+    base_ = other.base_;
+    offsets_ = std::move(other.offsets_);
+    values_ = std::move(other.values_);
+    num_valid_ = other.num_valid_;
+    ttl_ = other.ttl_;
+    validated_at_ = other.validated_at_;
+    generation_ = other.generation_;
+    has_generation_ = other.has_generation_;
+
+    return *this;
+  }
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  PVOID GetBase() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return reinterpret_cast<PVOID>(base_);
+  }
+
+  std::vector<std::uint32_t> const& GetOffsets() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return offsets_;
+  }
+
+  // A TTL of zero (the default) revalidates on every call to Resolve().
+  void SetTtl(std::chrono::milliseconds ttl) HADESMEM_DETAIL_NOEXCEPT
+  {
+    ttl_ = ttl;
+  }
+
+  // Returns nullptr if any pointer along the chain is unreadable or null.
+  PVOID Resolve()
+  {
+    if (IsComplete() && !has_generation_ &&
+        std::chrono::steady_clock::now() - validated_at_ < ttl_)
+    {
+      return GetResult();
+    }
+
+    has_generation_ = false;
+    return Revalidate();
+  }
+
+  // As above, but the cache is trusted for as long as the caller passes the
+  // same generation (the TTL is ignored).
+  PVOID Resolve(std::uint64_t generation)
+  {
+    if (IsComplete() && has_generation_ && generation_ == generation)
+    {
+      return GetResult();
+    }
+
+    PVOID const result = Revalidate();
+    generation_ = generation;
+    has_generation_ = true;
+    return result;
+  }
+
+  void Invalidate() HADESMEM_DETAIL_NOEXCEPT
+  {
+    num_valid_ = 0;
+    has_generation_ = false;
+  }
+
+private:
+  friend std::vector<PVOID>
+    ResolvePointerChains(Process const& process,
+                         std::vector<PointerChain*> const& chains);
+
+  static std::uintptr_t GetModuleBase(Process const& process,
+                                      std::wstring const& module_name)
+  {
+    Module const module{process, module_name};
+    return reinterpret_cast<std::uintptr_t>(module.GetHandle());
+  }
+
+  void Verify() const
+  {
+    if (offsets_.empty())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Pointer chain must have at least one level."});
+    }
+  }
+
+  bool IsComplete() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return num_valid_ == offsets_.size();
+  }
+
+  std::uintptr_t GetLevelAddress(std::size_t level) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    return level ? values_[level - 1] + offsets_[level - 1] : base_;
+  }
+
+  PVOID GetResult() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    HADESMEM_DETAIL_ASSERT(IsComplete());
+    return reinterpret_cast<PVOID>(values_.back() + offsets_.back());
+  }
+
+  // Records the pointer read at a level. Returns false (and truncates the
+  // cache) if the read failed or the pointer is null.
+  bool SetLevel(std::size_t level,
+                bool success,
+                std::uintptr_t value) HADESMEM_DETAIL_NOEXCEPT
+  {
+    if (!success || !value)
+    {
+      num_valid_ = level;
+      return false;
+    }
+
+    values_[level] = value;
+    num_valid_ = level + 1;
+    return true;
+  }
+
+  void MarkValidated()
+  {
+    validated_at_ = std::chrono::steady_clock::now();
+  }
+
+  PVOID Revalidate()
+  {
+    if (num_valid_)
+    {
+      std::size_t const num_cached = num_valid_;
+      std::vector<std::uintptr_t> current(num_cached);
+      std::vector<detail::CoalescedRead> requests(num_cached);
+      for (std::size_t i = 0; i < num_cached; ++i)
+      {
+        detail::CoalescedRead const request = {
+          reinterpret_cast<void*>(GetLevelAddress(i)),
+          sizeof(std::uintptr_t),
+          &current[i],
+          false};
+        requests[i] = request;
+      }
+
+      detail::ReadCoalesced(*process_, requests.data(), requests.size());
+
+      for (std::size_t i = 0; i < num_cached; ++i)
+      {
+        if (!requests[i].success || current[i] != values_[i])
+        {
+          if (!SetLevel(i, requests[i].success, current[i]))
+          {
+            MarkValidated();
+            return nullptr;
+          }
+
+          break;
+        }
+      }
+    }
+
+    for (std::size_t i = num_valid_; i < offsets_.size(); ++i)
+    {
+      std::uintptr_t value = 0;
+      bool const success =
+        detail::TryReadUnchecked(*process_,
+                                 reinterpret_cast<void*>(GetLevelAddress(i)),
+                                 &value,
+                                 sizeof(value));
+      if (!SetLevel(i, success, value))
+      {
+        MarkValidated();
+        return nullptr;
+      }
+    }
+
+    MarkValidated();
+    return GetResult();
+  }
+
+  Process const* process_;
+  std::uintptr_t base_;
+  std::vector<std::uint32_t> offsets_;
+  std::vector<std::uintptr_t> values_;
+  std::size_t num_valid_{};
+  std::chrono::milliseconds ttl_{};
+  std::chrono::steady_clock::time_point validated_at_;
+  std::uint64_t generation_{};
+  bool has_generation_{};
+};
+
+// Resolves many chains in lockstep, one coalesced batch of reads per level,
+// so chains which share intermediate objects (or whose pointers live on the
+// same page) cost one read between them. Chains whose cache is still fresh
+// (by TTL) are not read at all. Every chain's cache is updated, so this can be
+// mixed freely with PointerChain::Resolve.
+inline std::vector<PVOID>
+  ResolvePointerChains(Process const& process,
+                       std::vector<PointerChain*> const& chains)
+{
+  std::vector<PVOID> results(chains.size());
+  std::vector<std::size_t> active;
+  std::size_t max_levels = 0;
+  auto const now = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < chains.size(); ++i)
+  {
+    PointerChain& chain = *chains[i];
+    HADESMEM_DETAIL_ASSERT(chain.process_->GetId() == process.GetId());
+    if (chain.IsComplete() && !chain.has_generation_ &&
+        now - chain.validated_at_ < chain.ttl_)
+    {
+      results[i] = chain.GetResult();
+    }
+    else
+    {
+      chain.num_valid_ = 0;
+      chain.has_generation_ = false;
+      active.push_back(i);
+      max_levels = (std::max)(max_levels, chain.offsets_.size());
+    }
+  }
+
+  std::vector<std::uintptr_t> values;
+  std::vector<detail::CoalescedRead> requests;
+  for (std::size_t level = 0; level < max_levels && !active.empty(); ++level)
+  {
+    values.assign(active.size(), 0);
+    requests.clear();
+    for (std::size_t i = 0; i < active.size(); ++i)
+    {
+      PointerChain const& chain = *chains[active[i]];
+      detail::CoalescedRead const request = {
+        reinterpret_cast<void*>(chain.GetLevelAddress(level)),
+        sizeof(std::uintptr_t),
+        &values[i],
+        false};
+      requests.push_back(request);
+    }
+
+    detail::ReadCoalesced(process, requests.data(), requests.size());
+
+    std::vector<std::size_t> next_active;
+    for (std::size_t i = 0; i < active.size(); ++i)
+    {
+      PointerChain& chain = *chains[active[i]];
+      if (!chain.SetLevel(level, requests[i].success, values[i]))
+      {
+        chain.MarkValidated();
+        continue;
+      }
+
+      if (chain.IsComplete())
+      {
+        chain.MarkValidated();
+        results[active[i]] = chain.GetResult();
+      }
+      else
+      {
+        next_active.push_back(active[i]);
+      }
+    }
+
+    active = std::move(next_active);
+  }
+
+  return results;
+}
+}
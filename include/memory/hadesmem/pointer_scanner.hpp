@@ -0,0 +1,618 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/parallel_for.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/scan_region.hpp>
+#include <hadesmem/detail/to_upper_ordinal.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/module_list.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// A path from a static location inside a module to a target address. The
+// pointer stored at module base + module_offset is dereferenced, the first
+// offset is added, the result is dereferenced, and so on. The final offset is
+// added without dereferencing.
+struct PointerPath
+{
+  std::wstring module_name;
+  std::uintptr_t module_offset;
+  std::vector<std::uint32_t> offsets;
+};
+
+namespace detail
+{
+// Amount of memory read in one go by a single worker while building the
+// index.
+std::size_t const kPointerScanChunkSize = 0x100000;
+
+// Default upper bound on the number of index entries. Each entry is two
+// pointers wide, so on x64 this caps the index at 1GB.
+std::size_t const kPointerScanDefaultMaxIndexEntries = 0x4000000;
+
+// Upper bound on the number of intermediate addresses visited by a single
+// scan.
+std::size_t const kPointerScanMaxNodes = 0x400000;
+
+std::uint32_t const kPointerPathFileMagic = 0x50504D48; // "HMPP"
+std::uint32_t const kPointerPathFileVersion = 1;
+
+struct PointerIndexEntry
+{
+  std::uintptr_t value;
+  std::uintptr_t location;
+};
+
+inline bool operator<(PointerIndexEntry const& lhs,
+                      PointerIndexEntry const& rhs) HADESMEM_DETAIL_NOEXCEPT
+{
+  return lhs.value < rhs.value ||
+         (lhs.value == rhs.value && lhs.location < rhs.location);
+}
+
+struct PointerScanModule
+{
+  std::wstring name;
+  std::uintptr_t base;
+  std::uintptr_t end;
+};
+
+inline bool IsInScanRanges(std::vector<ScanRange> const& ranges,
+                           std::uintptr_t address) HADESMEM_DETAIL_NOEXCEPT
+{
+  auto const iter = std::upper_bound(std::begin(ranges),
+                                     std::end(ranges),
+                                     address,
+                                     [](std::uintptr_t a, ScanRange const& r)
+                                     {
+                                       return a < r.base;
+                                     });
+  if (iter == std::begin(ranges))
+  {
+    return false;
+  }
+
+  auto const& range = *(iter - 1);
+  return address - range.base < range.size;
+}
+
+template <typename T>
+void AppendPointerPathData(std::vector<char>& buf, T const& value)
+{
+  auto const p = reinterpret_cast<char const*>(&value);
+  buf.insert(std::end(buf), p, p + sizeof(T));
+}
+
+template <typename T>
+T ReadPointerPathData(std::vector<char> const& buf, std::size_t& pos)
+{
+  if (buf.size() - pos < sizeof(T))
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Unexpected end of pointer path file."});
+  }
+
+  T value;
+  std::memcpy(&value, buf.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return value;
+}
+}
+
+// Finds pointer paths from static module data to a dynamic address.
+//
+// Construction takes a snapshot of every aligned pointer-sized value in the
+// scanned regions which points back into a scanned region, sorted by value.
+// The snapshot can then be searched for any number of targets. The index is
+// capped at max_index_entries to keep memory bounded on large targets; if the
+// cap is hit construction fails and the caller should narrow the scan (e.g.
+// MemoryScanFlags::kWritableOnly).
+class PointerScanner
+{
+public:
+  explicit PointerScanner(
+    Process const& process,
+    std::uint32_t flags = MemoryScanFlags::kNone,
+    std::size_t max_index_entries = detail::kPointerScanDefaultMaxIndexEntries,
+    std::size_t num_threads = 0)
+    : process_{&process}
+  {
+    BuildModules();
+    BuildIndex(flags, max_index_entries, num_threads);
+  }
+
+  explicit PointerScanner(
+    Process&& process,
+    std::uint32_t flags = MemoryScanFlags::kNone,
+    std::size_t max_index_entries = detail::kPointerScanDefaultMaxIndexEntries,
+    std::size_t num_threads = 0) = delete;
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  PointerScanner(PointerScanner const&) = default;
+
+  PointerScanner& operator=(PointerScanner const&) = default;
+
+  PointerScanner(PointerScanner&& other) HADESMEM_DETAIL_NOEXCEPT
+    : process_{other.process_},
+      modules_(std::move(other.modules_)),
+      index_(std::move(other.index_))
+  {
+  }
+
+  PointerScanner& operator=(PointerScanner&& other) HADESMEM_DETAIL_NOEXCEPT
+  {
+    process_ = other.process_;
+    modules_ = std::move(other.modules_);
+    index_ = std::move(other.index_);
+
+    return *this;
+  }
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  std::size_t GetIndexSize() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return index_.size();
+  }
+
+  // Breadth-first search outwards from the target, so shorter paths are
+  // always reported first. Each intermediate address is expanded at most
+  // once (at its shallowest depth).
+  std::vector<PointerPath>
+    Scan(PVOID target,
+         std::size_t max_depth,
+         std::uint32_t max_offset,
+         std::size_t max_results =
+           (std::numeric_limits<std::size_t>::max)()) const
+  {
+    struct Node
+    {
+      std::uintptr_t address;
+      std::size_t next;
+      std::uint32_t offset;
+    };
+
+    std::size_t const kNoNext = static_cast<std::size_t>(-1);
+
+    std::vector<PointerPath> results;
+    if (!max_depth || !max_results)
+    {
+      return results;
+    }
+
+    std::vector<Node> nodes;
+    std::unordered_set<std::uintptr_t> visited;
+    Node const root = {reinterpret_cast<std::uintptr_t>(target), kNoNext, 0};
+    nodes.push_back(root);
+    visited.insert(root.address);
+
+    std::size_t level_begin = 0;
+    for (std::size_t depth = 1; depth <= max_depth; ++depth)
+    {
+      std::size_t const level_end = nodes.size();
+      for (std::size_t n = level_begin; n < level_end; ++n)
+      {
+        std::uintptr_t const address = nodes[n].address;
+        std::uintptr_t const lowest =
+          address >= max_offset ? address - max_offset : 0;
+        detail::PointerIndexEntry const lower_key = {lowest, 0};
+        auto iter =
+          std::lower_bound(std::begin(index_), std::end(index_), lower_key);
+        for (; iter != std::end(index_) && iter->value <= address; ++iter)
+        {
+          auto const offset = static_cast<std::uint32_t>(address - iter->value);
+          auto const module = FindModule(iter->location);
+          if (module)
+          {
+            PointerPath path;
+            path.module_name = module->name;
+            path.module_offset = iter->location - module->base;
+            path.offsets.push_back(offset);
+            for (std::size_t i = n; nodes[i].next != kNoNext;
+                 i = nodes[i].next)
+            {
+              path.offsets.push_back(nodes[i].offset);
+            }
+            results.emplace_back(std::move(path));
+
+            if (results.size() >= max_results)
+            {
+              return results;
+            }
+          }
+          else if (depth < max_depth &&
+                   nodes.size() < detail::kPointerScanMaxNodes &&
+                   visited.insert(iter->location).second)
+          {
+            Node const node = {iter->location, n, offset};
+            nodes.push_back(node);
+          }
+        }
+      }
+
+      level_begin = level_end;
+      if (level_begin == nodes.size())
+      {
+        break;
+      }
+    }
+
+    return results;
+  }
+
+private:
+  void BuildModules()
+  {
+    for (auto const& module : ModuleList{*process_})
+    {
+      auto const base = reinterpret_cast<std::uintptr_t>(module.GetHandle());
+      detail::PointerScanModule const entry = {
+        module.GetName(), base, base + module.GetSize()};
+      modules_.push_back(entry);
+    }
+
+    std::sort(std::begin(modules_),
+              std::end(modules_),
+              [](detail::PointerScanModule const& lhs,
+                 detail::PointerScanModule const& rhs)
+              {
+      return lhs.base < rhs.base;
+    });
+  }
+
+  detail::PointerScanModule const* FindModule(std::uintptr_t address) const
+    HADESMEM_DETAIL_NOEXCEPT
+  {
+    auto const iter =
+      std::upper_bound(std::begin(modules_),
+                       std::end(modules_),
+                       address,
+                       [](std::uintptr_t a, detail::PointerScanModule const& m)
+                       {
+                         return a < m.base;
+                       });
+    if (iter == std::begin(modules_) || address >= (iter - 1)->end)
+    {
+      return nullptr;
+    }
+
+    return &*(iter - 1);
+  }
+
+  void BuildIndex(std::uint32_t flags,
+                  std::size_t max_index_entries,
+                  std::size_t num_threads)
+  {
+    auto const ranges = detail::GetScanRegions(*process_, flags);
+    auto const chunks =
+      detail::SplitScanRegions(ranges, detail::kPointerScanChunkSize);
+
+    std::atomic<std::size_t> total{0};
+    std::vector<std::vector<detail::PointerIndexEntry>> results(chunks.size());
+    detail::ParallelFor(
+      chunks.size(),
+      [&](std::size_t i)
+      {
+        auto const& chunk = chunks[i];
+        std::vector<std::uintptr_t> buf(chunk.size / sizeof(std::uintptr_t));
+        try
+        {
+          detail::ReadUnchecked(*process_,
+                                reinterpret_cast<void*>(chunk.base),
+                                buf.data(),
+                                buf.size() * sizeof(std::uintptr_t));
+        }
+        catch (Error const& /*e*/)
+        {
+          return;
+        }
+
+        auto& entries = results[i];
+        for (std::size_t j = 0; j < buf.size(); ++j)
+        {
+          if (detail::IsInScanRanges(ranges, buf[j]))
+          {
+            detail::PointerIndexEntry const entry = {
+              buf[j], chunk.base + j * sizeof(std::uintptr_t)};
+            entries.push_back(entry);
+          }
+        }
+
+        if ((total += entries.size()) > max_index_entries)
+        {
+          HADESMEM_DETAIL_THROW_EXCEPTION(
+            Error{} << ErrorString{"Pointer index size limit exceeded."});
+        }
+
+        std::sort(std::begin(entries), std::end(entries));
+      },
+      num_threads);
+
+    std::vector<std::size_t> bounds;
+    bounds.reserve(results.size() + 1);
+    bounds.push_back(0);
+    index_.reserve(total);
+    for (auto& result : results)
+    {
+      if (!result.empty())
+      {
+        index_.insert(std::end(index_), std::begin(result), std::end(result));
+        bounds.push_back(index_.size());
+      }
+
+      result = std::vector<detail::PointerIndexEntry>();
+    }
+
+    // Pairwise merge of the sorted runs, one level at a time.
+    while (bounds.size() > 2)
+    {
+      std::size_t const num_pairs = (bounds.size() - 1) / 2;
+      detail::ParallelFor(num_pairs,
+                          [&](std::size_t i)
+                          {
+                            auto const begin = std::begin(index_);
+                            std::inplace_merge(begin + bounds[i * 2],
+                                               begin + bounds[i * 2 + 1],
+                                               begin + bounds[i * 2 + 2]);
+                          },
+                          num_threads);
+
+      std::vector<std::size_t> new_bounds;
+      for (std::size_t i = 0; i < bounds.size(); i += 2)
+      {
+        new_bounds.push_back(bounds[i]);
+      }
+      if (new_bounds.back() != bounds.back())
+      {
+        new_bounds.push_back(bounds.back());
+      }
+      bounds = std::move(new_bounds);
+    }
+  }
+
+  Process const* process_;
+  std::vector<detail::PointerScanModule> modules_;
+  std::vector<detail::PointerIndexEntry> index_;
+};
+
+// Returns nullptr if any pointer along the path is unreadable or null, and
+// throws if the module is not loaded.
+// Module bases are looked up by name in the given process, so paths can be
+// re-validated against a later instance of the target.
+inline PVOID ResolvePointerPath(Process const& process, PointerPath const& path)
+{
+  Module const module{process, path.module_name};
+  if (path.module_offset >= module.GetSize() || path.offsets.empty())
+  {
+    return nullptr;
+  }
+
+  std::uintptr_t address =
+    reinterpret_cast<std::uintptr_t>(module.GetHandle()) + path.module_offset;
+  for (auto const offset : path.offsets)
+  {
+    std::uintptr_t value = 0;
+    try
+    {
+      value =
+        Read<std::uintptr_t>(process, reinterpret_cast<PVOID>(address));
+    }
+    catch (Error const& /*e*/)
+    {
+      return nullptr;
+    }
+
+    if (!value)
+    {
+      return nullptr;
+    }
+
+    address = value + offset;
+  }
+
+  return reinterpret_cast<PVOID>(address);
+}
+
+// Returns the paths which still lead to the target.
+inline std::vector<PointerPath>
+  FilterPointerPaths(Process const& process,
+                     std::vector<PointerPath> const& paths,
+                     PVOID target)
+{
+  std::map<std::wstring, bool> module_present;
+  std::vector<PointerPath> results;
+  for (auto const& path : paths)
+  {
+    std::wstring const name_upper = detail::ToUpperOrdinal(path.module_name);
+    auto iter = module_present.find(name_upper);
+    if (iter == std::end(module_present))
+    {
+      bool present = true;
+      try
+      {
+        Module const module{process, path.module_name};
+      }
+      catch (Error const& /*e*/)
+      {
+        present = false;
+      }
+      iter = module_present.insert(std::make_pair(name_upper, present)).first;
+    }
+
+    if (iter->second && ResolvePointerPath(process, path) == target)
+    {
+      results.push_back(path);
+    }
+  }
+
+  return results;
+}
+
+// File layout (little endian):
+//   u32 magic, u32 version, u32 pointer size
+//   u32 module count, then per module: u32 length, UTF-16 name
+//   u64 path count, then per path: u32 module index, u64 module offset,
+//     u8 offset count, u32 offsets
+inline void SavePointerPaths(std::wstring const& path,
+                             std::vector<PointerPath> const& paths)
+{
+  std::vector<std::wstring> names;
+  std::map<std::wstring, std::uint32_t> name_indexes;
+  for (auto const& p : paths)
+  {
+    if (name_indexes.find(p.module_name) == std::end(name_indexes))
+    {
+      name_indexes[p.module_name] = static_cast<std::uint32_t>(names.size());
+      names.push_back(p.module_name);
+    }
+  }
+
+  std::vector<char> buf;
+  detail::AppendPointerPathData(buf, detail::kPointerPathFileMagic);
+  detail::AppendPointerPathData(buf, detail::kPointerPathFileVersion);
+  detail::AppendPointerPathData(
+    buf, static_cast<std::uint32_t>(sizeof(std::uintptr_t)));
+  detail::AppendPointerPathData(buf, static_cast<std::uint32_t>(names.size()));
+  for (auto const& name : names)
+  {
+    detail::AppendPointerPathData(buf, static_cast<std::uint32_t>(name.size()));
+    for (auto const c : name)
+    {
+      detail::AppendPointerPathData(buf, static_cast<std::uint16_t>(c));
+    }
+  }
+
+  detail::AppendPointerPathData(buf, static_cast<std::uint64_t>(paths.size()));
+  for (auto const& p : paths)
+  {
+    if (p.offsets.size() > (std::numeric_limits<std::uint8_t>::max)())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Too many offsets in pointer path."});
+    }
+
+    detail::AppendPointerPathData(buf, name_indexes[p.module_name]);
+    detail::AppendPointerPathData(
+      buf, static_cast<std::uint64_t>(p.module_offset));
+    detail::AppendPointerPathData(
+      buf, static_cast<std::uint8_t>(p.offsets.size()));
+    for (auto const offset : p.offsets)
+    {
+      detail::AppendPointerPathData(buf, offset);
+    }
+  }
+
+  auto const file = detail::OpenFile<char>(
+    path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!*file)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Failed to open pointer path file."});
+  }
+
+  file->write(buf.data(), static_cast<std::streamsize>(buf.size()));
+  if (!*file)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Failed to write pointer path file."});
+  }
+}
+
+inline std::vector<PointerPath> LoadPointerPaths(std::wstring const& path)
+{
+  auto const file =
+    detail::OpenFile<char>(path, std::ios::in | std::ios::binary);
+  if (!*file)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Failed to open pointer path file."});
+  }
+
+  std::vector<char> const buf((std::istreambuf_iterator<char>(*file)),
+                              std::istreambuf_iterator<char>());
+  std::size_t pos = 0;
+
+  if (detail::ReadPointerPathData<std::uint32_t>(buf, pos) !=
+        detail::kPointerPathFileMagic ||
+      detail::ReadPointerPathData<std::uint32_t>(buf, pos) !=
+        detail::kPointerPathFileVersion)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Invalid pointer path file header."});
+  }
+
+  if (detail::ReadPointerPathData<std::uint32_t>(buf, pos) !=
+      sizeof(std::uintptr_t))
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Pointer path file architecture mismatch."});
+  }
+
+  auto const num_names = detail::ReadPointerPathData<std::uint32_t>(buf, pos);
+  std::vector<std::wstring> names;
+  for (std::uint32_t i = 0; i < num_names; ++i)
+  {
+    auto const len = detail::ReadPointerPathData<std::uint32_t>(buf, pos);
+    std::wstring name;
+    for (std::uint32_t j = 0; j < len; ++j)
+    {
+      name.push_back(static_cast<wchar_t>(
+        detail::ReadPointerPathData<std::uint16_t>(buf, pos)));
+    }
+    names.emplace_back(std::move(name));
+  }
+
+  auto const num_paths = detail::ReadPointerPathData<std::uint64_t>(buf, pos);
+  std::vector<PointerPath> paths;
+  for (std::uint64_t i = 0; i < num_paths; ++i)
+  {
+    auto const name_index =
+      detail::ReadPointerPathData<std::uint32_t>(buf, pos);
+    if (name_index >= names.size())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid module index in pointer path file."});
+    }
+
+    PointerPath p;
+    p.module_name = names[name_index];
+    p.module_offset = static_cast<std::uintptr_t>(
+      detail::ReadPointerPathData<std::uint64_t>(buf, pos));
+    auto const num_offsets =
+      detail::ReadPointerPathData<std::uint8_t>(buf, pos);
+    for (std::uint8_t j = 0; j < num_offsets; ++j)
+    {
+      p.offsets.push_back(detail::ReadPointerPathData<std::uint32_t>(buf, pos));
+    }
+    paths.emplace_back(std::move(p));
+  }
+
+  return paths;
+}
+}
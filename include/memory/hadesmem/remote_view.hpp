@@ -0,0 +1,302 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/detail/type_traits.hpp>
+#include <hadesmem/detail/write_impl.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// Granularity at which RemoteView fetches the remote object.
+std::size_t const kRemoteViewLineSize = 64;
+
+// A lazily fetched local copy of a T living in another process.
+//
+// Fields are accessed through member pointers (view.Get(&Foo::bar)). Only the
+// cache lines covering a field are read the first time it is accessed, and
+// Prefetch can pull in several fields with a single coalesced read ahead of
+// time. Set only updates the local copy and marks the field dirty, Flush
+// writes the dirty byte ranges back.
+//
+// Fetched data is never refreshed implicitly. Call Invalidate to discard the
+// clean parts of the copy.
+template <typename T> class RemoteView
+{
+public:
+  HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<T>::value);
+
+  explicit RemoteView(Process const& process, PVOID address)
+    : process_{&process},
+      address_{reinterpret_cast<std::uintptr_t>(address)},
+      first_line_{address_ / kRemoteViewLineSize},
+      valid_(((address_ + sizeof(T) - 1) / kRemoteViewLineSize) -
+             first_line_ + 1),
+      dirty_(sizeof(T)),
+      data_(new T())
+  {
+    HADESMEM_DETAIL_ASSERT(address != nullptr);
+  }
+
+  explicit RemoteView(Process&& process, PVOID address) = delete;
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  RemoteView(RemoteView&& other) HADESMEM_DETAIL_NOEXCEPT
+    : process_{other.process_},
+      address_{other.address_},
+      first_line_{other.first_line_},
+      valid_(std::move(other.valid_)),
+      dirty_(std::move(other.dirty_)),
+      num_dirty_{other.num_dirty_},
+      data_(std::move(other.data_))
+  {
+  }
+
+  RemoteView& operator=(RemoteView&& other) HADESMEM_DETAIL_NOEXCEPT
+  {
+    process_ = other.process_;
+    address_ = other.address_;
+    first_line_ = other.first_line_;
+    valid_ = std::move(other.valid_);
+    dirty_ = std::move(other.dirty_);
+    num_dirty_ = other.num_dirty_;
+    data_ = std::move(other.data_);
+
+    return *this;
+  }
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  PVOID GetAddress() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return reinterpret_cast<PVOID>(address_);
+  }
+
+  template <typename M> M Get(M T::*member)
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<M>::value);
+
+    Fetch(GetOffset(member), sizeof(M));
+    return (*data_).*member;
+  }
+
+  // Fetches (if necessary) and returns the whole object.
+  T const& Get()
+  {
+    Fetch(0, sizeof(T));
+    return *data_;
+  }
+
+  template <typename M> void Set(M T::*member, M const& value)
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<M>::value);
+
+    std::size_t const offset = GetOffset(member);
+    (*data_).*member = value;
+    for (std::size_t i = offset; i < offset + sizeof(M); ++i)
+    {
+      if (!dirty_[i])
+      {
+        dirty_[i] = true;
+        ++num_dirty_;
+      }
+    }
+  }
+
+  // Fetches every field passed in with one batch of reads.
+  template <typename... Members> void Prefetch(Members... members)
+  {
+    std::size_t const offsets[] = {GetOffset(members)...};
+    std::size_t const sizes[] = {GetSize(members)...};
+    std::vector<bool> wanted(valid_.size());
+    for (std::size_t i = 0; i < sizeof...(Members); ++i)
+    {
+      MarkLines(wanted, offsets[i], sizes[i]);
+    }
+
+    FetchLines(wanted);
+  }
+
+  bool IsDirty() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return num_dirty_ != 0;
+  }
+
+  // Writes each contiguous run of dirty bytes back to the target.
+  void Flush()
+  {
+    for (std::size_t i = 0; i < sizeof(T) && num_dirty_;)
+    {
+      if (!dirty_[i])
+      {
+        ++i;
+        continue;
+      }
+
+      std::size_t j = i;
+      while (j < sizeof(T) && dirty_[j])
+      {
+        ++j;
+      }
+
+      detail::WriteImpl(*process_,
+                        reinterpret_cast<void*>(address_ + i),
+                        GetBytes() + i,
+                        j - i);
+
+      for (std::size_t k = i; k < j; ++k)
+      {
+        dirty_[k] = false;
+      }
+
+      num_dirty_ -= j - i;
+      i = j;
+    }
+  }
+
+  // Discards everything fetched so far. Pending (unflushed) writes are kept.
+  void Invalidate()
+  {
+    valid_.assign(valid_.size(), false);
+  }
+
+private:
+  template <typename M> std::size_t GetOffset(M T::*member) const
+  {
+    return static_cast<std::size_t>(
+      reinterpret_cast<char const*>(&((*data_).*member)) -
+      reinterpret_cast<char const*>(data_.get()));
+  }
+
+  template <typename M> static std::size_t GetSize(M T::* /*member*/)
+  {
+    return sizeof(M);
+  }
+
+  std::uint8_t* GetBytes() const
+  {
+    return reinterpret_cast<std::uint8_t*>(data_.get());
+  }
+
+  void MarkLines(std::vector<bool>& lines,
+                 std::size_t offset,
+                 std::size_t size) const
+  {
+    HADESMEM_DETAIL_ASSERT(size && offset + size <= sizeof(T));
+    std::size_t const first =
+      (address_ + offset) / kRemoteViewLineSize - first_line_;
+    std::size_t const last =
+      (address_ + offset + size - 1) / kRemoteViewLineSize - first_line_;
+    for (std::size_t i = first; i <= last; ++i)
+    {
+      lines[i] = true;
+    }
+  }
+
+  void Fetch(std::size_t offset, std::size_t size)
+  {
+    std::vector<bool> wanted(valid_.size());
+    MarkLines(wanted, offset, size);
+    FetchLines(wanted);
+  }
+
+  // Returns the [begin, end) byte range of the object covered by a line.
+  void GetLineRange(std::size_t line,
+                    std::size_t& begin,
+                    std::size_t& end) const HADESMEM_DETAIL_NOEXCEPT
+  {
+    std::uintptr_t const line_address =
+      (first_line_ + line) * kRemoteViewLineSize;
+    begin = line_address > address_ ? line_address - address_ : 0;
+    end = (std::min)(line_address + kRemoteViewLineSize - address_, sizeof(T));
+  }
+
+  void FetchLines(std::vector<bool> const& wanted)
+  {
+    // Read into a scratch buffer first so pending writes aren't clobbered.
+    std::vector<std::uint8_t> buf;
+    std::vector<detail::CoalescedRead> requests;
+    std::vector<std::size_t> lines;
+    for (std::size_t i = 0; i < wanted.size(); ++i)
+    {
+      if (wanted[i] && !valid_[i])
+      {
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        GetLineRange(i, begin, end);
+        if (buf.empty())
+        {
+          buf.resize(sizeof(T));
+        }
+
+        detail::CoalescedRead const request = {
+          reinterpret_cast<void*>(address_ + begin),
+          end - begin,
+          buf.data() + begin,
+          false};
+        requests.push_back(request);
+        lines.push_back(i);
+      }
+    }
+
+    if (requests.empty())
+    {
+      return;
+    }
+
+    detail::ReadCoalesced(*process_, requests.data(), requests.size());
+
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+      auto const& request = requests[i];
+      if (!request.success)
+      {
+        // Let the regular read path deal with guard pages etc. (and throw if
+        // the memory really is unreadable).
+        detail::ReadImpl(
+          *process_, request.address, request.data, request.size);
+      }
+
+      std::size_t begin = 0;
+      std::size_t end = 0;
+      GetLineRange(lines[i], begin, end);
+      std::uint8_t* const bytes = GetBytes();
+      for (std::size_t j = begin; j < end; ++j)
+      {
+        if (!dirty_[j])
+        {
+          bytes[j] = buf[j];
+        }
+      }
+
+      valid_[lines[i]] = true;
+    }
+  }
+
+  Process const* process_;
+  std::uintptr_t address_;
+  std::uintptr_t first_line_;
+  std::vector<bool> valid_;
+  std::vector<bool> dirty_;
+  std::size_t num_dirty_{};
+  // Heap allocated so large structures don't end up on the stack.
+  std::unique_ptr<T> data_;
+};
+}
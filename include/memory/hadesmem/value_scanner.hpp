@@ -0,0 +1,747 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+#include <emmintrin.h>
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/parallel_for.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/scan_region.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+enum class ValueScanFilter
+{
+  kChanged,
+  kUnchanged,
+  kIncreased,
+  kDecreased,
+  kEqual
+};
+
+namespace detail
+{
+std::size_t const kValueScanPageSize = 0x1000;
+
+// Amount of memory read in one go by a single worker during a first scan.
+std::size_t const kValueScanChunkSize = 0x100000;
+
+// Maximum number of contiguous candidate pages read in one go during a next
+// scan.
+std::size_t const kValueScanMaxRunPages = 0x40;
+
+// Candidates are stored per page. Dense pages keep a bitmap of the matching
+// slots plus a snapshot of the page (and the few bytes after it, for values
+// which straddle the page boundary). Sparse pages keep a sorted array of slot
+// offsets and the matching values. Whichever is smaller is used, and pages are
+// re-packed after every scan.
+template <typename T> struct ValueScanPage
+{
+  std::uintptr_t base;
+  std::size_t count;
+  std::vector<std::uint64_t> bitmap;
+  std::vector<std::uint8_t> snapshot;
+  std::vector<std::uint16_t> offsets;
+  std::vector<T> values;
+};
+
+template <typename T>
+inline std::size_t GetValueScanSlotLimit(std::size_t available)
+{
+  if (available < sizeof(T))
+  {
+    return 0;
+  }
+
+  return (std::min)(kValueScanPageSize, available - sizeof(T) + 1);
+}
+
+template <typename T> inline T ReadValueScanSlot(std::uint8_t const* data)
+{
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void MakeValueScanPage(std::uintptr_t base,
+                       std::uint8_t const* data,
+                       std::size_t available,
+                       std::size_t alignment,
+                       std::vector<std::uint16_t>& offsets,
+                       ValueScanPage<T>& page)
+{
+  std::size_t const num_slots =
+    (kValueScanPageSize + alignment - 1) / alignment;
+  std::size_t const bitmap_len = (num_slots + 63) / 64;
+  std::size_t const snapshot_len = kValueScanPageSize + sizeof(T) - 1;
+  std::size_t const dense_size =
+    bitmap_len * sizeof(std::uint64_t) + snapshot_len;
+  std::size_t const sparse_size =
+    offsets.size() * (sizeof(std::uint16_t) + sizeof(T));
+
+  page.base = base;
+  page.count = offsets.size();
+
+  if (sparse_size < dense_size)
+  {
+    page.bitmap = std::vector<std::uint64_t>();
+    page.snapshot = std::vector<std::uint8_t>();
+    page.values.clear();
+    page.values.reserve(offsets.size());
+    for (auto const offset : offsets)
+    {
+      page.values.push_back(ReadValueScanSlot<T>(data + offset));
+    }
+    page.offsets = offsets;
+  }
+  else
+  {
+    page.offsets = std::vector<std::uint16_t>();
+    page.values = std::vector<T>();
+    page.bitmap.assign(bitmap_len, 0);
+    for (auto const offset : offsets)
+    {
+      std::size_t const slot = offset / alignment;
+      page.bitmap[slot / 64] |= (1ULL << (slot % 64));
+    }
+    page.snapshot.assign(snapshot_len, 0);
+    std::memcpy(
+      page.snapshot.data(), data, (std::min)(available, snapshot_len));
+  }
+}
+
+template <typename T, typename Func>
+void ForEachValueScanCandidate(ValueScanPage<T> const& page,
+                               std::size_t alignment,
+                               Func const& func)
+{
+  if (!page.offsets.empty())
+  {
+    for (std::size_t i = 0; i < page.offsets.size(); ++i)
+    {
+      func(page.offsets[i], page.values[i]);
+    }
+  }
+  else
+  {
+    for (std::size_t i = 0; i < page.bitmap.size(); ++i)
+    {
+      std::uint64_t bits = page.bitmap[i];
+      for (std::size_t j = 0; bits; ++j, bits >>= 1)
+      {
+        if (bits & 1)
+        {
+          std::size_t const offset = (i * 64 + j) * alignment;
+          func(static_cast<std::uint16_t>(offset),
+               ReadValueScanSlot<T>(page.snapshot.data() + offset));
+        }
+      }
+    }
+  }
+}
+
+template <typename T, typename Pred>
+void CollectValueScanMatches(std::uint8_t const* data,
+                             std::size_t available,
+                             std::size_t alignment,
+                             Pred const& pred,
+                             std::vector<std::uint16_t>& offsets)
+{
+  std::size_t const limit = GetValueScanSlotLimit<T>(available);
+  for (std::size_t offset = 0; offset < limit; offset += alignment)
+  {
+    if (pred(ReadValueScanSlot<T>(data + offset)))
+    {
+      offsets.push_back(static_cast<std::uint16_t>(offset));
+    }
+  }
+}
+
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+// Exact matches for naturally aligned integers can be found with a bytewise
+// compare against the value's bit pattern (repeated to fill a register),
+// followed by reducing the byte mask to one bit per element.
+template <typename T>
+void CollectValueScanExactMatchesSse2(std::uint8_t const* data,
+                                      std::size_t available,
+                                      T value,
+                                      std::vector<std::uint16_t>& offsets)
+{
+  HADESMEM_DETAIL_STATIC_ASSERT(std::is_integral<T>::value);
+  HADESMEM_DETAIL_STATIC_ASSERT(16 % sizeof(T) == 0);
+
+  std::uint8_t pattern_buf[16];
+  for (std::size_t i = 0; i < 16; i += sizeof(T))
+  {
+    std::memcpy(&pattern_buf[i], &value, sizeof(T));
+  }
+  __m128i const pattern =
+    _mm_loadu_si128(reinterpret_cast<__m128i const*>(pattern_buf));
+
+  std::uint32_t element_mask = 0;
+  for (std::size_t i = 0; i < 16; i += sizeof(T))
+  {
+    element_mask |= (1UL << i);
+  }
+
+  std::size_t const limit = (std::min)(kValueScanPageSize, available);
+  std::size_t offset = 0;
+  for (; offset + 16 <= limit; offset += 16)
+  {
+    __m128i const block =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + offset));
+    std::uint32_t mask = static_cast<std::uint32_t>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)));
+    if (!mask)
+    {
+      continue;
+    }
+
+    for (std::size_t shift = 1; shift < sizeof(T); shift *= 2)
+    {
+      mask &= (mask >> shift);
+    }
+
+    mask &= element_mask;
+
+    for (std::size_t i = 0; mask; ++i, mask >>= 1)
+    {
+      if (mask & 1)
+      {
+        offsets.push_back(static_cast<std::uint16_t>(offset + i));
+      }
+    }
+  }
+
+  if (offset < limit)
+  {
+    std::size_t const first_tail = offsets.size();
+    CollectValueScanMatches<T>(data + offset,
+                               available - offset,
+                               sizeof(T),
+                               [&](T v)
+                               {
+                                 return v == value;
+                               },
+                               offsets);
+    for (std::size_t i = first_tail; i < offsets.size(); ++i)
+    {
+      offsets[i] = static_cast<std::uint16_t>(offsets[i] + offset);
+    }
+  }
+}
+
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+template <typename T>
+void CollectValueScanExactMatches(std::uint8_t const* data,
+                                  std::size_t available,
+                                  std::size_t alignment,
+                                  T value,
+                                  std::vector<std::uint16_t>& offsets,
+                                  std::true_type /*is_integral*/)
+{
+#if !defined(HADESMEM_DETAIL_NO_SSE2)
+  if (alignment == sizeof(T))
+  {
+    CollectValueScanExactMatchesSse2(data, available, value, offsets);
+    return;
+  }
+#endif // #if !defined(HADESMEM_DETAIL_NO_SSE2)
+
+  CollectValueScanMatches<T>(data,
+                             available,
+                             alignment,
+                             [&](T v)
+                             {
+                               return v == value;
+                             },
+                             offsets);
+}
+
+template <typename T>
+void CollectValueScanExactMatches(std::uint8_t const* data,
+                                  std::size_t available,
+                                  std::size_t alignment,
+                                  T value,
+                                  std::vector<std::uint16_t>& offsets,
+                                  std::false_type /*is_integral*/)
+{
+  CollectValueScanMatches<T>(data,
+                             available,
+                             alignment,
+                             [&](T v)
+                             {
+                               return v == value;
+                             },
+                             offsets);
+}
+
+inline bool TryReadValueScanMemory(Process const& process,
+                                   std::uintptr_t address,
+                                   std::uint8_t* data,
+                                   std::size_t len)
+{
+  try
+  {
+    ReadUnchecked(process, reinterpret_cast<void*>(address), data, len);
+    return true;
+  }
+  catch (Error const& /*e*/)
+  {
+    return false;
+  }
+}
+}
+
+// Finds the addresses of values of type T in the readable memory of a process
+// and narrows them down over successive scans.
+//
+// Memory is read directly (no protection changes), so guard pages and
+// inaccessible regions are skipped. Memory which becomes unreadable between
+// scans simply drops out of the candidate set.
+//
+// Slots are aligned relative to the start of each page, so any alignment up
+// to the page size is supported.
+//
+// Only fixed-size scalar values are supported (not strings or byte arrays),
+// and comparisons are always exact, including for floating point values.
+template <typename T> class ValueScanner
+{
+public:
+  HADESMEM_DETAIL_STATIC_ASSERT(std::is_arithmetic<T>::value);
+
+  explicit ValueScanner(Process const& process,
+                        std::size_t alignment = sizeof(T),
+                        std::uint32_t flags = MemoryScanFlags::kNone,
+                        std::size_t num_threads = 0)
+    : process_{&process},
+      alignment_{alignment},
+      flags_{flags},
+      num_threads_{num_threads}
+  {
+    if (!alignment_ || alignment_ > detail::kValueScanPageSize)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid alignment."});
+    }
+  }
+
+  explicit ValueScanner(Process&& process,
+                        std::size_t alignment = sizeof(T),
+                        std::uint32_t flags = MemoryScanFlags::kNone,
+                        std::size_t num_threads = 0) = delete;
+
+#if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  ValueScanner(ValueScanner const&) = default;
+
+  ValueScanner& operator=(ValueScanner const&) = default;
+
+  ValueScanner(ValueScanner&& other) HADESMEM_DETAIL_NOEXCEPT
+    : process_{other.process_},
+      alignment_{other.alignment_},
+      flags_{other.flags_},
+      num_threads_{other.num_threads_},
+      pages_(std::move(other.pages_)),
+      count_{other.count_},
+      scanned_{other.scanned_}
+  {
+  }
+
+  ValueScanner& operator=(ValueScanner&& other) HADESMEM_DETAIL_NOEXCEPT
+  {
+    process_ = other.process_;
+    alignment_ = other.alignment_;
+    flags_ = other.flags_;
+    num_threads_ = other.num_threads_;
+    pages_ = std::move(other.pages_);
+    count_ = other.count_;
+    scanned_ = other.scanned_;
+
+    return *this;
+  }
+
+#endif // #if defined(HADESMEM_DETAIL_NO_RVALUE_REFERENCES_V3)
+
+  void FirstScanExact(T value)
+  {
+    std::size_t const alignment = alignment_;
+    FirstScanImpl([=](std::uint8_t const* data,
+                      std::size_t available,
+                      std::vector<std::uint16_t>& offsets)
+                  {
+      detail::CollectValueScanExactMatches(data,
+                                           available,
+                                           alignment,
+                                           value,
+                                           offsets,
+                                           std::is_integral<T>());
+    });
+  }
+
+  void FirstScanRange(T lower, T upper)
+  {
+    std::size_t const alignment = alignment_;
+    FirstScanImpl([=](std::uint8_t const* data,
+                      std::size_t available,
+                      std::vector<std::uint16_t>& offsets)
+                  {
+      detail::CollectValueScanMatches<T>(data,
+                                         available,
+                                         alignment,
+                                         [=](T v)
+                                         {
+                                           return v >= lower && v <= upper;
+                                         },
+                                         offsets);
+    });
+  }
+
+  void FirstScanUnknown()
+  {
+    std::size_t const alignment = alignment_;
+    FirstScanImpl([=](std::uint8_t const* /*data*/,
+                      std::size_t available,
+                      std::vector<std::uint16_t>& offsets)
+                  {
+      std::size_t const limit = detail::GetValueScanSlotLimit<T>(available);
+      for (std::size_t offset = 0; offset < limit; offset += alignment)
+      {
+        offsets.push_back(static_cast<std::uint16_t>(offset));
+      }
+    });
+  }
+
+  // The value is only used by ValueScanFilter::kEqual.
+  void NextScan(ValueScanFilter filter, T value = T())
+  {
+    if (!scanned_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Next scan requested before first scan."});
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    for (std::size_t i = 0; i < pages_.size();)
+    {
+      std::size_t j = i + 1;
+      while (j < pages_.size() && j - i < detail::kValueScanMaxRunPages &&
+             pages_[j].base ==
+               pages_[j - 1].base + detail::kValueScanPageSize)
+      {
+        ++j;
+      }
+
+      runs.emplace_back(i, j);
+      i = j;
+    }
+
+    detail::ParallelFor(runs.size(),
+                        [&](std::size_t i)
+                        {
+                          NextScanRun(runs[i].first,
+                                      runs[i].second,
+                                      filter,
+                                      value);
+                        },
+                        num_threads_);
+
+    pages_.erase(std::remove_if(std::begin(pages_),
+                                std::end(pages_),
+                                [](detail::ValueScanPage<T> const& page)
+                                {
+                                  return page.count == 0;
+                                }),
+                 std::end(pages_));
+    UpdateCount();
+  }
+
+  std::size_t GetCount() const HADESMEM_DETAIL_NOEXCEPT
+  {
+    return count_;
+  }
+
+  // Calls func(address, value) for every candidate in address order, where
+  // value is the value seen by the most recent scan.
+  template <typename Func> void ForEach(Func const& func) const
+  {
+    for (auto const& page : pages_)
+    {
+      detail::ForEachValueScanCandidate(
+        page,
+        alignment_,
+        [&](std::uint16_t offset, T v)
+        {
+          func(reinterpret_cast<PVOID>(page.base + offset), v);
+        });
+    }
+  }
+
+  std::vector<PVOID> GetAddresses(
+    std::size_t max_count = (std::numeric_limits<std::size_t>::max)()) const
+  {
+    std::vector<PVOID> addresses;
+    addresses.reserve((std::min)(max_count, count_));
+    for (auto const& page : pages_)
+    {
+      detail::ForEachValueScanCandidate(
+        page,
+        alignment_,
+        [&](std::uint16_t offset, T /*v*/)
+        {
+          if (addresses.size() < max_count)
+          {
+            addresses.push_back(reinterpret_cast<PVOID>(page.base + offset));
+          }
+        });
+
+      if (addresses.size() >= max_count)
+      {
+        break;
+      }
+    }
+
+    return addresses;
+  }
+
+  void Reset()
+  {
+    pages_.clear();
+    count_ = 0;
+    scanned_ = false;
+  }
+
+private:
+  template <typename Collect> void FirstScanImpl(Collect const& collect)
+  {
+    Reset();
+
+    auto const regions = detail::GetScanRegions(*process_, flags_);
+    auto const chunks =
+      detail::SplitScanRegions(regions, detail::kValueScanChunkSize);
+
+    std::vector<std::vector<detail::ValueScanPage<T>>> results(chunks.size());
+    detail::ParallelFor(chunks.size(),
+                        [&](std::size_t i)
+                        {
+                          FirstScanChunk(chunks[i], collect, results[i]);
+                        },
+                        num_threads_);
+
+    std::size_t num_pages = 0;
+    for (auto const& result : results)
+    {
+      num_pages += result.size();
+    }
+
+    pages_.reserve(num_pages);
+    for (auto& result : results)
+    {
+      std::move(
+        std::begin(result), std::end(result), std::back_inserter(pages_));
+      result = std::vector<detail::ValueScanPage<T>>();
+    }
+
+    UpdateCount();
+    scanned_ = true;
+  }
+
+  template <typename Collect>
+  void FirstScanChunk(detail::ScanChunk const& chunk,
+                      Collect const& collect,
+                      std::vector<detail::ValueScanPage<T>>& pages) const
+  {
+    std::size_t const tail = (std::min)(sizeof(T) - 1, chunk.available_after);
+    std::vector<std::uint8_t> buf(chunk.size + tail);
+    std::size_t len = buf.size();
+    if (!detail::TryReadValueScanMemory(
+          *process_, chunk.base, buf.data(), len))
+    {
+      len = chunk.size;
+      if (!tail || !detail::TryReadValueScanMemory(
+                     *process_, chunk.base, buf.data(), len))
+      {
+        return;
+      }
+    }
+
+    std::vector<std::uint16_t> offsets;
+    for (std::size_t page_offset = 0; page_offset < chunk.size;
+         page_offset += detail::kValueScanPageSize)
+    {
+      offsets.clear();
+      std::uint8_t const* const data = buf.data() + page_offset;
+      std::size_t const available = len - page_offset;
+      collect(data, available, offsets);
+      if (!offsets.empty())
+      {
+        pages.emplace_back();
+        detail::MakeValueScanPage(chunk.base + page_offset,
+                                  data,
+                                  available,
+                                  alignment_,
+                                  offsets,
+                                  pages.back());
+      }
+    }
+  }
+
+  void NextScanRun(std::size_t first,
+                   std::size_t last,
+                   ValueScanFilter filter,
+                   T value)
+  {
+    std::uintptr_t const run_base = pages_[first].base;
+    std::size_t const run_size = (last - first) * detail::kValueScanPageSize;
+    std::size_t const tail = sizeof(T) - 1;
+    std::vector<std::uint8_t> buf(run_size + tail);
+
+    std::size_t len = buf.size();
+    bool read_ok =
+      detail::TryReadValueScanMemory(*process_, run_base, buf.data(), len);
+    if (!read_ok && tail)
+    {
+      len = run_size;
+      read_ok =
+        detail::TryReadValueScanMemory(*process_, run_base, buf.data(), len);
+    }
+
+    std::vector<std::uint16_t> offsets;
+    for (std::size_t i = first; i < last; ++i)
+    {
+      auto& page = pages_[i];
+      std::size_t const page_offset =
+        static_cast<std::size_t>(page.base - run_base);
+      std::uint8_t* const data = buf.data() + page_offset;
+      std::size_t available = len - page_offset;
+
+      if (!read_ok)
+      {
+        // Fall back to reading page by page so one page which has become
+        // inaccessible doesn't take its neighbours down with it.
+        available = detail::kValueScanPageSize + tail;
+        if (!detail::TryReadValueScanMemory(
+              *process_, page.base, data, available))
+        {
+          available = detail::kValueScanPageSize;
+          if (!tail || !detail::TryReadValueScanMemory(
+                         *process_, page.base, data, available))
+          {
+            page.count = 0;
+            continue;
+          }
+        }
+      }
+
+      if (!page.snapshot.empty())
+      {
+        bool const same = std::memcmp(page.snapshot.data(),
+                                      data,
+                                      (std::min)(available,
+                                                 page.snapshot.size())) == 0;
+        if (same && filter == ValueScanFilter::kUnchanged)
+        {
+          continue;
+        }
+
+        if (same && filter == ValueScanFilter::kChanged)
+        {
+          page.count = 0;
+          continue;
+        }
+      }
+
+      std::size_t const limit = detail::GetValueScanSlotLimit<T>(available);
+      offsets.clear();
+      detail::ForEachValueScanCandidate(
+        page,
+        alignment_,
+        [&](std::uint16_t offset, T old_value)
+        {
+          if (offset >= limit)
+          {
+            return;
+          }
+
+          T const new_value = detail::ReadValueScanSlot<T>(data + offset);
+          if (MatchesFilter(filter, old_value, new_value, value))
+          {
+            offsets.push_back(offset);
+          }
+        });
+
+      if (offsets.empty())
+      {
+        page.count = 0;
+        continue;
+      }
+
+      detail::MakeValueScanPage(
+        page.base, data, available, alignment_, offsets, page);
+    }
+  }
+
+  static bool MatchesFilter(ValueScanFilter filter,
+                            T old_value,
+                            T new_value,
+                            T value) HADESMEM_DETAIL_NOEXCEPT
+  {
+    switch (filter)
+    {
+    case ValueScanFilter::kChanged:
+      return std::memcmp(&old_value, &new_value, sizeof(T)) != 0;
+    case ValueScanFilter::kUnchanged:
+      return std::memcmp(&old_value, &new_value, sizeof(T)) == 0;
+    case ValueScanFilter::kIncreased:
+      return new_value > old_value;
+    case ValueScanFilter::kDecreased:
+      return new_value < old_value;
+    case ValueScanFilter::kEqual:
+      return new_value == value;
+    }
+
+    HADESMEM_DETAIL_ASSERT(false);
+    return false;
+  }
+
+  void UpdateCount() HADESMEM_DETAIL_NOEXCEPT
+  {
+    count_ = 0;
+    for (auto const& page : pages_)
+    {
+      count_ += page.count;
+    }
+  }
+
+  Process const* process_;
+  std::size_t alignment_;
+  std::uint32_t flags_;
+  std::size_t num_threads_;
+  std::vector<detail::ValueScanPage<T>> pages_;
+  std::size_t count_{};
+  bool scanned_{};
+};
+}
@@ -0,0 +1,431 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/coalesced_read.hpp>
+#include <hadesmem/detail/srw_lock.hpp>
+#include <hadesmem/detail/trace.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+struct WatchChange
+{
+  std::uint64_t id;
+  PVOID address;
+  std::size_t size;
+  // Opaque tag supplied when the watch was added (e.g. the value type).
+  std::uint32_t type;
+  std::uint8_t const* old_data;
+  std::uint8_t const* new_data;
+};
+
+struct WatchListStats
+{
+  std::uint64_t polls;
+  std::uint64_t reads;
+  std::uint64_t read_failures;
+  std::uint64_t changes;
+  std::chrono::microseconds last_poll_time;
+  std::chrono::microseconds max_poll_time;
+  std::chrono::microseconds total_poll_time;
+  // How late the most recent poll started relative to its schedule.
+  std::chrono::microseconds last_poll_delay;
+};
+
+// Polls a set of addresses in a process and notifies subscribers when their
+// contents change.
+//
+// The watches and subscribers are immutable snapshots which are swapped out
+// wholesale by Add/Remove/Subscribe/Unsubscribe, so the poll loop only holds
+// the lock long enough to copy a pointer and never blocks writers while it is
+// reading memory or running callbacks. Each poll services all watches with
+// page-grouped coalesced reads and compares them against the previous values
+// (a single memcmp of the whole value buffer in the common nothing-changed
+// case).
+//
+// Callbacks run on the poll thread (or the caller of Poll). The first
+// successful read of a watch establishes its baseline and does not generate
+// an event.
+class WatchList
+{
+public:
+  using Callback = std::function<void(WatchChange const&)>;
+
+  explicit WatchList(Process const& process,
+                     std::chrono::milliseconds interval =
+                       std::chrono::milliseconds(16))
+    : process_{&process},
+      interval_(interval),
+      watches_{std::make_shared<Watches const>()},
+      subscribers_{std::make_shared<Subscribers const>()}
+  {
+  }
+
+  explicit WatchList(Process&& process,
+                     std::chrono::milliseconds interval =
+                       std::chrono::milliseconds(16)) = delete;
+
+  WatchList(WatchList const&) = delete;
+
+  WatchList& operator=(WatchList const&) = delete;
+
+  ~WatchList()
+  {
+    try
+    {
+      Stop();
+    }
+    catch (...)
+    {
+      // WARNING: Thread is still running if we get here...
+      HADESMEM_DETAIL_TRACE_A(
+        boost::current_exception_diagnostic_information().c_str());
+      HADESMEM_DETAIL_ASSERT(false);
+    }
+  }
+
+  std::uint64_t Add(PVOID address, std::size_t size, std::uint32_t type = 0)
+  {
+    if (!address || !size)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid watch."});
+    }
+
+    detail::AcquireSRWLock const lock(&lock_,
+                                      detail::SRWLockType::Exclusive);
+    auto watches = std::make_shared<Watches>(*watches_);
+    Watch const watch = {++next_id_, address, size, type};
+    watches->push_back(watch);
+    watches_ = std::move(watches);
+    return watch.id;
+  }
+
+  void Remove(std::uint64_t id)
+  {
+    detail::AcquireSRWLock const lock(&lock_,
+                                      detail::SRWLockType::Exclusive);
+    auto watches = std::make_shared<Watches>(*watches_);
+    watches->erase(std::remove_if(std::begin(*watches),
+                                  std::end(*watches),
+                                  [&](Watch const& watch)
+                                  {
+                                    return watch.id == id;
+                                  }),
+                   std::end(*watches));
+    watches_ = std::move(watches);
+  }
+
+  std::uint64_t Subscribe(Callback const& callback)
+  {
+    detail::AcquireSRWLock const lock(&lock_,
+                                      detail::SRWLockType::Exclusive);
+    auto subscribers = std::make_shared<Subscribers>(*subscribers_);
+    subscribers->emplace_back(++next_id_, callback);
+    subscribers_ = std::move(subscribers);
+    return subscribers_->back().first;
+  }
+
+  void Unsubscribe(std::uint64_t id)
+  {
+    detail::AcquireSRWLock const lock(&lock_,
+                                      detail::SRWLockType::Exclusive);
+    auto subscribers = std::make_shared<Subscribers>(*subscribers_);
+    subscribers->erase(
+      std::remove_if(std::begin(*subscribers),
+                     std::end(*subscribers),
+                     [&](std::pair<std::uint64_t, Callback> const& subscriber)
+                     {
+                       return subscriber.first == id;
+                     }),
+      std::end(*subscribers));
+    subscribers_ = std::move(subscribers);
+  }
+
+  void SetInterval(std::chrono::milliseconds interval)
+  {
+    detail::AcquireSRWLock const lock(&lock_,
+                                      detail::SRWLockType::Exclusive);
+    interval_ = interval;
+  }
+
+  void Start()
+  {
+    detail::AcquireSRWLock const lock(&lock_,
+                                      detail::SRWLockType::Exclusive);
+    if (thread_.joinable())
+    {
+      return;
+    }
+
+    stop_ = false;
+    thread_ = std::thread(&WatchList::PollLoop, this);
+  }
+
+  void Stop()
+  {
+    {
+      detail::AcquireSRWLock const lock(&lock_,
+                                        detail::SRWLockType::Exclusive);
+      stop_ = true;
+    }
+
+    ::WakeAllConditionVariable(&stop_cv_);
+
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+  // Polls once on the calling thread. Must not be called while the background
+  // thread is running.
+  void Poll()
+  {
+    PollImpl(std::chrono::microseconds(0));
+  }
+
+  WatchListStats GetStats() const
+  {
+    WatchListStats stats;
+    stats.polls = polls_;
+    stats.reads = reads_;
+    stats.read_failures = read_failures_;
+    stats.changes = changes_;
+    stats.last_poll_time = std::chrono::microseconds(last_poll_time_);
+    stats.max_poll_time = std::chrono::microseconds(max_poll_time_);
+    stats.total_poll_time = std::chrono::microseconds(total_poll_time_);
+    stats.last_poll_delay = std::chrono::microseconds(last_poll_delay_);
+    return stats;
+  }
+
+private:
+  struct Watch
+  {
+    std::uint64_t id;
+    PVOID address;
+    std::size_t size;
+    std::uint32_t type;
+  };
+
+  using Watches = std::vector<Watch>;
+  using Subscribers = std::vector<std::pair<std::uint64_t, Callback>>;
+
+  // Poll-side state for one snapshot of the watches. Values are packed into
+  // contiguous buffers so the nothing-changed case is a single memcmp.
+  struct PollState
+  {
+    std::shared_ptr<Watches const> watches;
+    std::vector<std::size_t> offsets;
+    std::vector<std::uint8_t> current;
+    std::vector<std::uint8_t> previous;
+    std::vector<bool> has_previous;
+    std::vector<detail::CoalescedRead> requests;
+  };
+
+  void PollLoop()
+  {
+    auto next = std::chrono::steady_clock::now();
+    for (;;)
+    {
+      std::chrono::milliseconds interval;
+      {
+        detail::AcquireSRWLock const lock(&lock_,
+                                          detail::SRWLockType::Exclusive);
+        interval = interval_;
+        // Wakes up early (spuriously, or to stop), so the time left is
+        // checked again every time.
+        for (auto now = std::chrono::steady_clock::now(); !stop_ && now < next;
+             now = std::chrono::steady_clock::now())
+        {
+          auto const wait =
+            std::chrono::duration_cast<std::chrono::milliseconds>(next - now);
+          ::SleepConditionVariableSRW(
+            &stop_cv_, &lock_, static_cast<DWORD>(wait.count() + 1), 0);
+        }
+
+        if (stop_)
+        {
+          return;
+        }
+      }
+
+      auto const now = std::chrono::steady_clock::now();
+      PollImpl(std::chrono::duration_cast<std::chrono::microseconds>(
+        now - next));
+
+      // Don't try to catch up on missed polls, just stay on the grid.
+      next += interval;
+      auto const after = std::chrono::steady_clock::now();
+      if (next < after)
+      {
+        next = after;
+      }
+    }
+  }
+
+  void UpdatePollState(std::shared_ptr<Watches const> const& watches)
+  {
+    std::unordered_map<std::uint64_t, std::size_t> old_indexes;
+    if (poll_state_.watches)
+    {
+      for (std::size_t i = 0; i < poll_state_.watches->size(); ++i)
+      {
+        old_indexes[(*poll_state_.watches)[i].id] = i;
+      }
+    }
+
+    PollState state;
+    state.watches = watches;
+    std::size_t total_size = 0;
+    for (auto const& watch : *watches)
+    {
+      state.offsets.push_back(total_size);
+      total_size += watch.size;
+    }
+
+    state.current.resize(total_size);
+    state.previous.resize(total_size);
+    state.has_previous.resize(watches->size());
+    for (std::size_t i = 0; i < watches->size(); ++i)
+    {
+      auto const& watch = (*watches)[i];
+      auto const iter = old_indexes.find(watch.id);
+      if (iter != std::end(old_indexes) &&
+          poll_state_.has_previous[iter->second])
+      {
+        std::memcpy(&state.previous[state.offsets[i]],
+                    &poll_state_.previous[poll_state_.offsets[iter->second]],
+                    watch.size);
+        state.has_previous[i] = true;
+      }
+
+      detail::CoalescedRead const request = {
+        watch.address, watch.size, &state.current[state.offsets[i]], false};
+      state.requests.push_back(request);
+    }
+
+    poll_state_ = std::move(state);
+  }
+
+  void PollImpl(std::chrono::microseconds delay)
+  {
+    auto const start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<Watches const> watches;
+    std::shared_ptr<Subscribers const> subscribers;
+    {
+      detail::AcquireSRWLock const lock(&lock_, detail::SRWLockType::Shared);
+      watches = watches_;
+      subscribers = subscribers_;
+    }
+
+    if (watches != poll_state_.watches)
+    {
+      UpdatePollState(watches);
+    }
+
+    auto& state = poll_state_;
+    reads_ += detail::ReadCoalesced(
+      *process_, state.requests.data(), state.requests.size());
+
+    bool const all_previous =
+      std::find(std::begin(state.has_previous),
+                std::end(state.has_previous),
+                false) == std::end(state.has_previous);
+    bool const all_success =
+      std::find_if(std::begin(state.requests),
+                   std::end(state.requests),
+                   [](detail::CoalescedRead const& request)
+                   {
+                     return !request.success;
+                   }) == std::end(state.requests);
+    bool const unchanged =
+      all_previous && all_success &&
+      (state.current.empty() ||
+       std::memcmp(state.current.data(),
+                   state.previous.data(),
+                   state.current.size()) == 0);
+
+    if (!unchanged)
+    {
+      for (std::size_t i = 0; i < watches->size(); ++i)
+      {
+        if (!state.requests[i].success)
+        {
+          ++read_failures_;
+          continue;
+        }
+
+        auto const& watch = (*watches)[i];
+        std::uint8_t* const current = &state.current[state.offsets[i]];
+        std::uint8_t* const previous = &state.previous[state.offsets[i]];
+        if (state.has_previous[i] &&
+            std::memcmp(current, previous, watch.size) != 0)
+        {
+          ++changes_;
+          WatchChange const change = {
+            watch.id, watch.address, watch.size, watch.type, previous, current};
+          for (auto const& subscriber : *subscribers)
+          {
+            subscriber.second(change);
+          }
+        }
+
+        std::memcpy(previous, current, watch.size);
+        state.has_previous[i] = true;
+      }
+    }
+
+    auto const elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start).count();
+    ++polls_;
+    last_poll_time_ = elapsed;
+    total_poll_time_ += elapsed;
+    if (elapsed > max_poll_time_)
+    {
+      max_poll_time_ = elapsed;
+    }
+    last_poll_delay_ = delay.count();
+  }
+
+  Process const* process_;
+  std::chrono::milliseconds interval_;
+  SRWLOCK lock_ = SRWLOCK_INIT;
+  CONDITION_VARIABLE stop_cv_ = CONDITION_VARIABLE_INIT;
+  bool stop_{};
+  std::thread thread_;
+  std::uint64_t next_id_{};
+  std::shared_ptr<Watches const> watches_;
+  std::shared_ptr<Subscribers const> subscribers_;
+  PollState poll_state_;
+  std::atomic<std::uint64_t> polls_{0};
+  std::atomic<std::uint64_t> reads_{0};
+  std::atomic<std::uint64_t> read_failures_{0};
+  std::atomic<std::uint64_t> changes_{0};
+  std::atomic<std::int64_t> last_poll_time_{0};
+  std::atomic<std::int64_t> max_poll_time_{0};
+  std::atomic<std::int64_t> total_poll_time_{0};
+  std::atomic<std::int64_t> last_poll_delay_{0};
+};
+}
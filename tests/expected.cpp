@@ -0,0 +1,79 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/expected.hpp>
+#include <hadesmem/expected.hpp>
+
+#include <string>
+#include <utility>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+
+namespace
+{
+hadesmem::Expected<std::string> MakeExpected(bool valid)
+{
+  if (!valid)
+  {
+    return hadesmem::Error{} << hadesmem::ErrorString{"Test error."}
+                             << hadesmem::ErrorCodeWinLast{5};
+  }
+
+  return std::string{"Test value."};
+}
+}
+
+void TestExpected()
+{
+  auto value = MakeExpected(true);
+  BOOST_TEST(!!value);
+  BOOST_TEST(value.HasValue());
+  BOOST_TEST_EQ(value.Get(), "Test value.");
+  BOOST_TEST_EQ(*value, "Test value.");
+  BOOST_TEST_EQ(value->size(), 11UL);
+  BOOST_TEST(value.GetErrorString().empty());
+  value.EnsureValue();
+
+  auto const value_copy = value;
+  BOOST_TEST_EQ(value_copy.Get(), value.Get());
+  auto const value_moved = std::move(value);
+  BOOST_TEST_EQ(value_moved.Get(), "Test value.");
+
+  auto const error = MakeExpected(false);
+  BOOST_TEST(!error);
+  BOOST_TEST(!error.HasValue());
+  BOOST_TEST_EQ(error.GetErrorString(), "Test error.");
+  auto const last_error =
+    boost::get_error_info<hadesmem::ErrorCodeWinLast>(error.GetError());
+  BOOST_TEST(last_error != nullptr);
+  BOOST_TEST(last_error && *last_error == 5);
+
+  // The error is only thrown on access, and carries the same info.
+  bool thrown = false;
+  try
+  {
+    error.Get();
+  }
+  catch (hadesmem::Error const& e)
+  {
+    thrown = true;
+    auto const error_string = boost::get_error_info<hadesmem::ErrorString>(e);
+    BOOST_TEST(error_string && *error_string == "Test error.");
+  }
+  BOOST_TEST(thrown);
+
+  auto const error_copy = error;
+  BOOST_TEST(!error_copy);
+  BOOST_TEST_EQ(error_copy.GetErrorString(), "Test error.");
+}
+
+int main()
+{
+  TestExpected();
+  return boost::report_errors();
+}
@@ -0,0 +1,131 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/find_procedure.hpp>
+#include <hadesmem/find_procedure.hpp>
+
+#include <cstddef>
+#include <string>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/procedure_cache.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/export.hpp>
+#include <hadesmem/pelib/export_list.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+void TestFindProcedureForwarded()
+{
+  hadesmem::Process const process{::GetCurrentProcessId()};
+
+  // Kernel32 forwards a lot of its exports (to NTDLL, KernelBase, etc.).
+  hadesmem::Module const kernel32{process, L"kernel32.dll"};
+  hadesmem::PeFile const pe_file{
+    process, kernel32.GetHandle(), hadesmem::PeFileType::Image, 0};
+  hadesmem::ExportList const exports{process, pe_file};
+
+  std::size_t num_forwarded = 0;
+  for (auto const& e : exports)
+  {
+    if (!e.IsForwarded() || !e.ByName())
+    {
+      continue;
+    }
+
+    // API set forwarders are resolved by the loader rather than by module
+    // name, so they can't be found this way.
+    FARPROC remote_func = nullptr;
+    try
+    {
+      remote_func = FindProcedure(process, kernel32, e.GetName());
+    }
+    catch (hadesmem::Error const& /*e*/)
+    {
+      continue;
+    }
+
+    BOOST_TEST_EQ(remote_func,
+                  ::GetProcAddress(kernel32.GetHandle(), e.GetName().c_str()));
+    // Second lookup is served from the cache.
+    BOOST_TEST_EQ(FindProcedure(process, kernel32, e.GetName()), remote_func);
+    ++num_forwarded;
+  }
+
+  BOOST_TEST(num_forwarded > 0);
+
+  hadesmem::InvalidateProcedureCache(process, kernel32);
+  BOOST_TEST_EQ(FindProcedure(process, kernel32, "GetProcAddress"),
+                ::GetProcAddress(kernel32.GetHandle(), "GetProcAddress"));
+}
+
+void TestProcedureCacheEviction()
+{
+  hadesmem::Process const process{::GetCurrentProcessId()};
+
+  // Entries for other (e.g. exited) processes never validate, but they're
+  // still evicted once the cache is full, least recently used first.
+  hadesmem::detail::ProcedureCache::Clear();
+  hadesmem::detail::ProcedureCacheEntry const entry = {nullptr, {}};
+  std::size_t const max_entries =
+    hadesmem::detail::ProcedureCache::kMaxEntries;
+  hadesmem::detail::ProcedureCacheKey const first_key = {
+    0xFFFFFFFCUL, nullptr, std::string(), 0};
+  hadesmem::detail::ProcedureCache::Insert(first_key, entry);
+  for (std::size_t i = 1; i <= max_entries; ++i)
+  {
+    hadesmem::detail::ProcedureCacheKey const key = {
+      0xFFFFFFFCUL, nullptr, std::string(), static_cast<WORD>(i)};
+    hadesmem::detail::ProcedureCache::Insert(key, entry);
+
+    // Keep the first entry in use.
+    hadesmem::detail::ProcedureCacheEntry found;
+    BOOST_TEST(
+      hadesmem::detail::ProcedureCache::Find(process, first_key, found));
+  }
+  BOOST_TEST(hadesmem::detail::ProcedureCache::GetSize() <= max_entries);
+  BOOST_TEST(hadesmem::detail::ProcedureCache::GetSize() > max_entries / 2);
+  hadesmem::detail::ProcedureCacheEntry found;
+  BOOST_TEST(
+    hadesmem::detail::ProcedureCache::Find(process, first_key, found));
+  hadesmem::detail::ProcedureCacheKey const oldest_key = {
+    0xFFFFFFFCUL, nullptr, std::string(), 1};
+  BOOST_TEST(
+    !hadesmem::detail::ProcedureCache::Find(process, oldest_key, found));
+
+  hadesmem::detail::ProcedureCache::RemoveProcess(0xFFFFFFFCUL);
+  BOOST_TEST_EQ(hadesmem::detail::ProcedureCache::GetSize(), 0UL);
+
+  // Removing a process only removes its own entries.
+  hadesmem::Module const kernel32{process, L"kernel32.dll"};
+  BOOST_TEST(FindProcedure(process, kernel32, "GetProcAddress") != nullptr);
+  hadesmem::detail::ProcedureCache::RemoveProcess(0xFFFFFFFCUL);
+  BOOST_TEST(hadesmem::detail::ProcedureCache::GetSize() > 0);
+  hadesmem::InvalidateProcedureCache(process);
+  BOOST_TEST_EQ(hadesmem::detail::ProcedureCache::GetSize(), 0UL);
+}
+
+void TestWarmProcedureCache()
+{
+  hadesmem::Process const process{::GetCurrentProcessId()};
+
+  hadesmem::Module const this_mod{process, nullptr};
+  BOOST_TEST(hadesmem::WarmProcedureCache(process, this_mod) > 0);
+
+  hadesmem::Module const kernel32{process, L"kernel32.dll"};
+  BOOST_TEST_EQ(FindProcedure(process, kernel32, "GetProcAddress"),
+                ::GetProcAddress(kernel32.GetHandle(), "GetProcAddress"));
+}
+
+int main()
+{
+  TestFindProcedureForwarded();
+  TestProcedureCacheEviction();
+  TestWarmProcedureCache();
+  return boost::report_errors();
+}
@@ -0,0 +1,166 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/export_index.hpp>
+#include <hadesmem/pelib/export_index.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/find_procedure.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/module_list.hpp>
+#include <hadesmem/pelib/export.hpp>
+#include <hadesmem/pelib/export_dir.hpp>
+#include <hadesmem/pelib/export_list.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+// Export something to ensure tests pass...
+extern "C" HADESMEM_DETAIL_DLLEXPORT void Dummy();
+extern "C" HADESMEM_DETAIL_DLLEXPORT void Dummy()
+{
+}
+
+void TestExportIndex()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  bool processed_one_export_index = false;
+
+  hadesmem::ModuleList modules(process);
+  for (auto const& mod : modules)
+  {
+    hadesmem::PeFile const cur_pe_file(
+      process, mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+
+    hadesmem::ExportList cur_export_list(process, cur_pe_file);
+    hadesmem::ExportIndex const cur_export_index(process, cur_pe_file);
+    BOOST_TEST(cur_export_index.IsValid());
+    if (std::begin(cur_export_list) == std::end(cur_export_list))
+    {
+      BOOST_TEST_EQ(cur_export_index.GetNumberOfNames(), 0U);
+      continue;
+    }
+
+    hadesmem::ExportDir cur_export_dir(process, cur_pe_file);
+    BOOST_TEST_EQ(cur_export_index.GetOrdinalBase(),
+                  cur_export_dir.GetOrdinalBase());
+    BOOST_TEST_EQ(cur_export_index.GetNumberOfNames(),
+                  cur_export_dir.GetNumberOfNames());
+
+    processed_one_export_index = true;
+
+    for (auto const& e : cur_export_list)
+    {
+      WORD const ordinal_number =
+        cur_export_index.FindOrdinal(e.GetProcedureNumber());
+      BOOST_TEST_NE(ordinal_number,
+                    static_cast<WORD>(hadesmem::ExportIndex::kInvalidOrdinal));
+      BOOST_TEST_EQ(e.GetOrdinalNumber(), ordinal_number);
+      BOOST_TEST_EQ(cur_export_index.IsForwarded(ordinal_number),
+                    e.IsForwarded());
+      if (e.IsForwarded())
+      {
+        BOOST_TEST_EQ(cur_export_index.GetForwarder(ordinal_number),
+                      e.GetForwarder());
+      }
+      else
+      {
+        BOOST_TEST_EQ(cur_export_index.GetFunctionRva(ordinal_number),
+                      e.GetRva());
+      }
+
+      std::string const* const name = cur_export_index.GetName(ordinal_number);
+      BOOST_TEST_EQ(name != nullptr, e.ByName());
+      if (e.ByName())
+      {
+        BOOST_TEST_EQ(*name, e.GetName());
+        BOOST_TEST_EQ(cur_export_index.FindName(e.GetName()), ordinal_number);
+      }
+
+      // Resolving forwarders may legitimately fail (e.g. API sets), so only
+      // compare lookups for exports in the module itself.
+      if (!e.IsForwarded())
+      {
+        FARPROC const expected =
+          hadesmem::detail::GetProcAddressFromExport(process, e);
+        BOOST_TEST_EQ(hadesmem::detail::GetProcAddressInternal(
+                        process, mod.GetHandle(), e.GetProcedureNumber()),
+                      expected);
+        if (e.ByName())
+        {
+          BOOST_TEST_EQ(hadesmem::detail::GetProcAddressInternal(
+                          process, mod.GetHandle(), e.GetName()),
+                        expected);
+        }
+      }
+    }
+
+    BOOST_TEST_EQ(cur_export_index.FindName("non_existant_export"),
+                  static_cast<WORD>(hadesmem::ExportIndex::kInvalidOrdinal));
+  }
+
+  BOOST_TEST(processed_one_export_index);
+
+  // The cached index is shared between lookups.
+  hadesmem::PeFile const pe_file(
+    process, ::GetModuleHandleW(nullptr), hadesmem::PeFileType::Image, 0);
+  BOOST_TEST_EQ(hadesmem::detail::GetExportIndex(process, pe_file),
+                hadesmem::detail::GetExportIndex(process, pe_file));
+  BOOST_TEST_EQ(
+    hadesmem::detail::GetProcAddressInternal(
+      process, ::GetModuleHandleW(nullptr), "Dummy"),
+    reinterpret_cast<FARPROC>(&Dummy));
+
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+  std::vector<std::uint8_t> data(base, base + file.GetSize());
+  hadesmem::PeFile const pe_file_data(process,
+                                      data.data(),
+                                      hadesmem::PeFileType::Data,
+                                      static_cast<DWORD>(data.size()));
+
+  // An export directory with no functions is a valid (empty) index, whatever
+  // else is in it.
+  hadesmem::ExportDir export_dir(process, pe_file_data);
+  export_dir.SetNumberOfFunctions(0);
+  export_dir.UpdateWrite();
+  hadesmem::ExportIndex const no_functions_index(process, pe_file_data);
+  BOOST_TEST(no_functions_index.IsValid());
+  BOOST_TEST_EQ(no_functions_index.GetNumberOfFunctions(), 0U);
+
+  // An export directory which can't be read gives an empty index which isn't
+  // valid (and so isn't cached), rather than one which looks like the module
+  // has no exports.
+  hadesmem::NtHeaders nt_headers(process, pe_file_data);
+  nt_headers.SetDataDirectoryVirtualAddress(hadesmem::PeDataDir::Export,
+                                            0xFFFFFFF0UL);
+  nt_headers.UpdateWrite();
+  hadesmem::ExportIndex const invalid_index(process, pe_file_data);
+  BOOST_TEST(!invalid_index.IsValid());
+  BOOST_TEST_EQ(invalid_index.GetNumberOfFunctions(), 0U);
+
+  // Whereas no export directory at all is a valid (empty) index.
+  nt_headers.SetDataDirectoryVirtualAddress(hadesmem::PeDataDir::Export, 0);
+  nt_headers.UpdateWrite();
+  hadesmem::ExportIndex const empty_index(process, pe_file_data);
+  BOOST_TEST(empty_index.IsValid());
+  BOOST_TEST_EQ(empty_index.GetNumberOfFunctions(), 0U);
+}
+
+int main()
+{
+  TestExportIndex();
+  return boost::report_errors();
+}
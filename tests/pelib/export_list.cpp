@@ -57,6 +57,16 @@ void TestExportList()
       hadesmem::Export const test_export(
         process, cur_pe_file, e.GetProcedureNumber());
 
+      // The list builds its exports from a bulk read of the export tables,
+      // so check it agrees with reading them one at a time.
+      BOOST_TEST_EQ(e.GetOrdinalNumber(), test_export.GetOrdinalNumber());
+      BOOST_TEST_EQ(e.ByName(), test_export.ByName());
+      BOOST_TEST_EQ(e.GetName(), test_export.GetName());
+      BOOST_TEST_EQ(e.IsForwarded(), test_export.IsForwarded());
+      BOOST_TEST_EQ(e.GetForwarder(), test_export.GetForwarder());
+      BOOST_TEST_EQ(e.GetRva(), test_export.GetRva());
+      BOOST_TEST_EQ(e.GetVa(), test_export.GetVa());
+
       if (test_export.ByName())
       {
         BOOST_TEST(!test_export.GetName().empty());
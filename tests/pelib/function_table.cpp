@@ -0,0 +1,155 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/function_table.hpp>
+#include <hadesmem/pelib/function_table.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+bool IsSameTable(hadesmem::FunctionTable const& lhs,
+                 hadesmem::FunctionTable const& rhs)
+{
+  if (lhs.GetNumberOfEntries() != rhs.GetNumberOfEntries())
+  {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < lhs.GetNumberOfEntries(); ++i)
+  {
+    if (std::memcmp(&lhs.GetEntry(i),
+                    &rhs.GetEntry(i),
+                    sizeof(hadesmem::FunctionEntry)) != 0 ||
+        lhs.GetPrimary(i) != rhs.GetPrimary(i))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+}
+
+void TestFunctionTable()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::PeFile const pe_file_image(
+    process, this_mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+
+  hadesmem::FunctionTable const image_table(process, pe_file_image);
+#if defined(HADESMEM_DETAIL_ARCH_X64)
+  BOOST_TEST(image_table.GetNumberOfEntries() != 0);
+#else
+  BOOST_TEST_EQ(image_table.GetNumberOfEntries(), 0UL);
+#endif
+  BOOST_TEST(image_table.IsSorted());
+  BOOST_TEST_EQ(image_table.GetNumberOfInvalid(), 0UL);
+  BOOST_TEST(image_table.Find(0) == hadesmem::FunctionTable::kNotFound);
+  BOOST_TEST(image_table.Lookup(0) == nullptr);
+
+  for (std::size_t i = 0; i < image_table.GetNumberOfEntries(); ++i)
+  {
+    auto const& entry = image_table.GetEntry(i);
+    BOOST_TEST_EQ(image_table.Find(entry.begin_address), i);
+    BOOST_TEST_EQ(image_table.Find(entry.end_address - 1), i);
+    BOOST_TEST(image_table.Lookup(entry.begin_address) == &entry);
+
+    std::size_t const primary = image_table.GetPrimary(i);
+    BOOST_TEST(!image_table.IsChained(primary));
+    BOOST_TEST(image_table.LookupPrimary(entry.begin_address) ==
+               &image_table.GetEntry(primary));
+  }
+
+  // The file has the same table.
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  hadesmem::PeFile const pe_file_data(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+  hadesmem::FunctionTable const data_table(process, pe_file_data);
+  BOOST_TEST(IsSameTable(image_table, data_table));
+
+  // Built once per module.
+  auto const cached = hadesmem::GetFunctionTable(process, pe_file_image);
+  BOOST_TEST(IsSameTable(image_table, *cached));
+  BOOST_TEST(hadesmem::GetFunctionTable(process, pe_file_image) == cached);
+}
+
+void TestFunctionTableMalformed()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+  std::vector<std::uint8_t> data(base, base + file.GetSize());
+  hadesmem::PeFile const pe_file(process,
+                                 data.data(),
+                                 hadesmem::PeFileType::Data,
+                                 static_cast<DWORD>(data.size()));
+
+  hadesmem::FunctionTable const table(process, pe_file);
+  if (table.GetNumberOfEntries() < 5)
+  {
+    return;
+  }
+
+  hadesmem::NtHeaders const nt_headers(process, pe_file);
+  DWORD const table_rva =
+    nt_headers.GetDataDirectoryVirtualAddress(hadesmem::PeDataDir::Exception);
+  auto const entries = static_cast<hadesmem::FunctionEntry*>(
+    hadesmem::RvaToVa(process, pe_file, table_rva));
+  auto const first = entries[0];
+  auto const second = entries[1];
+  auto const third = entries[2];
+  auto const fourth = entries[3];
+
+  // Out of order, and with an empty entry.
+  entries[0] = second;
+  entries[1] = first;
+  entries[2].end_address = entries[2].begin_address;
+  // Indirect entries, one of them referring back to itself.
+  entries[3].unwind_data =
+    (table_rva + static_cast<DWORD>(sizeof(hadesmem::FunctionEntry))) |
+    hadesmem::detail::kRuntimeFunctionIndirect;
+  entries[4].unwind_data =
+    (table_rva + 4 * static_cast<DWORD>(sizeof(hadesmem::FunctionEntry))) |
+    hadesmem::detail::kRuntimeFunctionIndirect;
+
+  hadesmem::FunctionTable const patched(process, pe_file);
+  BOOST_TEST(!patched.IsSorted());
+  BOOST_TEST_EQ(patched.GetNumberOfInvalid(), 1UL);
+  BOOST_TEST_EQ(patched.GetNumberOfEntries(), table.GetNumberOfEntries() - 1);
+  BOOST_TEST_EQ(patched.Find(first.begin_address), 0UL);
+  BOOST_TEST_EQ(patched.Find(second.begin_address), 1UL);
+  BOOST_TEST(patched.Find(third.begin_address) ==
+             hadesmem::FunctionTable::kNotFound);
+
+  std::size_t const fourth_index = patched.Find(fourth.begin_address);
+  BOOST_TEST_EQ(fourth_index, 2UL);
+  BOOST_TEST(patched.IsChained(fourth_index));
+  BOOST_TEST_EQ(patched.GetPrimary(fourth_index), 0UL);
+  BOOST_TEST(patched.LookupPrimary(fourth.end_address - 1) ==
+             &patched.GetEntry(0));
+  BOOST_TEST(!patched.IsChained(3));
+}
+
+int main()
+{
+  TestFunctionTable();
+  TestFunctionTableMalformed();
+  return boost::report_errors();
+}
@@ -0,0 +1,131 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/import_dir_table.hpp>
+#include <hadesmem/pelib/import_dir_table.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/module_list.hpp>
+#include <hadesmem/pelib/import_dir.hpp>
+#include <hadesmem/pelib/import_dir_list.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace
+{
+void CheckImportDirTable(hadesmem::Process const& process,
+                         hadesmem::PeFile const& pe_file)
+{
+  hadesmem::ImportDirTable const table(process, pe_file);
+  BOOST_TEST_EQ(static_cast<std::size_t>(
+                  std::distance(std::begin(table), std::end(table))),
+                table.size());
+
+  for (std::size_t i = 0; i < table.size(); ++i)
+  {
+    BOOST_TEST(table[i].Name != 0);
+    BOOST_TEST(table[i].FirstThunk != 0);
+    auto const import_dir = table.GetImportDir(i);
+    BOOST_TEST(import_dir.GetBase() == table.GetBase() + i);
+    if (!import_dir.IsVirtualBegin())
+    {
+      auto const raw =
+        hadesmem::Read<IMAGE_IMPORT_DESCRIPTOR>(process, table.GetBase() + i);
+      BOOST_TEST(std::memcmp(&raw, &table[i], sizeof(raw)) == 0);
+    }
+  }
+
+  // ImportDirList is a view over the same table, and stops in the same
+  // place.
+  hadesmem::ImportDirList const import_dirs(process, pe_file);
+  std::size_t i = 0;
+  for (auto const& import_dir : import_dirs)
+  {
+    BOOST_TEST(i < table.size());
+    BOOST_TEST(import_dir.GetBase() == table.GetBase() + i);
+    BOOST_TEST_EQ(import_dir.GetNameRaw(), table[i].Name);
+    BOOST_TEST_EQ(import_dir.GetFirstThunk(), table[i].FirstThunk);
+    BOOST_TEST_EQ(import_dir.GetOriginalFirstThunk(),
+                  table[i].OriginalFirstThunk);
+    ++i;
+  }
+  BOOST_TEST_EQ(i, table.size());
+}
+}
+
+void TestImportDirTable()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::ModuleList const modules(process);
+  for (auto const& mod : modules)
+  {
+    hadesmem::PeFile const pe_file(
+      process, mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+    CheckImportDirTable(process, pe_file);
+  }
+
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::PeFile const pe_file_image(
+    process, this_mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+  hadesmem::ImportDirTable const image_table(process, pe_file_image);
+  BOOST_TEST(!image_table.empty());
+
+  // The file has the same descriptors.
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  hadesmem::PeFile const pe_file_data(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+  CheckImportDirTable(process, pe_file_data);
+  hadesmem::ImportDirTable const data_table(process, pe_file_data);
+  BOOST_TEST_EQ(data_table.size(), image_table.size());
+  for (std::size_t i = 0; i < image_table.size() && i < data_table.size();
+       ++i)
+  {
+    BOOST_TEST_EQ(data_table[i].Name, image_table[i].Name);
+  }
+
+  // A descriptor with no IAT ends the table early.
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+  std::vector<std::uint8_t> data(base, base + file.GetSize());
+  hadesmem::PeFile const pe_file_patched(process,
+                                         data.data(),
+                                         hadesmem::PeFileType::Data,
+                                         static_cast<DWORD>(data.size()));
+  hadesmem::ImportDirTable const table(process, pe_file_patched);
+  BOOST_TEST(!table.empty());
+  if (table.size() >= 2)
+  {
+    table.GetBase()[1].FirstThunk = 0;
+    hadesmem::ImportDirTable const table_patched(process, pe_file_patched);
+    BOOST_TEST_EQ(table_patched.size(), 1UL);
+    CheckImportDirTable(process, pe_file_patched);
+  }
+
+  // As does one with no name, even if it's the first.
+  if (!table.empty())
+  {
+    table.GetBase()[0].Name = 0;
+    hadesmem::ImportDirTable const table_empty(process, pe_file_patched);
+    BOOST_TEST(table_empty.empty());
+    BOOST_TEST(table_empty.GetBase() == nullptr);
+  }
+}
+
+int main()
+{
+  TestImportDirTable();
+  return boost::report_errors();
+}
@@ -0,0 +1,120 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/import_table.hpp>
+#include <hadesmem/pelib/import_table.hpp>
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/module_list.hpp>
+#include <hadesmem/pelib/import_dir.hpp>
+#include <hadesmem/pelib/import_dir_list.hpp>
+#include <hadesmem/pelib/import_thunk.hpp>
+#include <hadesmem/pelib/import_thunk_list.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+void TestImportTable()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  bool processed_one_import_table = false;
+
+  hadesmem::ModuleList modules(process);
+  for (auto const& mod : modules)
+  {
+    hadesmem::PeFile const cur_pe_file(
+      process, mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+
+    hadesmem::ImportTable cur_import_table_tmp(process, cur_pe_file);
+    hadesmem::ImportTable const cur_import_table(
+      std::move(cur_import_table_tmp));
+    auto const& descriptors = cur_import_table.GetDescriptors();
+
+    hadesmem::ImportDirList const import_dirs(process, cur_pe_file);
+    std::size_t i = 0;
+    for (auto const& d : import_dirs)
+    {
+      BOOST_TEST(i < descriptors.size());
+      if (i >= descriptors.size())
+      {
+        break;
+      }
+
+      auto const& descriptor = descriptors[i++];
+      BOOST_TEST_EQ(descriptor.address, d.GetBase());
+      BOOST_TEST_EQ(descriptor.data.FirstThunk, d.GetFirstThunk());
+      BOOST_TEST(descriptor.has_name);
+      BOOST_TEST_EQ(descriptor.name.to_string(), d.GetName());
+
+      // Names are only available from the ILT once the module is loaded.
+      if (!descriptor.uses_ilt)
+      {
+        continue;
+      }
+
+      processed_one_import_table = true;
+
+      auto record = cur_import_table.GetThunksBegin(descriptor);
+      hadesmem::ImportThunkList const import_thunks(
+        process, cur_pe_file, d.GetOriginalFirstThunk());
+      for (auto const& t : import_thunks)
+      {
+        BOOST_TEST(record != cur_import_table.GetThunksEnd(descriptor));
+        if (record == cur_import_table.GetThunksEnd(descriptor))
+        {
+          break;
+        }
+
+        BOOST_TEST_EQ(record->lookup_address, t.GetBase());
+        BOOST_TEST_EQ(cur_import_table.FindThunk(t.GetBase()), record);
+        BOOST_TEST_EQ(record->by_ordinal, t.ByOrdinal());
+        if (t.ByOrdinal())
+        {
+          BOOST_TEST_EQ(record->ordinal, t.GetOrdinal());
+        }
+        else
+        {
+          BOOST_TEST(record->has_name);
+          BOOST_TEST_EQ(record->hint, t.GetHint());
+          BOOST_TEST_EQ(record->name.to_string(), t.GetName());
+        }
+
+        ++record;
+      }
+      BOOST_TEST(record == cur_import_table.GetThunksEnd(descriptor));
+    }
+    BOOST_TEST_EQ(i, descriptors.size());
+  }
+
+  BOOST_TEST(processed_one_import_table);
+
+  // Everything this module imports is loaded, so it should all resolve to
+  // what the loader bound.
+  hadesmem::PeFile const pe_file(
+    process, ::GetModuleHandleW(nullptr), hadesmem::PeFileType::Image, 0);
+  hadesmem::ImportTable import_table(process, pe_file);
+  BOOST_TEST(import_table.Resolve() > 0);
+  for (auto const& thunk : import_table.GetThunks())
+  {
+    if (thunk.target)
+    {
+      BOOST_TEST_EQ(reinterpret_cast<DWORD_PTR>(thunk.target), thunk.function);
+    }
+  }
+}
+
+int main()
+{
+  TestImportTable();
+  return boost::report_errors();
+}
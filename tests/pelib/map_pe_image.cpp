@@ -0,0 +1,153 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/map_pe_image.hpp>
+#include <hadesmem/pelib/map_pe_image.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/to_upper_ordinal.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/import_table.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+void TestMapPeImage()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::Module const this_mod(process, nullptr);
+  auto const file = hadesmem::detail::OpenFile<char>(
+    this_mod.GetPath(), std::ios::in | std::ios::binary);
+  BOOST_TEST(file && *file);
+  std::vector<char> file_data((std::istreambuf_iterator<char>(*file)),
+                              std::istreambuf_iterator<char>());
+  hadesmem::PeFile const data_file(process,
+                                   file_data.data(),
+                                   hadesmem::PeFileType::Data,
+                                   static_cast<DWORD>(file_data.size()));
+
+  // Map it at the same base as the loaded copy and bind the imports the same
+  // way the loader did.
+  auto const loaded_base = reinterpret_cast<PBYTE>(this_mod.GetHandle());
+  std::size_t num_bound = 0;
+  std::vector<BYTE> image = hadesmem::MapPeImage(
+    process,
+    data_file,
+    reinterpret_cast<std::uintptr_t>(loaded_base),
+    [&](hadesmem::ImportDescriptorRecord const& descriptor,
+        hadesmem::ImportThunkRecord const& thunk) -> DWORD_PTR
+    {
+      HMODULE const module =
+        ::GetModuleHandleA(descriptor.name.to_string().c_str());
+      if (!module)
+      {
+        return 0;
+      }
+
+      FARPROC const proc =
+        thunk.by_ordinal
+          ? ::GetProcAddress(module, MAKEINTRESOURCEA(thunk.ordinal))
+          : ::GetProcAddress(module, thunk.name.to_string().c_str());
+      num_bound += !!proc;
+      return reinterpret_cast<DWORD_PTR>(proc);
+    });
+  BOOST_TEST(num_bound > 0);
+
+  hadesmem::PeFile const image_file(process,
+                                    image.data(),
+                                    hadesmem::PeFileType::Image,
+                                    static_cast<DWORD>(image.size()));
+  hadesmem::NtHeaders const nt_headers(process, image_file);
+  BOOST_TEST_EQ(nt_headers.GetImageBase(),
+                reinterpret_cast<ULONG_PTR>(loaded_base));
+  BOOST_TEST_EQ(image.size() % nt_headers.GetSectionAlignment(), 0U);
+
+  // Code should be identical to the loaded module, other than the IAT (which
+  // is only partially bound above) if it's been merged into the same
+  // section.
+  DWORD const iat_beg =
+    nt_headers.GetDataDirectoryVirtualAddress(hadesmem::PeDataDir::IAT);
+  DWORD const iat_end =
+    iat_beg + nt_headers.GetDataDirectorySize(hadesmem::PeDataDir::IAT);
+  bool compared_one_section = false;
+  hadesmem::SectionList const sections(process, image_file);
+  for (auto const& section : sections)
+  {
+    DWORD const characteristics = section.GetCharacteristics();
+    if (!(characteristics & IMAGE_SCN_MEM_EXECUTE) ||
+        (characteristics & IMAGE_SCN_MEM_WRITE))
+    {
+      continue;
+    }
+
+    DWORD const beg = section.GetVirtualAddress();
+    DWORD const end = beg + (std::min)(section.GetVirtualSize(),
+                                       section.GetSizeOfRawData());
+    for (DWORD rva = beg; rva < end; ++rva)
+    {
+      if (rva >= iat_beg && rva < iat_end)
+      {
+        continue;
+      }
+
+      if (image[rva] != loaded_base[rva])
+      {
+        BOOST_TEST_EQ(image[rva], loaded_base[rva]);
+        break;
+      }
+    }
+
+    compared_one_section = true;
+  }
+  BOOST_TEST(compared_one_section);
+
+  // Imports from kernel32 should have been bound to what the loader bound
+  // them to.
+  hadesmem::ImportTable const imports(process, data_file);
+  for (auto const& descriptor : imports.GetDescriptors())
+  {
+    if (hadesmem::detail::ToUpperOrdinal(descriptor.name.to_string()) !=
+        "KERNEL32.DLL")
+    {
+      continue;
+    }
+
+    for (std::size_t i = 0; i < descriptor.num_thunks; ++i)
+    {
+      std::size_t const rva =
+        descriptor.data.FirstThunk + i * sizeof(IMAGE_THUNK_DATA);
+      DWORD_PTR mapped = 0;
+      DWORD_PTR loaded = 0;
+      std::memcpy(&mapped, &image[rva], sizeof(mapped));
+      std::memcpy(&loaded, loaded_base + rva, sizeof(loaded));
+      BOOST_TEST_EQ(mapped, loaded);
+    }
+  }
+
+  BOOST_TEST_THROWS(hadesmem::MapPeImage(process, image_file),
+                    hadesmem::Error);
+}
+
+int main()
+{
+  TestMapPeImage();
+  return boost::report_errors();
+}
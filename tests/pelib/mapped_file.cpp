@@ -0,0 +1,95 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <ios>
+#include <iterator>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+void TestMappedFile()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::Module const this_mod(process, nullptr);
+  auto const file = hadesmem::detail::OpenFile<char>(
+    this_mod.GetPath(), std::ios::in | std::ios::binary);
+  BOOST_TEST(file && *file);
+  std::vector<char> file_data((std::istreambuf_iterator<char>(*file)),
+                              std::istreambuf_iterator<char>());
+
+  hadesmem::MappedFile const mapped_file(this_mod.GetPath());
+  BOOST_TEST_EQ(mapped_file.GetFileSize(), file_data.size());
+  BOOST_TEST_EQ(mapped_file.GetSize(), file_data.size());
+  BOOST_TEST(mapped_file.GetBase() != nullptr);
+  BOOST_TEST(std::memcmp(mapped_file.GetBase(),
+                         file_data.data(),
+                         file_data.size()) == 0);
+
+  BOOST_TEST(hadesmem::ProbePeFile(
+    process, mapped_file.GetBase(), mapped_file.GetSize()));
+  hadesmem::PeFile const pe_file(process,
+                                 mapped_file.GetBase(),
+                                 hadesmem::PeFileType::Data,
+                                 mapped_file.GetSize());
+  hadesmem::NtHeaders const nt_headers(process, pe_file);
+  BOOST_TEST_EQ(nt_headers.GetSizeOfImage(), this_mod.GetSize());
+
+  hadesmem::MappedFile moved_file(
+    hadesmem::MappedFile(this_mod.GetPath()));
+  BOOST_TEST_EQ(moved_file.GetSize(), mapped_file.GetSize());
+  moved_file = hadesmem::MappedFile(this_mod.GetPath());
+  BOOST_TEST(moved_file.GetBase() != nullptr);
+
+  BOOST_TEST_THROWS(hadesmem::MappedFile(L"?"), hadesmem::Error);
+}
+
+void TestProbePeFile()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::Module const this_mod(process, nullptr);
+  auto const base = reinterpret_cast<PBYTE>(this_mod.GetHandle());
+  std::vector<BYTE> headers(base, base + 0x1000);
+  BOOST_TEST(hadesmem::ProbePeFile(process, headers.data(), headers.size()));
+
+  // Too small for a DOS header.
+  BOOST_TEST(!hadesmem::ProbePeFile(process, headers.data(), 2));
+
+  // The signature is past the end of the buffer.
+  auto const nt_headers_offset =
+    reinterpret_cast<IMAGE_DOS_HEADER*>(headers.data())->e_lfanew;
+  BOOST_TEST(!hadesmem::ProbePeFile(
+    process, headers.data(), static_cast<std::size_t>(nt_headers_offset)));
+
+  std::vector<BYTE> bad_headers(headers);
+  reinterpret_cast<IMAGE_DOS_HEADER*>(bad_headers.data())->e_lfanew = -1;
+  BOOST_TEST(
+    !hadesmem::ProbePeFile(process, bad_headers.data(), bad_headers.size()));
+
+  std::fill(std::begin(bad_headers), std::end(bad_headers), BYTE(0));
+  BOOST_TEST(
+    !hadesmem::ProbePeFile(process, bad_headers.data(), bad_headers.size()));
+}
+
+int main()
+{
+  TestMappedFile();
+  TestProbePeFile();
+  return boost::report_errors();
+}
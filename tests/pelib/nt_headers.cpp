@@ -4,8 +4,11 @@
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 #include <hadesmem/detail/warning_disable_prefix.hpp>
 #include <boost/detail/lightweight_test.hpp>
@@ -15,6 +18,8 @@
 #include <hadesmem/error.hpp>
 #include <hadesmem/module.hpp>
 #include <hadesmem/module_list.hpp>
+#include <hadesmem/pelib/dos_header.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
@@ -142,8 +147,88 @@ void TestNtHeaders()
   }
 }
 
+void TestNtHeadersTry()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::PeFile const pe_file_image(
+    process, ::GetModuleHandleW(nullptr), hadesmem::PeFileType::Image, 0);
+  hadesmem::NtHeaders const nt_headers(process, pe_file_image);
+  auto const nt_headers_image = hadesmem::TryNtHeaders(process, pe_file_image);
+  BOOST_TEST(!!nt_headers_image);
+  BOOST_TEST_EQ(nt_headers_image->GetBase(), nt_headers.GetBase());
+  BOOST_TEST_EQ(nt_headers_image->GetSizeOfImage(),
+                nt_headers.GetSizeOfImage());
+  BOOST_TEST(!!hadesmem::TryDosHeader(process, pe_file_image));
+
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+  std::vector<std::uint8_t> data(base, base + file.GetSize());
+  hadesmem::PeFile const pe_file(process,
+                                 data.data(),
+                                 hadesmem::PeFileType::Data,
+                                 static_cast<DWORD>(data.size()));
+  BOOST_TEST(!!hadesmem::TryNtHeaders(process, pe_file));
+  DWORD const ep_rva = nt_headers.GetAddressOfEntryPoint();
+  auto const ep_va = hadesmem::TryRvaToVa(process, pe_file, ep_rva);
+  BOOST_TEST(!!ep_va);
+  BOOST_TEST(ep_va && *ep_va == hadesmem::RvaToVa(process, pe_file, ep_rva));
+
+  // Strings can cross pages, and are terminated by the end of the file.
+  std::size_t const page_offset =
+    0x1000 - (reinterpret_cast<std::uintptr_t>(data.data()) & 0xFFF) - 3;
+  BOOST_TEST(page_offset + 0x10 < data.size());
+  std::memcpy(&data[page_offset], "abcdef", 7);
+  auto const str = hadesmem::detail::TryCheckedReadString<char>(
+    process, pe_file, &data[page_offset]);
+  BOOST_TEST(str && *str == "abcdef");
+  data[data.size() - 2] = 'x';
+  data[data.size() - 1] = 'y';
+  auto const str_eof = hadesmem::detail::TryCheckedReadString<char>(
+    process, pe_file, &data[data.size() - 2]);
+  BOOST_TEST(str_eof && *str_eof == "xy");
+  auto const str_invalid = hadesmem::detail::TryCheckedReadString<char>(
+    process, pe_file, data.data() + data.size());
+  BOOST_TEST(!str_invalid);
+  BOOST_TEST_EQ(str_invalid.GetErrorString(), "Invalid VA.");
+
+  // Failures are reported with the same info as the throwing API.
+  auto& dos_header = *reinterpret_cast<IMAGE_DOS_HEADER*>(data.data());
+  data[dos_header.e_lfanew] = 0;
+  BOOST_TEST(!!hadesmem::TryDosHeader(process, pe_file));
+  auto const nt_headers_bad = hadesmem::TryNtHeaders(process, pe_file);
+  BOOST_TEST(!nt_headers_bad);
+  BOOST_TEST_EQ(nt_headers_bad.GetErrorString(),
+                "NT headers signature invalid.");
+  bool thrown = false;
+  try
+  {
+    hadesmem::NtHeaders const nt_headers_throw(process, pe_file);
+  }
+  catch (hadesmem::Error const& e)
+  {
+    thrown = true;
+    auto const error_string = boost::get_error_info<hadesmem::ErrorString>(e);
+    BOOST_TEST(error_string &&
+               *error_string == nt_headers_bad.GetErrorString());
+  }
+  BOOST_TEST(thrown);
+  auto const ep_va_bad = hadesmem::TryRvaToVa(process, pe_file, ep_rva);
+  BOOST_TEST(!ep_va_bad);
+  BOOST_TEST_EQ(ep_va_bad.GetErrorString(), "Invalid NT headers.");
+
+  dos_header.e_magic = 0;
+  auto const dos_header_bad = hadesmem::TryDosHeader(process, pe_file);
+  BOOST_TEST(!dos_header_bad);
+  BOOST_TEST_EQ(dos_header_bad.GetErrorString(), "DOS header magic invalid.");
+  BOOST_TEST_EQ(hadesmem::TryNtHeaders(process, pe_file).GetErrorString(),
+                "DOS header magic invalid.");
+}
+
 int main()
 {
   TestNtHeaders();
+  TestNtHeadersTry();
   return boost::report_errors();
 }
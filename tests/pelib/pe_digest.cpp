@@ -0,0 +1,172 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/pe_digest.hpp>
+#include <hadesmem/pelib/pe_digest.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/map_pe_image.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+// The checksum as CheckSumMappedFile computes it, a WORD at a time.
+DWORD ReferenceCheckSum(std::uint8_t const* data,
+                        DWORD size,
+                        DWORD checksum_offset)
+{
+  DWORD sum = 0;
+  for (DWORD i = 0; i < size; i += 2)
+  {
+    DWORD word = data[i];
+    if (i + 1 < size)
+    {
+      word |= data[i + 1] << 8;
+    }
+    if (i >= checksum_offset && i < checksum_offset + sizeof(DWORD))
+    {
+      word = 0;
+    }
+    sum += word;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+
+  return sum + size;
+}
+}
+
+void TestPeCheckSumWords()
+{
+  std::vector<std::uint8_t> data(0x1234);
+  for (std::size_t i = 0; i < data.size(); ++i)
+  {
+    data[i] = static_cast<std::uint8_t>(i * 7 + (i >> 8));
+  }
+
+  // Unaligned, and with a tail which isn't a multiple of the vector size.
+  for (std::size_t offset = 0; offset < 4; offset += 2)
+  {
+    std::uint64_t expected = 0;
+    std::size_t const size = data.size() - 10 - offset;
+    for (std::size_t i = 0; i < size; i += 2)
+    {
+      expected += data[offset + i] | (data[offset + i + 1] << 8);
+    }
+    BOOST_TEST_EQ(
+      hadesmem::detail::SumPeCheckSumWords(data.data() + offset, size),
+      expected);
+  }
+
+  BOOST_TEST_EQ(hadesmem::detail::FoldPeCheckSum(0), 0UL);
+  BOOST_TEST_EQ(hadesmem::detail::FoldPeCheckSum(0xFFFF), 0xFFFFUL);
+  BOOST_TEST_EQ(hadesmem::detail::FoldPeCheckSum(0x1FFFE), 0xFFFFUL);
+  BOOST_TEST_EQ(hadesmem::detail::FoldPeCheckSum(0x12345678), 0x68ACUL);
+}
+
+void TestPeDigest()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  hadesmem::PeFile const pe_file_data(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+
+  hadesmem::PeDigest const data_digest(process, pe_file_data);
+  hadesmem::NtHeaders const nt_headers(process, pe_file_data);
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+  auto const checksum_offset = static_cast<DWORD>(
+    static_cast<std::uint8_t const*>(nt_headers.GetBase()) - base +
+    offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
+    offsetof(IMAGE_OPTIONAL_HEADER, CheckSum));
+  BOOST_TEST(data_digest.HasCheckSum());
+  BOOST_TEST_EQ(data_digest.GetCheckSum(),
+                ReferenceCheckSum(base, file.GetSize(), checksum_offset));
+  if (nt_headers.GetCheckSum())
+  {
+    BOOST_TEST_EQ(data_digest.GetCheckSum(), nt_headers.GetCheckSum());
+  }
+
+  BOOST_TEST_EQ(data_digest.GetImportHash().size(), 16UL);
+  BOOST_TEST_EQ(data_digest.GetImageHash().size(), 32UL);
+  hadesmem::SectionList const sections(process, pe_file_data);
+  BOOST_TEST_EQ(data_digest.GetSectionHashes().size(),
+                static_cast<std::size_t>(
+                  std::distance(std::begin(sections), std::end(sections))));
+  BOOST_TEST_EQ(hadesmem::FormatDigest(data_digest.GetImageHash()).size(),
+                64UL);
+
+  // An image layout with no relocations applied or imports bound has the
+  // same sections, and (with no overlay) the same image hash.
+  auto image = hadesmem::MapPeImage(process, pe_file_data);
+  hadesmem::PeFile const pe_file_image(process,
+                                       image.data(),
+                                       hadesmem::PeFileType::Image,
+                                       static_cast<DWORD>(image.size()));
+  hadesmem::PeDigest const image_digest(process, pe_file_image);
+  BOOST_TEST(!image_digest.HasCheckSum());
+  BOOST_TEST(image_digest.GetImportHash() == data_digest.GetImportHash());
+  BOOST_TEST(image_digest.GetSectionHashes() ==
+             data_digest.GetSectionHashes());
+  BOOST_TEST(image_digest.GetImageHash() == data_digest.GetImageHash());
+
+  // Changing a section changes its hash and the image hash, but no others.
+  // Sections with no raw data (e.g. .textbss) aren't hashed.
+  std::size_t patched_index = 0;
+  DWORD patched_rva = 0;
+  for (auto const& section : sections)
+  {
+    if (section.GetSizeOfRawData())
+    {
+      patched_rva = section.GetVirtualAddress();
+      break;
+    }
+    ++patched_index;
+  }
+  BOOST_TEST(patched_rva != 0);
+  image[patched_rva] ^= 0xFF;
+  hadesmem::PeDigest const patched_digest(process, pe_file_image);
+  for (std::size_t i = 0; i < data_digest.GetSectionHashes().size(); ++i)
+  {
+    BOOST_TEST_EQ(patched_digest.GetSectionHashes()[i] ==
+                    data_digest.GetSectionHashes()[i],
+                  i != patched_index);
+  }
+  BOOST_TEST(patched_digest.GetImageHash() != data_digest.GetImageHash());
+
+  hadesmem::PeDigest const md5_digest(process,
+                                      pe_file_data,
+                                      hadesmem::PeDigestFlags::kSectionHashes,
+                                      hadesmem::PeHashAlgorithm::kMd5);
+  BOOST_TEST(!md5_digest.HasCheckSum());
+  BOOST_TEST(md5_digest.GetImportHash().empty());
+  BOOST_TEST(md5_digest.GetImageHash().empty());
+  BOOST_TEST_EQ(md5_digest.GetSectionHashes().size(),
+                data_digest.GetSectionHashes().size());
+  BOOST_TEST_EQ(md5_digest.GetSectionHashes()[0].size(), 16UL);
+
+  hadesmem::PeDigest const checksum_digest(
+    process, pe_file_data, hadesmem::PeDigestFlags::kCheckSum);
+  BOOST_TEST_EQ(checksum_digest.GetCheckSum(), data_digest.GetCheckSum());
+  BOOST_TEST(checksum_digest.GetSectionHashes().empty());
+}
+
+int main()
+{
+  TestPeCheckSumWords();
+  TestPeDigest();
+  return boost::report_errors();
+}
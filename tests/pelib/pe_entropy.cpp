@@ -0,0 +1,201 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/pe_entropy.hpp>
+#include <hadesmem/pelib/pe_entropy.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/map_pe_image.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+double ReferenceEntropy(std::vector<std::uint8_t> const& data)
+{
+  std::vector<double> counts(256);
+  for (auto const b : data)
+  {
+    ++counts[b];
+  }
+
+  double entropy = 0.0;
+  for (auto const count : counts)
+  {
+    if (count != 0.0)
+    {
+      double const p = count / data.size();
+      entropy -= p * std::log2(p);
+    }
+  }
+
+  return entropy;
+}
+
+double GetEntropy(std::vector<std::uint8_t> const& data)
+{
+  hadesmem::detail::ByteHistogram histogram;
+  histogram.Update(data.data(), data.size());
+  return histogram.GetEntropy();
+}
+
+bool IsClose(double lhs, double rhs)
+{
+  return std::fabs(lhs - rhs) < 1e-9;
+}
+}
+
+void TestByteHistogram()
+{
+  BOOST_TEST_EQ(GetEntropy(std::vector<std::uint8_t>()), 0.0);
+  BOOST_TEST_EQ(GetEntropy(std::vector<std::uint8_t>(100, 0xCC)), 0.0);
+
+  std::vector<std::uint8_t> every_byte;
+  for (std::size_t i = 0; i < 256 * 4; ++i)
+  {
+    every_byte.push_back(static_cast<std::uint8_t>(i));
+  }
+  BOOST_TEST(IsClose(GetEntropy(every_byte), 8.0));
+
+  std::vector<std::uint8_t> two_bytes;
+  for (std::size_t i = 0; i < 64; ++i)
+  {
+    two_bytes.push_back(static_cast<std::uint8_t>(i & 1));
+  }
+  BOOST_TEST(IsClose(GetEntropy(two_bytes), 1.0));
+
+  // Runs of one byte mixed with noise, with a tail which isn't a multiple
+  // of the block size, fed in uneven pieces.
+  std::vector<std::uint8_t> data(0x1235);
+  std::uint32_t seed = 1;
+  for (std::size_t i = 0; i < data.size(); ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (i & 0x100) ? 0 : static_cast<std::uint8_t>(seed >> 16);
+  }
+  hadesmem::detail::ByteHistogram histogram;
+  for (std::size_t i = 0; i < data.size(); i += 0x333)
+  {
+    histogram.Update(&data[i],
+                     (std::min)(static_cast<std::size_t>(0x333),
+                                data.size() - i));
+  }
+  BOOST_TEST_EQ(histogram.GetTotal(), data.size());
+  std::size_t zeros = 0;
+  for (auto const b : data)
+  {
+    zeros += !b;
+  }
+  BOOST_TEST_EQ(histogram.GetCount(0), zeros);
+  BOOST_TEST(IsClose(histogram.GetEntropy(), ReferenceEntropy(data)));
+}
+
+void TestPeEntropy()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  hadesmem::PeFile const pe_file_data(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+
+  hadesmem::PeEntropy const data_entropy(process, pe_file_data);
+  hadesmem::SectionList const sections(process, pe_file_data);
+  auto const& section_entropy = data_entropy.GetSectionEntropy();
+  BOOST_TEST_EQ(section_entropy.size(),
+                static_cast<std::size_t>(
+                  std::distance(std::begin(sections), std::end(sections))));
+  std::size_t i = 0;
+  for (auto const& section : sections)
+  {
+    BOOST_TEST(section_entropy[i] >= 0.0 && section_entropy[i] <= 8.0);
+    BOOST_TEST_EQ(section_entropy[i] == 0.0, !section.GetSizeOfRawData());
+    ++i;
+  }
+
+  // An image has the same raw data, and so the same entropy, but no overlay.
+  auto image = hadesmem::MapPeImage(process, pe_file_data);
+  hadesmem::PeFile const pe_file_image(process,
+                                       image.data(),
+                                       hadesmem::PeFileType::Image,
+                                       static_cast<DWORD>(image.size()));
+  hadesmem::PeEntropy const image_entropy(process, pe_file_image);
+  BOOST_TEST(image_entropy.GetSectionEntropy() == section_entropy);
+  BOOST_TEST(!image_entropy.HasOverlay());
+
+  // PointerToRawData is rounded down to 0x200, so low bits in it don't move
+  // the raw data.
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+  std::vector<std::uint8_t> data(base, base + file.GetSize());
+  {
+    hadesmem::PeFile const pe_file_unaligned(process,
+                                             data.data(),
+                                             hadesmem::PeFileType::Data,
+                                             static_cast<DWORD>(data.size()));
+    hadesmem::SectionList const unaligned_sections(process,
+                                                   pe_file_unaligned);
+    for (auto section : unaligned_sections)
+    {
+      section.SetPointerToRawData(section.GetPointerToRawData() | 0x1F);
+      section.UpdateWrite();
+    }
+    hadesmem::PeEntropy const unaligned_entropy(process, pe_file_unaligned);
+    BOOST_TEST(unaligned_entropy.GetSectionEntropy() == section_entropy);
+    BOOST_TEST_EQ(unaligned_entropy.HasOverlay(), data_entropy.HasOverlay());
+  }
+  data.assign(base, base + file.GetSize());
+
+  // Appending data gives an overlay (or a bigger one).
+  DWORD const overlay_offset = data_entropy.HasOverlay()
+                                 ? data_entropy.GetOverlayOffset()
+                                 : file.GetSize();
+  for (std::size_t j = 0; j < 0x1000; ++j)
+  {
+    data.push_back(static_cast<std::uint8_t>(j * 7 + (j >> 8)));
+  }
+  hadesmem::PeFile const pe_file_overlay(process,
+                                         data.data(),
+                                         hadesmem::PeFileType::Data,
+                                         static_cast<DWORD>(data.size()));
+  hadesmem::PeEntropy const overlay_entropy(process, pe_file_overlay);
+  BOOST_TEST(overlay_entropy.GetSectionEntropy() == section_entropy);
+  BOOST_TEST(overlay_entropy.HasOverlay());
+  BOOST_TEST_EQ(overlay_entropy.GetOverlayOffset(), overlay_offset);
+  BOOST_TEST_EQ(overlay_entropy.GetOverlayOffset() +
+                  overlay_entropy.GetOverlaySize(),
+                data.size());
+  BOOST_TEST(overlay_entropy.GetOverlayEntropy() > 7.0);
+
+  // A signature at the end of the file isn't part of the overlay.
+  if (!data_entropy.HasOverlay())
+  {
+    hadesmem::NtHeaders nt_headers(process, pe_file_overlay);
+    nt_headers.SetDataDirectoryVirtualAddress(hadesmem::PeDataDir::Security,
+                                              file.GetSize());
+    nt_headers.SetDataDirectorySize(hadesmem::PeDataDir::Security, 0x1000);
+    nt_headers.UpdateWrite();
+    hadesmem::PeEntropy const signed_entropy(process, pe_file_overlay);
+    BOOST_TEST(!signed_entropy.HasOverlay());
+  }
+}
+
+int main()
+{
+  TestByteHistogram();
+  TestPeEntropy();
+  return boost::report_errors();
+}
@@ -0,0 +1,127 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/pe_image.hpp>
+#include <hadesmem/pelib/pe_image.hpp>
+
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/self_path.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+void TestPeImageImage()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::PeFile const pe_file(
+    process, ::GetModuleHandleW(nullptr), hadesmem::PeFileType::Image, 0);
+  hadesmem::PeImage const pe_image(
+    process, ::GetModuleHandleW(nullptr), hadesmem::PeFileType::Image, 0);
+  BOOST_TEST(pe_file.GetImageData() == nullptr);
+  BOOST_TEST(pe_image.GetImageData() != nullptr);
+  BOOST_TEST_EQ(pe_file, pe_image);
+  BOOST_TEST_EQ(pe_file.GetSize(), pe_image.GetSize());
+
+  hadesmem::NtHeaders const nt_headers(process, pe_file);
+  hadesmem::NtHeaders const nt_headers_cached(process, pe_image);
+  BOOST_TEST_EQ(nt_headers, nt_headers_cached);
+  BOOST_TEST_EQ(nt_headers.GetSizeOfImage(),
+                nt_headers_cached.GetSizeOfImage());
+  BOOST_TEST_EQ(pe_image.GetSectionHeaders().size(),
+                static_cast<std::size_t>(nt_headers.GetNumberOfSections()));
+
+  hadesmem::SectionList const sections(process, pe_file);
+  hadesmem::SectionList const sections_cached(process, pe_image);
+  BOOST_TEST_EQ(std::distance(std::begin(sections), std::end(sections)),
+                std::distance(std::begin(sections_cached),
+                              std::end(sections_cached)));
+  auto iter_cached = std::begin(sections_cached);
+  for (auto const& section : sections)
+  {
+    BOOST_TEST_EQ(section.GetName(), iter_cached->GetName());
+    BOOST_TEST_EQ(section.GetVirtualAddress(),
+                  iter_cached->GetVirtualAddress());
+    ++iter_cached;
+  }
+
+  BOOST_TEST_EQ(hadesmem::RvaToVa(process, pe_image, 0),
+                static_cast<void*>(nullptr));
+  BOOST_TEST_EQ(hadesmem::RvaToVa(process, pe_image, 0x1000),
+                hadesmem::RvaToVa(process, pe_file, 0x1000));
+}
+
+void TestPeImageData()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  auto const file = hadesmem::detail::OpenFile<char>(
+    hadesmem::detail::GetSelfPath(), std::ios::in | std::ios::binary);
+  BOOST_TEST(!!*file);
+  std::vector<char> const buf((std::istreambuf_iterator<char>(*file)),
+                              std::istreambuf_iterator<char>());
+  BOOST_TEST(!buf.empty());
+  void* const base = const_cast<char*>(buf.data());
+  DWORD const size = static_cast<DWORD>(buf.size());
+
+  hadesmem::PeFile const pe_file(
+    process, base, hadesmem::PeFileType::Data, size);
+  hadesmem::PeImage const pe_image(
+    process, base, hadesmem::PeFileType::Data, size);
+
+  // Every section edge (and the bytes either side of it) plus a sweep over
+  // the whole image must map identically with and without the cache.
+  std::vector<DWORD> rvas = {0, 1, 0x1000, 0xFFFFFFFFUL};
+  for (auto const& section_header : pe_image.GetSectionHeaders())
+  {
+    DWORD const edges[] = {
+      section_header.VirtualAddress,
+      section_header.VirtualAddress + section_header.Misc.VirtualSize,
+      section_header.VirtualAddress + section_header.SizeOfRawData};
+    for (auto const edge : edges)
+    {
+      rvas.push_back(edge - 1);
+      rvas.push_back(edge);
+      rvas.push_back(edge + 1);
+    }
+  }
+
+  DWORD const size_of_image =
+    pe_image.GetNtHeadersData().OptionalHeader.SizeOfImage;
+  for (DWORD rva = 0; rva < size_of_image + 0x2000; rva += 0x37)
+  {
+    rvas.push_back(rva);
+  }
+
+  for (auto const rva : rvas)
+  {
+    BOOST_TEST_EQ(hadesmem::RvaToVa(process, pe_image, rva),
+                  hadesmem::RvaToVa(process, pe_file, rva));
+  }
+
+  std::vector<char> invalid(0x1000);
+  BOOST_TEST_THROWS(hadesmem::PeImage(process,
+                                      invalid.data(),
+                                      hadesmem::PeFileType::Data,
+                                      static_cast<DWORD>(invalid.size())),
+                    hadesmem::Error);
+}
+
+int main()
+{
+  TestPeImageImage();
+  TestPeImageData();
+  return boost::report_errors();
+}
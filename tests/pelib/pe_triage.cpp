@@ -0,0 +1,210 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/pe_triage.hpp>
+#include <hadesmem/pelib/pe_triage.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+template <typename T>
+void Patch(std::vector<std::uint8_t>& data, std::size_t offset, T value)
+{
+  std::memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+hadesmem::PeTriageStatus Triage(std::vector<std::uint8_t> const& data,
+                                hadesmem::PeTriageRecord& record)
+{
+  return hadesmem::TriagePeHeaders(
+    data.data(), data.size(), data.size(), record);
+}
+}
+
+void TestTriagePeFile()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+
+  hadesmem::PeTriageRecord record;
+  BOOST_TEST(hadesmem::TriagePeFile(
+               process, file.GetBase(), file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST(record.status == hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST_EQ(record.flags, hadesmem::PeTriageFlags::kNone);
+
+  hadesmem::PeFile const pe_file(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+  hadesmem::NtHeaders const nt_headers(process, pe_file);
+  BOOST_TEST_EQ(record.file_size, file.GetSize());
+  BOOST_TEST_EQ(record.machine, nt_headers.GetMachine());
+  BOOST_TEST_EQ(record.magic, nt_headers.GetMagic());
+  BOOST_TEST_EQ(record.time_date_stamp, nt_headers.GetTimeDateStamp());
+  BOOST_TEST_EQ(record.number_of_sections, nt_headers.GetNumberOfSections());
+  BOOST_TEST_EQ(record.address_of_entry_point,
+                nt_headers.GetAddressOfEntryPoint());
+  BOOST_TEST_EQ(record.size_of_image, nt_headers.GetSizeOfImage());
+  BOOST_TEST_EQ(record.subsystem, nt_headers.GetSubsystem());
+  BOOST_TEST_EQ(record.image_base, nt_headers.GetImageBase());
+  BOOST_TEST((record.data_directories &
+              (1UL << static_cast<int>(hadesmem::PeDataDir::Import))) != 0);
+
+  // Unreadable memory fails cleanly. The first 64KB is never mapped.
+  BOOST_TEST(hadesmem::TriagePeFile(
+               process, reinterpret_cast<void*>(0x1000), 0x1000, record) ==
+             hadesmem::PeTriageStatus::kUnreadable);
+  BOOST_TEST_EQ(record.file_size, 0x1000ULL);
+}
+
+void TestTriagePeHeaders()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+
+  hadesmem::PeTriageRecord record;
+  std::vector<std::uint8_t> const headers(base, base + 0x1000);
+  BOOST_TEST(hadesmem::TriagePeHeaders(
+               headers.data(), headers.size(), file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kValid);
+  DWORD const nt_headers_offset = record.nt_headers_offset;
+  DWORD const headers_end = record.headers_end;
+  std::size_t const optional_header_offset =
+    nt_headers_offset + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+  std::size_t const last_section_offset =
+    headers_end - sizeof(IMAGE_SECTION_HEADER);
+  std::size_t const prev_section_offset =
+    last_section_offset - sizeof(IMAGE_SECTION_HEADER);
+  DWORD prev_section_va = 0;
+  std::memcpy(&prev_section_va,
+              headers.data() + prev_section_offset +
+                offsetof(IMAGE_SECTION_HEADER, VirtualAddress),
+              sizeof(prev_section_va));
+
+  // Too little of the file to get to the end of the section table.
+  BOOST_TEST(hadesmem::TriagePeHeaders(
+               headers.data(), headers_end - 1, file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kIncomplete);
+  BOOST_TEST_EQ(record.headers_end, headers_end);
+  BOOST_TEST(hadesmem::TriagePeHeaders(
+               headers.data(), 0x10, file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kIncomplete);
+
+  // The same, but the file itself is truncated.
+  std::vector<std::uint8_t> data(headers.data(), headers.data() + 0x10);
+  BOOST_TEST(Triage(data, record) ==
+             hadesmem::PeTriageStatus::kInvalidDosHeader);
+  data.assign(headers.data(),
+              headers.data() + nt_headers_offset + sizeof(DWORD) + 1);
+  BOOST_TEST(Triage(data, record) ==
+             hadesmem::PeTriageStatus::kInvalidFileHeader);
+
+  // Section tables which run past the end of the file are virtual, as they
+  // are for the loader, and only the sections in the file are checked.
+  data.assign(headers.data(), headers.data() + headers_end - 1);
+  BOOST_TEST(Triage(data, record) == hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST((record.flags & hadesmem::PeTriageFlags::kVirtualSectionTable) !=
+             0);
+  BOOST_TEST_EQ(record.headers_end, last_section_offset);
+
+  data = headers;
+  Patch(data, 0, WORD{0});
+  BOOST_TEST(Triage(data, record) ==
+             hadesmem::PeTriageStatus::kInvalidDosHeader);
+
+  data = headers;
+  Patch(data, offsetof(IMAGE_DOS_HEADER, e_lfanew), LONG{-1});
+  BOOST_TEST(Triage(data, record) ==
+             hadesmem::PeTriageStatus::kInvalidNtHeaders);
+
+  data = headers;
+  Patch(data, nt_headers_offset, DWORD{0});
+  BOOST_TEST(Triage(data, record) ==
+             hadesmem::PeTriageStatus::kInvalidNtHeaders);
+
+  data = headers;
+  Patch(data,
+        nt_headers_offset + sizeof(DWORD) +
+          offsetof(IMAGE_FILE_HEADER, NumberOfSections),
+        WORD{0xFFFF});
+  BOOST_TEST(Triage(data, record) == hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST((record.flags & hadesmem::PeTriageFlags::kVirtualSectionTable) !=
+             0);
+
+  data = headers;
+  Patch(data, optional_header_offset, WORD{0x1234});
+  BOOST_TEST(Triage(data, record) ==
+             hadesmem::PeTriageStatus::kInvalidOptionalHeader);
+  BOOST_TEST_EQ(record.magic, 0x1234);
+
+  data = headers;
+  Patch(data,
+        optional_header_offset +
+          offsetof(IMAGE_OPTIONAL_HEADER, SectionAlignment),
+        DWORD{3});
+  BOOST_TEST(Triage(data, record) ==
+             hadesmem::PeTriageStatus::kInvalidOptionalHeader);
+
+  // Oddities in the section table which pelib accepts are only flagged. The
+  // headers are triaged as the start of the real file, so that the raw data
+  // is in the file.
+  data = headers;
+  Patch(data,
+        last_section_offset + offsetof(IMAGE_SECTION_HEADER, SizeOfRawData),
+        DWORD{0x7FFFFFFF});
+  BOOST_TEST(hadesmem::TriagePeHeaders(
+               data.data(), data.size(), file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST_EQ(record.flags, hadesmem::PeTriageFlags::kRawDataPastEof);
+
+  data = headers;
+  Patch(data,
+        last_section_offset + offsetof(IMAGE_SECTION_HEADER, VirtualAddress),
+        DWORD{0});
+  BOOST_TEST(hadesmem::TriagePeHeaders(
+               data.data(), data.size(), file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST_EQ(record.flags, hadesmem::PeTriageFlags::kSectionsOutOfOrder);
+
+  data = headers;
+  Patch(data,
+        last_section_offset + offsetof(IMAGE_SECTION_HEADER, VirtualAddress),
+        prev_section_va);
+  BOOST_TEST(hadesmem::TriagePeHeaders(
+               data.data(), data.size(), file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST_EQ(record.flags, hadesmem::PeTriageFlags::kSectionsOverlap);
+
+  data = headers;
+  Patch(data,
+        last_section_offset + offsetof(IMAGE_SECTION_HEADER, VirtualAddress),
+        DWORD{0x7FFFF000});
+  BOOST_TEST(hadesmem::TriagePeHeaders(
+               data.data(), data.size(), file.GetSize(), record) ==
+             hadesmem::PeTriageStatus::kValid);
+  BOOST_TEST_EQ(record.flags, hadesmem::PeTriageFlags::kSectionPastImage);
+}
+
+int main()
+{
+  TestTriagePeFile();
+  TestTriagePeHeaders();
+  return boost::report_errors();
+}
@@ -0,0 +1,122 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/relocation_table.hpp>
+#include <hadesmem/pelib/relocation_table.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/module_list.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/relocation.hpp>
+#include <hadesmem/pelib/relocation_block.hpp>
+#include <hadesmem/pelib/relocation_block_list.hpp>
+#include <hadesmem/pelib/relocation_list.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+void TestRelocationTable()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  bool processed_one_relocation_table = false;
+
+  hadesmem::ModuleList modules(process);
+  for (auto const& mod : modules)
+  {
+    hadesmem::PeFile const cur_pe_file(
+      process, mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+
+    std::map<std::uint8_t, std::vector<DWORD>> expected;
+    hadesmem::RelocationBlockList const blocks(process, cur_pe_file);
+    for (auto const& block : blocks)
+    {
+      hadesmem::RelocationList const relocs(process,
+                                            cur_pe_file,
+                                            block.GetRelocationDataStart(),
+                                            block.GetNumberOfRelocations());
+      for (auto const& reloc : relocs)
+      {
+        expected[reloc.GetType()].push_back(block.GetVirtualAddress() +
+                                            reloc.GetOffset());
+      }
+    }
+    for (auto& relocs : expected)
+    {
+      std::sort(std::begin(relocs.second), std::end(relocs.second));
+    }
+
+    hadesmem::RelocationTable const cur_relocation_table(process,
+                                                         cur_pe_file);
+    BOOST_TEST(cur_relocation_table.GetHighLow() ==
+               expected[IMAGE_REL_BASED_HIGHLOW]);
+    BOOST_TEST(cur_relocation_table.GetDir64() ==
+               expected[IMAGE_REL_BASED_DIR64]);
+    if (!cur_relocation_table.GetNumberOfRelocations())
+    {
+      continue;
+    }
+
+    processed_one_relocation_table = true;
+
+    hadesmem::NtHeaders const nt_headers(process, cur_pe_file);
+    std::vector<BYTE> const image = hadesmem::ReadVector<BYTE>(
+      process, mod.GetHandle(), nt_headers.GetSizeOfImage());
+    BOOST_TEST(cur_relocation_table.GetRequiredSize() <= image.size());
+
+    // Rebase to somewhere else and back again, on one thread and on all.
+    std::uint64_t const delta = 0x10000000ULL;
+    for (std::size_t num_threads = 0; num_threads < 2; ++num_threads)
+    {
+      std::vector<BYTE> rebased = image;
+      cur_relocation_table.Apply(
+        rebased.data(), rebased.size(), delta, num_threads);
+      for (auto const rva : cur_relocation_table.GetHighLow())
+      {
+        std::uint32_t before = 0;
+        std::uint32_t after = 0;
+        std::memcpy(&before, &image[rva], sizeof(before));
+        std::memcpy(&after, &rebased[rva], sizeof(after));
+        BOOST_TEST_EQ(after, static_cast<std::uint32_t>(before + delta));
+      }
+      for (auto const rva : cur_relocation_table.GetDir64())
+      {
+        std::uint64_t before = 0;
+        std::uint64_t after = 0;
+        std::memcpy(&before, &image[rva], sizeof(before));
+        std::memcpy(&after, &rebased[rva], sizeof(after));
+        BOOST_TEST_EQ(after, before + delta);
+      }
+
+      cur_relocation_table.Revert(
+        rebased.data(), rebased.size(), delta, num_threads);
+      BOOST_TEST(rebased == image);
+    }
+
+    std::vector<BYTE> too_small(
+      static_cast<std::size_t>(cur_relocation_table.GetRequiredSize() - 1));
+    BOOST_TEST_THROWS(
+      cur_relocation_table.Apply(too_small.data(), too_small.size(), delta),
+      hadesmem::Error);
+  }
+
+  BOOST_TEST(processed_one_relocation_table);
+}
+
+int main()
+{
+  TestRelocationTable();
+  return boost::report_errors();
+}
@@ -0,0 +1,255 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/resource_dir.hpp>
+#include <hadesmem/pelib/resource_dir.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+DWORD const kTestRva = 0x3000;
+
+// Builds a resource directory by hand, so the layout (and the malformed
+// parts of it) are known.
+class TestResources
+{
+public:
+  DWORD AddDirectory(WORD num_named, WORD num_ids)
+  {
+    IMAGE_RESOURCE_DIRECTORY dir = {};
+    dir.NumberOfNamedEntries = num_named;
+    dir.NumberOfIdEntries = num_ids;
+    DWORD const offset = Append(&dir, sizeof(dir));
+    std::size_t const num_entries = num_named + num_ids;
+    data_.resize(data_.size() +
+                 num_entries * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY));
+    return offset;
+  }
+
+  void SetEntry(DWORD dir, std::size_t index, DWORD name, DWORD offset)
+  {
+    IMAGE_RESOURCE_DIRECTORY_ENTRY entry = {};
+    entry.Name = name;
+    entry.OffsetToData = offset;
+    std::memcpy(&data_[dir + sizeof(IMAGE_RESOURCE_DIRECTORY) +
+                       index * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY)],
+                &entry,
+                sizeof(entry));
+  }
+
+  DWORD AddName(std::wstring const& name)
+  {
+    std::vector<std::uint8_t> buf(sizeof(WORD) +
+                                  name.size() * sizeof(wchar_t));
+    auto const size = static_cast<WORD>(name.size());
+    std::memcpy(buf.data(), &size, sizeof(size));
+    std::memcpy(
+      buf.data() + sizeof(size), name.data(), name.size() * sizeof(wchar_t));
+    return Append(buf.data(), buf.size()) | IMAGE_RESOURCE_NAME_IS_STRING;
+  }
+
+  DWORD AddData(DWORD rva, DWORD size)
+  {
+    IMAGE_RESOURCE_DATA_ENTRY entry = {};
+    entry.OffsetToData = rva;
+    entry.Size = size;
+    entry.CodePage = 1252;
+    return Append(&entry, sizeof(entry));
+  }
+
+  DWORD Append(void const* data, std::size_t size)
+  {
+    auto const offset = static_cast<DWORD>(data_.size());
+    auto const bytes = static_cast<std::uint8_t const*>(data);
+    data_.insert(std::end(data_), bytes, bytes + size);
+    // Keep everything DWORD aligned, as resource compilers do.
+    data_.resize((data_.size() + 3) & ~3U);
+    return offset;
+  }
+
+  hadesmem::detail::ResourceRegion GetRegion() const
+  {
+    hadesmem::detail::ResourceRegion const region = {
+      data_.data(), static_cast<DWORD>(data_.size()), kTestRva};
+    return region;
+  }
+
+private:
+  std::vector<std::uint8_t> data_;
+};
+
+hadesmem::ResourceNode GetRoot(hadesmem::detail::ResourceRegion const& region)
+{
+  hadesmem::detail::ResourcePath const path = {{0}, 0};
+  return hadesmem::ResourceNode(region, 0, path);
+}
+}
+
+void TestResourceNode()
+{
+  TestResources resources;
+  DWORD const root = resources.AddDirectory(2, 3);
+  DWORD const version = resources.AddDirectory(0, 1);
+  DWORD const version_lang = resources.AddDirectory(0, 1);
+  DWORD const overflow = resources.AddDirectory(0, 0);
+  DWORD const bar = resources.AddName(L"BAR");
+  DWORD const foo = resources.AddName(L"FOO");
+  DWORD const payload = resources.Append("payload", 8);
+  DWORD const inside = resources.AddData(kTestRva + payload, 8);
+  DWORD const outside = resources.AddData(0x10000, 8);
+
+  resources.SetEntry(root, 0, bar, inside);
+  resources.SetEntry(root, 1, foo, outside);
+  resources.SetEntry(root, 2, 3, root | IMAGE_RESOURCE_DATA_IS_DIRECTORY);
+  resources.SetEntry(root, 3, 16, version | IMAGE_RESOURCE_DATA_IS_DIRECTORY);
+  resources.SetEntry(
+    root, 4, 24, overflow | IMAGE_RESOURCE_DATA_IS_DIRECTORY);
+  resources.SetEntry(
+    version, 0, 1, version_lang | IMAGE_RESOURCE_DATA_IS_DIRECTORY);
+  resources.SetEntry(version_lang, 0, 0x409, inside);
+
+  auto const region = resources.GetRegion();
+  auto const root_node = GetRoot(region);
+  BOOST_TEST_EQ(root_node.GetNumberOfNamedEntries(), 2UL);
+  BOOST_TEST_EQ(root_node.GetNumberOfIdEntries(), 3UL);
+
+  BOOST_TEST_EQ(root_node.FindName(L"BAR"), 0UL);
+  BOOST_TEST_EQ(root_node.FindName(L"FOO"), 1UL);
+  BOOST_TEST(root_node.FindName(L"FO") == hadesmem::ResourceNode::kNotFound);
+  BOOST_TEST(root_node.FindName(L"ZAP") == hadesmem::ResourceNode::kNotFound);
+  BOOST_TEST_EQ(root_node.FindId(3), 2UL);
+  BOOST_TEST_EQ(root_node.FindId(16), 3UL);
+  BOOST_TEST_EQ(root_node.FindId(24), 4UL);
+  BOOST_TEST(root_node.FindId(0) == hadesmem::ResourceNode::kNotFound);
+  BOOST_TEST(root_node.FindId(17) == hadesmem::ResourceNode::kNotFound);
+
+  // Names are viewed in place.
+  auto const bar_entry = root_node.GetEntry(0);
+  BOOST_TEST(bar_entry.IsNamed());
+  BOOST_TEST_EQ(bar_entry.GetId(), 0);
+  BOOST_TEST(bar_entry.GetName().ToString() == L"BAR");
+  DWORD const bar_offset = bar & ~IMAGE_RESOURCE_NAME_IS_STRING;
+  BOOST_TEST(reinterpret_cast<std::uint8_t const*>(
+               bar_entry.GetName().GetData()) ==
+             region.data + bar_offset + sizeof(WORD));
+  BOOST_TEST(!bar_entry.IsDirectory());
+  auto const bar_data = bar_entry.GetData();
+  BOOST_TEST_EQ(bar_data.rva, kTestRva + payload);
+  BOOST_TEST_EQ(bar_data.size, 8UL);
+  BOOST_TEST_EQ(bar_data.code_page, 1252UL);
+  BOOST_TEST(bar_data.data == region.data + payload);
+  BOOST_TEST_THROWS(bar_entry.GetDirectory(), hadesmem::Error);
+
+  // Data outside the resource directory has to be read by RVA.
+  auto const foo_data = root_node.GetEntry(1).GetData();
+  BOOST_TEST_EQ(foo_data.rva, 0x10000UL);
+  BOOST_TEST(foo_data.data == nullptr);
+
+  // Type -> name -> language.
+  auto const version_node = root_node.GetEntry(3).GetDirectory();
+  BOOST_TEST_EQ(version_node.GetDepth(), 1UL);
+  auto const lang_node = version_node.GetEntry(0).GetDirectory();
+  BOOST_TEST_EQ(lang_node.GetDepth(), 2UL);
+  BOOST_TEST_EQ(lang_node.FindId(0x409), 0UL);
+  BOOST_TEST(lang_node.GetEntry(0).GetData().data == region.data + payload);
+  BOOST_TEST_THROWS(lang_node.GetEntry(0).GetDirectory(), hadesmem::Error);
+
+  hadesmem::ResourceData first;
+  BOOST_TEST(hadesmem::detail::GetFirstResource(root_node, 16, first));
+  BOOST_TEST(first.data == region.data + payload);
+  BOOST_TEST(!hadesmem::detail::GetFirstResource(root_node, 5, first));
+
+  // A directory which refers back to the root.
+  BOOST_TEST_THROWS(root_node.GetEntry(2).GetDirectory(), hadesmem::Error);
+
+  // A directory which claims more entries than fit is clamped.
+  auto const overflow_node = root_node.GetEntry(4).GetDirectory();
+  BOOST_TEST_EQ(overflow_node.GetNumberOfEntries(), 0UL);
+  std::vector<std::uint8_t> truncated(region.data, region.data + region.size);
+  IMAGE_RESOURCE_DIRECTORY dir = {};
+  dir.NumberOfNamedEntries = 0xFFFF;
+  dir.NumberOfIdEntries = 0xFFFF;
+  std::memcpy(&truncated[overflow], &dir, sizeof(dir));
+  hadesmem::detail::ResourceRegion const truncated_region = {
+    truncated.data(), static_cast<DWORD>(truncated.size()), kTestRva};
+  auto const clamped_node =
+    GetRoot(truncated_region).GetEntry(4).GetDirectory();
+  BOOST_TEST_EQ(clamped_node.GetNumberOfEntries(),
+                (truncated.size() - overflow - sizeof(dir)) /
+                  sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY));
+  BOOST_TEST(clamped_node.FindId(1) == hadesmem::ResourceNode::kNotFound);
+
+  // A chain of directories deeper than any real tree.
+  TestResources deep;
+  std::vector<DWORD> dirs;
+  for (std::size_t i = 0; i <= hadesmem::detail::kResourceMaxDepth; ++i)
+  {
+    dirs.push_back(deep.AddDirectory(0, 1));
+  }
+  for (std::size_t i = 0; i + 1 < dirs.size(); ++i)
+  {
+    deep.SetEntry(
+      dirs[i], 0, 1, dirs[i + 1] | IMAGE_RESOURCE_DATA_IS_DIRECTORY);
+  }
+  auto const deep_region = deep.GetRegion();
+  auto node = GetRoot(deep_region);
+  while (node.GetDepth() + 1 < hadesmem::detail::kResourceMaxDepth)
+  {
+    node = node.GetEntry(0).GetDirectory();
+  }
+  BOOST_TEST_THROWS(node.GetEntry(0).GetDirectory(), hadesmem::Error);
+}
+
+void TestResourceDir()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const kernel32(process, L"kernel32.dll");
+  hadesmem::PeFile const pe_file_image(
+    process, kernel32.GetHandle(), hadesmem::PeFileType::Image, 0);
+
+  hadesmem::ResourceDir const resource_dir(process, pe_file_image);
+  auto const root = resource_dir.GetRoot();
+  BOOST_TEST(root.GetNumberOfEntries() != 0);
+  for (std::size_t i = root.GetNumberOfNamedEntries();
+       i < root.GetNumberOfEntries();
+       ++i)
+  {
+    BOOST_TEST_EQ(root.FindId(root.GetEntry(i).GetId()), i);
+  }
+  BOOST_TEST(root.FindId(16) != hadesmem::ResourceNode::kNotFound);
+
+  VS_FIXEDFILEINFO image_info = {};
+  BOOST_TEST(hadesmem::GetFixedFileInfo(process, pe_file_image, image_info));
+  BOOST_TEST_EQ(image_info.dwSignature, VS_FFI_SIGNATURE);
+
+  // The file has the same version resource.
+  hadesmem::MappedFile const file(kernel32.GetPath());
+  hadesmem::PeFile const pe_file_data(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+  VS_FIXEDFILEINFO data_info = {};
+  BOOST_TEST(hadesmem::GetFixedFileInfo(process, pe_file_data, data_info));
+  BOOST_TEST(std::memcmp(&image_info, &data_info, sizeof(image_info)) == 0);
+}
+
+int main()
+{
+  TestResourceNode();
+  TestResourceDir();
+  return boost::report_errors();
+}
@@ -0,0 +1,136 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/section_table.hpp>
+#include <hadesmem/pelib/section_table.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/module_list.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace
+{
+void CheckSectionTable(hadesmem::Process const& process,
+                       hadesmem::PeFile const& pe_file)
+{
+  hadesmem::NtHeaders const nt_headers(process, pe_file);
+  hadesmem::SectionTable const table(process, pe_file);
+  BOOST_TEST_EQ(table.size(), nt_headers.GetNumberOfSections());
+  BOOST_TEST_EQ(table.empty(), !nt_headers.GetNumberOfSections());
+  BOOST_TEST_EQ(static_cast<std::size_t>(
+                  std::distance(std::begin(table), std::end(table))),
+                table.size());
+  BOOST_TEST(table.data() == &*std::begin(table));
+
+  for (std::size_t i = 0; i < table.size(); ++i)
+  {
+    auto const raw =
+      hadesmem::Read<IMAGE_SECTION_HEADER>(process, table.GetBase() + i);
+    BOOST_TEST(std::memcmp(&raw, &table[i], sizeof(raw)) == 0);
+    BOOST_TEST(!table.IsVirtual(i));
+  }
+
+  // SectionList is a view over the same table.
+  hadesmem::SectionList const sections(process, pe_file);
+  std::size_t i = 0;
+  for (auto const& section : sections)
+  {
+    BOOST_TEST(i < table.size());
+    hadesmem::Section const expected(process, pe_file, table.GetBase() + i);
+    BOOST_TEST(section == expected);
+    BOOST_TEST(section == table.GetSection(i));
+    BOOST_TEST_EQ(section.GetName(), expected.GetName());
+    BOOST_TEST_EQ(section.GetVirtualAddress(), expected.GetVirtualAddress());
+    BOOST_TEST_EQ(section.GetSizeOfRawData(), expected.GetSizeOfRawData());
+    BOOST_TEST_EQ(section.GetCharacteristics(),
+                  expected.GetCharacteristics());
+    ++i;
+  }
+  BOOST_TEST_EQ(i, table.size());
+}
+}
+
+void TestSectionTable()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::ModuleList const modules(process);
+  for (auto const& mod : modules)
+  {
+    hadesmem::PeFile const pe_file(
+      process, mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+    CheckSectionTable(process, pe_file);
+  }
+
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  hadesmem::PeFile const pe_file_data(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+  CheckSectionTable(process, pe_file_data);
+}
+
+void TestSectionTableVirtual()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  hadesmem::PeFile const pe_file(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+  hadesmem::SectionTable const table(process, pe_file);
+  BOOST_TEST(table.size() >= 2);
+
+  // Cut the file off part way through the second section header.
+  auto const base = static_cast<std::uint8_t const*>(file.GetBase());
+  std::size_t const table_offset =
+    reinterpret_cast<std::uint8_t const*>(table.GetBase()) - base;
+  std::vector<std::uint8_t> data(
+    base, base + table_offset + sizeof(IMAGE_SECTION_HEADER) + 8);
+  hadesmem::PeFile const pe_file_cut(process,
+                                     data.data(),
+                                     hadesmem::PeFileType::Data,
+                                     static_cast<DWORD>(data.size()));
+  hadesmem::SectionTable const table_cut(process, pe_file_cut);
+  BOOST_TEST_EQ(table_cut.size(), table.size());
+  BOOST_TEST(!table_cut.IsVirtual(0));
+  BOOST_TEST(std::memcmp(&table_cut[0], &table[0], sizeof(table[0])) == 0);
+
+  IMAGE_SECTION_HEADER const zero = IMAGE_SECTION_HEADER{};
+  hadesmem::SectionList const sections(process, pe_file_cut);
+  std::size_t i = 0;
+  for (auto const& section : sections)
+  {
+    BOOST_TEST_EQ(section.IsVirtual(), i != 0);
+    BOOST_TEST_EQ(table_cut.IsVirtual(i), i != 0);
+    if (i)
+    {
+      BOOST_TEST(std::memcmp(&table_cut[i], &zero, sizeof(zero)) == 0);
+      BOOST_TEST_EQ(section.GetVirtualAddress(), 0UL);
+    }
+    ++i;
+  }
+  BOOST_TEST_EQ(i, table.size());
+}
+
+int main()
+{
+  TestSectionTable();
+  TestSectionTableVirtual();
+  return boost::report_errors();
+}
@@ -0,0 +1,221 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/string_extractor.hpp>
+#include <hadesmem/pelib/string_extractor.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/pelib/mapped_file.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+char const kNarrowString[] = "HadesMem string extractor test (narrow)";
+wchar_t const kWideString[] = L"HadesMem string extractor test (wide)";
+
+using ScannedString = std::tuple<std::size_t, bool, std::string>;
+
+std::vector<ScannedString> ScanInChunks(std::vector<std::uint8_t> const& data,
+                                        std::size_t chunk_size,
+                                        std::size_t min_length)
+{
+  std::vector<ScannedString> strings;
+  hadesmem::detail::StringScanner scanner{
+    min_length,
+    [&](std::size_t offset,
+        hadesmem::StringEncoding encoding,
+        std::string const& value)
+    {
+      strings.emplace_back(
+        offset, encoding == hadesmem::StringEncoding::kUtf16, value);
+    }};
+  for (std::size_t i = 0; i < data.size(); i += chunk_size)
+  {
+    std::size_t const size = (std::min)(chunk_size, data.size() - i);
+    int const next = i + size < data.size() ? data[i + size] : -1;
+    scanner.Scan(&data[i], size, next);
+  }
+  scanner.Finish();
+  std::sort(std::begin(strings), std::end(strings));
+  return strings;
+}
+
+// Returns the offset of the value, or zero if it wasn't found. The string
+// it's found in may have picked up printable bytes from before the value.
+DWORD FindString(hadesmem::StringExtractor const& strings,
+                 hadesmem::StringEncoding encoding,
+                 std::string const& value,
+                 WORD& section)
+{
+  DWORD const stride = encoding == hadesmem::StringEncoding::kUtf16 ? 2 : 1;
+  for (auto const& s : strings.GetStrings())
+  {
+    if (s.encoding == encoding && s.value.size() >= value.size() &&
+        s.value.compare(s.value.size() - value.size(), value.size(), value) ==
+          0)
+    {
+      section = s.section;
+      return s.offset +
+             static_cast<DWORD>(s.value.size() - value.size()) * stride;
+    }
+  }
+
+  return 0;
+}
+
+std::string GetSectionName(hadesmem::Process const& process,
+                           hadesmem::PeFile const& pe_file,
+                           WORD index)
+{
+  WORD i = 0;
+  hadesmem::SectionList const sections(process, pe_file);
+  for (auto const& section : sections)
+  {
+    if (i++ == index)
+    {
+      return section.GetName();
+    }
+  }
+
+  return std::string();
+}
+}
+
+void TestStringScanner()
+{
+  std::vector<std::uint8_t> data;
+  auto const append = [&](char const* s, std::size_t len)
+  {
+    data.insert(std::end(data), s, s + len);
+  };
+  // Narrow, then UTF-16 at an even offset, then (after one byte) UTF-16 at
+  // an odd offset, then a narrow string too short to report, then a long
+  // narrow string which spans several blocks.
+  append("abcd\0\0", 6);
+  append("e\0f\0g\0\0\0", 8);
+  append("\x01h\0i\0j\0k\0\0\0", 12);
+  append("xy\0\0", 4);
+  std::string const long_string(200, 'z');
+  append(long_string.c_str(), long_string.size());
+
+  std::vector<ScannedString> const expected = {
+    ScannedString{0, false, "abcd"},
+    ScannedString{6, true, "efg"},
+    ScannedString{15, true, "hijk"},
+    ScannedString{30, false, long_string}};
+
+  for (std::size_t chunk_size : {2, 6, 64, 66, 1024})
+  {
+    BOOST_TEST(ScanInChunks(data, chunk_size, 3) == expected);
+  }
+
+  // Every printable character is a string of its own, and the final 'z'
+  // is followed by an unknown byte, so it isn't UTF-16.
+  auto const all = ScanInChunks(data, 64, 0);
+  BOOST_TEST(std::count_if(std::begin(all),
+                           std::end(all),
+                           [](ScannedString const& s)
+                           {
+    return std::get<1>(s) && std::get<2>(s) == "y";
+  }) == 1);
+  BOOST_TEST(std::get<2>(all.back()) == long_string);
+}
+
+void TestStringExtractor()
+{
+  // Make sure the strings are referenced.
+  BOOST_TEST_EQ(std::strlen(kNarrowString), sizeof(kNarrowString) - 1);
+  BOOST_TEST_EQ(std::wcslen(kWideString),
+                sizeof(kWideString) / sizeof(wchar_t) - 1);
+
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::Module const this_mod(process, nullptr);
+  auto const base = reinterpret_cast<std::uint8_t*>(this_mod.GetHandle());
+
+  hadesmem::PeFile const pe_file_image(
+    process, this_mod.GetHandle(), hadesmem::PeFileType::Image, 0);
+  hadesmem::StringExtractor const image_strings(process, pe_file_image);
+  WORD narrow_section = 0;
+  BOOST_TEST_EQ(FindString(image_strings,
+                           hadesmem::StringEncoding::kAscii,
+                           kNarrowString,
+                           narrow_section),
+                static_cast<DWORD>(
+                  reinterpret_cast<std::uint8_t const*>(kNarrowString) -
+                  base));
+  BOOST_TEST(narrow_section != hadesmem::StringExtractor::kNoSection);
+  BOOST_TEST(GetSectionName(process, pe_file_image, narrow_section) ==
+             ".rdata");
+  WORD wide_section = 0;
+  BOOST_TEST_EQ(FindString(image_strings,
+                           hadesmem::StringEncoding::kUtf16,
+                           "HadesMem string extractor test (wide)",
+                           wide_section),
+                static_cast<DWORD>(
+                  reinterpret_cast<std::uint8_t const*>(kWideString) - base));
+  BOOST_TEST_EQ(wide_section, narrow_section);
+
+  auto const& strings = image_strings.GetStrings();
+  BOOST_TEST(std::is_sorted(std::begin(strings),
+                            std::end(strings),
+                            [](hadesmem::ExtractedString const& lhs,
+                               hadesmem::ExtractedString const& rhs)
+                            {
+    return lhs.offset < rhs.offset;
+  }));
+  BOOST_TEST(std::none_of(std::begin(strings),
+                          std::end(strings),
+                          [](hadesmem::ExtractedString const& s)
+                          {
+    return s.value.size() < 3;
+  }));
+
+  hadesmem::MappedFile const file(this_mod.GetPath());
+  hadesmem::PeFile const pe_file_data(
+    process, file.GetBase(), hadesmem::PeFileType::Data, file.GetSize());
+  hadesmem::StringExtractor const data_strings(process, pe_file_data);
+  WORD data_section = 0;
+  DWORD const data_offset = FindString(data_strings,
+                                       hadesmem::StringEncoding::kAscii,
+                                       kNarrowString,
+                                       data_section);
+  BOOST_TEST(data_offset != 0);
+  BOOST_TEST_EQ(data_section, narrow_section);
+  BOOST_TEST(
+    std::memcmp(static_cast<std::uint8_t const*>(file.GetBase()) + data_offset,
+                kNarrowString,
+                sizeof(kNarrowString)) == 0);
+
+  hadesmem::StringExtractor const long_strings(process, pe_file_data, 0x100);
+  BOOST_TEST(long_strings.GetStrings().size() <
+             data_strings.GetStrings().size());
+  BOOST_TEST_EQ(FindString(long_strings,
+                           hadesmem::StringEncoding::kAscii,
+                           kNarrowString,
+                           data_section),
+                0UL);
+}
+
+int main()
+{
+  TestStringScanner();
+  TestStringExtractor();
+  return boost::report_errors();
+}
@@ -0,0 +1,135 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pointer_chain.hpp>
+#include <hadesmem/pointer_chain.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+struct Inner
+{
+  std::uint32_t padding[0x12];
+  std::uint32_t health;
+};
+
+struct Outer
+{
+  std::uint32_t padding[0x04];
+  Inner* inner;
+};
+
+Outer* volatile g_outer = reinterpret_cast<Outer*>(1);
+}
+
+void TestPointerChain()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::unique_ptr<Inner> inner(new Inner());
+  std::unique_ptr<Inner> inner_other(new Inner());
+  std::unique_ptr<Outer> outer(new Outer());
+  outer->inner = inner.get();
+  g_outer = outer.get();
+
+  std::vector<std::uint32_t> const offsets = {
+    static_cast<std::uint32_t>(offsetof(Outer, inner)),
+    static_cast<std::uint32_t>(offsetof(Inner, health))};
+
+  BOOST_TEST_THROWS(hadesmem::PointerChain(process,
+                                           const_cast<Outer**>(&g_outer),
+                                           std::vector<std::uint32_t>()),
+                    hadesmem::Error);
+
+  hadesmem::PointerChain chain(
+    process, const_cast<Outer**>(&g_outer), offsets);
+  BOOST_TEST_EQ(chain.Resolve(), static_cast<PVOID>(&inner->health));
+
+  outer->inner = inner_other.get();
+  BOOST_TEST_EQ(chain.Resolve(), static_cast<PVOID>(&inner_other->health));
+
+  // A long TTL keeps serving the cached walk until invalidated.
+  chain.SetTtl(std::chrono::milliseconds(1000 * 60 * 60));
+  BOOST_TEST_EQ(chain.Resolve(), static_cast<PVOID>(&inner_other->health));
+  outer->inner = inner.get();
+  BOOST_TEST_EQ(chain.Resolve(), static_cast<PVOID>(&inner_other->health));
+  chain.Invalidate();
+  BOOST_TEST_EQ(chain.Resolve(), static_cast<PVOID>(&inner->health));
+
+  // Generations ignore the TTL.
+  BOOST_TEST_EQ(chain.Resolve(1), static_cast<PVOID>(&inner->health));
+  outer->inner = inner_other.get();
+  BOOST_TEST_EQ(chain.Resolve(1), static_cast<PVOID>(&inner->health));
+  BOOST_TEST_EQ(chain.Resolve(2), static_cast<PVOID>(&inner_other->health));
+
+  outer->inner = nullptr;
+  BOOST_TEST_EQ(chain.Resolve(3), static_cast<PVOID>(nullptr));
+  outer->inner = inner.get();
+  BOOST_TEST_EQ(chain.Resolve(3), static_cast<PVOID>(&inner->health));
+
+  hadesmem::Module const module(process, nullptr);
+  auto const module_offset =
+    reinterpret_cast<std::uintptr_t>(&g_outer) -
+    reinterpret_cast<std::uintptr_t>(module.GetHandle());
+  hadesmem::PointerChain const chain_module(
+    process, module.GetName(), module_offset, offsets);
+  BOOST_TEST_EQ(chain_module.GetBase(),
+                static_cast<PVOID>(const_cast<Outer**>(&g_outer)));
+  hadesmem::PointerPath path;
+  path.module_name = module.GetName();
+  path.module_offset = module_offset;
+  path.offsets = offsets;
+  hadesmem::PointerChain chain_path(process, path);
+  BOOST_TEST_EQ(chain_path.Resolve(), static_cast<PVOID>(&inner->health));
+}
+
+void TestResolvePointerChains()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::unique_ptr<Inner> inner(new Inner());
+  std::unique_ptr<Outer> outer(new Outer());
+  outer->inner = inner.get();
+  Outer* outer_ptr = outer.get();
+  Outer* null_ptr = nullptr;
+
+  std::vector<std::uint32_t> const offsets = {
+    static_cast<std::uint32_t>(offsetof(Outer, inner)),
+    static_cast<std::uint32_t>(offsetof(Inner, health))};
+  std::vector<std::uint32_t> const offsets_short = {
+    static_cast<std::uint32_t>(offsetof(Outer, padding))};
+
+  hadesmem::PointerChain chain_1(process, &outer_ptr, offsets);
+  hadesmem::PointerChain chain_2(process, &outer_ptr, offsets_short);
+  hadesmem::PointerChain chain_3(process, &null_ptr, offsets);
+  std::vector<hadesmem::PointerChain*> const chains = {
+    &chain_1, &chain_2, &chain_3};
+
+  auto const results = hadesmem::ResolvePointerChains(process, chains);
+  BOOST_TEST_EQ(results.size(), 3UL);
+  BOOST_TEST_EQ(results[0], static_cast<PVOID>(&inner->health));
+  BOOST_TEST_EQ(results[1], static_cast<PVOID>(&outer->padding[0]));
+  BOOST_TEST_EQ(results[2], static_cast<PVOID>(nullptr));
+
+  BOOST_TEST_EQ(chain_1.Resolve(), static_cast<PVOID>(&inner->health));
+}
+
+int main()
+{
+  TestPointerChain();
+  TestResolvePointerChains();
+  return boost::report_errors();
+}
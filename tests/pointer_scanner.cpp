@@ -0,0 +1,132 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pointer_scanner.hpp>
+#include <hadesmem/pointer_scanner.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/module.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+struct Inner
+{
+  std::uint32_t padding[0x10];
+  std::uint32_t health;
+};
+
+struct Outer
+{
+  std::uint32_t padding[0x08];
+  Inner* inner;
+};
+
+// Initialized so it lives in the image rather than in an anonymous mapping.
+Outer* volatile g_outer = reinterpret_cast<Outer*>(1);
+
+bool HasPath(std::vector<hadesmem::PointerPath> const& paths,
+             std::uintptr_t module_offset,
+             std::vector<std::uint32_t> const& offsets)
+{
+  return std::find_if(std::begin(paths),
+                      std::end(paths),
+                      [&](hadesmem::PointerPath const& path)
+                      {
+           return path.module_offset == module_offset &&
+                  path.offsets == offsets;
+         }) != std::end(paths);
+}
+}
+
+void TestPointerScanner()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::unique_ptr<Inner> inner(new Inner());
+  std::unique_ptr<Outer> outer(new Outer());
+  outer->inner = inner.get();
+  g_outer = outer.get();
+
+  hadesmem::Module const module(process, nullptr);
+  auto const module_offset =
+    reinterpret_cast<std::uintptr_t>(&g_outer) -
+    reinterpret_cast<std::uintptr_t>(module.GetHandle());
+  std::vector<std::uint32_t> const expected_offsets = {
+    static_cast<std::uint32_t>(offsetof(Outer, inner)),
+    static_cast<std::uint32_t>(offsetof(Inner, health))};
+
+  hadesmem::PointerScanner const scanner(
+    process, hadesmem::MemoryScanFlags::kWritableOnly);
+  BOOST_TEST(scanner.GetIndexSize() > 0);
+
+  auto const paths = scanner.Scan(&inner->health, 3, 0x100);
+  BOOST_TEST(HasPath(paths, module_offset, expected_offsets));
+  BOOST_TEST(scanner.Scan(&inner->health, 1, 0x100).size() <= paths.size());
+  BOOST_TEST(!HasPath(
+    scanner.Scan(&inner->health, 3, 0x10), module_offset, expected_offsets));
+  BOOST_TEST_EQ(scanner.Scan(&inner->health, 3, 0x100, 1).size(), 1UL);
+
+  for (auto const& path : paths)
+  {
+    if (path.module_offset == module_offset &&
+        path.offsets == expected_offsets)
+    {
+      BOOST_TEST_EQ(hadesmem::ResolvePointerPath(process, path),
+                    static_cast<PVOID>(&inner->health));
+    }
+  }
+
+  auto const valid =
+    hadesmem::FilterPointerPaths(process, paths, &inner->health);
+  BOOST_TEST(HasPath(valid, module_offset, expected_offsets));
+
+  BOOST_TEST_THROWS(hadesmem::PointerScanner(
+                      process, hadesmem::MemoryScanFlags::kWritableOnly, 1),
+                    hadesmem::Error);
+}
+
+void TestPointerPathFile()
+{
+  hadesmem::PointerPath path;
+  path.module_name = L"foo.dll";
+  path.module_offset = 0x1234;
+  path.offsets.push_back(0x10);
+  path.offsets.push_back(0x20);
+  hadesmem::PointerPath path_other;
+  path_other.module_name = L"bar.dll";
+  path_other.module_offset = 0x5678;
+  path_other.offsets.push_back(0x30);
+  std::vector<hadesmem::PointerPath> const paths = {path, path_other, path};
+
+  std::wstring const file_path = L"pointer_scanner_test.bin";
+  hadesmem::SavePointerPaths(file_path, paths);
+  auto const loaded = hadesmem::LoadPointerPaths(file_path);
+  BOOST_TEST_EQ(loaded.size(), paths.size());
+  for (std::size_t i = 0; i < loaded.size() && i < paths.size(); ++i)
+  {
+    BOOST_TEST(loaded[i].module_name == paths[i].module_name);
+    BOOST_TEST_EQ(loaded[i].module_offset, paths[i].module_offset);
+    BOOST_TEST(loaded[i].offsets == paths[i].offsets);
+  }
+
+  BOOST_TEST_THROWS(hadesmem::LoadPointerPaths(L"pointer_scanner_missing.bin"),
+                    hadesmem::Error);
+}
+
+int main()
+{
+  TestPointerScanner();
+  TestPointerPathFile();
+  return boost::report_errors();
+}
@@ -0,0 +1,81 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/remote_view.hpp>
+#include <hadesmem/remote_view.hpp>
+
+#include <cstdint>
+#include <memory>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+struct BigStruct
+{
+  std::uint32_t a;
+  std::uint8_t padding_1[0x100];
+  std::uint32_t b;
+  std::uint8_t padding_2[0x1000];
+  std::uint64_t c;
+};
+}
+
+void TestRemoteView()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::unique_ptr<BigStruct> big(new BigStruct());
+  big->a = 1;
+  big->b = 2;
+  big->c = 3;
+
+  hadesmem::RemoteView<BigStruct> view(process, big.get());
+  BOOST_TEST_EQ(view.GetAddress(), static_cast<PVOID>(big.get()));
+  BOOST_TEST_EQ(view.Get(&BigStruct::a), 1U);
+
+  // Fields are fetched lazily and then cached until invalidated.
+  big->a = 10;
+  big->b = 20;
+  BOOST_TEST_EQ(view.Get(&BigStruct::a), 1U);
+  BOOST_TEST_EQ(view.Get(&BigStruct::b), 20U);
+
+  view.Invalidate();
+  big->c = 30;
+  view.Prefetch(&BigStruct::a, &BigStruct::c);
+  big->a = 100;
+  big->c = 300;
+  BOOST_TEST_EQ(view.Get(&BigStruct::a), 10U);
+  BOOST_TEST_EQ(view.Get(&BigStruct::c), 30ULL);
+
+  // Dirty fields survive fetches and are only written on Flush.
+  view.Invalidate();
+  view.Set(&BigStruct::b, static_cast<std::uint32_t>(5));
+  BOOST_TEST(view.IsDirty());
+  BOOST_TEST_EQ(big->b, 20U);
+  BOOST_TEST_EQ(view.Get(&BigStruct::b), 5U);
+  BOOST_TEST_EQ(view.Get(&BigStruct::a), 100U);
+  view.Flush();
+  BOOST_TEST(!view.IsDirty());
+  BOOST_TEST_EQ(big->b, 5U);
+  BOOST_TEST_EQ(big->a, 100U);
+
+  view.Invalidate();
+  BOOST_TEST_EQ(view.Get().c, 300ULL);
+
+  hadesmem::RemoteView<BigStruct> view_invalid(
+    process, reinterpret_cast<PVOID>(static_cast<std::uintptr_t>(0x10000)));
+  BOOST_TEST_THROWS(view_invalid.Get(&BigStruct::a), hadesmem::Error);
+}
+
+int main()
+{
+  TestRemoteView();
+  return boost::report_errors();
+}
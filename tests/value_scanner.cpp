@@ -0,0 +1,140 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/value_scanner.hpp>
+#include <hadesmem/value_scanner.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+template <typename T>
+bool HasCandidate(hadesmem::ValueScanner<T> const& scanner, void* address)
+{
+  auto const addresses = scanner.GetAddresses();
+  return std::find(std::begin(addresses), std::end(addresses), address) !=
+         std::end(addresses);
+}
+}
+
+void TestValueScannerExact()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  // Values are built at runtime so the only copies in memory are the ones
+  // in the buffer (and in the scanner's own candidate storage).
+  volatile std::uint32_t const seed = 0x13371337;
+  std::vector<std::uint32_t> buf(0x2000, 0);
+  buf[0] = seed;
+  buf[0x401] = seed;
+  buf[0x1FFF] = seed;
+
+  hadesmem::ValueScanner<std::uint32_t> scanner(
+    process, sizeof(std::uint32_t), hadesmem::MemoryScanFlags::kWritableOnly);
+  BOOST_TEST_THROWS(scanner.NextScan(hadesmem::ValueScanFilter::kChanged),
+                    hadesmem::Error);
+
+  scanner.FirstScanExact(seed);
+  BOOST_TEST(scanner.GetCount() >= 3);
+  BOOST_TEST(HasCandidate(scanner, &buf[0]));
+  BOOST_TEST(HasCandidate(scanner, &buf[0x401]));
+  BOOST_TEST(HasCandidate(scanner, &buf[0x1FFF]));
+  BOOST_TEST(!HasCandidate(scanner, &buf[1]));
+
+  buf[0x401] = seed + 1;
+  scanner.NextScan(hadesmem::ValueScanFilter::kIncreased);
+  BOOST_TEST(HasCandidate(scanner, &buf[0x401]));
+  BOOST_TEST(!HasCandidate(scanner, &buf[0]));
+  BOOST_TEST(!HasCandidate(scanner, &buf[0x1FFF]));
+
+  scanner.NextScan(hadesmem::ValueScanFilter::kUnchanged);
+  BOOST_TEST(HasCandidate(scanner, &buf[0x401]));
+
+  buf[0x401] = seed - 1;
+  scanner.NextScan(hadesmem::ValueScanFilter::kDecreased);
+  BOOST_TEST(HasCandidate(scanner, &buf[0x401]));
+
+  scanner.NextScan(hadesmem::ValueScanFilter::kEqual, seed - 1);
+  BOOST_TEST(HasCandidate(scanner, &buf[0x401]));
+
+  buf[0x401] = 0;
+  scanner.NextScan(hadesmem::ValueScanFilter::kChanged);
+  BOOST_TEST(HasCandidate(scanner, &buf[0x401]));
+  scanner.NextScan(hadesmem::ValueScanFilter::kEqual, seed);
+  BOOST_TEST(!HasCandidate(scanner, &buf[0x401]));
+}
+
+void TestValueScannerUnaligned()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  volatile std::uint16_t const seed = 0xBEEF;
+  std::vector<std::uint8_t> buf(0x3000, 0);
+  // Straddle a page boundary somewhere in the buffer.
+  auto const page_end =
+    (reinterpret_cast<std::uintptr_t>(buf.data()) + 0x1000) &
+    ~static_cast<std::uintptr_t>(0xFFF);
+  auto const straddle = reinterpret_cast<std::uint8_t*>(page_end - 1);
+  std::uint16_t const value = seed;
+  std::copy(reinterpret_cast<std::uint8_t const*>(&value),
+            reinterpret_cast<std::uint8_t const*>(&value) + sizeof(value),
+            straddle);
+
+  hadesmem::ValueScanner<std::uint16_t> scanner(
+    process, 1, hadesmem::MemoryScanFlags::kWritableOnly);
+  scanner.FirstScanExact(seed);
+  BOOST_TEST(HasCandidate(scanner, straddle));
+}
+
+void TestValueScannerRangeAndUnknown()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  volatile float const seed = 12345.5f;
+  std::vector<float> buf(0x400, 0.0f);
+  buf[0x10] = seed;
+
+  hadesmem::ValueScanner<float> scanner(
+    process, sizeof(float), hadesmem::MemoryScanFlags::kWritableOnly);
+  scanner.FirstScanRange(seed - 0.25f, seed + 0.25f);
+  BOOST_TEST(HasCandidate(scanner, &buf[0x10]));
+
+  std::vector<double> buf_unknown(0x200, 1.0);
+  hadesmem::ValueScanner<double> scanner_unknown(
+    process, sizeof(double), hadesmem::MemoryScanFlags::kWritableOnly);
+  scanner_unknown.FirstScanUnknown();
+  BOOST_TEST(HasCandidate(scanner_unknown, &buf_unknown[0x100]));
+  buf_unknown[0x100] = 2.0;
+  scanner_unknown.NextScan(hadesmem::ValueScanFilter::kIncreased);
+  BOOST_TEST(HasCandidate(scanner_unknown, &buf_unknown[0x100]));
+  BOOST_TEST(!HasCandidate(scanner_unknown, &buf_unknown[0x101]));
+
+  std::size_t count = 0;
+  scanner_unknown.ForEach([&](void* address, double v)
+                          {
+    if (address == &buf_unknown[0x100])
+    {
+      BOOST_TEST_EQ(v, 2.0);
+    }
+    ++count;
+  });
+  BOOST_TEST_EQ(count, scanner_unknown.GetCount());
+}
+
+int main()
+{
+  TestValueScannerExact();
+  TestValueScannerUnaligned();
+  TestValueScannerRangeAndUnknown();
+  return boost::report_errors();
+}
@@ -0,0 +1,134 @@
+// Copyright (C) 2010-2014 Joshua Boyce.
+// See the file COPYING for copying permission.
+
+#include <hadesmem/watch_list.hpp>
+#include <hadesmem/watch_list.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+void TestWatchList()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::uint32_t volatile values[4] = {1, 2, 3, 4};
+  std::uint64_t volatile other = 5;
+
+  hadesmem::WatchList watch_list(process);
+
+  BOOST_TEST_THROWS(watch_list.Add(nullptr, 4), hadesmem::Error);
+
+  auto const id_0 = watch_list.Add(
+    const_cast<std::uint32_t*>(&values[0]), sizeof(values[0]), 1);
+  auto const id_2 = watch_list.Add(
+    const_cast<std::uint32_t*>(&values[2]), sizeof(values[2]), 1);
+  auto const id_other =
+    watch_list.Add(const_cast<std::uint64_t*>(&other), sizeof(other), 2);
+
+  std::vector<std::uint64_t> ids;
+  std::vector<std::uint32_t> old_values;
+  std::vector<std::uint32_t> new_values;
+  auto const subscriber = watch_list.Subscribe(
+    [&](hadesmem::WatchChange const& change)
+    {
+      ids.push_back(change.id);
+      if (change.type == 1)
+      {
+        std::uint32_t old_value = 0;
+        std::uint32_t new_value = 0;
+        std::memcpy(&old_value, change.old_data, sizeof(old_value));
+        std::memcpy(&new_value, change.new_data, sizeof(new_value));
+        old_values.push_back(old_value);
+        new_values.push_back(new_value);
+      }
+    });
+
+  // The first poll only establishes the baseline.
+  watch_list.Poll();
+  BOOST_TEST(ids.empty());
+  watch_list.Poll();
+  BOOST_TEST(ids.empty());
+
+  values[1] = 20;
+  watch_list.Poll();
+  BOOST_TEST(ids.empty());
+
+  values[2] = 30;
+  watch_list.Poll();
+  BOOST_TEST_EQ(ids.size(), 1UL);
+  BOOST_TEST_EQ(ids[0], id_2);
+  BOOST_TEST_EQ(old_values[0], 3U);
+  BOOST_TEST_EQ(new_values[0], 30U);
+
+  // Removing a watch keeps the baselines of the others.
+  watch_list.Remove(id_2);
+  values[0] = 10;
+  other = 50;
+  watch_list.Poll();
+  BOOST_TEST_EQ(ids.size(), 3UL);
+  BOOST_TEST_EQ(ids[1], id_0);
+  BOOST_TEST_EQ(ids[2], id_other);
+  BOOST_TEST_EQ(old_values[1], 1U);
+  BOOST_TEST_EQ(new_values[1], 10U);
+
+  watch_list.Unsubscribe(subscriber);
+  values[0] = 100;
+  watch_list.Poll();
+  BOOST_TEST_EQ(ids.size(), 3UL);
+
+  auto const stats = watch_list.GetStats();
+  BOOST_TEST_EQ(stats.polls, 6UL);
+  BOOST_TEST_EQ(stats.changes, 4UL);
+  BOOST_TEST_EQ(stats.read_failures, 0UL);
+  BOOST_TEST(stats.reads >= stats.polls);
+}
+
+void TestWatchListThread()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::uint32_t volatile value = 0;
+
+  hadesmem::WatchList watch_list(process, std::chrono::milliseconds(1));
+  watch_list.Add(const_cast<std::uint32_t*>(&value), sizeof(value));
+  std::atomic<std::uint32_t> num_changes{0};
+  watch_list.Subscribe([&](hadesmem::WatchChange const& /*change*/)
+                       {
+                         ++num_changes;
+                       });
+  watch_list.Start();
+
+  for (std::size_t i = 0; i < 1000 && watch_list.GetStats().polls < 2; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  value = 1;
+
+  for (std::size_t i = 0; i < 1000 && !num_changes; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  watch_list.Stop();
+  BOOST_TEST_EQ(num_changes.load(), 1U);
+}
+
+int main()
+{
+  TestWatchList();
+  TestWatchListThread();
+  return boost::report_errors();
+}